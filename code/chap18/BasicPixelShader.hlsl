@@ -8,10 +8,6 @@ struct PixelOutput
 	float4 highLum : SV_TARGET2;
 };
 
-Texture2D<float4> tex : register(t0);
-Texture2D<float4> sph : register(t1);
-Texture2D<float4> spa : register(t2);
-Texture2D<float4> toon : register(t3);
 Texture2D<float> lightDepthTex : register(t4);
 SamplerState smp : register(s0);
 SamplerState smpToon : register(s1);
@@ -23,27 +19,28 @@ static float3 convertYuvFromRgb(float3 rgb);
 
 float4 BasicPs(Output input) : SV_TARGET
 {
+	const Material mat = materials[materialIdx];
 	const float3 light = normalize(float3(1, -1, 1));
 	const float3 lightColor = float3(1, 1, 1);
 
 	const float diffuseB = saturate(dot(-light, input.normal.xyz));
-	const float4 toonDif = toon.Sample(smpToon, float2(0, 1.0f - diffuseB));
+	const float4 toonDif = textures[mat.toonIdx].Sample(smpToon, float2(0, 1.0f - diffuseB));
 
 	const float3 refLight = normalize(reflect(light, input.normal.xyz));
-	const float specularB = pow(saturate(dot(refLight, -input.ray)), specular.a);
+	const float specularB = pow(saturate(dot(refLight, -input.ray)), mat.specularity);
 
 	const float2 sphereMapUv = (input.vnormal.xy + float2(1, -1)) * float2(0.5, -0.5);
 
-	const float4 texColor = tex.Sample(smp, input.uv);
+	const float4 texColor = textures[mat.texIdx].Sample(smp, input.uv);
 
 	return max(
 		toonDif // brightness (toon)
-		* diffuse // diffuse
+		* float4(mat.diffuse, mat.alpha) // diffuse
 		* texColor // texture color
-		* sph.Sample(smp, sphereMapUv) // sphere map (multiply)
-		+ saturate(spa.Sample(smp, sphereMapUv) * texColor // sphere map (add)
-			+ float4(specularB * specular.rgb, 1)) // (specular)
-		, float4(texColor.rgb * ambient, 1)); // (ambient)
+		* textures[mat.sphIdx].Sample(smp, sphereMapUv) // sphere map (multiply)
+		+ saturate(textures[mat.spaIdx].Sample(smp, sphereMapUv) * texColor // sphere map (add)
+			+ float4(specularB * mat.specular, 1)) // (specular)
+		, float4(texColor.rgb * mat.ambient, 1)); // (ambient)
 }
 
 float4 BasicWithShadowInstancePs(Output input) : SV_TARGET
@@ -54,43 +51,45 @@ float4 BasicWithShadowInstancePs(Output input) : SV_TARGET
 		return float4(0, 0, 0, 1);
 	}
 
+	const Material mat = materials[materialIdx];
 	const float3 light = normalize(float3(1, -1, 1));
 	const float3 lightColor = float3(1, 1, 1);
 
 	const float diffuseB = saturate(dot(-light, input.normal.xyz));
-	const float4 toonDif = toon.Sample(smpToon, float2(0, 1.0f - diffuseB));
+	const float4 toonDif = textures[mat.toonIdx].Sample(smpToon, float2(0, 1.0f - diffuseB));
 
 	const float3 refLight = normalize(reflect(light, input.normal.xyz));
-	const float specularB = pow(saturate(dot(refLight, -input.ray)), specular.a);
+	const float specularB = pow(saturate(dot(refLight, -input.ray)), mat.specularity);
 
 	const float2 sphereMapUv = (input.vnormal.xy + float2(1, -1)) * float2(0.5, -0.5);
 
-	const float4 texColor = tex.Sample(smp, input.uv);
+	const float4 texColor = textures[mat.texIdx].Sample(smp, input.uv);
 
 	return max(
 		toonDif // brightness (toon)
-		* diffuse // diffuse
+		* float4(mat.diffuse, mat.alpha) // diffuse
 		* texColor // texture color
-		* sph.Sample(smp, sphereMapUv) // sphere map (multiply)
-		+ saturate(spa.Sample(smp, sphereMapUv) * texColor // sphere map (add)
-			+ float4(specularB * specular.rgb, 1)) // (specular)
-		, float4(texColor.rgb * ambient, 1)); // (ambient)
+		* textures[mat.sphIdx].Sample(smp, sphereMapUv) // sphere map (multiply)
+		+ saturate(textures[mat.spaIdx].Sample(smp, sphereMapUv) * texColor // sphere map (add)
+			+ float4(specularB * mat.specular, 1)) // (specular)
+		, float4(texColor.rgb * mat.ambient, 1)); // (ambient)
 }
 
 float4 BasicWithShadowMapPs(Output input) : SV_TARGET
 {
+	const Material mat = materials[materialIdx];
 	const float3 light = normalize(float3(1, -1, 1));
 	const float3 lightColor = float3(1, 1, 1);
 
 	const float diffuseB = saturate(dot(-light, input.normal.xyz));
-	const float4 toonDif = toon.Sample(smpToon, float2(0, 1.0f - diffuseB));
+	const float4 toonDif = textures[mat.toonIdx].Sample(smpToon, float2(0, 1.0f - diffuseB));
 
 	const float3 refLight = normalize(reflect(light, input.normal.xyz));
-	const float specularB = pow(saturate(dot(refLight, -input.ray)), specular.a);
+	const float specularB = pow(saturate(dot(refLight, -input.ray)), mat.specularity);
 
 	const float2 sphereMapUv = (input.vnormal.xy + float2(1, -1)) * float2(0.5, -0.5);
 
-	const float4 texColor = tex.Sample(smp, input.uv);
+	const float4 texColor = textures[mat.texIdx].Sample(smp, input.uv);
 
 	const float3 posFromLightVP = input.tpos.xyz / input.tpos.w;
 
@@ -100,30 +99,31 @@ float4 BasicWithShadowMapPs(Output input) : SV_TARGET
 
 	const float4 ret = max(
 		toonDif // brightness (toon)
-		* diffuse // diffuse
+		* float4(mat.diffuse, mat.alpha) // diffuse
 		* texColor // texture color
-		* sph.Sample(smp, sphereMapUv) // sphere map (multiply)
-		+ saturate(spa.Sample(smp, sphereMapUv) * texColor // sphere map (add)
-			+ float4(specularB * specular.rgb, 1)) // (specular)
-		, float4(texColor.rgb * ambient, 1)); // (ambient)
+		* textures[mat.sphIdx].Sample(smp, sphereMapUv) // sphere map (multiply)
+		+ saturate(textures[mat.spaIdx].Sample(smp, sphereMapUv) * texColor // sphere map (add)
+			+ float4(specularB * mat.specular, 1)) // (specular)
+		, float4(texColor.rgb * mat.ambient, 1)); // (ambient)
 
 	return float4(ret.rgb * shadowWeight, ret.a);
 }
 
 PixelOutput MrtWithShadowMapPs(Output input)
 {
+	const Material mat = materials[materialIdx];
 	const float3 light = normalize(float3(1, -1, 1));
 	const float3 lightColor = float3(1, 1, 1);
 
 	const float diffuseB = saturate(dot(-light, input.normal.xyz));
-	const float4 toonDif = toon.Sample(smpToon, float2(0, 1.0f - diffuseB));
+	const float4 toonDif = textures[mat.toonIdx].Sample(smpToon, float2(0, 1.0f - diffuseB));
 
 	const float3 refLight = normalize(reflect(light, input.normal.xyz));
-	const float specularB = pow(saturate(dot(refLight, -input.ray)), specular.a);
+	const float specularB = pow(saturate(dot(refLight, -input.ray)), mat.specularity);
 
 	const float2 sphereMapUv = (input.vnormal.xy + float2(1, -1)) * float2(0.5, -0.5);
 
-	const float4 texColor = tex.Sample(smp, input.uv);
+	const float4 texColor = textures[mat.texIdx].Sample(smp, input.uv);
 
 	const float3 posFromLightVP = input.tpos.xyz / input.tpos.w;
 
@@ -133,12 +133,12 @@ PixelOutput MrtWithShadowMapPs(Output input)
 
 	const float4 ret = max(
 		toonDif // brightness (toon)
-		* diffuse // diffuse
+		* float4(mat.diffuse, mat.alpha) // diffuse
 		* texColor // texture color
-		* sph.Sample(smp, sphereMapUv) // sphere map (multiply)
-		+ saturate(spa.Sample(smp, sphereMapUv) * texColor // sphere map (add)
-			+ float4(specularB * specular.rgb, 1)) // (specular)
-		, float4(texColor.rgb * ambient, 1)); // (ambient)
+		* textures[mat.sphIdx].Sample(smp, sphereMapUv) // sphere map (multiply)
+		+ saturate(textures[mat.spaIdx].Sample(smp, sphereMapUv) * texColor // sphere map (add)
+			+ float4(specularB * mat.specular, 1)) // (specular)
+		, float4(texColor.rgb * mat.ambient, 1)); // (ambient)
 
 	PixelOutput output;
 	{
@@ -16,9 +16,36 @@ cbuffer Transform: register(b1)
 	matrix boneMat[256];
 }
 
-cbuffer Material : register(b2)
+struct Material
 {
-	float4 diffuse;
-	float4 specular;
+	float3 diffuse;
+	float alpha;
+	float3 specular;
+	float specularity;
 	float3 ambient;
+	uint texIdx;
+	uint sphIdx;
+	uint spaIdx;
+	uint toonIdx;
+	uint padding;
+};
+
+cbuffer MaterialIndex : register(b2)
+{
+	uint materialIdx;
+	uint paletteOffset; // the first bone matrix of the instance in boneMat
 }
+
+StructuredBuffer<Material> materials : register(t0, space2);
+Texture2D<float4> textures[] : register(t0, space3);
+
+// crowd. An instance is placed by its world and posed with the palette of its phase
+struct CrowdInstance
+{
+	matrix world;
+	uint paletteOffset; // in crowdPalettes
+	uint3 padding;
+};
+
+StructuredBuffer<CrowdInstance> crowdInstances : register(t0, space4);
+StructuredBuffer<matrix> crowdPalettes : register(t1, space4);
@@ -11,7 +11,7 @@ Output BasicVs(
 	Output output;
 	{
 		const float w = weight / 100.0f;
-		const matrix bm = boneMat[boneno[0]] * w + boneMat[boneno[1]] * (1 - w);
+		const matrix bm = boneMat[paletteOffset + boneno[0]] * w + boneMat[paletteOffset + boneno[1]] * (1 - w);
 		const float4 wpos = mul(mul(world, bm), pos);
 
 		output.svpos = mul(mul(proj, view), wpos);
@@ -41,7 +41,7 @@ Output BasicWithShadowVs(
 	Output output;
 	{
 		const float w = weight / 100.0f;
-		const matrix bm = boneMat[boneno[0]] * w + boneMat[boneno[1]] * (1 - w);
+		const matrix bm = boneMat[paletteOffset + boneno[0]] * w + boneMat[paletteOffset + boneno[1]] * (1 - w);
 		float4 wpos = mul(mul(world, bm), pos);
 
 		if (instNo == 1)
@@ -74,8 +74,59 @@ float4 shadowVs(
 	min16uint weight : WEIGHT) : SV_POSITION
 {
 	const float fWeight = float(weight) / 100.0f;
-	const matrix conBone = boneMat[boneno.x] * fWeight + boneMat[boneno.y] * (1.0f - fWeight);
+	const matrix conBone = boneMat[paletteOffset + boneno.x] * fWeight + boneMat[paletteOffset + boneno.y] * (1.0f - fWeight);
 	const float4 wpos = mul(mul(world, conBone), pos);
 
+	return mul(lightCamera, wpos);
+}
+
+Output CrowdVs(
+	float4 pos : POSITION,
+	float4 normal : NORMAL,
+	float2 uv : TEXCOORD,
+	min16uint2 boneno : BONENO,
+	min16uint weight : WEIGHT,
+	uint instNo : SV_InstanceID)
+{
+	const CrowdInstance inst = crowdInstances[instNo];
+	const uint palette = paletteOffset + inst.paletteOffset;
+
+	Output output;
+	{
+		const float w = weight / 100.0f;
+		const matrix bm = crowdPalettes[palette + boneno[0]] * w + crowdPalettes[palette + boneno[1]] * (1 - w);
+		const float4 wpos = mul(mul(inst.world, bm), pos);
+
+		output.svpos = mul(mul(proj, view), wpos);
+		output.pos = mul(view, wpos);
+
+		normal.w = 0;
+		output.normal = mul(inst.world, normal);
+		output.vnormal = mul(view, output.normal);
+
+		output.uv = uv;
+		output.ray = normalize(wpos.xyz - eye);
+		output.tpos = mul(lightCamera, wpos);
+		output.instNo = 0;
+	}
+
+	return output;
+}
+
+float4 crowdShadowVs(
+	float4 pos : POSITION,
+	float4 normal : NORMAL,
+	float2 uv : TEXCOORD,
+	min16uint2 boneno : BONENO,
+	min16uint weight : WEIGHT,
+	uint instNo : SV_InstanceID) : SV_POSITION
+{
+	const CrowdInstance inst = crowdInstances[instNo];
+	const uint palette = paletteOffset + inst.paletteOffset;
+
+	const float fWeight = float(weight) / 100.0f;
+	const matrix conBone = crowdPalettes[palette + boneno.x] * fWeight + crowdPalettes[palette + boneno.y] * (1.0f - fWeight);
+	const float4 wpos = mul(mul(inst.world, conBone), pos);
+
 	return mul(lightCamera, wpos);
 }
\ No newline at end of file
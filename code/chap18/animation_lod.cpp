@@ -0,0 +1,217 @@
+#include "animation_lod.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <algorithm>
+#include <cmath>
+#pragma warning(pop)
+#include "debug.h"
+#include "util.h"
+
+#undef min
+#undef max
+
+using namespace DirectX;
+
+namespace {
+	constexpr float kFullCostWeight = 1.0f / 16.0f; // of a step in the average
+} // namespace anonymous
+
+std::atomic<uint32_t> AnimationLod::s_numInstances = 0;
+
+AnimationLod::Level AnimationLod::select(float screenHeight, float halfBelow, float quarterBelow)
+{
+	if (screenHeight < quarterBelow)
+		return Level::kQuarter;
+
+	if (screenHeight < halfBelow)
+		return Level::kHalf;
+
+	return Level::kFull;
+}
+
+uint32_t AnimationLod::getInterval(Level level)
+{
+	switch (level)
+	{
+	case Level::kFull: return 1;
+	case Level::kHalf: return 2;
+	case Level::kQuarter: return 4;
+	default: break;
+	}
+
+	ThrowIfFalse(false);
+	return 1;
+}
+
+void AnimationLod::init(uint32_t numSlots, uint32_t numBones)
+{
+	m_slots.clear();
+	m_slots.resize(numSlots);
+	m_numBones = numBones;
+	m_stagger = s_numInstances++;
+	m_step = 0;
+
+	for (auto& slot : m_slots)
+	{
+		slot.from.resize(numBones, XMMatrixIdentity());
+		slot.to.resize(numBones, XMMatrixIdentity());
+	}
+}
+
+bool AnimationLod::isDue(uint32_t slot, Level level, uint32_t* pAheadSteps) const
+{
+	const uint32_t interval = getInterval(level);
+	const Slot& s = m_slots.at(slot);
+
+	if (interval == 1)
+	{
+		*pAheadSteps = 0;
+		return true;
+	}
+
+	// the next step of the slot on the grid of the interval, so that a key of each slot comes on its own step
+	const uint32_t phase = static_cast<uint32_t>((m_step + m_stagger + slot) % interval);
+	*pAheadSteps = interval - phase;
+
+	return s.interval != interval || m_step >= s.toStep;
+}
+
+void AnimationLod::setKey(uint32_t slot, Level level, uint32_t aheadSteps, const XMMATRIX* palette)
+{
+	Slot& s = m_slots.at(slot);
+
+	// blends on from where it is now. The first key has nothing to blend from
+	if (s.interval == 0)
+		std::copy(palette, palette + m_numBones, s.from.begin());
+	else
+		getPalette(slot, s.from.data());
+
+	std::copy(palette, palette + m_numBones, s.to.begin());
+	s.fromStep = m_step;
+	s.toStep = m_step + aheadSteps;
+	s.interval = getInterval(level);
+}
+
+void AnimationLod::getPalette(uint32_t slot, XMMATRIX* pDst) const
+{
+	const Slot& s = m_slots.at(slot);
+
+	if (s.toStep <= s.fromStep)
+	{
+		std::copy(s.to.begin(), s.to.end(), pDst);
+		return;
+	}
+
+	const float t = std::min(static_cast<float>(m_step - s.fromStep) / static_cast<float>(s.toStep - s.fromStep), 1.0f);
+
+	// the rows apart, which is close enough to a blend of the rotations over a few steps
+	for (uint32_t i = 0; i < m_numBones; ++i)
+	{
+		for (uint32_t r = 0; r < 4; ++r)
+		{
+			pDst[i].r[r] = XMVectorLerp(s.from.at(i).r[r], s.to.at(i).r[r], t);
+		}
+	}
+}
+
+void AnimationLod::beginStep()
+{
+	m_stepStart = Util::getTick();
+}
+
+void AnimationLod::endStep(Level level)
+{
+	m_costInUs = Util::toUs(Util::getTick() - m_stepStart);
+
+	if (level == Level::kFull)
+	{
+		m_fullCostInUs = hasFullCost() ? m_fullCostInUs + (m_costInUs - m_fullCostInUs) * kFullCostWeight : m_costInUs;
+		m_savedInUs = 0.0f;
+	}
+	else
+	{
+		m_savedInUs = std::max(m_fullCostInUs - m_costInUs, 0.0f);
+	}
+
+	++m_step;
+}
+
+bool AnimationLod::selfCheck()
+{
+	if (select(500.0f, 270.0f, 90.0f) != Level::kFull
+		|| select(200.0f, 270.0f, 90.0f) != Level::kHalf
+		|| select(50.0f, 270.0f, 90.0f) != Level::kQuarter
+		|| !hasSecondaryBones(Level::kFull) || hasSecondaryBones(Level::kHalf)
+		|| !hasIk(Level::kHalf) || hasIk(Level::kQuarter))
+	{
+		return false;
+	}
+
+	// a pose which moves linearly with the step, so that the blend between the keys is exact
+	constexpr uint32_t kNumSlots = 4;
+	constexpr uint32_t kNumBones = 2;
+	auto makePose = [](uint32_t slot, uint64_t step, XMMATRIX* pDst) {
+		for (uint32_t i = 0; i < kNumBones; ++i)
+		{
+			pDst[i] = XMMatrixTranslation(static_cast<float>(step), static_cast<float>(slot), static_cast<float>(i));
+		}
+	};
+
+	AnimationLod lod;
+	lod.init(kNumSlots, kNumBones);
+
+	const Level levels[] = { Level::kHalf, Level::kQuarter, Level::kHalf, Level::kFull };
+	constexpr uint32_t kStepsPerLevel = 16;
+	uint32_t numKeys = 0;
+
+	for (uint32_t i = 0; i < _countof(levels) * kStepsPerLevel; ++i)
+	{
+		const Level level = levels[i / kStepsPerLevel];
+		const uint64_t step = lod.m_step;
+		uint32_t numDue = 0;
+
+		lod.beginStep();
+
+		for (uint32_t slot = 0; slot < kNumSlots; ++slot)
+		{
+			uint32_t aheadSteps = 0;
+
+			if (lod.isDue(slot, level, &aheadSteps))
+			{
+				XMMATRIX pose[kNumBones];
+				makePose(slot, step + aheadSteps, pose);
+				lod.setKey(slot, level, aheadSteps, pose);
+				++numDue;
+			}
+
+			XMMATRIX palette[kNumBones];
+			XMMATRIX expected[kNumBones];
+			lod.getPalette(slot, palette);
+			makePose(slot, step, expected);
+
+			// the first keys are ahead with nothing to blend from
+			for (uint32_t b = 0; i >= 4 && b < kNumBones; ++b)
+			{
+				if (!XMVector4NearEqual(palette[b].r[3], expected[b].r[3], XMVectorReplicate(1e-4f)))
+					return false;
+			}
+		}
+
+		lod.endStep(level);
+
+		// once settled, the keys of the slots spread over the steps of the interval
+		const uint32_t interval = getInterval(level);
+		const bool bSettled = i % kStepsPerLevel >= interval;
+		const uint32_t maxDue = (kNumSlots + interval - 1) / interval;
+
+		if (bSettled && numDue > maxDue)
+			return false;
+
+		numKeys += numDue;
+	}
+
+	// every step at the full level, and about one in two and in four below
+	const uint32_t maxKeys = kNumSlots * (kStepsPerLevel + (kStepsPerLevel / 2 + 1) * 2 + (kStepsPerLevel / 4 + 1));
+	return numKeys <= maxKeys && lod.hasFullCost();
+}
@@ -0,0 +1,69 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#pragma warning(pop)
+
+// The level of detail of the animation of an actor, from its height on the screen. A far actor computes its palettes
+// every second or fourth step, a key ahead of the step, and blends toward it in between. The first keys are staggered
+// by the slot and the actor, so that the phases of a crowd and the actors spread their work over the steps.
+// The lower levels leave out the secondary bones, which only sway (the hair, the skirts, the sleeves and the ties), and then the IK.
+class AnimationLod
+{
+public:
+	enum class Level : uint32_t
+	{
+		kFull,
+		kHalf, // every second step, without the secondary bones
+		kQuarter, // every fourth step, without the secondary bones nor the IK
+	};
+
+	// screenHeight is in pixels
+	static Level select(float screenHeight, float halfBelow, float quarterBelow);
+	static uint32_t getInterval(Level level);
+	static bool hasSecondaryBones(Level level) { return level == Level::kFull; }
+	static bool hasIk(Level level) { return level != Level::kQuarter; }
+
+	// a slot per palette, which is a phase in the crowd mode
+	void init(uint32_t numSlots, uint32_t numBones);
+	// true if the palette of the slot is computed on this step. *pAheadSteps is the steps ahead of this one it is for
+	bool isDue(uint32_t slot, Level level, uint32_t* pAheadSteps) const;
+	void setKey(uint32_t slot, Level level, uint32_t aheadSteps, const DirectX::XMMATRIX* palette);
+	// the palette for this step, blended between the keys
+	void getPalette(uint32_t slot, DirectX::XMMATRIX* pDst) const;
+
+	// around the keys of a step, for the time it takes. A step at the full level also times the full one, the others are told against
+	void beginStep();
+	void endStep(Level level);
+	bool hasFullCost() const { return m_fullCostInUs > 0.0f; }
+	float getCostInUs() const { return m_costInUs; }
+	float getSavedInUs() const { return m_savedInUs; }
+
+	static bool selfCheck();
+
+private:
+	struct Slot
+	{
+		std::vector<DirectX::XMMATRIX> from;
+		std::vector<DirectX::XMMATRIX> to;
+		uint64_t fromStep = 0;
+		uint64_t toStep = 0;
+		uint32_t interval = 0; // of the level the keys are for. 0 before the first one
+	};
+
+	static std::atomic<uint32_t> s_numInstances; // the actors are loaded in parallel
+
+	std::vector<Slot> m_slots;
+	uint32_t m_numBones = 0;
+	uint32_t m_stagger = 0;
+	uint64_t m_step = 0;
+	LONGLONG m_stepStart = 0;
+	float m_costInUs = 0.0f;
+	float m_fullCostInUs = 0.0f; // averaged over the steps at the full level
+	float m_savedInUs = 0.0f;
+};
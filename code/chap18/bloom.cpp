@@ -34,18 +34,8 @@ HRESULT Bloom::clearWorkRenderTarget(ID3D12GraphicsCommandList* list)
 	return S_OK;
 }
 
-HRESULT Bloom::render(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE dstRtv, ID3D12DescriptorHeap* pSrcTexDescHeap, D3D12_GPU_DESCRIPTOR_HANDLE srcTexHandle, D3D12_GPU_DESCRIPTOR_HANDLE srcLumHandle)
+HRESULT Bloom::render(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE dstRtv, D3D12_GPU_DESCRIPTOR_HANDLE srcTexHandle, D3D12_GPU_DESCRIPTOR_HANDLE srcLumHandle)
 {
-	list->SetGraphicsRootSignature(m_rootSignatures.at(static_cast<size_t>(Type::kMain)).Get());
-	list->SetPipelineState(m_pipelineStates.at(static_cast<size_t>(Type::kMain)).Get());
-
-	list->SetDescriptorHeaps(1, &pSrcTexDescHeap);
-	list->SetGraphicsRootDescriptorTable(static_cast<UINT>(Slot::kSrcTex), srcTexHandle);
-	list->SetGraphicsRootDescriptorTable(static_cast<UINT>(Slot::kSrcLuminance), srcLumHandle);
-
-	list->SetDescriptorHeaps(1, m_workDescHeapSrv.GetAddressOf());
-	list->SetGraphicsRootDescriptorTable(static_cast<UINT>(Slot::kShrinkLuminance), m_workDescHeapSrv.Get()->GetGPUDescriptorHandleForHeapStart());
-
 	list->OMSetRenderTargets(1, &dstRtv, false, nullptr);
 
 	{
@@ -58,14 +48,26 @@ HRESULT Bloom::render(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HAND
 		list->RSSetScissorRects(1, &scissorRect);
 	}
 
-	list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-	list->IASetVertexBuffers(0, 1, &m_vbView);
-	list->DrawInstanced(4, 1, 0, 0);
+	const uint64_t key = BundleCache::makeKey("bloom.main", { reinterpret_cast<uint64_t>(this), srcTexHandle.ptr, srcLumHandle.ptr });
+
+	Resource::instance()->getBundleCache()->execute(list, key, [&](ID3D12GraphicsCommandList* bundle) {
+		bundle->SetGraphicsRootSignature(m_rootSignatures.at(static_cast<size_t>(Type::kMain)).Get());
+		bundle->SetPipelineState(m_pipelineStates.at(static_cast<size_t>(Type::kMain)).Get());
+
+		bundle->SetGraphicsRootDescriptorTable(static_cast<UINT>(Slot::kSrcTex), srcTexHandle);
+		bundle->SetGraphicsRootDescriptorTable(static_cast<UINT>(Slot::kSrcLuminance), srcLumHandle);
+
+		bundle->SetGraphicsRootDescriptorTable(static_cast<UINT>(Slot::kShrinkLuminance), m_workSrvTable.getGpuHandle());
+
+		bundle->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+		bundle->IASetVertexBuffers(0, 1, &m_vbView);
+		bundle->DrawInstanced(4, 1, 0, 0);
+		});
 
 	return S_OK;
 }
 
-HRESULT Bloom::renderShrinkTextureForBlur(ID3D12GraphicsCommandList* list, ID3D12DescriptorHeap* pSrcTexDescHeap, D3D12_GPU_DESCRIPTOR_HANDLE srcLumHandle)
+HRESULT Bloom::renderShrinkTextureForBlur(ID3D12GraphicsCommandList* list, D3D12_GPU_DESCRIPTOR_HANDLE srcLumHandle)
 {
 	// TODO: barrierɓׂH
 	//   input: high luminance buffer
@@ -74,14 +76,18 @@ HRESULT Bloom::renderShrinkTextureForBlur(ID3D12GraphicsCommandList* list, ID3D1
 	const int32_t baseWidth = Config::kWindowWidth / 2;
 	const int32_t baseHeight = Config::kWindowHeight / 2;
 
-	list->SetGraphicsRootSignature(m_rootSignatures.at(static_cast<size_t>(Type::kTexCopy)).Get());
-	list->SetPipelineState(m_pipelineStates.at(static_cast<size_t>(Type::kTexCopy)).Get());
+	// the state only. The draws change the viewport, which a bundle cannot, so they stay in the list
+	const uint64_t key = BundleCache::makeKey("bloom.shrink", { reinterpret_cast<uint64_t>(this), srcLumHandle.ptr });
+
+	Resource::instance()->getBundleCache()->execute(list, key, [&](ID3D12GraphicsCommandList* bundle) {
+		bundle->SetGraphicsRootSignature(m_rootSignatures.at(static_cast<size_t>(Type::kTexCopy)).Get());
+		bundle->SetPipelineState(m_pipelineStates.at(static_cast<size_t>(Type::kTexCopy)).Get());
 
-	list->SetDescriptorHeaps(1, &pSrcTexDescHeap);
-	list->SetGraphicsRootDescriptorTable(static_cast<UINT>(Slot::kSrcLuminance), srcLumHandle);
+		bundle->SetGraphicsRootDescriptorTable(static_cast<UINT>(Slot::kSrcLuminance), srcLumHandle);
 
-	list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-	list->IASetVertexBuffers(0, 1, &m_vbView);
+		bundle->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+		bundle->IASetVertexBuffers(0, 1, &m_vbView);
+		});
 
 	{
 		const D3D12_CPU_DESCRIPTOR_HANDLE rtDescHandle[] = { m_workDescHeapRtv.Get()->GetCPUDescriptorHandleForHeapStart() };
@@ -113,11 +119,6 @@ Microsoft::WRL::ComPtr<ID3D12Resource> Bloom::getWorkResource()
 	return m_workResource;
 }
 
-Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> Bloom::getSrvWorkDescriptorHeap()
-{
-	return m_workDescHeapSrv;
-}
-
 HRESULT Bloom::compileShaders()
 {
 	for (uint32_t i = 0; i < m_vsBlobs.size(); ++i)
@@ -130,14 +131,11 @@ HRESULT Bloom::compileShaders()
 
 		ComPtr<ID3DBlob> errorBlob = nullptr;
 
-		auto result = D3DCompileFromFile(
+		auto result = Resource::instance()->getShaderCache()->load(
 			kVsFile,
 			nullptr,
-			D3D_COMPILE_STANDARD_FILE_INCLUDE,
 			kVsEntryPoints.at(i),
-			Constant::kVsShaderModel,
-			D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-			0,
+			Constant::kDxcVsShaderModel,
 			m_vsBlobs.at(i).ReleaseAndGetAddressOf(),
 			errorBlob.ReleaseAndGetAddressOf());
 
@@ -152,14 +150,11 @@ HRESULT Bloom::compileShaders()
 	{
 		ComPtr<ID3DBlob> errorBlob = nullptr;
 
-		auto result = D3DCompileFromFile(
+		auto result = Resource::instance()->getShaderCache()->load(
 			kPsFile,
 			nullptr,
-			D3D_COMPILE_STANDARD_FILE_INCLUDE,
 			kPsEntryPoints.at(i),
-			Constant::kPsShaderModel,
-			D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-			0,
+			Constant::kDxcPsShaderModel,
 			m_psBlobs.at(i).ReleaseAndGetAddressOf(),
 			errorBlob.ReleaseAndGetAddressOf());
 
@@ -248,7 +243,7 @@ HRESULT Bloom::createResource(UINT64 dstWidth, UINT dstHeight)
 		const D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {
 			.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
 			.NumDescriptors = 1,
-			.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE,
+			.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE,
 			.NodeMask = 0,
 		};
 
@@ -276,6 +271,8 @@ HRESULT Bloom::createResource(UINT64 dstWidth, UINT dstHeight)
 			m_workResource.Get(),
             &srvDesc,
             m_workDescHeapSrv.Get()->GetCPUDescriptorHandleForHeapStart());
+
+		m_workSrvTable = Resource::instance()->getDescriptorAllocator()->stage(m_workDescHeapSrv.Get()->GetCPUDescriptorHandleForHeapStart(), 1);
 	}
 
 	{
@@ -366,11 +363,10 @@ HRESULT Bloom::createRootSignature()
 
 
 	{
-		ret = Resource::instance()->getDevice()->CreateRootSignature(
-			0 /* nodeMask */,
+		ret = Resource::instance()->getPipelineCache()->createRootSignature(
 			rootSigBlob.Get()->GetBufferPointer(),
 			rootSigBlob.Get()->GetBufferSize(),
-			IID_PPV_ARGS(m_rootSignatures.at(static_cast<size_t>(Type::kMain)).ReleaseAndGetAddressOf()));
+			m_rootSignatures.at(static_cast<size_t>(Type::kMain)).ReleaseAndGetAddressOf());
 		ThrowIfFailed(ret);
 
 		ret = m_rootSignatures.at(static_cast<size_t>(Type::kMain)).Get()->SetName(Util::getWideStringFromString("bloomMainRootSignature").c_str());
@@ -442,9 +438,9 @@ HRESULT Bloom::createPipelineState()
 	gpDesc.RTVFormats[0] = Constant::kDefaultRtFormat;
 
 	{
-		auto result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+		auto result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
 			&gpDesc,
-			IID_PPV_ARGS(m_pipelineStates.at(static_cast<size_t>(Type::kMain)).ReleaseAndGetAddressOf()));
+			m_pipelineStates.at(static_cast<size_t>(Type::kMain)).ReleaseAndGetAddressOf());
 		ThrowIfFailed(result);
 
 		result = m_pipelineStates.at(static_cast<size_t>(Type::kMain)).Get()->SetName(Util::getWideStringFromString("bloomMainPipelineState").c_str());
@@ -460,9 +456,9 @@ HRESULT Bloom::createPipelineState()
 			m_psBlobs.at(static_cast<size_t>(Type::kTexCopy)).Get()->GetBufferPointer(),
 			m_psBlobs.at(static_cast<size_t>(Type::kTexCopy)).Get()->GetBufferSize() };
 
-		auto result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+		auto result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
 			&gpDesc,
-			IID_PPV_ARGS(m_pipelineStates.at(static_cast<size_t>(Type::kTexCopy)).ReleaseAndGetAddressOf()));
+			m_pipelineStates.at(static_cast<size_t>(Type::kTexCopy)).ReleaseAndGetAddressOf());
 		ThrowIfFailed(result);
 
 		result = m_pipelineStates.at(static_cast<size_t>(Type::kTexCopy)).Get()->SetName(Util::getWideStringFromString("bloomTexCopyPipelineState").c_str());
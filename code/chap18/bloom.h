@@ -7,16 +7,16 @@
 #include <d3d12.h>
 #include <wrl.h>
 #pragma warning(pop)
+#include "descriptor_allocator.h"
 
 class Bloom
 {
 public:
 	HRESULT init(UINT64 width, UINT height);
 	HRESULT clearWorkRenderTarget(ID3D12GraphicsCommandList* list);
-	HRESULT render(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE dstRtv, ID3D12DescriptorHeap* pSrcTexDescHeap, D3D12_GPU_DESCRIPTOR_HANDLE srcTexHandle, D3D12_GPU_DESCRIPTOR_HANDLE srcLumHandle);
-	HRESULT renderShrinkTextureForBlur(ID3D12GraphicsCommandList* list, ID3D12DescriptorHeap* pSrcTexDescHeap, D3D12_GPU_DESCRIPTOR_HANDLE srcLumHandle);
+	HRESULT render(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE dstRtv, D3D12_GPU_DESCRIPTOR_HANDLE srcTexHandle, D3D12_GPU_DESCRIPTOR_HANDLE srcLumHandle);
+	HRESULT renderShrinkTextureForBlur(ID3D12GraphicsCommandList* list, D3D12_GPU_DESCRIPTOR_HANDLE srcLumHandle);
 	Microsoft::WRL::ComPtr<ID3D12Resource> getWorkResource();
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> getSrvWorkDescriptorHeap();
 
 private:
 	static constexpr LPCWSTR kVsFile = L"bloomVertex.hlsl";
@@ -46,7 +46,8 @@ private:
 	std::array<Microsoft::WRL::ComPtr<ID3DBlob>, kNumOfType> m_psBlobs = { };
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_workResource = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_workDescHeapRtv = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_workDescHeapSrv = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_workDescHeapSrv = nullptr; // staging
+	DescriptorTable m_workSrvTable;
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_vertexBuffer = nullptr;
 	D3D12_VERTEX_BUFFER_VIEW m_vbView = { };
 	std::array<Microsoft::WRL::ComPtr<ID3D12RootSignature>, kNumOfType> m_rootSignatures = { };
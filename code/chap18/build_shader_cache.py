@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""Builds the shader cache offline with DXC.
+
+The entries are named by the same key as ShaderCache::computeKey(), so an entry is rebuilt
+only when the compiler, the shader, one of its includes, the defines or the arguments are changed.
+"""
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+COMPILE_ARGS = ['-O3']  # keep in sync with ShaderCache::kCompileArgs
+INCLUDE_RE = re.compile(r'^[ \t]*#[ \t]*include[^"\n]*"([^"]*)"', re.MULTILINE)
+VERSION_RE = re.compile(r'dxcompiler\.dll:\s*(\d+)\.(\d+)[^(\n]*(?:\(([^)\n]*)\))?')
+
+
+class KeyHasher:
+    """FNV-1a, same as Util::Fnv1a"""
+
+    def __init__(self):
+        self.hash = 0xcbf29ce484222325
+
+    def add_bytes(self, data):
+        for b in data:
+            self.hash ^= b
+            self.hash = (self.hash * 0x100000001b3) & 0xffffffffffffffff
+
+    def add_string(self, s):
+        self.add_bytes(s.encode('ascii') + b'\0')
+
+
+def collect_sources(root, base_dir):
+    """Depth first in the order of the #include lines. An include is visited once"""
+    files = []
+    visited = set()
+    stack = [(root, os.path.join(base_dir, root))]
+
+    while stack:
+        name, path = stack.pop()
+        key = os.path.normpath(path)
+        if key in visited:
+            continue
+        visited.add(key)
+
+        with open(path, 'rb') as f:
+            contents = f.read()
+        files.append((name, path, contents))
+
+        includes = INCLUDE_RE.findall(contents.decode('latin-1'))
+        for inc in reversed(includes):
+            stack.append((inc, os.path.join(os.path.dirname(path), inc)))
+
+    return files
+
+
+def get_compiler_version(dxc):
+    """"major.minor (commit hash)", the same as ShaderCache::getCompilerVersion()"""
+    output = subprocess.run([dxc, '--version'], capture_output=True, text=True).stdout
+    match = VERSION_RE.search(output)
+    if match is None:
+        return None
+
+    version = '%s.%s' % (match.group(1), match.group(2))
+    # e.g. "(69e54e290)" or "(dev;4530-b3a9b6e0)". The hash is the last part
+    commit = re.findall(r'[0-9a-f]{7,}', match.group(3) or '')
+    if commit:
+        version += ' (%s)' % commit[-1]
+    return version
+
+
+def compute_key(compiler_version, files, defines, entry, profile):
+    hasher = KeyHasher()
+    hasher.add_string(compiler_version)
+    hasher.add_string(profile)
+    hasher.add_string(entry)
+    for name, value in defines:
+        hasher.add_string(name)
+        hasher.add_string(value)
+    for arg in COMPILE_ARGS:
+        hasher.add_string(arg)
+    for name, _, contents in files:
+        hasher.add_string(name)
+        hasher.add_bytes(contents)
+        hasher.add_string('')
+    return hasher.hash
+
+
+def parse_manifest(path):
+    entries = []
+    with open(path) as f:
+        for line in f:
+            line = line.split('#', 1)[0].strip()
+            if not line:
+                continue
+            tokens = line.split()
+            defines = [tuple(d.split('=', 1)) if '=' in d else (d, '') for d in tokens[3:]]
+            entries.append((tokens[0], tokens[1], tokens[2], defines))
+    return entries
+
+
+def find_dxc(base_dir):
+    local = os.path.join(base_dir, '..', 'dxc', 'bin', 'x64', 'dxc.exe')
+    if os.name == 'nt' and os.path.exists(local):
+        return local
+    return shutil.which('dxc')
+
+
+def main():
+    base_dir = os.path.dirname(os.path.abspath(__file__))
+
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--manifest', default=os.path.join(base_dir, 'shader_manifest.txt'))
+    parser.add_argument('--out', default=os.path.join(base_dir, 'shader_cache'))
+    parser.add_argument('--dxc', default=None)
+    parser.add_argument('--prune', action='store_true', help='remove the entries not in the manifest')
+    parser.add_argument('--deps', action='store_true', help='print the include dependencies')
+    args = parser.parse_args()
+
+    dxc = args.dxc or find_dxc(base_dir)
+    if dxc is None:
+        print('dxc is not found. Pass it with --dxc', file=sys.stderr)
+        return 1
+
+    compiler_version = get_compiler_version(dxc)
+    if compiler_version is None:
+        print('the version of %s is not known' % dxc, file=sys.stderr)
+        return 1
+    print('dxc %s' % compiler_version)
+
+    os.makedirs(args.out, exist_ok=True)
+    built = 0
+    kept = set()
+
+    for file, entry, profile, defines in parse_manifest(args.manifest):
+        files = collect_sources(file, base_dir)
+        key = compute_key(compiler_version, files, defines, entry, profile)
+        out = os.path.join(args.out, '%016x.dxil' % key)
+        kept.add(os.path.basename(out))
+
+        if args.deps:
+            print('%s:%s <- %s' % (file, entry, ' '.join(name for name, _, _ in files[1:])))
+
+        if os.path.exists(out):
+            continue
+
+        cmd = [dxc, '-T', profile, '-E', entry] + COMPILE_ARGS
+        for name, value in defines:
+            cmd += ['-D', '%s=%s' % (name, value)]
+        cmd += ['-Fo', out + '.tmp', os.path.join(base_dir, file)]
+
+        print('%s %s %s -> %s' % (file, entry, profile, os.path.basename(out)))
+        result = subprocess.run(cmd)
+        if result.returncode != 0:
+            return result.returncode
+
+        os.replace(out + '.tmp', out)
+        built += 1
+
+    pruned = 0
+    if args.prune:
+        for name in os.listdir(args.out):
+            if name.endswith('.dxil') and name not in kept:
+                os.remove(os.path.join(args.out, name))
+                pruned += 1
+
+    print('built %d, up to date %d, pruned %d' % (built, len(kept) - built, pruned))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,135 @@
+#include "bundle_cache.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <cstdio>
+#pragma warning(pop)
+#include "config.h"
+#include "debug.h"
+#include "init.h"
+#include "util.h"
+
+#define ENABLE_BUNDLES (1)
+
+using namespace Microsoft::WRL;
+
+HRESULT BundleCache::init(ID3D12Device* device)
+{
+	ThrowIfFalse(device != nullptr);
+
+	m_device = device;
+
+	return S_OK;
+}
+
+void BundleCache::release()
+{
+	Debug::debugOutputFormatString("Bundle cache: executed %llu, recorded %u, released %u\n",
+		static_cast<unsigned long long>(m_stats.executed), m_stats.recorded, m_stats.released);
+
+	m_bundles.clear();
+	m_device.Reset();
+}
+
+void BundleCache::beginFrame()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	++m_frame;
+
+	for (auto it = m_bundles.begin(); it != m_bundles.end(); )
+	{
+		if (isExpired(it->second.lastUsedFrame, m_frame))
+		{
+			it = m_bundles.erase(it);
+			++m_stats.released;
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+void BundleCache::execute(ID3D12GraphicsCommandList* list, uint64_t key, const RecordFunc& record)
+{
+	ThrowIfFalse(list != nullptr);
+
+#if ENABLE_BUNDLES
+	ID3D12GraphicsCommandList* bundle = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_bundles.find(key);
+
+		if (it == m_bundles.end())
+		{
+			Bundle b = { };
+
+			auto result = m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_BUNDLE, IID_PPV_ARGS(b.allocator.GetAddressOf()));
+			ThrowIfFailed(result);
+
+			result = m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_BUNDLE, b.allocator.Get(), nullptr, IID_PPV_ARGS(b.list.GetAddressOf()));
+			ThrowIfFailed(result);
+
+			{
+				wchar_t name[32] = L"";
+				ThrowIfFalse(swprintf_s(name, L"bundle_%016llx", static_cast<unsigned long long>(key)) != -1);
+				ThrowIfFailed(b.list->SetName(name));
+			}
+
+			// a bundle which uses a descriptor table sets the same heap as the calling list
+			Resource::instance()->getDescriptorAllocator()->bind(b.list.Get());
+			record(b.list.Get());
+			ThrowIfFailed(b.list->Close());
+
+			it = m_bundles.emplace(key, std::move(b)).first;
+			++m_stats.recorded;
+		}
+
+		it->second.lastUsedFrame = m_frame;
+		++m_stats.executed;
+		bundle = it->second.list.Get();
+	}
+
+	list->ExecuteBundle(bundle);
+#else
+	record(list);
+#endif // ENABLE_BUNDLES
+}
+
+uint64_t BundleCache::makeKey(const char* tag, std::initializer_list<uint64_t> inputs)
+{
+	Util::Fnv1a hasher;
+	hasher.addString(tag);
+
+	for (const uint64_t input : inputs)
+	{
+		hasher.add(input);
+	}
+
+	return hasher.get();
+}
+
+bool BundleCache::isExpired(uint64_t lastUsedFrame, uint64_t frame)
+{
+	// the frames up to (frame - kNumFramesInFlight) have completed on the GPU when this frame begins
+	return frame - lastUsedFrame > Config::kNumFramesInFlight + kNumGraceFrames;
+}
+
+bool BundleCache::selfCheck()
+{
+	const uint64_t key = makeKey("floor", { 1, 2 });
+
+	if (makeKey("floor", { 1, 2 }) != key)
+		return false;
+
+	if (makeKey("axis", { 1, 2 }) == key || makeKey("floor", { 2, 1 }) == key || makeKey("floor", { 1, 2, 0 }) == key)
+		return false;
+
+	// kept while a frame in flight may refer to it, and a while after
+	constexpr uint64_t kLastFrame = Config::kNumFramesInFlight + kNumGraceFrames;
+
+	if (isExpired(100, 100 + kLastFrame) || !isExpired(100, 100 + kLastFrame + 1))
+		return false;
+
+	return true;
+}
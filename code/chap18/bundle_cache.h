@@ -0,0 +1,58 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <cstdint>
+#include <d3d12.h>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <unordered_map>
+#include <wrl.h>
+#pragma warning(pop)
+
+// Command sequences which are the same every frame, recorded once into bundles and replayed.
+// The key is the hash of everything the sequence binds, so a changed descriptor or buffer records a new one.
+// A bundle cannot set render targets, viewports or barriers. The caller sets them and the bundle inherits them.
+// The state set in a bundle stays set in the calling list after it.
+class BundleCache
+{
+public:
+	using RecordFunc = std::function<void(ID3D12GraphicsCommandList* bundle)>;
+
+	HRESULT init(ID3D12Device* device);
+	void release();
+	// releases the bundles which no frame in flight can refer to any more
+	void beginFrame();
+	// any recording thread
+	void execute(ID3D12GraphicsCommandList* list, uint64_t key, const RecordFunc& record);
+
+	// tag tells the call sites apart. inputs are the descriptors, buffers and objects the sequence binds
+	static uint64_t makeKey(const char* tag, std::initializer_list<uint64_t> inputs);
+	static bool selfCheck();
+
+private:
+	struct Bundle
+	{
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> allocator = nullptr;
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> list = nullptr;
+		uint64_t lastUsedFrame = 0;
+	};
+
+	static constexpr uint64_t kNumGraceFrames = 60; // so that a sequence drawn now and then is not recorded every time
+
+	static bool isExpired(uint64_t lastUsedFrame, uint64_t frame);
+
+	Microsoft::WRL::ComPtr<ID3D12Device> m_device = nullptr;
+	std::mutex m_mutex;
+	std::unordered_map<uint64_t, Bundle> m_bundles;
+	uint64_t m_frame = 0;
+
+	struct Stats
+	{
+		uint64_t executed = 0;
+		uint32_t recorded = 0;
+		uint32_t released = 0;
+	} m_stats;
+};
@@ -0,0 +1,781 @@
+#include "bvh.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+#pragma warning(pop)
+#include "debug.h"
+#include "util.h"
+
+#undef min
+#undef max
+
+using namespace DirectX;
+
+namespace {
+	struct Boxes
+	{
+		XMVECTOR minX;
+		XMVECTOR minY;
+		XMVECTOR minZ;
+		XMVECTOR maxX;
+		XMVECTOR maxY;
+		XMVECTOR maxZ;
+	};
+
+	template<typename T>
+	Boxes loadBoxes(const T& node)
+	{
+		return Boxes{
+			XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(node.minX)),
+			XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(node.minY)),
+			XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(node.minZ)),
+			XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(node.maxX)),
+			XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(node.maxY)),
+			XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(node.maxZ)),
+		};
+	}
+
+	// the empty slots have empty boxes, so they drop out of the min and the max
+	template<typename T>
+	Culling::Aabb getBound(const T& node)
+	{
+		auto lowest = [](const float* v) { return std::min(std::min(v[0], v[1]), std::min(v[2], v[3])); };
+		auto highest = [](const float* v) { return std::max(std::max(v[0], v[1]), std::max(v[2], v[3])); };
+
+		return Culling::Aabb{
+			{ lowest(node.minX), lowest(node.minY), lowest(node.minZ) },
+			{ highest(node.maxX), highest(node.maxY), highest(node.maxZ) },
+		};
+	}
+
+	uint32_t toMask(FXMVECTOR v)
+	{
+		return (XMVectorGetIntX(v) ? 1u : 0u)
+			| (XMVectorGetIntY(v) ? 2u : 0u)
+			| (XMVectorGetIntZ(v) ? 4u : 0u)
+			| (XMVectorGetIntW(v) ? 8u : 0u);
+	}
+
+	XMFLOAT3 getCentroid(const Culling::Aabb& bound)
+	{
+		return {
+			(bound.minPos.x + bound.maxPos.x) * 0.5f,
+			(bound.minPos.y + bound.maxPos.y) * 0.5f,
+			(bound.minPos.z + bound.maxPos.z) * 0.5f,
+		};
+	}
+
+	float getAxis(const XMFLOAT3& v, uint32_t axis)
+	{
+		return (axis == 0) ? v.x : ((axis == 1) ? v.y : v.z);
+	}
+
+	// deterministic, so that the checks and the benchmark see the same scenes every run
+	class Random
+	{
+	public:
+		explicit Random(uint32_t seed) : m_seed(seed) { }
+
+		float next()
+		{
+			m_seed = m_seed * 1664525u + 1013904223u;
+			return static_cast<float>(m_seed >> 8) / static_cast<float>(1u << 24); // [0, 1)
+		}
+
+		float next(float low, float high) { return low + (high - low) * next(); }
+
+	private:
+		uint32_t m_seed = 0;
+	};
+
+	Culling::Aabb makeRandomBox(Random* pRandom, float range)
+	{
+		const float x = pRandom->next(-range, range);
+		const float y = pRandom->next(-range, range);
+		const float z = pRandom->next(-range, range);
+		const float size = pRandom->next(0.5f, 5.0f);
+
+		Culling::Aabb bound = { };
+		{
+			bound.minPos = { x - size, y - size, z - size };
+			bound.maxPos = { x + size, y + size, z + size };
+		}
+		return bound;
+	}
+
+	void bruteForceFrustum(const std::vector<Culling::Aabb>& bounds, const Culling::Frustum& frustum, std::vector<uint32_t>* pResult)
+	{
+		for (uint32_t i = 0; i < bounds.size(); ++i)
+		{
+			if (Culling::intersects(frustum, bounds.at(i)))
+			{
+				pResult->push_back(i);
+			}
+		}
+	}
+
+	Culling::Frustum makeTestFrustum(float yaw, float farZ)
+	{
+		const XMMATRIX view = XMMatrixLookAtLH(
+			XMVectorZero(),
+			XMVectorSet(std::sin(yaw), 0.0f, std::cos(yaw), 0.0f),
+			XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+		return Culling::makeFrustum(view * XMMatrixPerspectiveFovLH(XM_PIDIV2, 16.0f / 9.0f, 1.0f, farZ));
+	}
+} // namespace anonymous
+
+uint32_t Bvh::insert(const Culling::Aabb& bound)
+{
+	uint32_t id = 0;
+
+	if (!m_freeIds.empty())
+	{
+		id = m_freeIds.back();
+		m_freeIds.pop_back();
+	}
+	else
+	{
+		id = static_cast<uint32_t>(m_objects.size());
+		m_objects.push_back(Object());
+	}
+
+	Object& object = m_objects.at(id);
+	{
+		object.bound = bound;
+		object.node = kEmpty;
+		object.bAlive = true;
+	}
+	++m_numObjects;
+
+	// a free slot on the way down is enough. Otherwise the next refit() builds the tree again
+	if (m_bNeedsRebuild || !insertIntoSlot(id))
+	{
+		m_bNeedsRebuild = true;
+	}
+
+	return id;
+}
+
+void Bvh::remove(uint32_t id)
+{
+	Object& object = m_objects.at(id);
+	ThrowIfFalse(object.bAlive);
+
+	if (object.node != kEmpty)
+	{
+		setSlot(object.node, object.slot, kEmpty, Culling::Aabb());
+	}
+
+	object = Object();
+	m_freeIds.push_back(id);
+	--m_numObjects;
+}
+
+void Bvh::update(uint32_t id, const Culling::Aabb& bound)
+{
+	Object& object = m_objects.at(id);
+	ThrowIfFalse(object.bAlive);
+
+	object.bound = bound;
+}
+
+void Bvh::refit()
+{
+	if (m_bNeedsRebuild)
+	{
+		rebuild();
+		return;
+	}
+
+	// the children are after their parents, so they are done first
+	for (size_t i = m_nodes.size(); i > 0; --i)
+	{
+		const uint32_t nodeIdx = static_cast<uint32_t>(i - 1);
+
+		for (uint32_t slot = 0; slot < 4; ++slot)
+		{
+			const uint32_t child = m_nodes.at(nodeIdx).children[slot];
+
+			if (child == kEmpty)
+				continue;
+
+			const Culling::Aabb& bound = (child & kObjectBit)
+				? m_objects.at(child & ~kObjectBit).bound
+				: m_nodes.at(child).bound;
+
+			setSlot(nodeIdx, slot, child, bound);
+		}
+
+		m_nodes.at(nodeIdx).bound = getBound(m_nodes.at(nodeIdx));
+	}
+
+	// the boxes moved apart since the build, so the nodes are loose
+	if (getCost() > m_builtCost * kRebuildRatio)
+	{
+		rebuild();
+	}
+}
+
+void Bvh::rebuild()
+{
+	std::vector<uint32_t> ids;
+
+	for (uint32_t i = 0; i < m_objects.size(); ++i)
+	{
+		if (m_objects.at(i).bAlive)
+		{
+			ids.push_back(i);
+		}
+	}
+
+	m_nodes.clear();
+
+	if (!ids.empty())
+	{
+		m_nodes.reserve(ids.size() / 2 + 1);
+		build(ids.data(), ids.data() + ids.size());
+	}
+
+	m_bNeedsRebuild = false;
+	m_builtCost = getCost();
+	++m_numRebuilds;
+}
+
+void Bvh::queryFrustum(const Culling::Frustum& frustum, std::vector<uint32_t>* pResult) const
+{
+	// the planes one by one. Culling::Frustum keeps them in columns
+	std::array<XMFLOAT4, 6> planes = { };
+
+	for (uint32_t i = 0; i < 6; ++i)
+	{
+		const auto& rows = (i < 4) ? frustum.planes0 : frustum.planes1;
+		const uint32_t column = i % 4;
+
+		planes.at(i) = {
+			XMVectorGetByIndex(rows.at(0), column),
+			XMVectorGetByIndex(rows.at(1), column),
+			XMVectorGetByIndex(rows.at(2), column),
+			XMVectorGetByIndex(rows.at(3), column),
+		};
+	}
+
+	traverse([&planes](const Node& node) {
+		const Boxes boxes = loadBoxes(node);
+		XMVECTOR outside = XMVectorFalseInt();
+
+		for (const auto& plane : planes)
+		{
+			// the corner furthest along the normal
+			const XMVECTOR x = (plane.x >= 0.0f) ? boxes.maxX : boxes.minX;
+			const XMVECTOR y = (plane.y >= 0.0f) ? boxes.maxY : boxes.minY;
+			const XMVECTOR z = (plane.z >= 0.0f) ? boxes.maxZ : boxes.minZ;
+
+			XMVECTOR distance = XMVectorMultiplyAdd(x, XMVectorReplicate(plane.x), XMVectorReplicate(plane.w));
+			distance = XMVectorMultiplyAdd(y, XMVectorReplicate(plane.y), distance);
+			distance = XMVectorMultiplyAdd(z, XMVectorReplicate(plane.z), distance);
+
+			outside = XMVectorOrInt(outside, XMVectorLess(distance, XMVectorZero()));
+		}
+
+		return ~toMask(outside) & 0xf;
+		}, pResult);
+}
+
+void Bvh::querySphere(const XMFLOAT3& center, float radius, std::vector<uint32_t>* pResult) const
+{
+	const XMVECTOR cx = XMVectorReplicate(center.x);
+	const XMVECTOR cy = XMVectorReplicate(center.y);
+	const XMVECTOR cz = XMVectorReplicate(center.z);
+	const XMVECTOR radiusSq = XMVectorReplicate(radius * radius);
+
+	traverse([&](const Node& node) {
+		const Boxes boxes = loadBoxes(node);
+
+		// the distance from the center to the nearest point of the box
+		const XMVECTOR dx = XMVectorMax(XMVectorMax(XMVectorSubtract(boxes.minX, cx), XMVectorSubtract(cx, boxes.maxX)), XMVectorZero());
+		const XMVECTOR dy = XMVectorMax(XMVectorMax(XMVectorSubtract(boxes.minY, cy), XMVectorSubtract(cy, boxes.maxY)), XMVectorZero());
+		const XMVECTOR dz = XMVectorMax(XMVectorMax(XMVectorSubtract(boxes.minZ, cz), XMVectorSubtract(cz, boxes.maxZ)), XMVectorZero());
+
+		XMVECTOR distanceSq = XMVectorMultiply(dx, dx);
+		distanceSq = XMVectorMultiplyAdd(dy, dy, distanceSq);
+		distanceSq = XMVectorMultiplyAdd(dz, dz, distanceSq);
+
+		return toMask(XMVectorLessOrEqual(distanceSq, radiusSq));
+		}, pResult);
+}
+
+void Bvh::queryRay(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, std::vector<uint32_t>* pResult) const
+{
+	// a large inverse rather than infinity for an axis the ray does not move along, so that 0 * inf does not make a NaN
+	auto inverse = [](float d) { return (std::fabs(d) < 1e-20f) ? std::copysign(1e20f, d) : 1.0f / d; };
+
+	const XMVECTOR ox = XMVectorReplicate(origin.x);
+	const XMVECTOR oy = XMVectorReplicate(origin.y);
+	const XMVECTOR oz = XMVectorReplicate(origin.z);
+	const XMVECTOR ix = XMVectorReplicate(inverse(direction.x));
+	const XMVECTOR iy = XMVectorReplicate(inverse(direction.y));
+	const XMVECTOR iz = XMVectorReplicate(inverse(direction.z));
+	const XMVECTOR tMax = XMVectorReplicate(maxDistance);
+
+	traverse([&](const Node& node) {
+		const Boxes boxes = loadBoxes(node);
+
+		// the slabs
+		const XMVECTOR tx0 = XMVectorMultiply(XMVectorSubtract(boxes.minX, ox), ix);
+		const XMVECTOR tx1 = XMVectorMultiply(XMVectorSubtract(boxes.maxX, ox), ix);
+		const XMVECTOR ty0 = XMVectorMultiply(XMVectorSubtract(boxes.minY, oy), iy);
+		const XMVECTOR ty1 = XMVectorMultiply(XMVectorSubtract(boxes.maxY, oy), iy);
+		const XMVECTOR tz0 = XMVectorMultiply(XMVectorSubtract(boxes.minZ, oz), iz);
+		const XMVECTOR tz1 = XMVectorMultiply(XMVectorSubtract(boxes.maxZ, oz), iz);
+
+		XMVECTOR tNear = XMVectorMax(XMVectorMin(tx0, tx1), XMVectorZero());
+		tNear = XMVectorMax(tNear, XMVectorMin(ty0, ty1));
+		tNear = XMVectorMax(tNear, XMVectorMin(tz0, tz1));
+
+		XMVECTOR tFar = XMVectorMin(XMVectorMax(tx0, tx1), tMax);
+		tFar = XMVectorMin(tFar, XMVectorMax(ty0, ty1));
+		tFar = XMVectorMin(tFar, XMVectorMax(tz0, tz1));
+
+		return toMask(XMVectorLessOrEqual(tNear, tFar));
+		}, pResult);
+}
+
+template<typename Test>
+void Bvh::traverse(const Test& test, std::vector<uint32_t>* pResult) const
+{
+	ThrowIfFalse(pResult != nullptr);
+	ThrowIfFalse(!m_bNeedsRebuild); // refit() first
+
+	if (m_nodes.empty())
+		return;
+
+	std::array<uint32_t, 256> stack = { };
+	uint32_t stackSize = 0;
+	stack.at(stackSize++) = 0;
+
+	while (stackSize > 0)
+	{
+		const Node& node = m_nodes[stack.at(--stackSize)];
+		const uint32_t mask = test(node);
+
+		for (uint32_t slot = 0; slot < 4; ++slot)
+		{
+			const uint32_t child = node.children[slot];
+
+			if (!(mask & (1u << slot)) || child == kEmpty)
+				continue;
+
+			if (child & kObjectBit)
+			{
+				pResult->push_back(child & ~kObjectBit);
+			}
+			else
+			{
+				stack.at(stackSize++) = child;
+			}
+		}
+	}
+}
+
+uint32_t Bvh::build(uint32_t* begin, uint32_t* end)
+{
+	const uint32_t nodeIdx = static_cast<uint32_t>(m_nodes.size());
+	m_nodes.push_back(Node());
+
+	for (uint32_t slot = 0; slot < 4; ++slot)
+	{
+		setSlot(nodeIdx, slot, kEmpty, Culling::Aabb());
+	}
+
+	// splits at the median of the centroids along the longest side
+	auto split = [this](uint32_t* first, uint32_t* last) {
+		Culling::Aabb centroids = { };
+
+		for (uint32_t* it = first; it != last; ++it)
+		{
+			const XMFLOAT3 centroid = getCentroid(m_objects.at(*it).bound);
+			Culling::extend(&centroids, XMLoadFloat3(&centroid));
+		}
+
+		const XMFLOAT3 size = {
+			centroids.maxPos.x - centroids.minPos.x,
+			centroids.maxPos.y - centroids.minPos.y,
+			centroids.maxPos.z - centroids.minPos.z,
+		};
+		const uint32_t axis = (size.x >= size.y && size.x >= size.z) ? 0 : ((size.y >= size.z) ? 1 : 2);
+
+		uint32_t* mid = first + (last - first) / 2;
+		std::nth_element(first, mid, last, [this, axis](uint32_t a, uint32_t b) {
+			return getAxis(getCentroid(m_objects.at(a).bound), axis) < getAxis(getCentroid(m_objects.at(b).bound), axis);
+			});
+
+		return mid;
+	};
+
+	std::array<uint32_t*, 5> ranges = { begin, begin + 1, begin + 2, begin + 3, begin + 4 };
+	const ptrdiff_t count = end - begin;
+
+	if (count > 4)
+	{
+		uint32_t* const mid = split(begin, end);
+		ranges = { begin, split(begin, mid), mid, split(mid, end), end };
+	}
+
+	for (uint32_t slot = 0; slot < 4; ++slot)
+	{
+		uint32_t* const first = ranges.at(slot);
+		uint32_t* const last = std::min(ranges.at(slot + 1), end);
+
+		if (first >= last)
+			continue;
+
+		if (last - first == 1)
+		{
+			const uint32_t id = *first;
+			m_objects.at(id).node = nodeIdx;
+			m_objects.at(id).slot = slot;
+			setSlot(nodeIdx, slot, id | kObjectBit, m_objects.at(id).bound);
+			continue;
+		}
+
+		const uint32_t childIdx = build(first, last);
+		setSlot(nodeIdx, slot, childIdx, m_nodes.at(childIdx).bound);
+	}
+
+	m_nodes.at(nodeIdx).bound = getBound(m_nodes.at(nodeIdx));
+
+	return nodeIdx;
+}
+
+bool Bvh::insertIntoSlot(uint32_t id)
+{
+	if (m_nodes.empty())
+		return false;
+
+	const Culling::Aabb& bound = m_objects.at(id).bound;
+	uint32_t nodeIdx = 0;
+
+	// down to the child which grows the least
+	while (true)
+	{
+		Node& node = m_nodes.at(nodeIdx);
+
+		for (uint32_t slot = 0; slot < 4; ++slot)
+		{
+			if (node.children[slot] != kEmpty)
+				continue;
+
+			m_objects.at(id).node = nodeIdx;
+			m_objects.at(id).slot = slot;
+			setSlot(nodeIdx, slot, id | kObjectBit, bound);
+			return true;
+		}
+
+		uint32_t bestChild = kEmpty;
+		float bestGrowth = FLT_MAX;
+
+		for (uint32_t slot = 0; slot < 4; ++slot)
+		{
+			const uint32_t child = node.children[slot];
+
+			if (child & kObjectBit)
+				continue;
+
+			const Culling::Aabb& childBound = m_nodes.at(child).bound;
+			const float growth = getSurfaceArea(Culling::merge(childBound, bound)) - getSurfaceArea(childBound);
+
+			if (growth < bestGrowth)
+			{
+				bestGrowth = growth;
+				bestChild = child;
+			}
+		}
+
+		if (bestChild == kEmpty)
+			return false;
+
+		nodeIdx = bestChild;
+	}
+}
+
+void Bvh::setSlot(uint32_t nodeIdx, uint32_t slot, uint32_t child, const Culling::Aabb& bound)
+{
+	Node& node = m_nodes.at(nodeIdx);
+
+	// an empty slot keeps an empty box, which no query hits
+	node.children[slot] = child;
+	node.minX[slot] = bound.minPos.x;
+	node.minY[slot] = bound.minPos.y;
+	node.minZ[slot] = bound.minPos.z;
+	node.maxX[slot] = bound.maxPos.x;
+	node.maxY[slot] = bound.maxPos.y;
+	node.maxZ[slot] = bound.maxPos.z;
+}
+
+float Bvh::getCost() const
+{
+	float cost = 0.0f;
+
+	for (const auto& node : m_nodes)
+	{
+		cost += getSurfaceArea(node.bound);
+	}
+
+	return cost;
+}
+
+float Bvh::getSurfaceArea(const Culling::Aabb& bound)
+{
+	if (bound.isEmpty())
+		return 0.0f;
+
+	const float x = bound.maxPos.x - bound.minPos.x;
+	const float y = bound.maxPos.y - bound.minPos.y;
+	const float z = bound.maxPos.z - bound.minPos.z;
+
+	return 2.0f * (x * y + y * z + z * x);
+}
+
+bool Bvh::selfCheck()
+{
+	Random random(7);
+	std::vector<Culling::Aabb> bounds;
+	Bvh bvh;
+
+	for (uint32_t i = 0; i < 300; ++i)
+	{
+		bounds.push_back(makeRandomBox(&random, 100.0f));
+		bvh.insert(bounds.back());
+	}
+
+	bvh.refit();
+
+	auto sorted = [](std::vector<uint32_t> ids) { std::sort(ids.begin(), ids.end()); return ids; };
+
+	// the same objects as the brute force, after moves, removals and additions
+	for (uint32_t frame = 0; frame < 4; ++frame)
+	{
+		const Culling::Frustum frustum = makeTestFrustum(frame * 1.5f, 150.0f);
+
+		std::vector<uint32_t> expected;
+		bruteForceFrustum(bounds, frustum, &expected);
+
+		std::vector<uint32_t> result;
+		bvh.queryFrustum(frustum, &result);
+
+		// the removed ones have empty boxes in bounds, so the brute force does not see them either
+		if (sorted(result) != expected || expected.empty())
+			return false;
+
+		for (uint32_t i = 0; i < bounds.size(); ++i)
+		{
+			if (bounds.at(i).isEmpty())
+				continue;
+
+			const float dx = random.next(-3.0f, 3.0f);
+			bounds.at(i).minPos.x += dx;
+			bounds.at(i).maxPos.x += dx;
+			bvh.update(i, bounds.at(i));
+		}
+
+		bvh.remove(frame * 10);
+		bounds.at(frame * 10) = Culling::Aabb();
+
+		const Culling::Aabb added = makeRandomBox(&random, 100.0f);
+		const uint32_t id = bvh.insert(added);
+
+		if (id != frame * 10) // the removed id is used again
+			return false;
+
+		bounds.at(id) = added;
+		bvh.refit();
+	}
+
+	// sphere and ray
+	{
+		const XMFLOAT3 center = { 10.0f, -5.0f, 20.0f };
+		constexpr float kRadius = 30.0f;
+		std::vector<uint32_t> expected;
+
+		for (uint32_t i = 0; i < bounds.size(); ++i)
+		{
+			const Culling::Aabb& b = bounds.at(i);
+
+			if (b.isEmpty())
+				continue;
+
+			const float dx = std::max({ b.minPos.x - center.x, center.x - b.maxPos.x, 0.0f });
+			const float dy = std::max({ b.minPos.y - center.y, center.y - b.maxPos.y, 0.0f });
+			const float dz = std::max({ b.minPos.z - center.z, center.z - b.maxPos.z, 0.0f });
+
+			if (dx * dx + dy * dy + dz * dz <= kRadius * kRadius)
+			{
+				expected.push_back(i);
+			}
+		}
+
+		std::vector<uint32_t> result;
+		bvh.querySphere(center, kRadius, &result);
+
+		if (sorted(result) != expected || expected.empty())
+			return false;
+	}
+
+	{
+		// through the center of an object, so that there is a hit
+		const XMFLOAT3 target = getCentroid(bounds.at(5));
+		const XMFLOAT3 origin = { -150.0f, 3.0f, -140.0f };
+		const XMFLOAT3 direction = { target.x - origin.x, target.y - origin.y, target.z - origin.z };
+		std::vector<uint32_t> expected;
+
+		for (uint32_t i = 0; i < bounds.size(); ++i)
+		{
+			const Culling::Aabb& b = bounds.at(i);
+
+			if (b.isEmpty())
+				continue;
+
+			float tNear = 0.0f;
+			float tFar = 1.0f;
+			const float o[] = { origin.x, origin.y, origin.z };
+			const float d[] = { direction.x, direction.y, direction.z };
+			const float lo[] = { b.minPos.x, b.minPos.y, b.minPos.z };
+			const float hi[] = { b.maxPos.x, b.maxPos.y, b.maxPos.z };
+
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				const float t0 = (lo[axis] - o[axis]) / d[axis];
+				const float t1 = (hi[axis] - o[axis]) / d[axis];
+				tNear = std::max(tNear, std::min(t0, t1));
+				tFar = std::min(tFar, std::max(t0, t1));
+			}
+
+			if (tNear <= tFar)
+			{
+				expected.push_back(i);
+			}
+		}
+
+		std::vector<uint32_t> result;
+		bvh.queryRay(origin, direction, 1.0f, &result);
+
+		if (sorted(result) != expected || std::find(expected.begin(), expected.end(), 5) == expected.end())
+			return false;
+	}
+
+	// scattered far apart, the nodes are loose and the tree is built again
+	{
+		const uint32_t numRebuilds = bvh.getNumRebuilds();
+
+		for (uint32_t i = 0; i < bounds.size(); ++i)
+		{
+			if (!bounds.at(i).isEmpty())
+			{
+				bvh.update(i, makeRandomBox(&random, 1000.0f));
+			}
+		}
+
+		bvh.refit();
+
+		if (bvh.getNumRebuilds() != numRebuilds + 1 || bvh.getNumObjects() != 300)
+			return false;
+	}
+
+	// nothing in it
+	{
+		Bvh empty;
+		empty.refit();
+
+		std::vector<uint32_t> result;
+		empty.querySphere({ 0.0f, 0.0f, 0.0f }, 1000.0f, &result);
+
+		if (!result.empty())
+			return false;
+	}
+
+	return true;
+}
+
+void Bvh::benchmark()
+{
+	constexpr uint32_t kNumFrames = 100;
+
+	for (const uint32_t numObjects : { 100u, 1000u, 10000u })
+	{
+		Random random(numObjects);
+		const float range = 10.0f * std::sqrt(static_cast<float>(numObjects)); // the same density
+		std::vector<Culling::Aabb> bounds;
+		Bvh bvh;
+
+		for (uint32_t i = 0; i < numObjects; ++i)
+		{
+			bounds.push_back(makeRandomBox(&random, range));
+			bvh.insert(bounds.back());
+		}
+
+		bvh.refit();
+
+		// two views a frame, the camera and the light, as the renderer culls
+		LONGLONG bruteTicks = 0;
+		LONGLONG refitTicks = 0;
+		LONGLONG queryTicks = 0;
+		size_t numHits = 0;
+		std::vector<uint32_t> result;
+
+		for (uint32_t frame = 0; frame < kNumFrames; ++frame)
+		{
+			for (uint32_t i = 0; i < numObjects; ++i)
+			{
+				const float dx = random.next(-0.5f, 0.5f);
+				bounds.at(i).minPos.x += dx;
+				bounds.at(i).maxPos.x += dx;
+				bvh.update(i, bounds.at(i));
+			}
+
+			const std::array<Culling::Frustum, 2> frustums = {
+				makeTestFrustum(frame * 0.1f, range),
+				makeTestFrustum(frame * 0.1f + XM_PI, range),
+			};
+
+			LONGLONG tick = Util::getTick();
+			{
+				for (const auto& frustum : frustums)
+				{
+					result.clear();
+					bruteForceFrustum(bounds, frustum, &result);
+				}
+			}
+			bruteTicks += Util::getTick() - tick;
+
+			tick = Util::getTick();
+			bvh.refit();
+			refitTicks += Util::getTick() - tick;
+
+			tick = Util::getTick();
+			{
+				for (const auto& frustum : frustums)
+				{
+					result.clear();
+					bvh.queryFrustum(frustum, &result);
+					numHits += result.size();
+				}
+			}
+			queryTicks += Util::getTick() - tick;
+		}
+
+		Debug::debugOutputFormatString("BVH %u objects: brute force %.1f us, refit %.1f us + query %.1f us, %.1f hits a view, %u rebuilds\n",
+			numObjects,
+			Util::toUs(bruteTicks) / kNumFrames,
+			Util::toUs(refitTicks) / kNumFrames,
+			Util::toUs(queryTicks) / kNumFrames,
+			static_cast<float>(numHits) / (kNumFrames * 2),
+			bvh.getNumRebuilds());
+	}
+}
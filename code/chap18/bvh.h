@@ -0,0 +1,79 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+#pragma warning(pop)
+#include "culling.h"
+
+// A four wide bounding volume hierarchy over the boxes of the scene objects.
+// The boxes of the four children of a node are kept in SoA, so that a query tests them at once.
+// update() only stores the box. refit() moves them into the nodes bottom up, and builds the tree again
+// when objects were added where no slot was free, or when the moved boxes made the nodes too large.
+// Call refit() after the changes of a frame, before the queries.
+class Bvh
+{
+public:
+	uint32_t insert(const Culling::Aabb& bound); // returns the id of the object
+	void remove(uint32_t id);
+	void update(uint32_t id, const Culling::Aabb& bound);
+	void refit();
+	void rebuild();
+
+	// the ids of the objects whose boxes are hit, in no particular order
+	void queryFrustum(const Culling::Frustum& frustum, std::vector<uint32_t>* pResult) const;
+	void querySphere(const DirectX::XMFLOAT3& center, float radius, std::vector<uint32_t>* pResult) const;
+	void queryRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, std::vector<uint32_t>* pResult) const;
+
+	uint32_t getNumObjects() const { return m_numObjects; }
+	uint32_t getNumRebuilds() const { return m_numRebuilds; }
+
+	static bool selfCheck();
+	// the queries against the brute force for 100, 1k and 10k objects. Printed to the debug output
+	static void benchmark();
+
+private:
+	static constexpr uint32_t kEmpty = UINT32_MAX;
+	static constexpr uint32_t kObjectBit = 0x80000000; // a child which is an object, not a node
+	static constexpr float kRebuildRatio = 1.5f; // of the surface area of the nodes to the one at the last build
+
+	struct Node
+	{
+		alignas(16) float minX[4];
+		alignas(16) float minY[4];
+		alignas(16) float minZ[4];
+		alignas(16) float maxX[4];
+		alignas(16) float maxY[4];
+		alignas(16) float maxZ[4];
+		uint32_t children[4] = { kEmpty, kEmpty, kEmpty, kEmpty };
+		Culling::Aabb bound; // of the four
+	};
+
+	struct Object
+	{
+		Culling::Aabb bound;
+		uint32_t node = kEmpty;
+		uint32_t slot = 0;
+		bool bAlive = false;
+	};
+
+	// test returns a bit per child of a node which may hold hits
+	template<typename Test>
+	void traverse(const Test& test, std::vector<uint32_t>* pResult) const;
+	uint32_t build(uint32_t* begin, uint32_t* end);
+	bool insertIntoSlot(uint32_t id);
+	void setSlot(uint32_t nodeIdx, uint32_t slot, uint32_t child, const Culling::Aabb& bound);
+	float getCost() const;
+
+	static float getSurfaceArea(const Culling::Aabb& bound);
+
+	std::vector<Node> m_nodes; // a parent before its children. [0] is the root
+	std::vector<Object> m_objects;
+	std::vector<uint32_t> m_freeIds;
+	uint32_t m_numObjects = 0;
+	bool m_bNeedsRebuild = false;
+	float m_builtCost = 0.0f;
+	uint32_t m_numRebuilds = 0;
+};
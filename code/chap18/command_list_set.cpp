@@ -0,0 +1,84 @@
+#include "command_list_set.h"
+#include "debug.h"
+#include "util.h"
+
+HRESULT CommandListSet::init(ID3D12Device* device, uint32_t numLists, const std::string& name)
+{
+	ThrowIfFalse(device != nullptr);
+	ThrowIfFalse(numLists > 0);
+
+	for (uint32_t frame = 0; auto& allocators : m_allocators)
+	{
+		allocators.resize(numLists);
+
+		for (uint32_t i = 0; auto& allocator : allocators)
+		{
+			auto result = device->CreateCommandAllocator(
+				D3D12_COMMAND_LIST_TYPE_DIRECT,
+				IID_PPV_ARGS(allocator.ReleaseAndGetAddressOf()));
+			ThrowIfFailed(result);
+
+			result = allocator.Get()->SetName(Util::getWideStringFromString(name + "Allocator" + std::to_string(frame) + "_" + std::to_string(i)).c_str());
+			ThrowIfFailed(result);
+
+			++i;
+		}
+
+		++frame;
+	}
+
+	m_lists.resize(numLists);
+
+	for (uint32_t i = 0; auto& list : m_lists)
+	{
+		auto result = device->CreateCommandList(
+			0,
+			D3D12_COMMAND_LIST_TYPE_DIRECT,
+			m_allocators.at(0).at(i).Get(),
+			nullptr,
+			IID_PPV_ARGS(list.ReleaseAndGetAddressOf()));
+		ThrowIfFailed(result);
+
+		result = list.Get()->SetName(Util::getWideStringFromString(name + "List" + std::to_string(i)).c_str());
+		ThrowIfFailed(result);
+
+		ThrowIfFailed(list->Close());
+
+		++i;
+	}
+
+	return S_OK;
+}
+
+HRESULT CommandListSet::reset(uint32_t frameIndex)
+{
+	const auto& allocators = m_allocators.at(frameIndex);
+
+	for (size_t i = 0; i < m_lists.size(); ++i)
+	{
+		ThrowIfFailed(allocators.at(i)->Reset());
+		ThrowIfFailed(m_lists.at(i)->Reset(allocators.at(i).Get(), nullptr));
+	}
+
+	return S_OK;
+}
+
+ID3D12GraphicsCommandList* CommandListSet::getList(uint32_t index) const
+{
+	return m_lists.at(index).Get();
+}
+
+void CommandListSet::execute(ID3D12CommandQueue* queue) const
+{
+	ThrowIfFalse(queue != nullptr);
+
+	std::vector<ID3D12CommandList*> lists;
+	lists.reserve(m_lists.size());
+
+	for (const auto& list : m_lists)
+	{
+		lists.push_back(list.Get());
+	}
+
+	queue->ExecuteCommandLists(static_cast<UINT>(lists.size()), lists.data());
+}
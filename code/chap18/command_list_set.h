@@ -0,0 +1,28 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <array>
+#include <d3d12.h>
+#include <string>
+#include <vector>
+#include <wrl.h>
+#pragma warning(pop)
+#include "config.h"
+
+// Direct command lists which are recorded on different threads and submitted together.
+// Each list has its own allocator per frame in flight, so that no allocator is shared between threads.
+class CommandListSet
+{
+public:
+	HRESULT init(ID3D12Device* device, uint32_t numLists, const std::string& name);
+	HRESULT reset(uint32_t frameIndex);
+	ID3D12GraphicsCommandList* getList(uint32_t index) const;
+	uint32_t getNumLists() const { return static_cast<uint32_t>(m_lists.size()); }
+	void execute(ID3D12CommandQueue* queue) const;
+
+private:
+	std::array<std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>>, Config::kNumFramesInFlight> m_allocators;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>> m_lists;
+};
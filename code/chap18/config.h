@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
 
 #define HIGH_RESOLUTION (1)
@@ -20,4 +21,26 @@ namespace Config {
 	constexpr int32_t kShadowBufferWidth = 1024;
 	constexpr int32_t kShadowBufferHeight = 1024;
 	constexpr float kDefaultHighLuminanceThreshold = 0.85f;
+	constexpr uint32_t kNumFramesInFlight = 2; // 2 or 3. Also used as the number of swap chain buffers
+	static_assert(2 <= kNumFramesInFlight && kNumFramesInFlight <= 3);
+	constexpr uint32_t kMaxFrameLatency = 1; // frames queued in the swap chain. Lower is less input lag
+	static_assert(1 <= kMaxFrameLatency && kMaxFrameLatency <= kNumFramesInFlight);
+	constexpr uint32_t kNumBasePassCommandLists = 2; // the actors are split into this number of chunks
+	constexpr uint32_t kSimulationHz = 60;
+	constexpr uint32_t kNumPersistentDescriptors = 4096; // views which live as long as their owner
+	constexpr uint32_t kNumTransientDescriptorsPerFrame = 1024; // views which are staged every frame
+	constexpr const char* kPipelineCacheFilePath = "pipeline_cache.bin"; // delete it to drop the stale PSOs
+	constexpr const char* kShaderCacheDir = "shader_cache"; // built by build_shader_cache.py
+	constexpr const char* kModelCacheDir = "model_cache"; // built with --mesh-report
+	constexpr const char* kMotionCacheDir = "motion_cache"; // built with --motion-report
+	constexpr uint32_t kNumTextureStreamingThreads = 2;
+	constexpr size_t kTextureStreamingBytesPerFrame = 4 * 1024 * 1024; // textures created on the render thread in a frame
+	constexpr uint32_t kNumCrowdInstances = 1000; // copies of the first actor drawn instanced
+	constexpr uint32_t kNumCrowdPhases = 16; // the palettes computed per step. The instances share them round robin
+	constexpr float kCrowdSpacing = 10.0f;
+	constexpr float kLodMaxScreenError = 1.0f; // pixels. The coarsest level of detail within it is drawn
+	constexpr float kAnimationLodHalfHeight = 270.0f; // pixels of the actor on the screen, below which it is animated at the half rate
+	constexpr float kAnimationLodQuarterHeight = 90.0f; // and at the quarter rate, without the IK
+	constexpr uint32_t kPoseCacheFrameQuantum = 1; // frames of the motion at 30 fps. A larger one shares the poses of the near frames
+	static_assert(kPoseCacheFrameQuantum >= 1);
 } // namespace Config
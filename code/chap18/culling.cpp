@@ -0,0 +1,395 @@
+#include "culling.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <algorithm>
+#include <cmath>
+#pragma warning(pop)
+#include "debug.h"
+
+using namespace DirectX;
+
+namespace {
+	void getCenterExtent(const Culling::Aabb& aabb, XMVECTOR* pCenter, XMVECTOR* pExtent)
+	{
+		const XMVECTOR minPos = XMLoadFloat3(&aabb.minPos);
+		const XMVECTOR maxPos = XMLoadFloat3(&aabb.maxPos);
+		const XMVECTOR half = XMVectorReplicate(0.5f);
+
+		*pCenter = XMVectorMultiply(XMVectorAdd(minPos, maxPos), half);
+		*pExtent = XMVectorMultiply(XMVectorSubtract(maxPos, minPos), half);
+	}
+
+	// accumulates into the registers, so that a skinned box is not stored and loaded per bone
+	void transformInto(const Culling::Aabb& aabb, FXMMATRIX m, XMVECTOR* pMin, XMVECTOR* pMax)
+	{
+		XMVECTOR center = { };
+		XMVECTOR extent = { };
+		getCenterExtent(aabb, &center, &extent);
+
+		const XMVECTOR newCenter = XMVector3Transform(center, m);
+		XMVECTOR newExtent = XMVectorMultiply(XMVectorAbs(m.r[0]), XMVectorSplatX(extent));
+		newExtent = XMVectorMultiplyAdd(XMVectorAbs(m.r[1]), XMVectorSplatY(extent), newExtent);
+		newExtent = XMVectorMultiplyAdd(XMVectorAbs(m.r[2]), XMVectorSplatZ(extent), newExtent);
+
+		*pMin = XMVectorMin(*pMin, XMVectorSubtract(newCenter, newExtent));
+		*pMax = XMVectorMax(*pMax, XMVectorAdd(newCenter, newExtent));
+	}
+
+	Culling::Aabb toAabb(FXMVECTOR minPos, FXMVECTOR maxPos)
+	{
+		Culling::Aabb aabb = { };
+		XMStoreFloat3(&aabb.minPos, minPos);
+		XMStoreFloat3(&aabb.maxPos, maxPos);
+		return aabb;
+	}
+
+	bool isOutside(const std::array<XMVECTOR, 4>& planes, FXMVECTOR center, FXMVECTOR extent)
+	{
+		// the distance of the center, and the reach of the box toward the plane
+		XMVECTOR distance = XMVectorMultiplyAdd(XMVectorSplatX(center), planes.at(0), planes.at(3));
+		distance = XMVectorMultiplyAdd(XMVectorSplatY(center), planes.at(1), distance);
+		distance = XMVectorMultiplyAdd(XMVectorSplatZ(center), planes.at(2), distance);
+
+		XMVECTOR reach = XMVectorMultiply(XMVectorSplatX(extent), XMVectorAbs(planes.at(0)));
+		reach = XMVectorMultiplyAdd(XMVectorSplatY(extent), XMVectorAbs(planes.at(1)), reach);
+		reach = XMVectorMultiplyAdd(XMVectorSplatZ(extent), XMVectorAbs(planes.at(2)), reach);
+
+		return !XMVector4GreaterOrEqual(XMVectorAdd(distance, reach), XMVectorZero());
+	}
+
+	bool contains(const Culling::Aabb& aabb, const XMFLOAT3& pos, float epsilon)
+	{
+		return aabb.minPos.x - epsilon <= pos.x && pos.x <= aabb.maxPos.x + epsilon
+			&& aabb.minPos.y - epsilon <= pos.y && pos.y <= aabb.maxPos.y + epsilon
+			&& aabb.minPos.z - epsilon <= pos.z && pos.z <= aabb.maxPos.z + epsilon;
+	}
+} // namespace anonymous
+
+namespace Culling {
+
+void extend(Aabb* pAabb, FXMVECTOR pos)
+{
+	ThrowIfFalse(pAabb != nullptr);
+
+	XMStoreFloat3(&pAabb->minPos, XMVectorMin(XMLoadFloat3(&pAabb->minPos), pos));
+	XMStoreFloat3(&pAabb->maxPos, XMVectorMax(XMLoadFloat3(&pAabb->maxPos), pos));
+}
+
+Aabb merge(const Aabb& a, const Aabb& b)
+{
+	return toAabb(
+		XMVectorMin(XMLoadFloat3(&a.minPos), XMLoadFloat3(&b.minPos)),
+		XMVectorMax(XMLoadFloat3(&a.maxPos), XMLoadFloat3(&b.maxPos)));
+}
+
+void addInfluence(std::vector<Aabb>* pBoneBounds, const XMFLOAT3& pos, uint32_t bone0, uint32_t bone1, float weight)
+{
+	ThrowIfFalse(pBoneBounds != nullptr);
+
+	if (weight > 0.0f)
+	{
+		extend(&pBoneBounds->at(bone0), XMLoadFloat3(&pos));
+	}
+
+	if (weight < 1.0f)
+	{
+		extend(&pBoneBounds->at(bone1), XMLoadFloat3(&pos));
+	}
+}
+
+std::vector<BoneBound> compact(const std::vector<Aabb>& boneBounds)
+{
+	std::vector<BoneBound> compacted;
+
+	for (uint32_t i = 0; i < boneBounds.size(); ++i)
+	{
+		if (boneBounds.at(i).isEmpty())
+			continue;
+
+		compacted.push_back({ i, boneBounds.at(i) });
+	}
+
+	return compacted;
+}
+
+Aabb transform(const Aabb& aabb, FXMMATRIX m)
+{
+	if (aabb.isEmpty())
+		return Aabb();
+
+	XMVECTOR minPos = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maxPos = XMVectorReplicate(-FLT_MAX);
+	transformInto(aabb, m, &minPos, &maxPos);
+
+	return toAabb(minPos, maxPos);
+}
+
+Aabb transformCorners(const Aabb& aabb, FXMMATRIX m)
+{
+	if (aabb.isEmpty())
+		return Aabb();
+
+	Aabb transformed = { };
+
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		const XMVECTOR corner = XMVectorSet(
+			(i & 1) ? aabb.maxPos.x : aabb.minPos.x,
+			(i & 2) ? aabb.maxPos.y : aabb.minPos.y,
+			(i & 4) ? aabb.maxPos.z : aabb.minPos.z,
+			1.0f);
+
+		extend(&transformed, XMVector3TransformCoord(corner, m));
+	}
+
+	return transformed;
+}
+
+Aabb skin(const std::vector<BoneBound>& boneBounds, const XMMATRIX* palette)
+{
+	ThrowIfFalse(palette != nullptr);
+
+	XMVECTOR minPos = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maxPos = XMVectorReplicate(-FLT_MAX);
+
+	for (const auto& boneBound : boneBounds)
+	{
+		transformInto(boneBound.bound, palette[boneBound.bone], &minPos, &maxPos);
+	}
+
+	if (boneBounds.empty())
+		return Aabb();
+
+	return toAabb(minPos, maxPos);
+}
+
+Frustum makeFrustum(FXMMATRIX viewProj)
+{
+	// the columns of the row vector convention, inside when dot(plane, pos) >= 0
+	const XMMATRIX columns = XMMatrixTranspose(viewProj);
+
+	const XMVECTOR left = XMVectorAdd(columns.r[3], columns.r[0]);
+	const XMVECTOR right = XMVectorSubtract(columns.r[3], columns.r[0]);
+	const XMVECTOR bottom = XMVectorAdd(columns.r[3], columns.r[1]);
+	const XMVECTOR top = XMVectorSubtract(columns.r[3], columns.r[1]);
+	const XMVECTOR nearPlane = columns.r[2];
+	const XMVECTOR farPlane = XMVectorSubtract(columns.r[3], columns.r[2]);
+
+	const XMMATRIX planes0 = XMMatrixTranspose(XMMATRIX(left, right, bottom, top));
+	const XMMATRIX planes1 = XMMatrixTranspose(XMMATRIX(nearPlane, farPlane, nearPlane, farPlane));
+
+	Frustum frustum = { };
+	{
+		frustum.planes0 = { planes0.r[0], planes0.r[1], planes0.r[2], planes0.r[3] };
+		frustum.planes1 = { planes1.r[0], planes1.r[1], planes1.r[2], planes1.r[3] };
+	}
+	return frustum;
+}
+
+Views makeViews(FXMMATRIX cameraViewProj, CXMMATRIX lightViewProj, CXMMATRIX planarShadow, const XMFLOAT3& eye, float screenScale)
+{
+	Views views = { };
+	{
+		views.camera = makeFrustum(cameraViewProj);
+		views.light = makeFrustum(lightViewProj);
+		views.planarShadow = planarShadow;
+		views.eye = eye;
+		views.screenScale = screenScale;
+	}
+	return views;
+}
+
+bool intersects(const Frustum& frustum, const Aabb& aabb)
+{
+	if (aabb.isEmpty())
+		return false;
+
+	XMVECTOR center = { };
+	XMVECTOR extent = { };
+	getCenterExtent(aabb, &center, &extent);
+
+	return !isOutside(frustum.planes0, center, extent) && !isOutside(frustum.planes1, center, extent);
+}
+
+float getDistance(const Aabb& aabb, const XMFLOAT3& pos)
+{
+	if (aabb.isEmpty())
+		return FLT_MAX;
+
+	const XMVECTOR p = XMLoadFloat3(&pos);
+	const XMVECTOR nearest = XMVectorClamp(p, XMLoadFloat3(&aabb.minPos), XMLoadFloat3(&aabb.maxPos));
+
+	return XMVectorGetX(XMVector3Length(XMVectorSubtract(p, nearest)));
+}
+
+float getScreenHeight(const Aabb& aabb, const Views& views)
+{
+	if (aabb.isEmpty())
+		return 0.0f;
+
+	if (views.screenScale == FLT_MAX)
+		return FLT_MAX;
+
+	const XMVECTOR center = XMVectorScale(XMVectorAdd(XMLoadFloat3(&aabb.minPos), XMLoadFloat3(&aabb.maxPos)), 0.5f);
+	const float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, XMLoadFloat3(&views.eye))));
+
+	return (aabb.maxPos.y - aabb.minPos.y) * views.screenScale / std::max(distance, FLT_EPSILON);
+}
+
+bool selfCheck()
+{
+	auto makeAabb = [](float x, float y, float z, float halfSize) {
+		return toAabb(XMVectorSet(x - halfSize, y - halfSize, z - halfSize, 0.0f), XMVectorSet(x + halfSize, y + halfSize, z + halfSize, 0.0f));
+	};
+
+	// a camera at the origin looking at +z, 90 degrees, from 1 to 100
+	{
+		const XMMATRIX view = XMMatrixLookAtLH(XMVectorZero(), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		const Frustum frustum = makeFrustum(view * XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.0f, 1.0f, 100.0f));
+
+		const bool results[] = {
+			intersects(frustum, makeAabb(0.0f, 0.0f, 10.0f, 1.0f)),
+			!intersects(frustum, makeAabb(0.0f, 0.0f, -10.0f, 1.0f)), // behind
+			!intersects(frustum, makeAabb(0.0f, 0.0f, 110.0f, 1.0f)), // beyond the far plane
+			!intersects(frustum, makeAabb(-30.0f, 0.0f, 10.0f, 1.0f)), // left
+			!intersects(frustum, makeAabb(0.0f, 30.0f, 10.0f, 1.0f)), // above
+			intersects(frustum, makeAabb(-10.5f, 0.0f, 10.0f, 1.0f)), // across the left plane
+			intersects(frustum, makeAabb(0.0f, 0.0f, 0.0f, 5.0f)), // around the camera
+			!intersects(frustum, Aabb()),
+		};
+
+		for (const bool result : results)
+		{
+			if (!result)
+				return false;
+		}
+	}
+
+	// the corners of a box rotated and moved are in the transformed box
+	{
+		const Aabb aabb = makeAabb(1.0f, 2.0f, 3.0f, 1.5f);
+		const XMMATRIX m = XMMatrixRotationRollPitchYaw(0.3f, 0.7f, -0.4f) * XMMatrixTranslation(5.0f, -2.0f, 1.0f);
+		const Aabb transformed = transform(aabb, m);
+		const Aabb exact = transformCorners(aabb, m);
+
+		if (!contains(transformed, exact.minPos, 1e-4f) || !contains(transformed, exact.maxPos, 1e-4f))
+			return false;
+
+		if (!transform(Aabb(), m).isEmpty())
+			return false;
+	}
+
+	// the distance to the nearest point of a box, and its height on the screen
+	{
+		const Aabb aabb = makeAabb(0.0f, 0.0f, 0.0f, 1.0f);
+
+		if (getDistance(aabb, { 0.5f, 0.0f, 0.0f }) != 0.0f || std::abs(getDistance(aabb, { 4.0f, 5.0f, 0.0f }) - 5.0f) > 1e-4f)
+			return false;
+
+		if (getDistance(Aabb(), { 0.0f, 0.0f, 0.0f }) != FLT_MAX)
+			return false;
+
+		Views views;
+		views.eye = { 0.0f, 0.0f, -10.0f };
+		views.screenScale = 100.0f;
+
+		if (std::abs(getScreenHeight(aabb, views) - 20.0f) > 1e-3f || getScreenHeight(Aabb(), views) != 0.0f)
+			return false;
+	}
+
+	// a bone with a part of the weight has the vertex too. A bone with none does not
+	{
+		std::vector<Aabb> boneBounds(3);
+		addInfluence(&boneBounds, { 1.0f, 2.0f, 3.0f }, 0, 1, 0.25f);
+		addInfluence(&boneBounds, { 1.0f, 2.0f, 3.0f }, 2, 0, 1.0f);
+
+		if (boneBounds.at(0).isEmpty() || boneBounds.at(1).isEmpty() || boneBounds.at(2).isEmpty())
+			return false;
+
+		if (compact(boneBounds).size() != 3 || compact(std::vector<Aabb>(2)).size() != 0)
+			return false;
+
+		std::vector<Aabb> single(2);
+		addInfluence(&single, { 1.0f, 2.0f, 3.0f }, 0, 1, 1.0f);
+
+		if (single.at(0).isEmpty() || !single.at(1).isEmpty())
+			return false;
+	}
+
+	// conservativeness. Every vertex skinned with random palettes stays in the skinned box
+	{
+		constexpr uint32_t kNumBones = 6;
+		constexpr uint32_t kNumVertices = 500;
+		uint32_t seed = 12345;
+
+		auto random = [&seed]() {
+			seed = seed * 1664525u + 1013904223u;
+			return static_cast<float>(seed >> 8) / static_cast<float>(1u << 24); // [0, 1)
+		};
+
+		struct Vertex
+		{
+			XMFLOAT3 pos;
+			uint32_t bones[2];
+			float weight;
+		};
+
+		std::vector<Vertex> vertices(kNumVertices);
+		std::vector<Aabb> boneBounds(kNumBones);
+
+		for (auto& v : vertices)
+		{
+			v.pos = { random() * 20.0f - 10.0f, random() * 20.0f, random() * 4.0f - 2.0f };
+			v.bones[0] = static_cast<uint32_t>(random() * kNumBones);
+			v.bones[1] = static_cast<uint32_t>(random() * kNumBones);
+			v.weight = (random() < 0.3f) ? 1.0f : random(); // PMD weights are often 100
+
+			addInfluence(&boneBounds, v.pos, v.bones[0], v.bones[1], v.weight);
+		}
+
+		const std::vector<BoneBound> compacted = compact(boneBounds);
+
+		for (uint32_t trial = 0; trial < 8; ++trial)
+		{
+			std::vector<XMMATRIX> palette(kNumBones);
+
+			for (auto& m : palette)
+			{
+				m = XMMatrixRotationRollPitchYaw(random() * XM_2PI, random() * XM_2PI, random() * XM_2PI)
+					* XMMatrixTranslation(random() * 10.0f, random() * 10.0f, random() * 10.0f);
+			}
+
+			const Aabb skinned = skin(compacted, palette.data());
+
+			for (const auto& v : vertices)
+			{
+				const XMVECTOR pos = XMLoadFloat3(&v.pos);
+				const XMVECTOR p0 = XMVector3Transform(pos, palette.at(v.bones[0]));
+				const XMVECTOR p1 = XMVector3Transform(pos, palette.at(v.bones[1]));
+
+				XMFLOAT3 blended = { };
+				XMStoreFloat3(&blended, XMVectorLerp(p1, p0, v.weight));
+
+				if (!contains(skinned, blended, 1e-3f))
+					return false;
+			}
+		}
+	}
+
+	// the planar shadow of a box is where the shadows of its corners are
+	{
+		const XMMATRIX shadow = XMMatrixShadow(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), XMVectorSet(1.0f, 1.0f, 0.0f, 0.0f));
+		const Aabb projected = transformCorners(makeAabb(0.0f, 5.0f, 0.0f, 1.0f), shadow);
+
+		if (std::fabs(projected.minPos.y) > 1e-4f || std::fabs(projected.maxPos.y) > 1e-4f)
+			return false;
+
+		if (projected.minPos.x > -6.0f + 1e-4f || projected.maxPos.x < -4.0f - 1e-4f)
+			return false;
+	}
+
+	return true;
+}
+
+} // namespace Culling
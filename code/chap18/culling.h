@@ -0,0 +1,72 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <DirectXMath.h>
+#include <array>
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+#pragma warning(pop)
+
+// Bounding boxes of skinned meshes, and the frustum tests against them.
+// The bones are given a box of the vertices they move in the bind pose. A skinned vertex is a blend of
+// its positions moved by its bones, so it stays in the union of the boxes moved by the bones. That union is the skinned box.
+namespace Culling {
+
+struct Aabb
+{
+	DirectX::XMFLOAT3 minPos = { FLT_MAX, FLT_MAX, FLT_MAX };
+	DirectX::XMFLOAT3 maxPos = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	bool isEmpty() const { return minPos.x > maxPos.x; }
+};
+
+struct BoneBound
+{
+	uint32_t bone = 0;
+	Aabb bound; // in the bind pose
+};
+
+// the six planes in four wide rows, so that a box is tested against four planes at a time
+struct Frustum
+{
+	std::array<DirectX::XMVECTOR, 4> planes0 = { }; // x, y, z and w of left, right, bottom and top
+	std::array<DirectX::XMVECTOR, 4> planes1 = { }; // near and far, twice
+};
+
+// the views an actor is drawn in for a frame
+struct Views
+{
+	Frustum camera;
+	Frustum light;
+	DirectX::XMMATRIX planarShadow = DirectX::XMMatrixIdentity(); // the copy on the floor, which is drawn in the camera view
+	DirectX::XMFLOAT3 eye = { }; // of the camera
+	float screenScale = FLT_MAX; // pixels per unit at the distance of 1 in the camera view. FLT_MAX keeps the full meshes
+};
+
+void extend(Aabb* pAabb, DirectX::FXMVECTOR pos);
+Aabb merge(const Aabb& a, const Aabb& b);
+// weight is of bone0. A bone with any weight gets the vertex
+void addInfluence(std::vector<Aabb>* pBoneBounds, const DirectX::XMFLOAT3& pos, uint32_t bone0, uint32_t bone1, float weight);
+std::vector<BoneBound> compact(const std::vector<Aabb>& boneBounds);
+
+// an affine transform, with the extents through the absolute of the matrix
+Aabb transform(const Aabb& aabb, DirectX::FXMMATRIX m);
+// the eight corners, for a projection such as the planar shadow
+Aabb transformCorners(const Aabb& aabb, DirectX::FXMMATRIX m);
+Aabb skin(const std::vector<BoneBound>& boneBounds, const DirectX::XMMATRIX* palette);
+
+// viewProj maps to the D3D clip space, z in [0, 1]
+Frustum makeFrustum(DirectX::FXMMATRIX viewProj);
+Views makeViews(DirectX::FXMMATRIX cameraViewProj, DirectX::CXMMATRIX lightViewProj, DirectX::CXMMATRIX planarShadow, const DirectX::XMFLOAT3& eye, float screenScale);
+// false only if the box is outside a plane. A box near a corner may pass
+bool intersects(const Frustum& frustum, const Aabb& aabb);
+// 0 inside the box, and FLT_MAX to an empty one
+float getDistance(const Aabb& aabb, const DirectX::XMFLOAT3& pos);
+// the height of the box in pixels, at the distance of its center in the camera view. 0 for an empty one
+float getScreenHeight(const Aabb& aabb, const Views& views);
+
+bool selfCheck();
+
+} // namespace Culling
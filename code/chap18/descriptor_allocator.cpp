@@ -0,0 +1,299 @@
+#include "descriptor_allocator.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <algorithm>
+#include <d3dx12.h>
+#pragma warning(pop)
+#include "debug.h"
+#include "util.h"
+
+D3D12_CPU_DESCRIPTOR_HANDLE DescriptorTable::getCpuHandle(uint32_t offset) const
+{
+	ThrowIfFalse(offset < count);
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(cpuHandle, static_cast<INT>(offset), incSize);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE DescriptorTable::getGpuHandle(uint32_t offset) const
+{
+	ThrowIfFalse(offset < count);
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(gpuHandle, static_cast<INT>(offset), incSize);
+}
+
+void FreeListAllocator::reset(uint32_t base, uint32_t capacity)
+{
+	m_freeRanges.clear();
+
+	if (capacity > 0)
+	{
+		m_freeRanges.push_back({ base, capacity });
+	}
+}
+
+uint32_t FreeListAllocator::allocate(uint32_t count)
+{
+	ThrowIfFalse(count > 0);
+
+	for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it)
+	{
+		if (it->count < count)
+			continue;
+
+		const uint32_t index = it->begin;
+		it->begin += count;
+		it->count -= count;
+
+		if (it->count == 0)
+		{
+			m_freeRanges.erase(it);
+		}
+
+		return index;
+	}
+
+	return kInvalidIndex;
+}
+
+void FreeListAllocator::free(uint32_t index, uint32_t count)
+{
+	ThrowIfFalse(count > 0);
+
+	auto next = std::lower_bound(m_freeRanges.begin(), m_freeRanges.end(), index, [](const Range& range, uint32_t idx) {
+		return range.begin < idx;
+		});
+
+	// a double free would overlap a free range
+	ThrowIfFalse(next == m_freeRanges.end() || index + count <= next->begin);
+	ThrowIfFalse(next == m_freeRanges.begin() || std::prev(next)->begin + std::prev(next)->count <= index);
+
+	next = m_freeRanges.insert(next, { index, count });
+
+	if (std::next(next) != m_freeRanges.end() && next->begin + next->count == std::next(next)->begin)
+	{
+		next->count += std::next(next)->count;
+		m_freeRanges.erase(std::next(next));
+	}
+
+	if (next != m_freeRanges.begin() && std::prev(next)->begin + std::prev(next)->count == next->begin)
+	{
+		std::prev(next)->count += next->count;
+		m_freeRanges.erase(next);
+	}
+}
+
+uint32_t FreeListAllocator::getNumFree() const
+{
+	uint32_t num = 0;
+
+	for (const auto& range : m_freeRanges)
+	{
+		num += range.count;
+	}
+
+	return num;
+}
+
+void FrameRingAllocator::reset(uint32_t base, uint32_t sizePerFrame, uint32_t numFrames)
+{
+	m_base = base;
+	m_sizePerFrame = sizePerFrame;
+	m_numFrames = numFrames;
+	m_frameIndex = 0;
+	m_peak = 0;
+	m_used = 0;
+}
+
+void FrameRingAllocator::beginFrame(uint32_t frameIndex)
+{
+	ThrowIfFalse(frameIndex < m_numFrames);
+
+	m_peak = std::max(m_peak, std::min(m_used.load(), m_sizePerFrame));
+	m_frameIndex = frameIndex;
+	m_used = 0;
+}
+
+uint32_t FrameRingAllocator::allocate(uint32_t count)
+{
+	ThrowIfFalse(count > 0);
+
+	const uint32_t offset = m_used.fetch_add(count);
+
+	if (offset + count > m_sizePerFrame)
+		return kInvalidIndex;
+
+	return m_base + m_frameIndex * m_sizePerFrame + offset;
+}
+
+HRESULT DescriptorAllocator::init(ID3D12Device* device, uint32_t numPersistent, uint32_t numTransientPerFrame, uint32_t numFrames)
+{
+	ThrowIfFalse(device != nullptr);
+
+	m_device = device;
+	m_incSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	{
+		const D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {
+			.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
+			.NumDescriptors = numPersistent + numTransientPerFrame * numFrames,
+			.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE,
+			.NodeMask = 0,
+		};
+
+		auto result = device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(m_heap.ReleaseAndGetAddressOf()));
+		ThrowIfFailed(result);
+
+		result = m_heap.Get()->SetName(Util::getWideStringFromString("globalCbvSrvUavHeap").c_str());
+		ThrowIfFailed(result);
+	}
+
+	// [0, numPersistent) is persistent, the rest is the ring
+	m_persistent.reset(0, numPersistent);
+	m_transient.reset(numPersistent, numTransientPerFrame, numFrames);
+
+	return S_OK;
+}
+
+void DescriptorAllocator::release()
+{
+	Debug::debugOutputFormatString("Global descriptor heap: persistent free %u, transient peak %u\n",
+		m_persistent.getNumFree(),
+		m_transient.getPeak());
+
+	m_heap.Reset();
+	m_device.Reset();
+}
+
+DescriptorTable DescriptorAllocator::allocate(uint32_t count)
+{
+	uint32_t index = FreeListAllocator::kInvalidIndex;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		index = m_persistent.allocate(count);
+	}
+	ThrowIfFalse(index != FreeListAllocator::kInvalidIndex);
+
+	return makeTable(index, count);
+}
+
+DescriptorTable DescriptorAllocator::stage(D3D12_CPU_DESCRIPTOR_HANDLE src, uint32_t count)
+{
+	const DescriptorTable table = allocate(count);
+	m_device.Get()->CopyDescriptorsSimple(count, table.cpuHandle, src, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	return table;
+}
+
+void DescriptorAllocator::free(DescriptorTable* pTable)
+{
+	ThrowIfFalse(pTable != nullptr);
+
+	if (!pTable->isValid())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_persistent.free(pTable->index, pTable->count);
+	}
+	*pTable = { };
+}
+
+void DescriptorAllocator::beginFrame(uint32_t frameIndex)
+{
+	m_transient.beginFrame(frameIndex);
+}
+
+DescriptorTable DescriptorAllocator::allocateTransient(uint32_t count)
+{
+	const uint32_t index = m_transient.allocate(count);
+	ThrowIfFalse(index != FrameRingAllocator::kInvalidIndex);
+
+	return makeTable(index, count);
+}
+
+DescriptorTable DescriptorAllocator::stageTransient(D3D12_CPU_DESCRIPTOR_HANDLE src, uint32_t count)
+{
+	const DescriptorTable table = allocateTransient(count);
+	m_device.Get()->CopyDescriptorsSimple(count, table.cpuHandle, src, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	return table;
+}
+
+void DescriptorAllocator::bind(ID3D12GraphicsCommandList* list) const
+{
+	ThrowIfFalse(list != nullptr);
+
+	ID3D12DescriptorHeap* heaps[] = { m_heap.Get() };
+	list->SetDescriptorHeaps(1, heaps);
+}
+
+DescriptorTable DescriptorAllocator::makeTable(uint32_t index, uint32_t count) const
+{
+	DescriptorTable table = { };
+	{
+		table.index = index;
+		table.count = count;
+		table.incSize = m_incSize;
+		table.cpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(m_heap.Get()->GetCPUDescriptorHandleForHeapStart(), static_cast<INT>(index), m_incSize);
+		table.gpuHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_heap.Get()->GetGPUDescriptorHandleForHeapStart(), static_cast<INT>(index), m_incSize);
+	}
+
+	return table;
+}
+
+bool DescriptorAllocator::selfCheck()
+{
+	// first fit, and the freed ranges are merged back into one
+	{
+		FreeListAllocator allocator;
+		allocator.reset(0, 16);
+
+		const uint32_t a = allocator.allocate(4);
+		const uint32_t b = allocator.allocate(4);
+		const uint32_t c = allocator.allocate(4);
+
+		if (a != 0 || b != 4 || c != 8 || allocator.getNumFree() != 4)
+			return false;
+
+		allocator.free(b, 4);
+
+		// too large for the hole of b
+		if (allocator.allocate(5) != FreeListAllocator::kInvalidIndex)
+			return false;
+
+		// fits in the hole of b
+		const uint32_t d = allocator.allocate(2);
+
+		if (d != 4)
+			return false;
+
+		allocator.free(a, 4);
+		allocator.free(c, 4);
+		allocator.free(d, 2);
+
+		if (allocator.getNumFree() != 16 || allocator.getNumFreeRanges() != 1)
+			return false;
+
+		if (allocator.allocate(16) != 0 || allocator.allocate(1) != FreeListAllocator::kInvalidIndex)
+			return false;
+	}
+
+	// each frame has its own slice and it is rewound when the frame comes around again
+	{
+		FrameRingAllocator ring;
+		ring.reset(100, 8, 2);
+
+		ring.beginFrame(0);
+		if (ring.allocate(3) != 100 || ring.allocate(5) != 103 || ring.allocate(1) != FrameRingAllocator::kInvalidIndex)
+			return false;
+
+		ring.beginFrame(1);
+		if (ring.allocate(2) != 108)
+			return false;
+
+		ring.beginFrame(0);
+		if (ring.allocate(8) != 100 || ring.getPeak() != 8)
+			return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <atomic>
+#include <cstdint>
+#include <d3d12.h>
+#include <mutex>
+#include <vector>
+#include <wrl.h>
+#pragma warning(pop)
+
+// A range of descriptors in the global shader visible heap
+struct DescriptorTable
+{
+	uint32_t index = 0;
+	uint32_t count = 0;
+	D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = { };
+	D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle = { };
+	UINT incSize = 0;
+
+	bool isValid() const { return count > 0; }
+	D3D12_CPU_DESCRIPTOR_HANDLE getCpuHandle(uint32_t offset = 0) const;
+	D3D12_GPU_DESCRIPTOR_HANDLE getGpuHandle(uint32_t offset = 0) const;
+};
+
+// First fit over the free ranges. Freed ranges are merged with their neighbours
+class FreeListAllocator
+{
+public:
+	static constexpr uint32_t kInvalidIndex = UINT32_MAX;
+
+	void reset(uint32_t base, uint32_t capacity);
+	uint32_t allocate(uint32_t count);
+	void free(uint32_t index, uint32_t count);
+	uint32_t getNumFree() const;
+	size_t getNumFreeRanges() const { return m_freeRanges.size(); }
+
+private:
+	struct Range
+	{
+		uint32_t begin = 0;
+		uint32_t count = 0;
+	};
+
+	std::vector<Range> m_freeRanges; // sorted by begin
+};
+
+// Each frame in flight owns a slice. A slice is rewound when its frame begins again,
+// which is after the GPU has finished the frame that used it last time.
+// allocate() is lock free since the command lists are recorded by the workers.
+class FrameRingAllocator
+{
+public:
+	static constexpr uint32_t kInvalidIndex = UINT32_MAX;
+
+	void reset(uint32_t base, uint32_t sizePerFrame, uint32_t numFrames);
+	void beginFrame(uint32_t frameIndex);
+	uint32_t allocate(uint32_t count);
+	uint32_t getUsed() const { return m_used.load(); }
+	uint32_t getPeak() const { return m_peak; }
+
+private:
+	uint32_t m_base = 0;
+	uint32_t m_sizePerFrame = 0;
+	uint32_t m_numFrames = 0;
+	uint32_t m_frameIndex = 0;
+	uint32_t m_peak = 0;
+	std::atomic<uint32_t> m_used = 0;
+};
+
+// The only shader visible CBV/SRV/UAV heap. The modules create their views in CPU only heaps
+// and copy them here: stage() for the views which live as long as the module,
+// stageTransient() for the ones which are rewritten every frame.
+class DescriptorAllocator
+{
+public:
+	HRESULT init(ID3D12Device* device, uint32_t numPersistent, uint32_t numTransientPerFrame, uint32_t numFrames);
+	void release();
+
+	DescriptorTable allocate(uint32_t count);
+	DescriptorTable stage(D3D12_CPU_DESCRIPTOR_HANDLE src, uint32_t count);
+	void free(DescriptorTable* pTable);
+
+	void beginFrame(uint32_t frameIndex);
+	DescriptorTable allocateTransient(uint32_t count);
+	DescriptorTable stageTransient(D3D12_CPU_DESCRIPTOR_HANDLE src, uint32_t count);
+
+	void bind(ID3D12GraphicsCommandList* list) const;
+	ID3D12DescriptorHeap* getHeap() const { return m_heap.Get(); }
+
+	static bool selfCheck();
+
+private:
+	DescriptorTable makeTable(uint32_t index, uint32_t count) const;
+
+	Microsoft::WRL::ComPtr<ID3D12Device> m_device = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_heap = nullptr;
+	UINT m_incSize = 0;
+	std::mutex m_mutex; // guards m_persistent
+	FreeListAllocator m_persistent;
+	FrameRingAllocator m_transient;
+};
@@ -50,9 +50,9 @@ HRESULT DoF::clearWorkRenderTarget(ID3D12GraphicsCommandList* list)
     return S_OK;
 }
 
-HRESULT DoF::render(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE dstRtv, ID3D12DescriptorHeap* pBaseSrvHeap, D3D12_GPU_DESCRIPTOR_HANDLE baseSrvHandle, ID3D12DescriptorHeap* pDepthSrvHeap, D3D12_GPU_DESCRIPTOR_HANDLE depthSrvHandle)
+HRESULT DoF::render(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE dstRtv, D3D12_GPU_DESCRIPTOR_HANDLE baseSrvHandle, D3D12_GPU_DESCRIPTOR_HANDLE depthSrvHandle)
 {
-    renderShrink(list, pBaseSrvHeap, baseSrvHandle);
+    renderShrink(list, baseSrvHandle);
 
     {
 		const auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(
@@ -63,19 +63,14 @@ HRESULT DoF::render(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE
         list->ResourceBarrier(1, &barrier);
     }
 
-    renderDof(list, dstRtv, pBaseSrvHeap, baseSrvHandle, pDepthSrvHeap, depthSrvHandle);
+    renderDof(list, dstRtv, baseSrvHandle, depthSrvHandle);
 
 	return S_OK;
 }
 
-ComPtr<ID3D12DescriptorHeap> DoF::getWorkDescSrvHeap() const
-{
-    return m_workDescSrvHeap;
-}
-
 D3D12_GPU_DESCRIPTOR_HANDLE DoF::getWorkResourceSrcHandle() const
 {
-    return m_workDescSrvHeap.Get()->GetGPUDescriptorHandleForHeapStart();
+    return m_workSrvTable.getGpuHandle();
 }
 
 HRESULT DoF::compileShaders()
@@ -96,14 +91,11 @@ HRESULT DoF::compileShaders()
         if (m_vsBlobs.at(i))
             continue;
 
-        auto result = D3DCompileFromFile(
+        auto result = Resource::instance()->getShaderCache()->load(
             kVsFile,
             Constant::kCompileShaderDefines,
-            D3D_COMPILE_STANDARD_FILE_INCLUDE,
             kVsEntrypoints.at(i),
-            Constant::kVsShaderModel,
-            Constant::kCompileShaderFlags1,
-            Constant::kCompileShaderFlags2,
+            Constant::kDxcVsShaderModel,
             m_vsBlobs.at(i).ReleaseAndGetAddressOf(),
             errorBlob.ReleaseAndGetAddressOf());
 
@@ -128,14 +120,11 @@ HRESULT DoF::compileShaders()
         if (m_psBlobs.at(i))
             continue;
 
-        auto result = D3DCompileFromFile(
+        auto result = Resource::instance()->getShaderCache()->load(
             kPsFile,
             Constant::kCompileShaderDefines,
-            D3D_COMPILE_STANDARD_FILE_INCLUDE,
             kPsEntrypoints.at(i),
-            Constant::kPsShaderModel,
-            Constant::kCompileShaderFlags1,
-            Constant::kCompileShaderFlags2,
+            Constant::kDxcPsShaderModel,
             m_psBlobs.at(i).ReleaseAndGetAddressOf(),
             errorBlob.ReleaseAndGetAddressOf());
 
@@ -248,7 +237,7 @@ HRESULT DoF::createResource(UINT64 dstWidth, UINT dstHeight)
             const D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {
                 .Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
                 .NumDescriptors = 1,
-                .Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE,
+                .Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE,
                 .NodeMask = 0,
             };
 
@@ -276,6 +265,8 @@ HRESULT DoF::createResource(UINT64 dstWidth, UINT dstHeight)
                 m_workResource.Get(),
                 &srvDesc,
                 m_workDescSrvHeap.Get()->GetCPUDescriptorHandleForHeapStart());
+
+            m_workSrvTable = Resource::instance()->getDescriptorAllocator()->stage(m_workDescSrvHeap.Get()->GetCPUDescriptorHandleForHeapStart(), 1);
         }
     }
 
@@ -334,11 +325,10 @@ HRESULT DoF::createRootSignature()
     }
     ThrowIfFailed(result);
 
-    result = Resource::instance()->getDevice()->CreateRootSignature(
-        0 /* nodeMask */,
+    result = Resource::instance()->getPipelineCache()->createRootSignature(
         rootSigBlob.Get()->GetBufferPointer(),
         rootSigBlob.Get()->GetBufferSize(),
-        IID_PPV_ARGS(m_rootSignature.ReleaseAndGetAddressOf()));
+        m_rootSignature.ReleaseAndGetAddressOf());
     ThrowIfFailed(result);
 
     result = m_rootSignature.Get()->SetName(Util::getWideStringFromString("dofRootSignature").c_str());
@@ -401,9 +391,9 @@ HRESULT DoF::createPipelineState()
 		gpDesc.DepthStencilState.DepthEnable = false;
 		gpDesc.RTVFormats[0] = Constant::kDefaultRtFormat;
 
-		auto result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+		auto result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
 			&gpDesc,
-			IID_PPV_ARGS(m_pipelineStates.at(static_cast<size_t>(Pass::kCopy)).ReleaseAndGetAddressOf()));
+			m_pipelineStates.at(static_cast<size_t>(Pass::kCopy)).ReleaseAndGetAddressOf());
 		ThrowIfFailed(result);
 
 		result = m_pipelineStates.at(static_cast<size_t>(Pass::kCopy)).Get()->SetName(Util::getWideStringFromString("dofCopyPipelineState").c_str());
@@ -414,9 +404,9 @@ HRESULT DoF::createPipelineState()
         gpDesc.VS = { m_vsBlobs.at(static_cast<size_t>(Pass::kDof)).Get()->GetBufferPointer(), m_vsBlobs.at(static_cast<size_t>(Pass::kDof)).Get()->GetBufferSize() };
 		gpDesc.PS = { m_psBlobs.at(static_cast<size_t>(Pass::kDof)).Get()->GetBufferPointer(), m_psBlobs.at(static_cast<size_t>(Pass::kDof)).Get()->GetBufferSize() };
 
-		auto result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+		auto result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
 			&gpDesc,
-			IID_PPV_ARGS(m_pipelineStates.at(static_cast<size_t>(Pass::kDof)).ReleaseAndGetAddressOf()));
+			m_pipelineStates.at(static_cast<size_t>(Pass::kDof)).ReleaseAndGetAddressOf());
 		ThrowIfFailed(result);
 
 		result = m_pipelineStates.at(static_cast<size_t>(Pass::kDof)).Get()->SetName(Util::getWideStringFromString("dofPipelineState").c_str());
@@ -426,23 +416,27 @@ HRESULT DoF::createPipelineState()
 	return S_OK;
 }
 
-HRESULT DoF::renderShrink(ID3D12GraphicsCommandList* list, ID3D12DescriptorHeap* pBaseSrvHeap, D3D12_GPU_DESCRIPTOR_HANDLE baseSrvHandle)
+HRESULT DoF::renderShrink(ID3D12GraphicsCommandList* list, D3D12_GPU_DESCRIPTOR_HANDLE baseSrvHandle)
 {
     constexpr int32_t baseWidth = Config::kWindowWidth / 2;
     constexpr int32_t baseHeight = Config::kWindowHeight / 2;
 
-    list->SetGraphicsRootSignature(m_rootSignature.Get());
-    list->SetPipelineState(m_pipelineStates.at(static_cast<size_t>(Pass::kCopy)).Get());
+    // the state only. The draws change the viewport, which a bundle cannot, so they stay in the list
+    const uint64_t key = BundleCache::makeKey("dof.shrink", { reinterpret_cast<uint64_t>(this), baseSrvHandle.ptr });
 
-    list->SetDescriptorHeaps(1, &pBaseSrvHeap);
-    list->SetGraphicsRootDescriptorTable(static_cast<UINT>(SrvSlot::kBaseColor), baseSrvHandle);
+    Resource::instance()->getBundleCache()->execute(list, key, [&](ID3D12GraphicsCommandList* bundle) {
+        bundle->SetGraphicsRootSignature(m_rootSignature.Get());
+        bundle->SetPipelineState(m_pipelineStates.at(static_cast<size_t>(Pass::kCopy)).Get());
+
+        bundle->SetGraphicsRootDescriptorTable(static_cast<UINT>(SrvSlot::kBaseColor), baseSrvHandle);
+
+        bundle->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+        bundle->IASetVertexBuffers(0, 1, &m_vbView);
+        });
 
     const D3D12_CPU_DESCRIPTOR_HANDLE dstRtvs[] = { m_workDescRtvHeap.Get()->GetCPUDescriptorHandleForHeapStart() };
     list->OMSetRenderTargets(_countof(dstRtvs), dstRtvs, false, nullptr);
 
-    list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-    list->IASetVertexBuffers(0, 1, &m_vbView);
-
     D3D12_VIEWPORT viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(baseWidth), static_cast<float>(baseHeight));
     D3D12_RECT scissorRect = CD3DX12_RECT(0, 0, baseWidth, baseHeight);
 
@@ -465,25 +459,10 @@ HRESULT DoF::renderShrink(ID3D12GraphicsCommandList* list, ID3D12DescriptorHeap*
     return S_OK;
 }
 
-HRESULT DoF::renderDof(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE dstRtv, ID3D12DescriptorHeap* pBaseSrvHeap, D3D12_GPU_DESCRIPTOR_HANDLE baseSrvHandle, ID3D12DescriptorHeap* pDepthSrvHeap, D3D12_GPU_DESCRIPTOR_HANDLE depthSrvHandle)
+HRESULT DoF::renderDof(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE dstRtv, D3D12_GPU_DESCRIPTOR_HANDLE baseSrvHandle, D3D12_GPU_DESCRIPTOR_HANDLE depthSrvHandle)
 {
-    list->SetGraphicsRootSignature(m_rootSignature.Get());
-    list->SetPipelineState(m_pipelineStates.at(static_cast<size_t>(Pass::kDof)).Get());
-
-    list->SetDescriptorHeaps(1, &pBaseSrvHeap);
-    list->SetGraphicsRootDescriptorTable(static_cast<UINT>(SrvSlot::kBaseColor), baseSrvHandle);
-
-    list->SetDescriptorHeaps(1, m_workDescSrvHeap.GetAddressOf());
-    list->SetGraphicsRootDescriptorTable(static_cast<UINT>(SrvSlot::kShrinkColor), m_workDescSrvHeap.Get()->GetGPUDescriptorHandleForHeapStart());
-
-    list->SetDescriptorHeaps(1, &pDepthSrvHeap);
-    list->SetGraphicsRootDescriptorTable(static_cast<UINT>(SrvSlot::kDepth), depthSrvHandle);
-
     list->OMSetRenderTargets(1, &dstRtv, 0, nullptr);
 
-    list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-    list->IASetVertexBuffers(0, 1, &m_vbView);
-
     {
         const D3D12_VIEWPORT viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(Config::kWindowWidth), static_cast<float>(Config::kWindowHeight));
         list->RSSetViewports(1, &viewport);
@@ -494,7 +473,23 @@ HRESULT DoF::renderDof(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HAN
         list->RSSetScissorRects(1, &scissorRect);
     }
 
-    list->DrawInstanced(_countof(vb), 1, 0, 0);
+    const uint64_t key = BundleCache::makeKey("dof.main", { reinterpret_cast<uint64_t>(this), baseSrvHandle.ptr, depthSrvHandle.ptr });
+
+    Resource::instance()->getBundleCache()->execute(list, key, [&](ID3D12GraphicsCommandList* bundle) {
+        bundle->SetGraphicsRootSignature(m_rootSignature.Get());
+        bundle->SetPipelineState(m_pipelineStates.at(static_cast<size_t>(Pass::kDof)).Get());
+
+        bundle->SetGraphicsRootDescriptorTable(static_cast<UINT>(SrvSlot::kBaseColor), baseSrvHandle);
+
+        bundle->SetGraphicsRootDescriptorTable(static_cast<UINT>(SrvSlot::kShrinkColor), m_workSrvTable.getGpuHandle());
+
+        bundle->SetGraphicsRootDescriptorTable(static_cast<UINT>(SrvSlot::kDepth), depthSrvHandle);
+
+        bundle->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+        bundle->IASetVertexBuffers(0, 1, &m_vbView);
+
+        bundle->DrawInstanced(_countof(vb), 1, 0, 0);
+        });
 
     return S_OK;
 }
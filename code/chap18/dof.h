@@ -7,13 +7,13 @@
 #include <d3d12.h>
 #include <wrl.h>
 #pragma warning(pop)
+#include "descriptor_allocator.h"
 
 class DoF {
 public:
 	HRESULT init(UINT64 width, UINT height);
 	HRESULT clearWorkRenderTarget(ID3D12GraphicsCommandList* list);
-	HRESULT render(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE dstRtv, ID3D12DescriptorHeap* pBaseSrvHeap, D3D12_GPU_DESCRIPTOR_HANDLE baseSrvHandle, ID3D12DescriptorHeap* pDepthSrvHeap, D3D12_GPU_DESCRIPTOR_HANDLE depthSrvHandle);
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> getWorkDescSrvHeap() const;
+	HRESULT render(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE dstRtv, D3D12_GPU_DESCRIPTOR_HANDLE baseSrvHandle, D3D12_GPU_DESCRIPTOR_HANDLE depthSrvHandle);
 	D3D12_GPU_DESCRIPTOR_HANDLE getWorkResourceSrcHandle() const;
 
 private:
@@ -39,8 +39,8 @@ private:
 	HRESULT createResource(UINT64 dstWidth, UINT dstHeight);
 	HRESULT createRootSignature();
 	HRESULT createPipelineState();
-	HRESULT renderShrink(ID3D12GraphicsCommandList* list, ID3D12DescriptorHeap* pBaseSrvHeap, D3D12_GPU_DESCRIPTOR_HANDLE baseSrvHandle);
-	HRESULT renderDof(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE dstRtv, ID3D12DescriptorHeap* pBaseSrvHeap, D3D12_GPU_DESCRIPTOR_HANDLE baseSrvHandle, ID3D12DescriptorHeap* pDepthSrvHeap, D3D12_GPU_DESCRIPTOR_HANDLE depthSrvHandle);
+	HRESULT renderShrink(ID3D12GraphicsCommandList* list, D3D12_GPU_DESCRIPTOR_HANDLE baseSrvHandle);
+	HRESULT renderDof(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE dstRtv, D3D12_GPU_DESCRIPTOR_HANDLE baseSrvHandle, D3D12_GPU_DESCRIPTOR_HANDLE depthSrvHandle);
 
 	std::array<Microsoft::WRL::ComPtr<ID3DBlob>, kNumPass> m_vsBlobs = { };
 	std::array<Microsoft::WRL::ComPtr<ID3DBlob>, kNumPass> m_psBlobs = { };
@@ -51,5 +51,6 @@ private:
 
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_workResource = nullptr; // to store shrink
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_workDescRtvHeap = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_workDescSrvHeap = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_workDescSrvHeap = nullptr; // staging
+	DescriptorTable m_workSrvTable;
 };
@@ -7,6 +7,7 @@
 #include <SpriteFont.h>
 #pragma warning(pop)
 #include "debug.h"
+#include "init.h"
 
 #pragma comment(lib, "DirectXTK12.lib")
 
@@ -21,24 +22,14 @@ HRESULT DxtkIf::init(ID3D12Device* device, DXGI_FORMAT rtFormat, DXGI_FORMAT dsF
 	DirectX::SpriteBatchPipelineStateDescription pd(rsState);
 	m_spriteBatch = std::make_unique<DirectX::SpriteBatch>(DirectX::SpriteBatch(device, resourceUploadBatch, pd));
 
-	{
-		const D3D12_DESCRIPTOR_HEAP_DESC heapDsc = {
-			.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
-			.NumDescriptors = 1,
-			.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE,
-			.NodeMask = 0,
-		};
-
-		auto result = device->CreateDescriptorHeap(&heapDsc, IID_PPV_ARGS(m_descHeap.ReleaseAndGetAddressOf()));
-		ThrowIfFailed(result);
-	}
+	m_fontSrvTable = Resource::instance()->getDescriptorAllocator()->allocate(1);
 
 	m_spriteFont = std::make_unique<DirectX::SpriteFont>(DirectX::SpriteFont(
 		device,
 		resourceUploadBatch,
 		kFilePath,
-		m_descHeap.Get()->GetCPUDescriptorHandleForHeapStart(),
-		m_descHeap.Get()->GetGPUDescriptorHandleForHeapStart()));
+		m_fontSrvTable.getCpuHandle(),
+		m_fontSrvTable.getGpuHandle()));
 	ThrowIfFalse(m_spriteFont != nullptr);
 
 	m_resourceUploadBatch = std::make_unique<DirectX::ResourceUploadBatch>(std::move(resourceUploadBatch));
@@ -63,8 +54,6 @@ HRESULT DxtkIf::draw(ID3D12GraphicsCommandList* list, float posx, float posy)
 {
 	ThrowIfFalse(list != nullptr);
 
-	list->SetDescriptorHeaps(1, m_descHeap.GetAddressOf());
-
 	m_spriteBatch->Begin(list);
 	{
 		m_spriteFont->DrawString(
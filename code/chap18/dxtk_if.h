@@ -11,6 +11,7 @@
 #include <memory>
 #include <wrl.h>
 #pragma warning(pop)
+#include "descriptor_allocator.h"
 
 class DxtkIf {
 public:
@@ -27,5 +28,5 @@ private:
 	std::unique_ptr<DirectX::SpriteFont> m_spriteFont = nullptr;
 	std::unique_ptr<DirectX::SpriteBatch> m_spriteBatch = nullptr;
 	std::unique_ptr<DirectX::ResourceUploadBatch> m_resourceUploadBatch = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_descHeap = nullptr;
+	DescriptorTable m_fontSrvTable; // in the global heap
 };
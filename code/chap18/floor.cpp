@@ -64,13 +64,11 @@ HRESULT Floor::init()
 	return S_OK;
 }
 
-HRESULT Floor::renderShadow(ID3D12GraphicsCommandList* list, ID3D12DescriptorHeap* sceneDescHeap, ID3D12DescriptorHeap* depthHeap)
+HRESULT Floor::renderShadow(ID3D12GraphicsCommandList* list, D3D12_GPU_DESCRIPTOR_HANDLE sceneDescHandle, ID3D12DescriptorHeap* depthHeap)
 {
 	ThrowIfFalse(list != nullptr);
-	ThrowIfFalse(sceneDescHeap != nullptr);
 	ThrowIfFalse(depthHeap != nullptr);
 
-	setInputAssembler(list);
 	setRasterizer(list, Config::kShadowBufferWidth, Config::kShadowBufferHeight);
 
 	{
@@ -78,67 +76,69 @@ HRESULT Floor::renderShadow(ID3D12GraphicsCommandList* list, ID3D12DescriptorHea
 		list->OMSetRenderTargets(0, nullptr, false, &depthHandle);
 	}
 
-	list->SetPipelineState(m_pipelineStates.at(PipelineType::kShadow).Get());
-	list->SetGraphicsRootSignature(m_rootSignature.Get());
+	const uint64_t key = BundleCache::makeKey("floor.shadow", { reinterpret_cast<uint64_t>(this), sceneDescHandle.ptr });
 
-	list->SetDescriptorHeaps(1, &sceneDescHeap);
-	list->SetGraphicsRootDescriptorTable(0 /* root param 0 */, sceneDescHeap->GetGPUDescriptorHandleForHeapStart());
+	Resource::instance()->getBundleCache()->execute(list, key, [&](ID3D12GraphicsCommandList* bundle) {
+		setInputAssembler(bundle);
 
-	list->SetDescriptorHeaps(1, m_transDescHeap.GetAddressOf());
-	list->SetGraphicsRootDescriptorTable(1 /* root param 1 */, m_transDescHeap.Get()->GetGPUDescriptorHandleForHeapStart());
+		bundle->SetPipelineState(m_pipelineStates.at(PipelineType::kShadow).Get());
+		bundle->SetGraphicsRootSignature(m_rootSignature.Get());
 
-	list->DrawInstanced(_countof(kFloorVertices), 1, 0, 0);
+		bundle->SetGraphicsRootDescriptorTable(0 /* root param 0 */, sceneDescHandle);
+		bundle->SetGraphicsRootDescriptorTable(1 /* root param 1 */, m_transDescTable.getGpuHandle());
+
+		bundle->DrawInstanced(_countof(kFloorVertices), 1, 0, 0);
+		});
 
 	return S_OK;
 }
 
-HRESULT Floor::render(ID3D12GraphicsCommandList* list, ID3D12DescriptorHeap* sceneDescHeap, ID3D12DescriptorHeap* depthLightSrvHeap)
+HRESULT Floor::render(ID3D12GraphicsCommandList* list, D3D12_GPU_DESCRIPTOR_HANDLE sceneDescHandle, D3D12_GPU_DESCRIPTOR_HANDLE depthLightSrvHandle)
 {
 	ThrowIfFalse(list != nullptr);
-	ThrowIfFalse(sceneDescHeap != nullptr);
 
-	setInputAssembler(list);
 	setRasterizer(list, Config::kWindowWidth, Config::kWindowHeight);
 
-	list->SetPipelineState(m_pipelineStates.at(PipelineType::kMesh).Get());
-	list->SetGraphicsRootSignature(m_rootSignature.Get());
+	const uint64_t key = BundleCache::makeKey("floor.mesh", { reinterpret_cast<uint64_t>(this), sceneDescHandle.ptr, depthLightSrvHandle.ptr });
+
+	Resource::instance()->getBundleCache()->execute(list, key, [&](ID3D12GraphicsCommandList* bundle) {
+		setInputAssembler(bundle);
 
-	list->SetDescriptorHeaps(1, &sceneDescHeap);
-	list->SetGraphicsRootDescriptorTable(0 /* root param 0 */, sceneDescHeap->GetGPUDescriptorHandleForHeapStart());
+		bundle->SetPipelineState(m_pipelineStates.at(PipelineType::kMesh).Get());
+		bundle->SetGraphicsRootSignature(m_rootSignature.Get());
 
-	list->SetDescriptorHeaps(1, m_transDescHeap.GetAddressOf());
-	list->SetGraphicsRootDescriptorTable(1 /* root param 1 */, m_transDescHeap.Get()->GetGPUDescriptorHandleForHeapStart());
+		bundle->SetGraphicsRootDescriptorTable(0 /* root param 0 */, sceneDescHandle);
+		bundle->SetGraphicsRootDescriptorTable(1 /* root param 1 */, m_transDescTable.getGpuHandle());
 
-	list->SetDescriptorHeaps(1, &depthLightSrvHeap);
-	list->SetGraphicsRootDescriptorTable(2 /* root param 2 */, depthLightSrvHeap->GetGPUDescriptorHandleForHeapStart());
+		bundle->SetGraphicsRootDescriptorTable(2 /* root param 2 */, depthLightSrvHandle);
 
-	list->DrawInstanced(_countof(kFloorVertices), 1, 0, 0);
+		bundle->DrawInstanced(_countof(kFloorVertices), 1, 0, 0);
+		});
 
 	return S_OK;
 }
 
-HRESULT Floor::renderAxis(ID3D12GraphicsCommandList* list, ID3D12DescriptorHeap* sceneDescHeap, D3D12_CPU_DESCRIPTOR_HANDLE dstRt, D3D12_CPU_DESCRIPTOR_HANDLE dstDrt)
+HRESULT Floor::renderAxis(ID3D12GraphicsCommandList* list, D3D12_GPU_DESCRIPTOR_HANDLE sceneDescHandle, D3D12_CPU_DESCRIPTOR_HANDLE dstRt, D3D12_CPU_DESCRIPTOR_HANDLE dstDrt)
 {
 	ThrowIfFalse(list != nullptr);
-	ThrowIfFalse(sceneDescHeap != nullptr);
 
-	{
-		list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_LINELIST);
-		list->IASetVertexBuffers(0, 1, &m_vbViews.at(VbType::kAxis));
-	}
 	setRasterizer(list, Config::kWindowWidth, Config::kWindowHeight);
 	list->OMSetRenderTargets(1, &dstRt, false, &dstDrt);
 
-	list->SetPipelineState(m_pipelineStates.at(PipelineType::kAxis).Get());
-	list->SetGraphicsRootSignature(m_rootSignature.Get());
+	const uint64_t key = BundleCache::makeKey("floor.axis", { reinterpret_cast<uint64_t>(this), sceneDescHandle.ptr });
+
+	Resource::instance()->getBundleCache()->execute(list, key, [&](ID3D12GraphicsCommandList* bundle) {
+		bundle->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_LINELIST);
+		bundle->IASetVertexBuffers(0, 1, &m_vbViews.at(VbType::kAxis));
 
-	list->SetDescriptorHeaps(1, &sceneDescHeap);
-	list->SetGraphicsRootDescriptorTable(0 /* root param 0 */, sceneDescHeap->GetGPUDescriptorHandleForHeapStart());
+		bundle->SetPipelineState(m_pipelineStates.at(PipelineType::kAxis).Get());
+		bundle->SetGraphicsRootSignature(m_rootSignature.Get());
 
-	list->SetDescriptorHeaps(1, m_transDescHeap.GetAddressOf());
-	list->SetGraphicsRootDescriptorTable(1 /* root param 1 */, m_transDescHeap.Get()->GetGPUDescriptorHandleForHeapStart());
+		bundle->SetGraphicsRootDescriptorTable(0 /* root param 0 */, sceneDescHandle);
+		bundle->SetGraphicsRootDescriptorTable(1 /* root param 1 */, m_transDescTable.getGpuHandle());
 
-	list->DrawInstanced(_countof(kAxisVertices), 1, 0, 0);
+		bundle->DrawInstanced(_countof(kAxisVertices), 1, 0, 0);
+		});
 
 	return S_OK;
 }
@@ -163,14 +163,11 @@ HRESULT Floor::loadShaders()
 {
 	ComPtr<ID3DBlob> errorBlob = nullptr;
 
-	auto result = D3DCompileFromFile(
+	auto result = Resource::instance()->getShaderCache()->load(
 		kVsFile,
 		nullptr,
-		D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		kVsEntryPoints.at(VsType::kBasic),
-		Constant::kVsShaderModel,
-		D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-		0,
+		Constant::kDxcVsShaderModel,
 		m_vsArray.at(VsType::kBasic).ReleaseAndGetAddressOf(),
 		errorBlob.ReleaseAndGetAddressOf());
 
@@ -180,14 +177,11 @@ HRESULT Floor::loadShaders()
 		return E_FAIL;
 	}
 
-	result = D3DCompileFromFile(
+	result = Resource::instance()->getShaderCache()->load(
 		kVsFile,
 		nullptr,
-		D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		kVsEntryPoints.at(VsType::kShadow),
-		Constant::kVsShaderModel,
-		D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-		0,
+		Constant::kDxcVsShaderModel,
 		m_vsArray.at(VsType::kShadow).ReleaseAndGetAddressOf(),
 		errorBlob.ReleaseAndGetAddressOf());
 
@@ -197,14 +191,11 @@ HRESULT Floor::loadShaders()
 		return E_FAIL;
 	}
 
-	result = D3DCompileFromFile(
+	result = Resource::instance()->getShaderCache()->load(
 		kVsFile,
 		nullptr,
-		D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		kVsEntryPoints.at(VsType::kAxis),
-		Constant::kVsShaderModel,
-		D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-		0,
+		Constant::kDxcVsShaderModel,
 		m_vsArray.at(VsType::kAxis).ReleaseAndGetAddressOf(),
 		errorBlob.ReleaseAndGetAddressOf());
 
@@ -214,14 +205,11 @@ HRESULT Floor::loadShaders()
 		return E_FAIL;
 	}
 
-	result = D3DCompileFromFile(
+	result = Resource::instance()->getShaderCache()->load(
 		kPsFile,
 		nullptr,
-		D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		kPsEntryPoints.at(PsType::kBasic),
-		Constant::kPsShaderModel,
-		D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-		0,
+		Constant::kDxcPsShaderModel,
 		m_psArray.at(PsType::kBasic).ReleaseAndGetAddressOf(),
 		errorBlob.ReleaseAndGetAddressOf());
 
@@ -231,14 +219,11 @@ HRESULT Floor::loadShaders()
 		return E_FAIL;
 	}
 
-	result = D3DCompileFromFile(
+	result = Resource::instance()->getShaderCache()->load(
 		kPsFile,
 		nullptr,
-		D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		kPsEntryPoints.at(PsType::kAxis),
-		Constant::kPsShaderModel,
-		D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-		0,
+		Constant::kDxcPsShaderModel,
 		m_psArray.at(PsType::kAxis).ReleaseAndGetAddressOf(),
 		errorBlob.ReleaseAndGetAddressOf());
 
@@ -386,8 +371,8 @@ HRESULT Floor::createTransformResource()
 		{
 			heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 			heapDesc.NumDescriptors = 1;
-			heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-			heapDesc.NodeMask = 1;
+			heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+			heapDesc.NodeMask = 0;
 		}
 
 		auto result = Resource::instance()->getDevice()->CreateDescriptorHeap(
@@ -406,6 +391,8 @@ HRESULT Floor::createTransformResource()
 		const auto handle = m_transDescHeap.Get()->GetCPUDescriptorHandleForHeapStart();
 
 		Resource::instance()->getDevice()->CreateConstantBufferView(&viewDesc, handle);
+
+		m_transDescTable = Resource::instance()->getDescriptorAllocator()->stage(handle, 1);
 	}
 
 	return S_OK;
@@ -480,11 +467,10 @@ HRESULT Floor::createRootSignature()
 		return E_FAIL;
 	}
 
-	result = Resource::instance()->getDevice()->CreateRootSignature(
-		0,
+	result = Resource::instance()->getPipelineCache()->createRootSignature(
 		rootSigBlob->GetBufferPointer(),
 		rootSigBlob->GetBufferSize(),
-		IID_PPV_ARGS(m_rootSignature.ReleaseAndGetAddressOf()));
+		m_rootSignature.ReleaseAndGetAddressOf());
 	ThrowIfFailed(result);
 
 	result = m_rootSignature.Get()->SetName(Util::getWideStringFromString("FloorRootSignature").c_str());
@@ -536,9 +522,9 @@ HRESULT Floor::createGraphicsPipeline()
 	}
 
 	{
-		auto result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+		auto result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
 			&pipelineStateDesc,
-			IID_PPV_ARGS(m_pipelineStates.at(PipelineType::kMesh).ReleaseAndGetAddressOf()));
+			m_pipelineStates.at(PipelineType::kMesh).ReleaseAndGetAddressOf());
 		ThrowIfFailed(result);
 
 		result = m_pipelineStates.at(PipelineType::kMesh).Get()->SetName(Util::getWideStringFromString("FloorGraphicsPipeline").c_str());
@@ -555,9 +541,9 @@ HRESULT Floor::createGraphicsPipeline()
 	}
 
 	{
-		auto result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+		auto result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
 			&pipelineStateDesc,
-			IID_PPV_ARGS(m_pipelineStates.at(PipelineType::kShadow).ReleaseAndGetAddressOf()));
+			m_pipelineStates.at(PipelineType::kShadow).ReleaseAndGetAddressOf());
 		ThrowIfFailed(result);
 
 		result = m_pipelineStates.at(PipelineType::kShadow)->SetName(Util::getWideStringFromString("FloorGraphicsShadowPipeline").c_str());
@@ -576,9 +562,9 @@ HRESULT Floor::createGraphicsPipeline()
 	}
 
 	{
-		auto result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+		auto result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
 			&pipelineStateDesc,
-			IID_PPV_ARGS(m_pipelineStates.at(PipelineType::kAxis).ReleaseAndGetAddressOf()));
+			m_pipelineStates.at(PipelineType::kAxis).ReleaseAndGetAddressOf());
 		ThrowIfFailed(result);
 
 		result = m_pipelineStates.at(PipelineType::kAxis)->SetName(Util::getWideStringFromString("FloorGraphicsAxisPipeline").c_str());
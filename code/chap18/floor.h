@@ -8,14 +8,15 @@
 #include <d3d12.h>
 #include <wrl.h>
 #pragma warning(pop)
+#include "descriptor_allocator.h"
 
 class Floor
 {
 public:
 	HRESULT init();
-	HRESULT renderShadow(ID3D12GraphicsCommandList* list, ID3D12DescriptorHeap* sceneDescHeap, ID3D12DescriptorHeap* depthHeap);
-	HRESULT render(ID3D12GraphicsCommandList* list, ID3D12DescriptorHeap* sceneDescHeap, ID3D12DescriptorHeap* depthLightSrvHeap);
-	HRESULT renderAxis(ID3D12GraphicsCommandList* list, ID3D12DescriptorHeap* sceneDescHeap, D3D12_CPU_DESCRIPTOR_HANDLE dstRt, D3D12_CPU_DESCRIPTOR_HANDLE dstDrt);
+	HRESULT renderShadow(ID3D12GraphicsCommandList* list, D3D12_GPU_DESCRIPTOR_HANDLE sceneDescHandle, ID3D12DescriptorHeap* depthHeap);
+	HRESULT render(ID3D12GraphicsCommandList* list, D3D12_GPU_DESCRIPTOR_HANDLE sceneDescHandle, D3D12_GPU_DESCRIPTOR_HANDLE depthLightSrvHandle);
+	HRESULT renderAxis(ID3D12GraphicsCommandList* list, D3D12_GPU_DESCRIPTOR_HANDLE sceneDescHandle, D3D12_CPU_DESCRIPTOR_HANDLE dstRt, D3D12_CPU_DESCRIPTOR_HANDLE dstDrt);
 
 private:
 	struct VsType
@@ -88,7 +89,8 @@ private:
 	std::array<D3D12_VERTEX_BUFFER_VIEW, VbType::kEnd> m_vbViews = { };
 	std::array<Microsoft::WRL::ComPtr<ID3D12Resource>, VbType::kEnd> m_vertResources = { };
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_transResource = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_transDescHeap = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_transDescHeap = nullptr; // staging
+	DescriptorTable m_transDescTable;
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> m_rootSignature = nullptr;
 	std::array<Microsoft::WRL::ComPtr<ID3D12PipelineState>, PipelineType::kEnd> m_pipelineStates = { };
 	TransMatrix* m_pTransMatrix = nullptr; // needs to be aligned 16 bytes
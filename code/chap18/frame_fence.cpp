@@ -0,0 +1,216 @@
+#include "frame_fence.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <algorithm>
+#include <synchapi.h>
+#pragma warning(pop)
+#include "debug.h"
+#include "util.h"
+
+namespace {
+	// A queue whose GPU never progresses by itself. Values complete only when they are waited for or completed explicitly.
+	class MockFenceQueue : public FenceQueue
+	{
+	public:
+		HRESULT signal(UINT64 value) override
+		{
+			if (value <= m_signaledValue)
+				return E_INVALIDARG;
+
+			m_signaledValue = value;
+			return S_OK;
+		}
+
+		UINT64 getCompletedValue() const override
+		{
+			return m_completedValue;
+		}
+
+		HRESULT waitForValue(UINT64 value) override
+		{
+			if (value > m_signaledValue)
+				return E_INVALIDARG; // would dead-lock on a real queue
+
+			m_completedValue = std::max(m_completedValue, value);
+			return S_OK;
+		}
+
+		void complete(UINT64 value)
+		{
+			m_completedValue = std::min(value, m_signaledValue);
+		}
+
+		UINT64 getSignaledValue() const { return m_signaledValue; }
+
+	private:
+		UINT64 m_signaledValue = 0;
+		UINT64 m_completedValue = 0;
+	};
+} // namespace anonymous
+
+D3d12FenceQueue::~D3d12FenceQueue()
+{
+	if (m_event != nullptr)
+	{
+		CloseHandle(m_event);
+		m_event = nullptr;
+	}
+}
+
+HRESULT D3d12FenceQueue::init(ID3D12Device* device, ID3D12CommandQueue* queue)
+{
+	ThrowIfFalse(device != nullptr);
+	ThrowIfFalse(queue != nullptr);
+
+	m_queue = queue;
+
+	auto result = device->CreateFence(
+		0,
+		D3D12_FENCE_FLAG_NONE,
+		IID_PPV_ARGS(m_fence.ReleaseAndGetAddressOf()));
+	ThrowIfFailed(result);
+
+	result = m_fence.Get()->SetName(Util::getWideStringFromString("frameFence").c_str());
+	ThrowIfFailed(result);
+
+	m_event = CreateEvent(nullptr, false, false, nullptr);
+
+	if (m_event == nullptr)
+	{
+		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+	}
+
+	return S_OK;
+}
+
+HRESULT D3d12FenceQueue::signal(UINT64 value)
+{
+	return m_queue->Signal(m_fence.Get(), value);
+}
+
+UINT64 D3d12FenceQueue::getCompletedValue() const
+{
+	return m_fence->GetCompletedValue();
+}
+
+HRESULT D3d12FenceQueue::waitForValue(UINT64 value)
+{
+	while (m_fence->GetCompletedValue() < value)
+	{
+		ThrowIfFailed(m_fence->SetEventOnCompletion(value, m_event));
+
+		auto ret = WaitForSingleObject(m_event, INFINITE);
+		ThrowIfFalse(ret == WAIT_OBJECT_0);
+	}
+
+	return S_OK;
+}
+
+FrameFenceRing::FrameFenceRing(uint32_t numFramesInFlight)
+	: m_numFramesInFlight(numFramesInFlight)
+{
+	ThrowIfFalse(1 <= numFramesInFlight && numFramesInFlight <= kMaxFramesInFlight);
+}
+
+uint32_t FrameFenceRing::beginFrame(FenceQueue* queue)
+{
+	ThrowIfFalse(queue != nullptr);
+
+	const UINT64 value = m_slotFenceValues.at(m_frameIndex);
+
+	if (queue->getCompletedValue() < value)
+	{
+		ThrowIfFailed(queue->waitForValue(value));
+		++m_numBlockingWaits;
+	}
+
+	return m_frameIndex;
+}
+
+HRESULT FrameFenceRing::endFrame(FenceQueue* queue)
+{
+	ThrowIfFalse(queue != nullptr);
+
+	const UINT64 value = m_lastSignaledValue + 1;
+
+	auto result = queue->signal(value);
+
+	if (FAILED(result))
+		return result;
+
+	m_lastSignaledValue = value;
+	m_slotFenceValues.at(m_frameIndex) = value;
+	m_frameIndex = (m_frameIndex + 1) % m_numFramesInFlight;
+
+	return S_OK;
+}
+
+HRESULT FrameFenceRing::flush(FenceQueue* queue)
+{
+	ThrowIfFalse(queue != nullptr);
+
+	const UINT64 value = m_lastSignaledValue + 1;
+
+	auto result = queue->signal(value);
+
+	if (FAILED(result))
+		return result;
+
+	m_lastSignaledValue = value;
+
+	return queue->waitForValue(value);
+}
+
+bool FrameFenceRing::selfCheck()
+{
+	for (uint32_t numFrames = 1; numFrames <= kMaxFramesInFlight; ++numFrames)
+	{
+		MockFenceQueue queue;
+		FrameFenceRing ring(numFrames);
+
+		// every slot is fresh, so the first N frames must not block
+		for (uint32_t i = 0; i < numFrames; ++i)
+		{
+			if (ring.beginFrame(&queue) != i)
+				return false;
+
+			if (FAILED(ring.endFrame(&queue)))
+				return false;
+		}
+
+		if (ring.getNumOfBlockingWaits() != 0)
+			return false;
+
+		// frame N reuses slot 0 and has to wait for the value signaled by frame 0
+		if (ring.beginFrame(&queue) != 0)
+			return false;
+
+		if (ring.getNumOfBlockingWaits() != 1 || queue.getCompletedValue() != 1)
+			return false;
+
+		if (FAILED(ring.endFrame(&queue)))
+			return false;
+
+		// no wait once the GPU has caught up
+		queue.complete(queue.getSignaledValue());
+
+		if (ring.beginFrame(&queue) != (1 % numFrames))
+			return false;
+
+		if (ring.getNumOfBlockingWaits() != 1)
+			return false;
+
+		if (FAILED(ring.endFrame(&queue)))
+			return false;
+
+		// nothing is in flight after flush
+		if (FAILED(ring.flush(&queue)))
+			return false;
+
+		if (queue.getCompletedValue() != ring.getLastSignaledValue())
+			return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <array>
+#include <cstdint>
+#include <d3d12.h>
+#include <wrl.h>
+#pragma warning(pop)
+#include "config.h"
+
+// A queue which can signal and wait a monotonically increasing fence value.
+// FrameFenceRing only talks to this interface so that it can be driven by a mock queue.
+class FenceQueue
+{
+public:
+	virtual ~FenceQueue() = default;
+	virtual HRESULT signal(UINT64 value) = 0;
+	virtual UINT64 getCompletedValue() const = 0;
+	virtual HRESULT waitForValue(UINT64 value) = 0;
+};
+
+class D3d12FenceQueue : public FenceQueue
+{
+public:
+	D3d12FenceQueue() = default;
+	D3d12FenceQueue(const D3d12FenceQueue&) = delete;
+	void operator=(const D3d12FenceQueue&) = delete;
+	~D3d12FenceQueue();
+
+	HRESULT init(ID3D12Device* device, ID3D12CommandQueue* queue);
+	HRESULT signal(UINT64 value) override;
+	UINT64 getCompletedValue() const override;
+	HRESULT waitForValue(UINT64 value) override;
+	ID3D12CommandQueue* getQueue() const { return m_queue.Get(); }
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_queue = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Fence> m_fence = nullptr;
+	HANDLE m_event = nullptr; // created once and reused by every wait
+};
+
+class FrameFenceRing
+{
+public:
+	static constexpr uint32_t kMaxFramesInFlight = 3;
+
+	explicit FrameFenceRing(uint32_t numFramesInFlight = Config::kNumFramesInFlight);
+
+	// blocks until the GPU has finished the frame which used the next slot last time
+	uint32_t beginFrame(FenceQueue* queue);
+	// signals the fence value of the current slot and advances to the next slot
+	HRESULT endFrame(FenceQueue* queue);
+	// signals and waits until all the submitted work is done
+	HRESULT flush(FenceQueue* queue);
+
+	uint32_t getFrameIndex() const { return m_frameIndex; }
+	uint32_t getNumFramesInFlight() const { return m_numFramesInFlight; }
+	UINT64 getSlotFenceValue(uint32_t frameIndex) const { return m_slotFenceValues.at(frameIndex); }
+	UINT64 getLastSignaledValue() const { return m_lastSignaledValue; }
+	uint64_t getNumOfBlockingWaits() const { return m_numBlockingWaits; }
+
+	static bool selfCheck();
+
+private:
+	uint32_t m_numFramesInFlight = 0;
+	uint32_t m_frameIndex = 0;
+	std::array<UINT64, kMaxFramesInFlight> m_slotFenceValues = { };
+	UINT64 m_lastSignaledValue = 0;
+	uint64_t m_numBlockingWaits = 0;
+};
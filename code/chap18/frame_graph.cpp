@@ -0,0 +1,427 @@
+#include "frame_graph.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <d3dx12.h>
+#pragma warning(pop)
+#include "debug.h"
+
+namespace {
+	constexpr D3D12_RESOURCE_STATES kWriteStates =
+		D3D12_RESOURCE_STATE_RENDER_TARGET |
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS |
+		D3D12_RESOURCE_STATE_DEPTH_WRITE |
+		D3D12_RESOURCE_STATE_STREAM_OUT |
+		D3D12_RESOURCE_STATE_COPY_DEST |
+		D3D12_RESOURCE_STATE_RESOLVE_DEST;
+} // namespace anonymous
+
+FrameGraph::ResourceId FrameGraph::importResource(const std::string& name, ID3D12Resource* resource, D3D12_RESOURCE_STATES currentState, Content content, std::optional<D3D12_RESOURCE_STATES> finalState)
+{
+	ResourceEntry entry = { };
+	{
+		entry.name = name;
+		entry.resource = resource;
+		entry.state = currentState;
+		entry.content = content;
+		entry.finalState = finalState;
+	}
+	m_resources.push_back(entry);
+
+	return static_cast<ResourceId>(m_resources.size() - 1);
+}
+
+void FrameGraph::setResource(ResourceId id, ID3D12Resource* resource)
+{
+	m_resources.at(id).resource = resource;
+}
+
+void FrameGraph::setAliased(ResourceId id, bool bAliased)
+{
+	ThrowIfFalse(!bAliased || m_resources.at(id).content == Content::kTransient);
+	m_resources.at(id).bAliased = bAliased;
+}
+
+FrameGraph::PassId FrameGraph::addPass(const std::string& name)
+{
+	m_passes.push_back({ .name = name });
+	m_passTransitions.emplace_back();
+	m_passActivations.emplace_back();
+
+	return static_cast<PassId>(m_passes.size() - 1);
+}
+
+void FrameGraph::use(PassId pass, ResourceId id, D3D12_RESOURCE_STATES state)
+{
+	m_passes.at(pass).uses.push_back({ id, state });
+}
+
+HRESULT FrameGraph::compile()
+{
+	m_errors.clear();
+
+	std::vector<D3D12_RESOURCE_STATES> states(m_resources.size());
+	std::vector<bool> written(m_resources.size(), false);
+	std::vector<std::vector<Transition>> passTransitions(m_passes.size());
+	std::vector<std::vector<ResourceId>> passActivations(m_passes.size());
+
+	for (size_t i = 0; i < m_resources.size(); ++i)
+	{
+		states.at(i) = m_resources.at(i).state;
+	}
+
+	for (PassId pass = 0; pass < m_passes.size(); ++pass)
+	{
+		const PassEntry& passEntry = m_passes.at(pass);
+
+		// a resource which is used more than once in a pass needs a single state which covers all of them
+		std::vector<std::optional<D3D12_RESOURCE_STATES>> required(m_resources.size());
+
+		for (const Use& use : passEntry.uses)
+		{
+			if (use.id >= m_resources.size())
+			{
+				m_errors.push_back(passEntry.name + ": unknown resource " + std::to_string(use.id));
+				continue;
+			}
+
+			auto& state = required.at(use.id);
+
+			if (!state.has_value())
+			{
+				state = use.state;
+			}
+			else if (*state != use.state && (isWriteState(*state) || isWriteState(use.state)))
+			{
+				m_errors.push_back(passEntry.name + ": " + m_resources.at(use.id).name + " is written and used in another state");
+			}
+			else
+			{
+				state = *state | use.state;
+			}
+		}
+
+		for (ResourceId id = 0; id < required.size(); ++id)
+		{
+			if (!required.at(id).has_value())
+				continue;
+
+			const D3D12_RESOURCE_STATES state = *required.at(id);
+
+			const ResourceEntry& resourceEntry = m_resources.at(id);
+
+			if (!isWriteState(state) && resourceEntry.content != Content::kPersistent && !written.at(id))
+			{
+				m_errors.push_back(passEntry.name + ": " + resourceEntry.name + " is read before any pass writes it");
+			}
+
+			// the memory may have been used by another resource since the last use
+			if (resourceEntry.bAliased && !written.at(id))
+			{
+				passActivations.at(pass).push_back(id);
+			}
+
+			if (needsTransition(states.at(id), state))
+			{
+				passTransitions.at(pass).push_back({ id, states.at(id), state });
+				states.at(id) = state;
+			}
+
+			if (isWriteState(state))
+			{
+				written.at(id) = true;
+			}
+		}
+	}
+
+	std::vector<Transition> finalTransitions;
+
+	for (ResourceId id = 0; id < m_resources.size(); ++id)
+	{
+		const auto& finalState = m_resources.at(id).finalState;
+
+		if (finalState.has_value() && needsTransition(states.at(id), *finalState))
+		{
+			finalTransitions.push_back({ id, states.at(id), *finalState });
+			states.at(id) = *finalState;
+		}
+	}
+
+	if (!m_errors.empty())
+	{
+		for (const auto& error : m_errors)
+		{
+			Debug::debugOutputFormatString("FrameGraph: %s\n", error.c_str());
+		}
+
+		return E_FAIL;
+	}
+
+	// the states at the end of this frame are the ones at the beginning of the next frame
+	for (size_t i = 0; i < m_resources.size(); ++i)
+	{
+		m_resources.at(i).state = states.at(i);
+	}
+
+	m_passTransitions = std::move(passTransitions);
+	m_passActivations = std::move(passActivations);
+	m_finalTransitions = std::move(finalTransitions);
+
+	return S_OK;
+}
+
+void FrameGraph::emitBarriers(ID3D12GraphicsCommandList* list, PassId pass) const
+{
+	emit(list, m_passActivations.at(pass), m_passTransitions.at(pass));
+}
+
+void FrameGraph::emitFinalBarriers(ID3D12GraphicsCommandList* list) const
+{
+	emit(list, { }, m_finalTransitions);
+}
+
+std::optional<FrameGraph::Lifetime> FrameGraph::getLifetime(ResourceId id) const
+{
+	std::optional<Lifetime> lifetime = std::nullopt;
+
+	for (PassId pass = 0; pass < m_passes.size(); ++pass)
+	{
+		for (const Use& use : m_passes.at(pass).uses)
+		{
+			if (use.id != id)
+				continue;
+
+			if (!lifetime.has_value())
+			{
+				lifetime = Lifetime{ pass, pass };
+			}
+
+			lifetime->last = pass;
+		}
+	}
+
+	return lifetime;
+}
+
+uint32_t FrameGraph::getNumOfTransitions() const
+{
+	size_t num = m_finalTransitions.size();
+
+	for (const auto& transitions : m_passTransitions)
+	{
+		num += transitions.size();
+	}
+
+	return static_cast<uint32_t>(num);
+}
+
+uint32_t FrameGraph::getNumOfBarrierCalls() const
+{
+	uint32_t num = m_finalTransitions.empty() ? 0 : 1;
+
+	for (PassId pass = 0; pass < m_passes.size(); ++pass)
+	{
+		num += (m_passTransitions.at(pass).empty() && m_passActivations.at(pass).empty()) ? 0 : 1;
+	}
+
+	return num;
+}
+
+bool FrameGraph::isWriteState(D3D12_RESOURCE_STATES state)
+{
+	return (state & kWriteStates) != 0;
+}
+
+bool FrameGraph::needsTransition(D3D12_RESOURCE_STATES current, D3D12_RESOURCE_STATES required)
+{
+	if (current == required)
+		return false;
+
+	// COMMON (== PRESENT) has no bit, so it is never covered by another state
+	if (current == D3D12_RESOURCE_STATE_COMMON || required == D3D12_RESOURCE_STATE_COMMON)
+		return true;
+
+	// a read-only state already covers a read which it includes
+	if (!isWriteState(current) && !isWriteState(required))
+		return (current & required) != required;
+
+	return true;
+}
+
+void FrameGraph::emit(ID3D12GraphicsCommandList* list, const std::vector<ResourceId>& activations, const std::vector<Transition>& transitions) const
+{
+	if (activations.empty() && transitions.empty())
+		return;
+
+	std::vector<D3D12_RESOURCE_BARRIER> barriers;
+	barriers.reserve(activations.size() + transitions.size());
+
+	// activate the aliased resources first. The transitions are issued on the activated resources
+	for (const ResourceId id : activations)
+	{
+		ID3D12Resource* resource = m_resources.at(id).resource;
+		ThrowIfFalse(resource != nullptr);
+
+		barriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(nullptr, resource));
+	}
+
+	for (const auto& transition : transitions)
+	{
+		ID3D12Resource* resource = m_resources.at(transition.id).resource;
+		ThrowIfFalse(resource != nullptr);
+
+		barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, transition.before, transition.after));
+	}
+
+	list->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+}
+
+bool FrameGraph::selfCheck()
+{
+	constexpr D3D12_RESOURCE_STATES kPsr = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+	constexpr D3D12_RESOURCE_STATES kRt = D3D12_RESOURCE_STATE_RENDER_TARGET;
+	constexpr D3D12_RESOURCE_STATES kDepthWrite = D3D12_RESOURCE_STATE_DEPTH_WRITE;
+	constexpr D3D12_RESOURCE_STATES kDepthRead = D3D12_RESOURCE_STATE_DEPTH_READ | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+
+	// the shape of the frame in Render: the depth buffer is written, sampled, then used as read-only DSV and sampled
+	{
+		FrameGraph graph;
+		const ResourceId backBuffer = graph.importResource("backBuffer", nullptr, D3D12_RESOURCE_STATE_PRESENT, Content::kProducedInFrame, D3D12_RESOURCE_STATE_PRESENT);
+		const ResourceId depth = graph.importResource("depth", nullptr, kPsr, Content::kProducedInFrame);
+		const ResourceId color = graph.importResource("color", nullptr, kPsr, Content::kProducedInFrame);
+
+		const PassId clear = graph.addPass("clear");
+		graph.use(clear, backBuffer, kRt);
+		graph.use(clear, depth, kDepthWrite);
+		graph.use(clear, color, kRt);
+
+		const PassId base = graph.addPass("base");
+		graph.use(base, depth, kDepthWrite);
+		graph.use(base, color, kRt);
+
+		const PassId post = graph.addPass("post");
+		graph.use(post, depth, kPsr);
+		graph.use(post, color, kPsr);
+		graph.use(post, backBuffer, kRt);
+
+		const PassId overlay = graph.addPass("overlay");
+		graph.use(overlay, depth, kDepthRead);
+		graph.use(overlay, color, kPsr);
+		graph.use(overlay, backBuffer, kRt);
+
+		// the first frame starts from the creation states
+		if (FAILED(graph.compile()))
+			return false;
+
+		if (graph.getTransitions(clear).size() != 3 || !graph.getTransitions(base).empty())
+			return false;
+
+		if (graph.getFinalTransitions().size() != 1 || graph.getState(backBuffer) != D3D12_RESOURCE_STATE_PRESENT)
+			return false;
+
+		// steady state: depth goes DEPTH_WRITE -> PSR -> DEPTH_READ|PSR -> DEPTH_WRITE, and the color is not touched in the overlay
+		if (FAILED(graph.compile()))
+			return false;
+
+		if (graph.getTransitions(clear).size() != 3 || graph.getTransitions(clear).at(1).before != kDepthRead)
+			return false;
+
+		if (graph.getTransitions(post).size() != 2 || graph.getTransitions(overlay).size() != 1)
+			return false;
+
+		if (graph.getNumOfTransitions() != 7 || graph.getNumOfBarrierCalls() != 4)
+			return false;
+	}
+
+	// reading a resource which has not been produced yet in the frame
+	{
+		FrameGraph graph;
+		const ResourceId color = graph.importResource("color", nullptr, kPsr, Content::kProducedInFrame);
+		const ResourceId texture = graph.importResource("texture", nullptr, kPsr, Content::kPersistent);
+
+		const PassId pass = graph.addPass("pass");
+		graph.use(pass, color, kPsr);
+		graph.use(pass, texture, kPsr);
+
+		if (SUCCEEDED(graph.compile()) || graph.getErrors().size() != 1)
+			return false;
+	}
+
+	// written and read in the same pass. The tracked state must not move on failure
+	{
+		FrameGraph graph;
+		const ResourceId color = graph.importResource("color", nullptr, kPsr, Content::kProducedInFrame);
+
+		const PassId pass = graph.addPass("pass");
+		graph.use(pass, color, kRt);
+		graph.use(pass, color, kPsr);
+
+		if (SUCCEEDED(graph.compile()) || graph.getState(color) != kPsr)
+			return false;
+	}
+
+	// two reads in the same pass are merged into one state
+	{
+		FrameGraph graph;
+		const ResourceId depth = graph.importResource("depth", nullptr, kDepthWrite, Content::kPersistent);
+
+		const PassId pass = graph.addPass("pass");
+		graph.use(pass, depth, D3D12_RESOURCE_STATE_DEPTH_READ);
+		graph.use(pass, depth, kPsr);
+
+		if (FAILED(graph.compile()) || graph.getTransitions(pass).size() != 1 || graph.getState(depth) != kDepthRead)
+			return false;
+	}
+
+	// transient resources: the lifetimes come from the uses, and an aliased one is activated at its first use in every frame
+	{
+		FrameGraph graph;
+		const ResourceId a = graph.importResource("a", nullptr, kPsr, Content::kTransient);
+		const ResourceId b = graph.importResource("b", nullptr, kPsr, Content::kTransient);
+		const ResourceId c = graph.importResource("c", nullptr, kPsr, Content::kTransient);
+
+		const PassId pass0 = graph.addPass("pass0");
+		graph.use(pass0, a, kRt);
+
+		const PassId pass1 = graph.addPass("pass1");
+		graph.use(pass1, a, kPsr);
+		graph.use(pass1, c, kRt);
+
+		const PassId pass2 = graph.addPass("pass2");
+		graph.use(pass2, b, kRt);
+		graph.use(pass2, c, kPsr);
+
+		const PassId pass3 = graph.addPass("pass3");
+		graph.use(pass3, b, kPsr);
+
+		const auto lifetimeA = graph.getLifetime(a);
+		const auto lifetimeB = graph.getLifetime(b);
+
+		if (!lifetimeA.has_value() || lifetimeA->first != pass0 || lifetimeA->last != pass1)
+			return false;
+
+		if (!lifetimeB.has_value() || lifetimeB->first != pass2 || lifetimeB->last != pass3)
+			return false;
+
+		// a and b share the memory, c has its own
+		graph.setAliased(a, true);
+		graph.setAliased(b, true);
+
+		for (uint32_t frame = 0; frame < 2; ++frame)
+		{
+			if (FAILED(graph.compile()))
+				return false;
+
+			if (graph.getActivations(pass0).size() != 1 || graph.getActivations(pass0).at(0) != a)
+				return false;
+
+			if (!graph.getActivations(pass1).empty() || graph.getActivations(pass2).size() != 1 || !graph.getActivations(pass3).empty())
+				return false;
+
+			if (graph.getNumOfBarrierCalls() != 4)
+				return false;
+		}
+	}
+
+	return true;
+}
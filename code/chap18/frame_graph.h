@@ -0,0 +1,102 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <cstdint>
+#include <d3d12.h>
+#include <optional>
+#include <string>
+#include <vector>
+#pragma warning(pop)
+
+// Passes declare the state in which they use each resource, in submission order.
+// compile() derives the transitions from the states tracked across frames, skipping the ones which are not needed
+// (e.g. a read while the resource is already in a read state which covers it), and groups them per pass so that
+// each pass issues at most one ResourceBarrier call. compile() only deals with ids and states, so it also runs headless.
+// A transient resource may share its memory with others (see TransientAllocator). If it is aliased,
+// the first pass which uses it in the frame also issues the aliasing barrier which activates it.
+class FrameGraph
+{
+public:
+	using ResourceId = uint32_t;
+	using PassId = uint32_t;
+
+	enum class Content
+	{
+		kPersistent,      // valid at any time, e.g. a texture loaded at init
+		kProducedInFrame, // must be written by a pass before any pass reads it in the frame
+		kTransient,       // kProducedInFrame, and the content is lost after the last pass which uses it
+	};
+
+	// the first and the last pass which use a resource, both inclusive
+	struct Lifetime
+	{
+		PassId first = 0;
+		PassId last = 0;
+	};
+
+	struct Transition
+	{
+		ResourceId id = 0;
+		D3D12_RESOURCE_STATES before = D3D12_RESOURCE_STATE_COMMON;
+		D3D12_RESOURCE_STATES after = D3D12_RESOURCE_STATE_COMMON;
+	};
+
+	// currentState is the state of the resource when the first compiled frame starts
+	ResourceId importResource(const std::string& name, ID3D12Resource* resource, D3D12_RESOURCE_STATES currentState, Content content, std::optional<D3D12_RESOURCE_STATES> finalState = std::nullopt);
+	void setResource(ResourceId id, ID3D12Resource* resource);
+	void setAliased(ResourceId id, bool bAliased);
+	PassId addPass(const std::string& name);
+	void use(PassId pass, ResourceId id, D3D12_RESOURCE_STATES state);
+
+	// fails if the declarations are not valid. The errors are in getErrors(), and the tracked states are left unchanged
+	HRESULT compile();
+	void emitBarriers(ID3D12GraphicsCommandList* list, PassId pass) const;
+	void emitFinalBarriers(ID3D12GraphicsCommandList* list) const;
+
+	std::optional<Lifetime> getLifetime(ResourceId id) const;
+	const std::vector<Transition>& getTransitions(PassId pass) const { return m_passTransitions.at(pass); }
+	const std::vector<ResourceId>& getActivations(PassId pass) const { return m_passActivations.at(pass); }
+	const std::vector<Transition>& getFinalTransitions() const { return m_finalTransitions; }
+	const std::vector<std::string>& getErrors() const { return m_errors; }
+	D3D12_RESOURCE_STATES getState(ResourceId id) const { return m_resources.at(id).state; }
+	uint32_t getNumOfTransitions() const;
+	uint32_t getNumOfBarrierCalls() const;
+
+	static bool isWriteState(D3D12_RESOURCE_STATES state);
+	static bool needsTransition(D3D12_RESOURCE_STATES current, D3D12_RESOURCE_STATES required);
+	static bool selfCheck();
+
+private:
+	struct ResourceEntry
+	{
+		std::string name;
+		ID3D12Resource* resource = nullptr;
+		D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COMMON;
+		Content content = Content::kPersistent;
+		std::optional<D3D12_RESOURCE_STATES> finalState = std::nullopt;
+		bool bAliased = false;
+	};
+
+	struct Use
+	{
+		ResourceId id = 0;
+		D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COMMON;
+	};
+
+	struct PassEntry
+	{
+		std::string name;
+		std::vector<Use> uses;
+	};
+
+	void emit(ID3D12GraphicsCommandList* list, const std::vector<ResourceId>& activations, const std::vector<Transition>& transitions) const;
+
+	std::vector<ResourceEntry> m_resources;
+	std::vector<PassEntry> m_passes;
+	std::vector<std::vector<Transition>> m_passTransitions;
+	std::vector<std::vector<ResourceId>> m_passActivations;
+	std::vector<Transition> m_finalTransitions;
+	std::vector<std::string> m_errors;
+};
@@ -0,0 +1,114 @@
+#include "frame_pacer.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <synchapi.h>
+#pragma warning(pop)
+#include "debug.h"
+#include "util.h"
+
+FramePacer::~FramePacer()
+{
+	if (m_waitableObject != nullptr)
+	{
+		CloseHandle(m_waitableObject);
+		m_waitableObject = nullptr;
+	}
+}
+
+HRESULT FramePacer::init(IDXGISwapChain2* swapChain, uint32_t maxFrameLatency)
+{
+	ThrowIfFalse(swapChain != nullptr);
+	ThrowIfFalse(m_waitableObject == nullptr);
+
+	m_swapChain = swapChain;
+
+	// requires DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT on the swap chain
+	ThrowIfFailed(m_swapChain->SetMaximumFrameLatency(maxFrameLatency));
+
+	m_waitableObject = m_swapChain->GetFrameLatencyWaitableObject();
+	ThrowIfFalse(m_waitableObject != nullptr);
+
+	Debug::debugOutputFormatString("Max frame latency: %u\n", maxFrameLatency);
+
+	return S_OK;
+}
+
+HRESULT FramePacer::waitForSwapChain()
+{
+	const DWORD ret = WaitForSingleObjectEx(m_waitableObject, kWaitTimeoutInMs, true);
+
+	if (ret == WAIT_TIMEOUT)
+	{
+		// e.g. the window is occluded. Keep going instead of hanging the message loop
+		++m_numWaitTimeouts;
+		return S_OK;
+	}
+
+	ThrowIfFalse(ret == WAIT_OBJECT_0 || ret == WAIT_IO_COMPLETION);
+
+	return S_OK;
+}
+
+void FramePacer::markUpdateStart()
+{
+	m_updateStart = Util::getTick();
+}
+
+void FramePacer::markPresented(uint32_t frameIndex)
+{
+	const LONGLONG presented = Util::getTick();
+
+	accumulate(&m_cpuLatencyInMs, Util::toMs(presented - m_updateStart));
+
+	Marker& marker = m_markers.at(frameIndex);
+	{
+		marker.updateStart = m_updateStart;
+		marker.bGpuPending = true;
+		marker.bDisplayPending = SUCCEEDED(m_swapChain->GetLastPresentCount(&marker.presentCount));
+	}
+}
+
+void FramePacer::markGpuCompleted(uint32_t frameIndex, LONGLONG completedTick)
+{
+	Marker& marker = m_markers.at(frameIndex);
+
+	if (!marker.bGpuPending)
+		return;
+
+	marker.bGpuPending = false;
+
+	// not when it was seen, which waits for the swap chain and the slot
+	if (completedTick > marker.updateStart)
+	{
+		accumulate(&m_gpuLatencyInMs, Util::toMs(completedTick - marker.updateStart));
+	}
+}
+
+void FramePacer::collect()
+{
+	// only the latest present is reported. It fails while the statistics are not available (e.g. windowed & composed)
+	DXGI_FRAME_STATISTICS stats = { };
+
+	if (FAILED(m_swapChain->GetFrameStatistics(&stats)))
+		return;
+
+	for (auto& marker : m_markers)
+	{
+		if (!marker.bDisplayPending || marker.presentCount > stats.PresentCount)
+			continue;
+
+		marker.bDisplayPending = false;
+
+		if (marker.presentCount == stats.PresentCount && stats.SyncQPCTime.QuadPart > marker.updateStart)
+		{
+			accumulate(&m_displayLatencyInMs, Util::toMs(stats.SyncQPCTime.QuadPart - marker.updateStart));
+		}
+	}
+}
+
+void FramePacer::accumulate(float* pAverage, float sample)
+{
+	// exponential moving average. The first sample is taken as is
+	*pAverage = (*pAverage == 0.0f) ? sample : *pAverage + (sample - *pAverage) * kSmoothingFactor;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <array>
+#include <cstdint>
+#include <dxgi1_6.h>
+#include <wrl.h>
+#pragma warning(pop)
+#include "config.h"
+
+// Paces the CPU with the waitable swap chain and measures the latency of each frame from the start of update().
+//   cpu     : until Present() returned
+//   gpu     : until the GPU finished the frame, from its last time stamp
+//   display : until the frame was shown (DXGI frame statistics. 0 while they are not available)
+class FramePacer
+{
+public:
+	FramePacer() = default;
+	FramePacer(const FramePacer&) = delete;
+	void operator=(const FramePacer&) = delete;
+	~FramePacer();
+
+	HRESULT init(IDXGISwapChain2* swapChain, uint32_t maxFrameLatency);
+	// blocks until the swap chain can queue a new frame. The input should be sampled after this
+	HRESULT waitForSwapChain();
+	void markUpdateStart();
+	void markPresented(uint32_t frameIndex);
+	// after the frame which used the slot last time has completed. completedTick is on the clock of QueryPerformanceCounter()
+	void markGpuCompleted(uint32_t frameIndex, LONGLONG completedTick);
+	// retires the frames which have been shown and updates the average
+	void collect();
+
+	float getCpuLatencyInMs() const { return m_cpuLatencyInMs; }
+	float getGpuLatencyInMs() const { return m_gpuLatencyInMs; }
+	float getDisplayLatencyInMs() const { return m_displayLatencyInMs; }
+	uint64_t getNumOfWaitTimeouts() const { return m_numWaitTimeouts; }
+
+private:
+	static constexpr DWORD kWaitTimeoutInMs = 1000;
+	static constexpr float kSmoothingFactor = 0.1f;
+
+	struct Marker
+	{
+		LONGLONG updateStart = 0;
+		UINT presentCount = 0;
+		bool bGpuPending = false;
+		bool bDisplayPending = false;
+	};
+
+	static void accumulate(float* pAverage, float sample);
+
+	Microsoft::WRL::ComPtr<IDXGISwapChain2> m_swapChain = nullptr;
+	HANDLE m_waitableObject = nullptr;
+	LONGLONG m_updateStart = 0;
+	std::array<Marker, Config::kNumFramesInFlight> m_markers = { };
+	float m_cpuLatencyInMs = 0.0f;
+	float m_gpuLatencyInMs = 0.0f;
+	float m_displayLatencyInMs = 0.0f;
+	uint64_t m_numWaitTimeouts = 0;
+};
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <d3dcompiler.h>
 #pragma warning(pop)
+#include "config.h"
 #include "constant.h"
 #include "debug.h"
 #include "init.h"
@@ -52,7 +53,7 @@ HRESULT RenderGraph::render(ID3D12GraphicsCommandList* list, D3D12_VIEWPORT view
 	list->RSSetScissorRects(1, &scissorRect);
 
 	list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_LINESTRIP);
-	list->IASetVertexBuffers(0, 1, &m_vertexBufferView);
+	list->IASetVertexBuffers(0, 1, &m_vertexBufferViews.at(Resource::instance()->getFrameIndex()));
 
 	list->DrawInstanced(kNumMaxVertices, 1, 0, 0);
 
@@ -63,14 +64,11 @@ HRESULT RenderGraph::compileShaders()
 {
 	ComPtr<ID3DBlob> errBlob = nullptr;
 
-	auto result = D3DCompileFromFile(
+	auto result = Resource::instance()->getShaderCache()->load(
 		L"graphVertex.hlsl",
 		nullptr,
-		D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		"main",
-		Constant::kVsShaderModel,
-		0,
-		0,
+		Constant::kDxcVsShaderModel,
 		m_vs.ReleaseAndGetAddressOf(),
 		errBlob.ReleaseAndGetAddressOf());
 
@@ -80,14 +78,11 @@ HRESULT RenderGraph::compileShaders()
 		ThrowIfFalse(false);
 	}
 
-	result = D3DCompileFromFile(
+	result = Resource::instance()->getShaderCache()->load(
 		L"graphPixel.hlsl",
 		nullptr,
-		D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		"main",
-		Constant::kPsShaderModel,
-		0,
-		0,
+		Constant::kDxcPsShaderModel,
 		m_ps.ReleaseAndGetAddressOf(),
 		errBlob.ReleaseAndGetAddressOf());
 
@@ -105,7 +100,7 @@ HRESULT RenderGraph::createVertexBuffer()
 	constexpr size_t vertexBufferSize = sizeof(Vertex) * kNumMaxVertices;
 
 	const D3D12_HEAP_PROPERTIES heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-	const D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(vertexBufferSize);
+	const D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(vertexBufferSize * Config::kNumFramesInFlight);
 
 	auto result = Resource::instance()->getDevice()->CreateCommittedResource(
 		&heapProp,
@@ -119,11 +114,16 @@ HRESULT RenderGraph::createVertexBuffer()
 	result = m_vertexBuffer.Get()->SetName(Util::getWideStringFromString("vertexBufferGraph").c_str());
 	ThrowIfFailed(result);
 
-	m_vertexBufferView = {
-		.BufferLocation = m_vertexBuffer.Get()->GetGPUVirtualAddress(),
-		.SizeInBytes = vertexBufferSize,
-		.StrideInBytes = sizeof(Vertex),
-	};
+	for (size_t i = 0; auto& view : m_vertexBufferViews)
+	{
+		view = {
+			.BufferLocation = m_vertexBuffer.Get()->GetGPUVirtualAddress() + vertexBufferSize * i,
+			.SizeInBytes = vertexBufferSize,
+			.StrideInBytes = sizeof(Vertex),
+		};
+
+		++i;
+	}
 
 	return S_OK;
 }
@@ -150,11 +150,10 @@ HRESULT RenderGraph::createPipelineState()
 		Debug::outputDebugMessage(errBlob.Get());
 	}
 
-	result = Resource::instance()->getDevice()->CreateRootSignature(
-		0,
+	result = Resource::instance()->getPipelineCache()->createRootSignature(
 		rsBlob.Get()->GetBufferPointer(),
 		rsBlob.Get()->GetBufferSize(),
-		IID_PPV_ARGS(m_rootSignature.ReleaseAndGetAddressOf()));
+		m_rootSignature.ReleaseAndGetAddressOf());
 	ThrowIfFailed(result);
 
 	result = m_rootSignature.Get()->SetName(Util::getWideStringFromString("RootSignatureGraph").c_str());
@@ -199,9 +198,9 @@ HRESULT RenderGraph::createPipelineState()
 	gpDesc.DepthStencilState.DepthEnable = false;
 	gpDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
 
-	result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+	result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
 		&gpDesc,
-		IID_PPV_ARGS(m_pipelineState.ReleaseAndGetAddressOf()));
+		m_pipelineState.ReleaseAndGetAddressOf());
 	ThrowIfFailed(result);
 
 	result = m_pipelineState.Get()->SetName(Util::getWideStringFromString("pipelineStateGraph").c_str());
@@ -250,7 +249,7 @@ void RenderGraph::uploadVertices(const std::array<Vertex, kNumMaxVertices> verti
 	}
 
 	{
-		std::copy(vertices.begin(), vertices.end(), pMappedVertex);
+		std::copy(vertices.begin(), vertices.end(), pMappedVertex + kNumMaxVertices * Resource::instance()->getFrameIndex());
 	}
 
 	// unmap
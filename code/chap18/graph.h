@@ -8,6 +8,7 @@
 #include <d3d12.h>
 #include <wrl.h>
 #pragma warning(pop)
+#include "config.h"
 
 class RenderGraph
 {
@@ -38,8 +39,8 @@ private:
 	Microsoft::WRL::ComPtr<ID3DBlob> m_ps = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> m_rootSignature = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12PipelineState> m_pipelineState = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12Resource> m_vertexBuffer = nullptr;
-	D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView = { };
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_vertexBuffer = nullptr; // a slice per frame in flight
+	std::array<D3D12_VERTEX_BUFFER_VIEW, Config::kNumFramesInFlight> m_vertexBufferViews = { };
 	uint32_t m_vertexCount = 0;
 };
 
@@ -31,13 +31,7 @@ HRESULT ImguiIf::init(HWND hwnd)
 		return E_FAIL;
 	}
 
-	m_descHeap = createDescriptorHeap();
-
-	if (m_descHeap == nullptr)
-	{
-		ThrowIfFalse(false);
-		return E_FAIL;
-	}
+	m_fontSrvTable = Resource::instance()->getDescriptorAllocator()->allocate(1);
 
 	constexpr int32_t kNumFramesInFlight = 3;
 
@@ -45,9 +39,9 @@ HRESULT ImguiIf::init(HWND hwnd)
 		Resource::instance()->getDevice(),
 		kNumFramesInFlight,
 		Resource::instance()->getFrameBuffer(0)->GetDesc().Format,
-		m_descHeap.Get(),
-		m_descHeap.Get()->GetCPUDescriptorHandleForHeapStart(),
-		m_descHeap.Get()->GetGPUDescriptorHandleForHeapStart()
+		Resource::instance()->getDescriptorAllocator()->getHeap(),
+		m_fontSrvTable.getCpuHandle(),
+		m_fontSrvTable.getGpuHandle()
 	);
 
 	if (!ret)
@@ -67,6 +61,7 @@ void ImguiIf::teardown()
 {
 	ImGui_ImplWin32_Shutdown();
 	ImGui_ImplDX12_Shutdown();
+	Resource::instance()->getDescriptorAllocator()->free(&m_fontSrvTable);
 }
 
 void ImguiIf::newFrame()
@@ -91,6 +86,10 @@ void ImguiIf::build()
 
 		ImGui::Text("FPS   : %2.1f\n", m_fps);
 		ImGui::Text("Render: %2.1f ms\n", m_renderingTimeInMs);
+		ImGui::Text("Latency: cpu %2.1f gpu %2.1f disp %2.1f ms\n", m_latencyInMs.x, m_latencyInMs.y, m_latencyInMs.z);
+		ImGui::Text("Input : %2.1f ms\n", m_inputLatencyInMs);
+		ImGui::Text("Anim  : %2.2f ms (saved %2.2f ms)\n", m_animationTimeInMs.x, m_animationTimeInMs.y);
+		ImGui::Text("Pose cache: %3.0f%% hits (saved %2.2f ms)\n", 100.0f * m_poseCacheStats.x, m_poseCacheStats.y);
 		ImGui::Text("Eye   : %2.2f %2.2f %2.2f\n", m_eyePos.x, m_eyePos.y, m_eyePos.z);
 		ImGui::Text("Focus : %2.2f %2.2f %2.2f\n", m_focusPos.x, m_focusPos.y, m_focusPos.z);
 		ImGui::Text("Light : %2.2f %2.2f %2.2f\n", m_lightPos.x, m_lightPos.y, m_lightPos.z);
@@ -125,6 +124,17 @@ void ImguiIf::build()
 				notify(UiEvent::kUpdateAutoLightPos, &uiEventData);
 			}
 		}
+
+		{
+			static bool bCheck = true;
+			const bool bUpdated = ImGui::Checkbox("Animation level of detail", &bCheck);
+
+			if (bUpdated)
+			{
+				const UiEventDataUpdateAnimationLod uiEventData = { .flag = bCheck };
+				notify(UiEvent::kUpdateAnimationLod, &uiEventData);
+			}
+		}
 	}
 	ImGui::End();
 }
@@ -135,7 +145,6 @@ void ImguiIf::render(ID3D12GraphicsCommandList* list)
 
 	ImGui::Render();
 
-	list->SetDescriptorHeaps(1, getDescHeap().GetAddressOf());
 	ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), list);
 }
 
@@ -144,32 +153,6 @@ LRESULT ImguiIf::wndProcHandler(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lpara
 	return ImGui_ImplWin32_WndProcHandler(hwnd, msg, wparam, lparam);
 }
 
-Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> ImguiIf::createDescriptorHeap() const
-{
-	ComPtr<ID3D12DescriptorHeap> descHeap = nullptr;
-
-	D3D12_DESCRIPTOR_HEAP_DESC desc = { };
-	{
-		desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-		desc.NumDescriptors = 1;
-		desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-		desc.NodeMask = 0;
-	}
-
-	auto ret = Resource::instance()->getDevice()->CreateDescriptorHeap(&desc, IID_PPV_ARGS(descHeap.ReleaseAndGetAddressOf()));
-	ThrowIfFailed(ret);
-
-	ret = descHeap.Get()->SetName(Util::getWideStringFromString("DescHeapImgui").c_str());
-	ThrowIfFailed(ret);
-
-	return descHeap;
-}
-
-Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> ImguiIf::getDescHeap()
-{
-	return m_descHeap;
-}
-
 void ImguiIf::buildTestWindow()
 {
 	ImGui::Begin("Rendering Test Menu");
@@ -10,6 +10,7 @@
 #pragma warning(pop)
 #include "../imgui/src/imgui.h"
 #include "config.h"
+#include "descriptor_allocator.h"
 #include "observer.h"
 
 class ImguiIf : public Subject
@@ -22,6 +23,10 @@ public:
 	void render(ID3D12GraphicsCommandList* list);
 	void setFps(float fps) { m_fps = fps; };
 	void setRenderTime(float time) { m_renderingTimeInMs = time; }
+	void setLatency(float cpu, float gpu, float display) { m_latencyInMs = { cpu, gpu, display }; }
+	void setInputLatency(float latency) { m_inputLatencyInMs = latency; }
+	void setAnimationTime(float time, float saved) { m_animationTimeInMs = { time, saved }; }
+	void setPoseCacheStats(float hitRate, float saved) { m_poseCacheStats = { hitRate, saved }; }
 	void setEyePos(DirectX::XMFLOAT3 pos) { m_eyePos = pos; }
 	void setFocusPos(DirectX::XMFLOAT3 pos) { m_focusPos = pos; }
 	void setLightPos(DirectX::XMFLOAT3 pos) { m_lightPos = pos; }
@@ -34,13 +39,15 @@ private:
 	inline static const ImVec2 kTestWindowSize = { 350.0f, 700.0f };
 	inline static const ImVec2 kTestWindowPos = { 0.0f, Config::kWindowHeight - kTestWindowSize.y };
 
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> createDescriptorHeap() const;
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> getDescHeap();
 	[[maybe_unused]] void buildTestWindow();
 
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_descHeap = nullptr;
+	DescriptorTable m_fontSrvTable; // in the global heap
 	float m_fps = 0.0f;
 	float m_renderingTimeInMs = 0.0f;
+	DirectX::XMFLOAT3 m_latencyInMs = { }; // cpu, gpu, display
+	float m_inputLatencyInMs = 0.0f;
+	DirectX::XMFLOAT2 m_animationTimeInMs = { }; // spent, saved by the animation level of detail
+	DirectX::XMFLOAT2 m_poseCacheStats = { }; // the hit rate, the time saved in ms
 	DirectX::XMFLOAT3 m_eyePos = { };
 	DirectX::XMFLOAT3 m_focusPos = { };
 	DirectX::XMFLOAT3 m_lightPos = { };
@@ -0,0 +1,277 @@
+#include "indirect_draw.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <cstddef>
+#include <cstring>
+#include <d3dx12.h>
+#include <numeric>
+#include <utility>
+#pragma warning(pop)
+#include "debug.h"
+#include "util.h"
+
+#define ENABLE_EXECUTE_INDIRECT (1)
+
+using namespace Microsoft::WRL;
+
+HRESULT IndirectDraw::init(ID3D12Device* device, ID3D12RootSignature* rootSignature, UINT constantsRootParamIdx, const std::vector<IndirectDrawCommand>& commands, const std::string& name)
+{
+	ThrowIfFalse(device != nullptr);
+	ThrowIfFalse(rootSignature != nullptr);
+	ThrowIfFalse(!commands.empty());
+
+	m_commands = commands;
+	m_constantsRootParamIdx = constantsRootParamIdx;
+
+	// the constants change a root argument, so the signature is tied to the root signature
+	{
+		D3D12_INDIRECT_ARGUMENT_DESC argumentDescs[2] = { };
+		{
+			argumentDescs[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+			argumentDescs[0].Constant.RootParameterIndex = constantsRootParamIdx;
+			argumentDescs[0].Constant.DestOffsetIn32BitValues = 0;
+			argumentDescs[0].Constant.Num32BitValuesToSet = 2;
+			argumentDescs[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+		}
+
+		const D3D12_COMMAND_SIGNATURE_DESC signatureDesc = {
+			.ByteStride = sizeof(IndirectDrawCommand),
+			.NumArgumentDescs = _countof(argumentDescs),
+			.pArgumentDescs = argumentDescs,
+			.NodeMask = 0,
+		};
+
+		auto result = device->CreateCommandSignature(&signatureDesc, rootSignature, IID_PPV_ARGS(m_commandSignature.ReleaseAndGetAddressOf()));
+		ThrowIfFailed(result);
+
+		result = m_commandSignature->SetName(Util::getWideStringFromString(name + "CommandSignature").c_str());
+		ThrowIfFailed(result);
+	}
+
+	// written by the CPU at most once a frame, so it stays in the upload heap
+	{
+		const size_t size = sizeof(IndirectDrawCommand) * m_commands.size() * Config::kNumFramesInFlight;
+		const D3D12_HEAP_PROPERTIES heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+		const D3D12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+
+		auto result = device->CreateCommittedResource(
+			&heapProp,
+			D3D12_HEAP_FLAG_NONE,
+			&resourceDesc,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(m_argumentBuffer.ReleaseAndGetAddressOf()));
+		ThrowIfFailed(result);
+
+		result = m_argumentBuffer->SetName(Util::getWideStringFromString(name + "DrawArguments").c_str());
+		ThrowIfFailed(result);
+
+		result = m_argumentBuffer->Map(0, nullptr, reinterpret_cast<void**>(&m_mappedArguments));
+		ThrowIfFailed(result);
+	}
+
+	for (UINT i = 0; i < Config::kNumFramesInFlight; ++i)
+	{
+		m_frameCommands.at(i) = m_commands;
+		std::memcpy(m_mappedArguments + m_commands.size() * i, m_commands.data(), sizeof(IndirectDrawCommand) * m_commands.size());
+	}
+
+	return S_OK;
+}
+
+void IndirectDraw::update(UINT frameIndex, const std::vector<bool>& visible, UINT instanceCount)
+{
+	auto& frameCommands = m_frameCommands.at(frameIndex);
+	auto commands = compact(m_commands, visible, instanceCount);
+
+	// the slice is written only when the visibility changed
+	if (commands.size() == frameCommands.size()
+		&& std::memcmp(commands.data(), frameCommands.data(), sizeof(IndirectDrawCommand) * commands.size()) == 0)
+		return;
+
+	if (!commands.empty())
+	{
+		std::memcpy(m_mappedArguments + m_commands.size() * frameIndex, commands.data(), sizeof(IndirectDrawCommand) * commands.size());
+	}
+
+	frameCommands = std::move(commands);
+}
+
+void IndirectDraw::execute(ID3D12GraphicsCommandList* list, UINT frameIndex) const
+{
+	ThrowIfFalse(list != nullptr);
+
+	const auto& frameCommands = m_frameCommands.at(frameIndex);
+
+	if (frameCommands.empty())
+		return;
+
+#if ENABLE_EXECUTE_INDIRECT
+	list->ExecuteIndirect(
+		m_commandSignature.Get(),
+		static_cast<UINT>(frameCommands.size()),
+		m_argumentBuffer.Get(),
+		sizeof(IndirectDrawCommand) * m_commands.size() * frameIndex,
+		nullptr,
+		0);
+#else
+	executeDirect(list, frameIndex);
+#endif // ENABLE_EXECUTE_INDIRECT
+}
+
+void IndirectDraw::executeDirect(ID3D12GraphicsCommandList* list, UINT frameIndex) const
+{
+	ThrowIfFalse(list != nullptr);
+
+	for (const auto& command : m_frameCommands.at(frameIndex))
+	{
+		list->SetGraphicsRoot32BitConstants(m_constantsRootParamIdx, 2, &command, 0);
+		list->DrawIndexedInstanced(
+			command.draw.IndexCountPerInstance,
+			command.draw.InstanceCount,
+			command.draw.StartIndexLocation,
+			command.draw.BaseVertexLocation,
+			command.draw.StartInstanceLocation);
+	}
+}
+
+std::vector<IndirectDrawCommand> IndirectDraw::build(const std::vector<UINT>& indexCounts, UINT instanceCount, uint32_t paletteOffset)
+{
+	std::vector<uint32_t> materialIdxes(indexCounts.size());
+	std::iota(materialIdxes.begin(), materialIdxes.end(), 0);
+
+	return build(indexCounts, materialIdxes, instanceCount, paletteOffset);
+}
+
+std::vector<IndirectDrawCommand> IndirectDraw::build(const std::vector<UINT>& indexCounts, const std::vector<uint32_t>& materialIdxes, UINT instanceCount, uint32_t paletteOffset)
+{
+	ThrowIfFalse(materialIdxes.size() == indexCounts.size());
+
+	std::vector<IndirectDrawCommand> commands;
+	UINT indexOffset = 0;
+
+	for (size_t i = 0; i < indexCounts.size(); ++i)
+	{
+		IndirectDrawCommand command = { };
+		{
+			command.materialIdx = materialIdxes.at(i);
+			command.paletteOffset = paletteOffset;
+			command.draw.IndexCountPerInstance = indexCounts.at(i);
+			command.draw.InstanceCount = instanceCount;
+			command.draw.StartIndexLocation = indexOffset;
+			command.draw.BaseVertexLocation = 0;
+			command.draw.StartInstanceLocation = 0;
+		}
+		commands.push_back(command);
+
+		indexOffset += indexCounts.at(i);
+	}
+
+	return commands;
+}
+
+std::vector<IndirectDrawCommand> IndirectDraw::compact(const std::vector<IndirectDrawCommand>& commands, const std::vector<bool>& visible, UINT instanceCount)
+{
+	ThrowIfFalse(visible.size() == commands.size());
+
+	std::vector<IndirectDrawCommand> compacted;
+
+	if (instanceCount == 0)
+		return compacted;
+
+	for (size_t i = 0; i < commands.size(); ++i)
+	{
+		const IndirectDrawCommand& command = commands.at(i);
+
+		if (!visible.at(i) || command.draw.IndexCountPerInstance == 0)
+			continue;
+
+		if (!compacted.empty())
+		{
+			D3D12_DRAW_INDEXED_ARGUMENTS& last = compacted.back().draw;
+
+			if (compacted.back().materialIdx == command.materialIdx
+				&& compacted.back().paletteOffset == command.paletteOffset
+				&& last.StartIndexLocation + last.IndexCountPerInstance == command.draw.StartIndexLocation
+				&& last.BaseVertexLocation == command.draw.BaseVertexLocation)
+			{
+				last.IndexCountPerInstance += command.draw.IndexCountPerInstance;
+				continue;
+			}
+		}
+
+		compacted.push_back(command);
+		compacted.back().draw.InstanceCount = instanceCount;
+	}
+
+	return compacted;
+}
+
+bool IndirectDraw::selfCheck()
+{
+	const auto commands = build({ 30, 0, 12, 6 }, 2, 256);
+
+	if (commands.size() != 4)
+		return false;
+
+	constexpr UINT kOffsets[] = { 0, 30, 30, 42 };
+
+	for (size_t i = 0; i < commands.size(); ++i)
+	{
+		const auto& command = commands.at(i);
+
+		if (command.materialIdx != i || command.paletteOffset != 256)
+			return false;
+
+		if (command.draw.StartIndexLocation != kOffsets[i] || command.draw.InstanceCount != 2)
+			return false;
+
+		if (command.draw.BaseVertexLocation != 0 || command.draw.StartInstanceLocation != 0)
+			return false;
+	}
+
+	// an empty material keeps its command, so that the indexes into the material buffer stay the same
+	if (commands.at(1).draw.IndexCountPerInstance != 0)
+		return false;
+
+	// the constants come first in the layout the command signature reads
+	if (offsetof(IndirectDrawCommand, paletteOffset) != 4 || offsetof(IndirectDrawCommand, draw) != 8)
+		return false;
+
+	if (!build({ }, 1, 0).empty())
+		return false;
+
+	// the culled and the empty ones are left out, and the rest keep their materials and ranges
+	{
+		const auto compacted = compact(commands, { true, true, false, true }, 5);
+
+		if (compacted.size() != 2 || compacted.at(0).materialIdx != 0 || compacted.at(1).materialIdx != 3)
+			return false;
+
+		if (compacted.at(1).draw.StartIndexLocation != 42 || compacted.at(1).draw.InstanceCount != 5)
+			return false;
+
+		if (!compact(commands, { true, true, true, true }, 0).empty())
+			return false;
+	}
+
+	// the ranges of a material which are seen one after another are one draw
+	{
+		const auto meshletCommands = build({ 12, 6, 9, 3, 6 }, { 0, 0, 0, 1, 1 }, 1, 0);
+		const auto compacted = compact(meshletCommands, { true, true, false, true, true }, 1);
+
+		if (compacted.size() != 2 || compacted.at(0).draw.IndexCountPerInstance != 18 || compacted.at(1).draw.IndexCountPerInstance != 9)
+			return false;
+
+		if (compacted.at(1).materialIdx != 1 || compacted.at(1).draw.StartIndexLocation != 27)
+			return false;
+
+		const auto split = compact(meshletCommands, { true, false, true, false, false }, 1);
+
+		if (split.size() != 2 || split.at(1).draw.StartIndexLocation != 18)
+			return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <array>
+#include <cstdint>
+#include <d3d12.h>
+#include <string>
+#include <vector>
+#include <wrl.h>
+#pragma warning(pop)
+#include "config.h"
+
+// The arguments of a draw. The two constants go to a root 32-bit constants parameter before the draw
+struct IndirectDrawCommand
+{
+	uint32_t materialIdx = 0;
+	uint32_t paletteOffset = 0; // the first bone matrix of the instance
+	D3D12_DRAW_INDEXED_ARGUMENTS draw = { };
+};
+static_assert(sizeof(IndirectDrawCommand) == 28); // the stride of the command signature
+
+// The draws of a model in a buffer, built once and submitted with one ExecuteIndirect.
+// build() makes the arguments on the CPU, so the buffer can be checked headless,
+// and executeDirect() issues the same draws one by one as the reference.
+// update() leaves the culled draws out of the slice of a frame in flight.
+class IndirectDraw
+{
+public:
+	HRESULT init(ID3D12Device* device, ID3D12RootSignature* rootSignature, UINT constantsRootParamIdx, const std::vector<IndirectDrawCommand>& commands, const std::string& name);
+	// visible is per command. All of them are drawn until the first update()
+	void update(UINT frameIndex, const std::vector<bool>& visible, UINT instanceCount);
+	void execute(ID3D12GraphicsCommandList* list, UINT frameIndex) const;
+	void executeDirect(ID3D12GraphicsCommandList* list, UINT frameIndex) const;
+	uint32_t getNumCommands() const { return static_cast<uint32_t>(m_commands.size()); }
+
+	// a command per material, the index ranges one after another in the index buffer
+	static std::vector<IndirectDrawCommand> build(const std::vector<UINT>& indexCounts, UINT instanceCount, uint32_t paletteOffset);
+	// a command per range, such as a meshlet, drawn with the material of materialIdxes
+	static std::vector<IndirectDrawCommand> build(const std::vector<UINT>& indexCounts, const std::vector<uint32_t>& materialIdxes, UINT instanceCount, uint32_t paletteOffset);
+	// the visible commands in order, with instanceCount. Nothing is drawn with 0 instances.
+	// The neighbors of a material are merged into one draw
+	static std::vector<IndirectDrawCommand> compact(const std::vector<IndirectDrawCommand>& commands, const std::vector<bool>& visible, UINT instanceCount);
+	static bool selfCheck();
+
+private:
+	std::vector<IndirectDrawCommand> m_commands;
+	std::array<std::vector<IndirectDrawCommand>, Config::kNumFramesInFlight> m_frameCommands; // what each slice has
+	UINT m_constantsRootParamIdx = 0;
+	Microsoft::WRL::ComPtr<ID3D12CommandSignature> m_commandSignature = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_argumentBuffer = nullptr; // a slice per frame in flight
+	IndirectDrawCommand* m_mappedArguments = nullptr;
+};
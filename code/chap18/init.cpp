@@ -16,7 +16,7 @@ extern "C" { __declspec(dllexport) extern const char* D3D12SDKPath = ".\\D3D12\\
 
 using namespace Microsoft::WRL;
 
-static constexpr UINT kNumOfSwapBuffer = 2;
+static constexpr UINT kNumOfSwapBuffer = Config::kNumFramesInFlight;
 
 Resource* Resource::m_instance = nullptr;
 
@@ -49,16 +49,53 @@ HRESULT Resource::allocate(HWND hwnd)
 	ret = createDescriptorHeap(&m_pRtvHeaps, m_frameBuffers);
 	ThrowIfFailed(ret);
 
+	ret = m_descriptorAllocator.init(
+		m_pDevice.Get(),
+		Config::kNumPersistentDescriptors,
+		Config::kNumTransientDescriptorsPerFrame,
+		Config::kNumFramesInFlight);
+	ThrowIfFailed(ret);
+
+	ret = m_pipelineCache.init(m_pDevice.Get(), Config::kPipelineCacheFilePath);
+	ThrowIfFailed(ret);
+
+	ret = m_bundleCache.init(m_pDevice.Get());
+	ThrowIfFailed(ret);
+
+	ret = m_shaderCache.init(Config::kShaderCacheDir);
+	ThrowIfFailed(ret);
+
+	ret = m_modelCache.init(Config::kModelCacheDir);
+	ThrowIfFailed(ret);
+
+	ret = m_motionCache.init(Config::kMotionCacheDir);
+	ThrowIfFailed(ret);
+
+	m_textureStreamer.start(Config::kNumTextureStreamingThreads);
+
 	return S_OK;
 }
 
 HRESULT Resource::release()
 {
+	m_textureStreamer.stop();
+	m_modelCache.release();
+	m_motionCache.release();
+	m_poseCache.clear();
+	m_shaderCache.release();
+	m_bundleCache.release();
+	m_pipelineCache.release();
+	m_descriptorAllocator.release();
 	m_pRtvHeaps.Reset();
 	m_pSwapChain.Reset();
 
 	m_pCommandList.Reset();
-	m_pCommandAllocator.Reset();
+
+	for (auto& allocator : m_pCommandAllocators)
+	{
+		allocator.Reset();
+	}
+
 	m_pCommandQueue.Reset();
 
 	for (auto& buffer : m_frameBuffers)
@@ -79,15 +116,31 @@ ID3D12Device* Resource::getDevice()
 
 ID3D12CommandAllocator* Resource::getCommandAllocator()
 {
-	if (m_pCommandAllocator != nullptr)
-		return m_pCommandAllocator.Get();
+	return getCommandAllocator(m_frameIndex);
+}
+
+ID3D12CommandAllocator* Resource::getCommandAllocator(UINT frameIndex)
+{
+	auto& allocator = m_pCommandAllocators.at(frameIndex);
+
+	if (allocator != nullptr)
+		return allocator.Get();
 
 	auto result = getDevice()->CreateCommandAllocator(
 		D3D12_COMMAND_LIST_TYPE_DIRECT,
-		IID_PPV_ARGS(m_pCommandAllocator.ReleaseAndGetAddressOf()));
+		IID_PPV_ARGS(allocator.ReleaseAndGetAddressOf()));
+	ThrowIfFailed(result);
+
+	result = allocator.Get()->SetName(Util::getWideStringFromString("commandAllocator" + std::to_string(frameIndex)).c_str());
 	ThrowIfFailed(result);
 
-	return m_pCommandAllocator.Get();
+	return allocator.Get();
+}
+
+void Resource::setFrameIndex(UINT frameIndex)
+{
+	ThrowIfFalse(frameIndex < m_pCommandAllocators.size());
+	m_frameIndex = frameIndex;
 }
 
 ID3D12GraphicsCommandList* Resource::getCommandList()
@@ -264,7 +317,7 @@ HRESULT Resource::createSwapChain(IDXGISwapChain4** ppSwapChain, IDXGIFactory6*
 		swapchainDesc.Scaling = DXGI_SCALING_STRETCH;
 		swapchainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
 		swapchainDesc.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED;
-		swapchainDesc.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;
+		swapchainDesc.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH | DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
 	}
 
 	auto result = pDxgiFactory->CreateSwapChainForHwnd(
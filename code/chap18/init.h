@@ -7,10 +7,20 @@
 #include <dxgi1_6.h>
 #include <Windows.h>
 #include <winerror.h>
+#include <array>
 #include <vector>
 #include <wrl.h>
 #pragma warning(pop)
+#include "bundle_cache.h"
+#include "config.h"
 #include "debug.h"
+#include "descriptor_allocator.h"
+#include "model_cache.h"
+#include "motion_cache.h"
+#include "pipeline_cache.h"
+#include "pose_cache.h"
+#include "shader_cache.h"
+#include "texture_streamer.h"
 
 class Resource
 {
@@ -40,11 +50,22 @@ public:
 	HRESULT release();
 	ID3D12Device* getDevice();
 	ID3D12CommandAllocator* getCommandAllocator();
+	ID3D12CommandAllocator* getCommandAllocator(UINT frameIndex);
+	UINT getFrameIndex() const { return m_frameIndex; }
+	void setFrameIndex(UINT frameIndex);
 	ID3D12GraphicsCommandList* getCommandList();
 	ID3D12CommandQueue* getCommandQueue();
 	IDXGISwapChain4* getSwapChain();
 	ID3D12DescriptorHeap* getRtvHeaps();
 	ID3D12Resource* getFrameBuffer(UINT index);
+	DescriptorAllocator* getDescriptorAllocator() { return &m_descriptorAllocator; }
+	PipelineCache* getPipelineCache() { return &m_pipelineCache; }
+	BundleCache* getBundleCache() { return &m_bundleCache; }
+	ShaderCache* getShaderCache() { return &m_shaderCache; }
+	ModelCache* getModelCache() { return &m_modelCache; }
+	MotionCache* getMotionCache() { return &m_motionCache; }
+	PoseCache* getPoseCache() { return &m_poseCache; }
+	TextureStreamer* getTextureStreamer() { return &m_textureStreamer; }
 	Microsoft::WRL::ComPtr<IDxcLibrary> getDxcLibrary();
 	Microsoft::WRL::ComPtr<IDxcCompiler> getDxcCompiler();
 
@@ -64,12 +85,21 @@ private:
 	static Resource* m_instance;
 	Microsoft::WRL::ComPtr<IDXGIFactory6> m_pDxgiFactory = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Device> m_pDevice = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> m_pCommandAllocator = nullptr;
+	std::array<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>, Config::kNumFramesInFlight> m_pCommandAllocators = { };
+	UINT m_frameIndex = 0;
 	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> m_pCommandList = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_pCommandQueue = nullptr;
 	Microsoft::WRL::ComPtr<IDXGISwapChain4> m_pSwapChain = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_pRtvHeaps = nullptr;
 	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> m_frameBuffers;
+	DescriptorAllocator m_descriptorAllocator;
+	PipelineCache m_pipelineCache;
+	BundleCache m_bundleCache;
+	ShaderCache m_shaderCache;
+	ModelCache m_modelCache;
+	MotionCache m_motionCache;
+	PoseCache m_poseCache;
+	TextureStreamer m_textureStreamer;
 	Microsoft::WRL::ComPtr<IDxcLibrary> m_idxcLibrary = nullptr;
 	Microsoft::WRL::ComPtr<IDxcCompiler> m_idxcCompiler = nullptr;
 };
@@ -0,0 +1,285 @@
+#include "init_graph.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#pragma warning(pop)
+#include "debug.h"
+#include "util.h"
+
+InitGraph::TaskId InitGraph::add(const char* name, std::function<HRESULT()> func, std::initializer_list<TaskId> deps, Affinity affinity)
+{
+	ThrowIfFalse(name != nullptr);
+	ThrowIfFalse(func != nullptr);
+
+	const TaskId id = static_cast<TaskId>(m_tasks.size());
+
+	Task task = { };
+	{
+		task.name = name;
+		task.func = std::move(func);
+		task.deps = deps;
+		task.affinity = affinity;
+	}
+
+	for (const TaskId dep : deps)
+	{
+		ThrowIfFalse(dep < id);
+		m_tasks.at(dep).dependents.push_back(id);
+	}
+
+	m_tasks.push_back(std::move(task));
+
+	return id;
+}
+
+HRESULT InitGraph::run(uint32_t numThreads)
+{
+	m_result = S_OK;
+	m_exception = nullptr;
+	m_startTick = Util::getTick();
+
+	for (size_t i = 0; i < m_tasks.size(); ++i)
+	{
+		m_tasks.at(i).numPendingDeps = static_cast<uint32_t>(m_tasks.at(i).deps.size());
+
+		if (m_tasks.at(i).numPendingDeps == 0)
+		{
+			push(static_cast<TaskId>(i));
+		}
+	}
+
+	std::vector<std::thread> threads;
+
+	for (uint32_t i = 0; i < numThreads; ++i)
+	{
+		threads.emplace_back([this]()
+			{
+				// WIC needs COM on the thread which decodes the images
+				const HRESULT comResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+				work(false);
+
+				if (SUCCEEDED(comResult))
+				{
+					CoUninitialize();
+				}
+			});
+	}
+
+	work(true);
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	m_endTick = Util::getTick();
+
+	if (m_exception)
+		std::rethrow_exception(m_exception);
+
+	return m_result;
+}
+
+void InitGraph::report() const
+{
+	// the longest chain of dependencies is the lower bound of the wall time
+	std::vector<LONGLONG> finish(m_tasks.size(), 0);
+	LONGLONG serial = 0;
+	LONGLONG criticalPath = 0;
+
+	for (size_t i = 0; i < m_tasks.size(); ++i)
+	{
+		const Task& task = m_tasks.at(i);
+		const LONGLONG duration = task.endTick - task.startTick;
+
+		for (const TaskId dep : task.deps)
+		{
+			finish.at(i) = std::max(finish.at(i), finish.at(dep));
+		}
+
+		finish.at(i) += duration;
+		serial += duration;
+		criticalPath = std::max(criticalPath, finish.at(i));
+	}
+
+	Debug::debugOutputFormatString("Init: wall %.1f ms, serial %.1f ms, critical path %.1f ms\n",
+		Util::toMs(m_endTick - m_startTick), Util::toMs(serial), Util::toMs(criticalPath));
+
+	for (const Task& task : m_tasks)
+	{
+		Debug::debugOutputFormatString("    %-16s start %7.1f ms, took %7.1f ms\n",
+			task.name.c_str(), Util::toMs(task.startTick - m_startTick), Util::toMs(task.endTick - task.startTick));
+	}
+}
+
+void InitGraph::work(bool bMainThread)
+{
+	while (true)
+	{
+		TaskId id = 0;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cv.wait(lock, [this, bMainThread]() { return isFinished() || !m_queue.empty() || (bMainThread && !m_mainQueue.empty()); });
+
+			if (bMainThread && !m_mainQueue.empty())
+			{
+				id = m_mainQueue.front();
+				m_mainQueue.pop_front();
+			}
+			else if (!m_queue.empty())
+			{
+				id = m_queue.front();
+				m_queue.pop_front();
+			}
+			else
+			{
+				return; // finished
+			}
+
+			++m_numRunning;
+		}
+
+		Task& task = m_tasks.at(id);
+		HRESULT result = S_OK;
+		std::exception_ptr exception = nullptr;
+
+		task.startTick = Util::getTick();
+
+		try
+		{
+			result = task.func();
+		}
+		catch (...)
+		{
+			result = E_FAIL;
+			exception = std::current_exception();
+		}
+
+		task.endTick = Util::getTick();
+
+		if (FAILED(result))
+		{
+			Debug::debugOutputFormatString("init step %s failed (0x%08x)\n", task.name.c_str(), static_cast<uint32_t>(result));
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			--m_numRunning;
+
+			if (FAILED(result))
+			{
+				if (SUCCEEDED(m_result))
+				{
+					m_result = result;
+					m_exception = exception;
+				}
+
+				m_queue.clear();
+				m_mainQueue.clear();
+			}
+			else if (SUCCEEDED(m_result))
+			{
+				for (const TaskId dependent : task.dependents)
+				{
+					if (--m_tasks.at(dependent).numPendingDeps == 0)
+					{
+						push(dependent);
+					}
+				}
+			}
+		}
+
+		m_cv.notify_all();
+	}
+}
+
+void InitGraph::push(TaskId id)
+{
+	if (m_tasks.at(id).affinity == Affinity::kMainThread)
+		m_mainQueue.push_back(id);
+	else
+		m_queue.push_back(id);
+}
+
+bool InitGraph::isFinished() const
+{
+	return m_queue.empty() && m_mainQueue.empty() && m_numRunning == 0;
+}
+
+bool InitGraph::selfCheck()
+{
+	const std::thread::id mainThreadId = std::this_thread::get_id();
+
+	// the order and the affinity, with and without threads
+	for (const uint32_t numThreads : { 0u, 3u })
+	{
+		std::mutex mutex;
+		std::vector<TaskId> order;
+		std::atomic<bool> bOnMainThread = false;
+
+		InitGraph graph;
+		auto record = [&](TaskId id)
+		{
+			return [&, id]()
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				order.push_back(id);
+				return S_OK;
+			};
+		};
+
+		const TaskId a = graph.add("a", record(0));
+		const TaskId b = graph.add("b", record(1), { a });
+		const TaskId c = graph.add("c", record(2), { a });
+		graph.add("d", [&, f = record(3)]()
+			{
+				bOnMainThread = (std::this_thread::get_id() == mainThreadId);
+				return f();
+			}, { b, c }, Affinity::kMainThread);
+		graph.add("e", record(4));
+
+		if (FAILED(graph.run(numThreads)))
+			return false;
+
+		if (order.size() != 5 || !bOnMainThread)
+			return false;
+
+		auto pos = [&](TaskId id) { return std::find(order.begin(), order.end(), id) - order.begin(); };
+
+		if (pos(0) > pos(1) || pos(0) > pos(2) || pos(1) > pos(3) || pos(2) > pos(3))
+			return false;
+	}
+
+	// a failure does not start its dependents
+	{
+		std::atomic<bool> bRan = false;
+
+		InitGraph graph;
+		const TaskId a = graph.add("a", []() { return E_OUTOFMEMORY; });
+		graph.add("b", [&]() { bRan = true; return S_OK; }, { a });
+
+		if (graph.run(2) != E_OUTOFMEMORY || bRan)
+			return false;
+	}
+
+	// an exception reaches the caller
+	{
+		InitGraph graph;
+		graph.add("a", []() { ThrowIfFalse(false); return S_OK; });
+
+		try
+		{
+			graph.run(2);
+			return false;
+		}
+		catch (const std::exception&)
+		{
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <vector>
+#pragma warning(pop)
+
+// Initialization steps with their dependencies. run() executes the steps whose dependencies are done
+// in parallel on its own threads. A step marked kMainThread runs on the calling thread, which also
+// takes the other steps while it waits. A failed step stops the ones not started yet.
+class InitGraph
+{
+public:
+	using TaskId = uint32_t;
+	enum class Affinity { kAny, kMainThread };
+
+	// a dependency must be added before, so the graph has no cycle
+	TaskId add(const char* name, std::function<HRESULT()> func, std::initializer_list<TaskId> deps = { }, Affinity affinity = Affinity::kAny);
+	// the first failure is returned. An exception thrown in a step is re-thrown here
+	HRESULT run(uint32_t numThreads);
+	void report() const;
+
+	static bool selfCheck();
+
+private:
+	struct Task
+	{
+		std::string name;
+		std::function<HRESULT()> func;
+		std::vector<TaskId> deps;
+		std::vector<TaskId> dependents;
+		Affinity affinity = Affinity::kAny;
+		uint32_t numPendingDeps = 0;
+		LONGLONG startTick = 0;
+		LONGLONG endTick = 0;
+	};
+
+	void work(bool bMainThread);
+	void push(TaskId id);
+	bool isFinished() const;
+
+	std::vector<Task> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::deque<TaskId> m_queue;
+	std::deque<TaskId> m_mainQueue;
+	uint32_t m_numRunning = 0;
+	HRESULT m_result = S_OK;
+	std::exception_ptr m_exception = nullptr;
+	LONGLONG m_startTick = 0;
+	LONGLONG m_endTick = 0;
+};
@@ -1,17 +1,38 @@
 #include "input.h"
+#include <algorithm>
+#include <cmath>
 #include <numbers>
 #include <winuser.h>
+#include <windowsx.h>
+#include "util.h"
 
 namespace {
-	Action processKeyInput(const MSG& msg, Render* pRender);
-	Action processMouseWheelInput(const MSG& msg, Render* pRender);
-	Action processMouseLbuttonInput(const MSG& msg, Render* pRender, int32_t srcx, int32_t srcy);
-	int32_t getCursorPosX();
-	int32_t getCursorPosY();
-}
+	Action processKeyInput(const Input::Event& event, Input::Sink* pSink);
+	Action processMouseWheelInput(const Input::Event& event, Input::Sink* pSink);
+
+	class MockSink : public Input::Sink
+	{
+	public:
+		struct MoveEyeCall
+		{
+			MoveEye moveEye = MoveEye::kNone;
+			float val = 0.0f;
+		};
+
+		void moveEye(MoveEye moveEye, float val) override { m_moveEyeCalls.push_back({ moveEye, val }); }
+		void toggleAnimationEnable() override { ++m_numToggleEnable; }
+		void toggleAnimationReverse() override { ++m_numToggleReverse; }
 
-int32_t InputState::m_x = 0;
-int32_t InputState::m_y = 0;
+		std::vector<MoveEyeCall> m_moveEyeCalls;
+		uint32_t m_numToggleEnable = 0;
+		uint32_t m_numToggleReverse = 0;
+	};
+
+	bool isNear(float a, float b)
+	{
+		return std::abs(a - b) < 1e-5f;
+	}
+}
 
 struct StaticInstance {
 	static DefaultInputState m_default;
@@ -21,37 +42,180 @@ DefaultInputState StaticInstance::m_default = { };
 LbDownInputState StaticInstance::m_lbDown = { };
 
 namespace Input {
-	Action processInputEvent(const MSG& msg, Render* pRender)
+	EventQueue::EventQueue(LONGLONG tickFrequency)
+		: m_tickFrequency(tickFrequency)
+		, m_state(&StaticInstance::m_default)
 	{
-		static InputState* s_inputState = &StaticInstance::m_default;
+		ThrowIfFalse(tickFrequency > 0);
+	}
 
-		const auto [action, nextState] = s_inputState->handleEvent(msg, pRender);
+	void EventQueue::push(const Event& event)
+	{
+		m_events.push_back(event);
+	}
+
+	Action EventQueue::consume(Sink* pSink, LONGLONG consumeTick)
+	{
+		ThrowIfFalse(pSink != nullptr);
+
+		Action action = Action::kNone;
+		float maxLatencyInMs = 0.0f;
+
+		for (const auto& event : m_events)
+		{
+			maxLatencyInMs = std::max(maxLatencyInMs, toMs(consumeTick - event.receivedTick));
+
+			const auto [eventAction, nextState] = m_state->handleEvent(event, pSink, &m_drag);
+
+			if (nextState != nullptr)
+			{
+				m_state = nextState;
+			}
+
+			if (eventAction == Action::kQuit)
+			{
+				action = Action::kQuit;
+				break;
+			}
+		}
 
-		if (nextState != nullptr)
+		if (!m_events.empty())
 		{
-			s_inputState = nextState;
+			m_maxLatencyInMs = maxLatencyInMs;
+			m_latencyInMs = (m_latencyInMs == 0.0f) ? maxLatencyInMs : m_latencyInMs + (maxLatencyInMs - m_latencyInMs) * kSmoothingFactor;
 		}
 
+		m_events.clear();
+		flushDrag(pSink);
+
 		return action;
 	}
+
+	void EventQueue::flushDrag(Sink* pSink)
+	{
+		if (m_drag.dx == 0 && m_drag.dy == 0)
+			return;
+
+		const float fx = static_cast<float>(m_drag.dx) / static_cast<float>(Config::kWindowWidth) * static_cast<float>(std::numbers::pi);
+		const float fy = static_cast<float>(m_drag.dy) / static_cast<float>(Config::kWindowHeight) * static_cast<float>(std::numbers::pi);
+
+		pSink->moveEye(MoveEye::kFocusX, fx);
+		pSink->moveEye(MoveEye::kFocusY, fy);
+
+		m_drag.dx = 0;
+		m_drag.dy = 0;
+	}
+
+	float EventQueue::toMs(LONGLONG tick) const
+	{
+		return static_cast<float>(tick) * 1000.0f / static_cast<float>(m_tickFrequency);
+	}
+
+	bool EventQueue::selfCheck()
+	{
+		constexpr LONGLONG kFreq = 1000; // 1 tick = 1 ms
+
+		// a burst of mouse moves while dragging is applied as one delta per axis
+		{
+			EventQueue queue(kFreq);
+			MockSink sink;
+
+			queue.push({ .message = WM_LBUTTONDOWN, .lParam = MAKELPARAM(100, 100), .receivedTick = 0 });
+
+			for (int32_t i = 1; i <= 100; ++i)
+			{
+				queue.push({ .message = WM_MOUSEMOVE, .lParam = MAKELPARAM(100 + i, 100 - i), .receivedTick = i });
+			}
+
+			if (queue.consume(&sink, 200) != Action::kNone)
+				return false;
+
+			if (queue.getNumOfPendingEvents() != 0 || sink.m_moveEyeCalls.size() != 2)
+				return false;
+
+			const float fx = 100.0f / Config::kWindowWidth * static_cast<float>(std::numbers::pi);
+			const float fy = 100.0f / Config::kWindowHeight * static_cast<float>(std::numbers::pi);
+
+			if (sink.m_moveEyeCalls.at(0).moveEye != MoveEye::kFocusX || !isNear(sink.m_moveEyeCalls.at(0).val, fx))
+				return false;
+
+			if (sink.m_moveEyeCalls.at(1).moveEye != MoveEye::kFocusY || !isNear(sink.m_moveEyeCalls.at(1).val, fy))
+				return false;
+
+			// the oldest event decides the latency
+			if (!isNear(queue.getMaxLatencyInMs(), 200.0f))
+				return false;
+
+			// no movement after the button is released
+			queue.push({ .message = WM_LBUTTONUP, .lParam = MAKELPARAM(200, 0), .receivedTick = 300 });
+			queue.push({ .message = WM_MOUSEMOVE, .lParam = MAKELPARAM(300, 0), .receivedTick = 301 });
+
+			if (queue.consume(&sink, 310) != Action::kNone || sink.m_moveEyeCalls.size() != 2)
+				return false;
+
+			// nothing to consume keeps the last latency
+			if (queue.consume(&sink, 1000) != Action::kNone || !isNear(queue.getMaxLatencyInMs(), 10.0f))
+				return false;
+		}
+
+		// keys are processed in order, and escape stops the processing
+		{
+			EventQueue queue(kFreq);
+			MockSink sink;
+
+			queue.push({ .message = WM_KEYDOWN, .wParam = 'R' });
+			queue.push({ .message = WM_KEYDOWN, .wParam = VK_SPACE });
+			queue.push({ .message = WM_KEYDOWN, .wParam = VK_ESCAPE });
+			queue.push({ .message = WM_KEYDOWN, .wParam = VK_SPACE });
+
+			if (queue.consume(&sink, 0) != Action::kQuit)
+				return false;
+
+			if (sink.m_numToggleReverse != 1 || sink.m_numToggleEnable != 1)
+				return false;
+		}
+
+		return true;
+	}
+
+	bool isInputMessage(UINT message)
+	{
+		return (WM_KEYFIRST <= message && message <= WM_KEYLAST) || (WM_MOUSEFIRST <= message && message <= WM_MOUSELAST);
+	}
+
+	Event makeEvent(const MSG& msg)
+	{
+		// MSG::time is in msec from GetTickCount(). Move the tick back by the time the message has been waiting
+		const DWORD waitInMs = GetTickCount() - msg.time;
+
+		Event event = { };
+		{
+			event.message = msg.message;
+			event.wParam = msg.wParam;
+			event.lParam = msg.lParam;
+			event.receivedTick = Util::getTick() - static_cast<LONGLONG>(waitInMs) * Util::getTickFrequency() / 1000;
+		}
+
+		return event;
+	}
 }
 
-std::pair<Action, InputState*> DefaultInputState::handleEvent(const MSG& msg, Render* pRender)
+std::pair<Action, InputState*> DefaultInputState::handleEvent(const Input::Event& event, Input::Sink* pSink, Input::Drag* pDrag)
 {
 	Action action = Action::kNone;
 	InputState* nextState = nullptr;
 
-	switch (msg.message) {
+	switch (event.message) {
 	case WM_KEYDOWN:
-		action = processKeyInput(msg, pRender);
+		action = processKeyInput(event, pSink);
 		break;
 	case WM_MOUSEWHEEL:
-		action = processMouseWheelInput(msg, pRender);
+		action = processMouseWheelInput(event, pSink);
 		break;
 	case WM_LBUTTONDOWN:
 		nextState = &StaticInstance::m_lbDown;
-		setX(getCursorPosX());
-		setY(getCursorPosY());
+		pDrag->x = GET_X_LPARAM(event.lParam);
+		pDrag->y = GET_Y_LPARAM(event.lParam);
 		break;
 	default:
 		break;
@@ -60,19 +224,28 @@ std::pair<Action, InputState*> DefaultInputState::handleEvent(const MSG& msg, Re
 	return { action, nextState };
 }
 
-std::pair<Action, InputState*> LbDownInputState::handleEvent(const MSG& msg, Render* pRender)
+std::pair<Action, InputState*> LbDownInputState::handleEvent(const Input::Event& event, [[maybe_unused]] Input::Sink* pSink, Input::Drag* pDrag)
 {
 	Action action = Action::kNone;
 	InputState* nextState = nullptr;
 
-	switch (msg.message) {
+	switch (event.message) {
 	case WM_LBUTTONUP:
 		nextState = &StaticInstance::m_default;
 		break;
+	case WM_MOUSEMOVE:
+	{
+		// only accumulated here. EventQueue applies the sum at the end of the frame
+		const int32_t curx = GET_X_LPARAM(event.lParam);
+		const int32_t cury = GET_Y_LPARAM(event.lParam);
+
+		pDrag->dx += curx - pDrag->x;
+		pDrag->dy += -(cury - pDrag->y);
+		pDrag->x = curx;
+		pDrag->y = cury;
+		break;
+	}
 	default:
-		action = processMouseLbuttonInput(msg, pRender, getX(), getY());
-		setX(getCursorPosX());
-		setY(getCursorPosY());
 		break;
 	}
 
@@ -80,40 +253,40 @@ std::pair<Action, InputState*> LbDownInputState::handleEvent(const MSG& msg, Ren
 }
 
 namespace {
-	Action processKeyInput(const MSG& msg, Render* pRender)
+	Action processKeyInput(const Input::Event& event, Input::Sink* pSink)
 	{
-		switch (msg.wParam) {
+		switch (event.wParam) {
 		case VK_ESCAPE:
 			return Action::kQuit;
 		case VK_SPACE:
-			pRender->toggleAnimationEnable();
+			pSink->toggleAnimationEnable();
 			break;
 		case VK_LEFT:
-			pRender->moveEye(MoveEye::kFocusX, -0.03f);
+			pSink->moveEye(MoveEye::kFocusX, -0.03f);
 			break;
 		case VK_UP:
-			pRender->moveEye(MoveEye::kPosY, 0.5f);
+			pSink->moveEye(MoveEye::kPosY, 0.5f);
 			break;
 		case VK_RIGHT:
-			pRender->moveEye(MoveEye::kFocusX, 0.03f);
+			pSink->moveEye(MoveEye::kFocusX, 0.03f);
 			break;
 		case VK_DOWN:
-			pRender->moveEye(MoveEye::kPosY, -0.5f);
+			pSink->moveEye(MoveEye::kPosY, -0.5f);
 			break;
 		case 'A':
-			pRender->moveEye(MoveEye::kPosX, -0.5f);
+			pSink->moveEye(MoveEye::kPosX, -0.5f);
 			break;
 		case 'W':
-			pRender->moveEye(MoveEye::kPosZ, 0.5f);
+			pSink->moveEye(MoveEye::kPosZ, 0.5f);
 			break;
 		case 'D':
-			pRender->moveEye(MoveEye::kPosX, 0.5f);
+			pSink->moveEye(MoveEye::kPosX, 0.5f);
 			break;
 		case 'S':
-			pRender->moveEye(MoveEye::kPosZ, -0.5f);
+			pSink->moveEye(MoveEye::kPosZ, -0.5f);
 			break;
 		case 'R':
-			pRender->toggleAnimationReverse();
+			pSink->toggleAnimationReverse();
 			break;
 		default:
 			break;
@@ -122,46 +295,15 @@ namespace {
 		return Action::kNone;
 	}
 
-	Action processMouseWheelInput(const MSG& msg, Render* pRender)
+	Action processMouseWheelInput(const Input::Event& event, Input::Sink* pSink)
 	{
 		constexpr float kBaseMovement = 0.5f;
 
-		const int32_t zDelta = GET_WHEEL_DELTA_WPARAM(msg.wParam);
+		const int32_t zDelta = GET_WHEEL_DELTA_WPARAM(event.wParam);
 		const float z = (zDelta / WHEEL_DELTA) * kBaseMovement;
 
-		pRender->moveEye(MoveEye::kPosZ, z);
-
-		return Action::kNone;
-	}
-
-	Action processMouseLbuttonInput(const MSG& msg, Render* pRender, int32_t prevx, int32_t prevy)
-	{
-		const int32_t curx = getCursorPosX();
-		const int32_t cury = getCursorPosY();
-		const int32_t dx = curx - prevx;
-		const int32_t dy = -(cury - prevy);
-		const float fx = static_cast<float>(dx) / static_cast<float>(Config::kWindowWidth) * static_cast<float>(std::numbers::pi);
-		const float fy = static_cast<float>(dy) / static_cast<float>(Config::kWindowHeight) * static_cast<float>(std::numbers::pi);
-
-		//Debug::debugOutputFormatString("[%zd] fx=%f dx=%d prevx=%d curx=%d\n", s_frame, fx, dx, prevx, curx);
-
-		pRender->moveEye(MoveEye::kFocusX, fx);
-		pRender->moveEye(MoveEye::kFocusY, fy);
+		pSink->moveEye(MoveEye::kPosZ, z);
 
 		return Action::kNone;
 	}
-
-	int32_t getCursorPosX()
-	{
-		POINT point = { };
-		GetCursorPos(&point);
-		return point.x;
-	}
-
-	int32_t getCursorPosY()
-	{
-		POINT point = { };
-		GetCursorPos(&point);
-		return point.y;
-	}
 }
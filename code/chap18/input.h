@@ -1,5 +1,12 @@
 #pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <cstdint>
 #include <utility>
+#include <vector>
+#pragma warning(pop)
 #include "render.h"
 
 enum class Action {
@@ -7,38 +14,98 @@ enum class Action {
 	kQuit,
 };
 
+class InputState;
+
 namespace Input {
-	Action processInputEvent(const MSG& msg, Render* pRender);
+	struct Event
+	{
+		UINT message = 0;
+		WPARAM wParam = 0;
+		LPARAM lParam = 0;
+		LONGLONG receivedTick = 0; // QueryPerformanceCounter() when the message was posted
+	};
+
+	// the left button drag. The movement is summed up and applied once per frame
+	struct Drag
+	{
+		int32_t x = 0;
+		int32_t y = 0;
+		int32_t dx = 0;
+		int32_t dy = 0;
+	};
+
+	// the receiver of the input. Render in the app, a mock in the self check
+	class Sink
+	{
+	public:
+		virtual ~Sink() = default;
+		virtual void moveEye(MoveEye moveEye, float val) = 0;
+		virtual void toggleAnimationEnable() = 0;
+		virtual void toggleAnimationReverse() = 0;
+	};
+
+	class RenderSink : public Sink
+	{
+	public:
+		explicit RenderSink(Render* pRender) : m_pRender(pRender) { }
+		void moveEye(MoveEye moveEye, float val) override { m_pRender->moveEye(moveEye, val); }
+		void toggleAnimationEnable() override { m_pRender->toggleAnimationEnable(); }
+		void toggleAnimationReverse() override { m_pRender->toggleAnimationReverse(); }
+
+	private:
+		Render* m_pRender = nullptr;
+	};
+
+	// The message loop pushes all the pending events, then the frame consumes them at once.
+	// The latency is measured from the time the message was posted to the time it is consumed.
+	class EventQueue
+	{
+	public:
+		explicit EventQueue(LONGLONG tickFrequency);
+
+		void push(const Event& event);
+		Action consume(Sink* pSink, LONGLONG consumeTick);
+		size_t getNumOfPendingEvents() const { return m_events.size(); }
+		float getLatencyInMs() const { return m_latencyInMs; } // moving average
+		float getMaxLatencyInMs() const { return m_maxLatencyInMs; } // in the last consumed frame
+
+		static bool selfCheck();
+
+	private:
+		static constexpr float kSmoothingFactor = 0.1f;
+
+		void flushDrag(Sink* pSink);
+		float toMs(LONGLONG tick) const;
+
+		LONGLONG m_tickFrequency = 0;
+		std::vector<Event> m_events;
+		InputState* m_state = nullptr;
+		Drag m_drag;
+		float m_latencyInMs = 0.0f;
+		float m_maxLatencyInMs = 0.0f;
+	};
+
+	bool isInputMessage(UINT message);
+	Event makeEvent(const MSG& msg);
 }
 
 class InputState
 {
 public:
 	virtual ~InputState() { }
-	virtual std::pair<Action, InputState*> handleEvent(const MSG& msg, Render* pRender) = 0;
-
-protected:
-	void setX(int32_t x) { m_x = x; }
-	void setY(int32_t y) { m_y = y; }
-	int32_t getX() const { return m_x; }
-	int32_t getY() const { return m_y; }
-
-private:
-	static int32_t m_x;
-	static int32_t m_y;
+	virtual std::pair<Action, InputState*> handleEvent(const Input::Event& event, Input::Sink* pSink, Input::Drag* pDrag) = 0;
 };
 
 class DefaultInputState : public InputState
 {
 public:
 	~DefaultInputState() { }
-	std::pair<Action, InputState*> handleEvent(const MSG& msg, Render* pRender) override;
+	std::pair<Action, InputState*> handleEvent(const Input::Event& event, Input::Sink* pSink, Input::Drag* pDrag) override;
 };
 
 class LbDownInputState : public InputState
 {
 public:
 	~LbDownInputState() { }
-	std::pair<Action, InputState*> handleEvent(const MSG& msg, Render* pRender) override;
+	std::pair<Action, InputState*> handleEvent(const Input::Event& event, Input::Sink* pSink, Input::Drag* pDrag) override;
 };
-
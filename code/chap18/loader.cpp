@@ -13,28 +13,44 @@ using namespace Microsoft::WRL;
 
 HRESULT Loader::loadImageFromFile(const std::string& texPath, ComPtr<ID3D12Resource>& buffer)
 {
+	if (findImage(texPath, buffer))
+		return S_OK;
+
+	DirectX::TexMetadata metadata = { };
+	DirectX::ScratchImage scratchImg = { };
+
+	if (FAILED(decodeImage(texPath, &metadata, &scratchImg)))
+		return E_FAIL;
+
+	return createImage(texPath, metadata, scratchImg, buffer);
+}
+
+bool Loader::findImage(const std::string& texPath, ComPtr<ID3D12Resource>& buffer)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
 	const auto it = m_resourceTable.find(texPath);
 
-	if (it != m_resourceTable.end())
-	{
-		buffer = it->second;
-		return S_OK;
-	}
+	if (it == m_resourceTable.end())
+		return false;
 
-	using namespace DirectX;
+	buffer = it->second;
+	return true;
+}
 
-	TexMetadata metadata = { };
-	ScratchImage scratchImg = { };
+HRESULT Loader::decodeImage(const std::string& texPath, DirectX::TexMetadata* metadata, DirectX::ScratchImage* scratchImg)
+{
+	ThrowIfFalse(metadata != nullptr);
+	ThrowIfFalse(scratchImg != nullptr);
 
-	auto ret = LoadFromWICFile(
+	return DirectX::LoadFromWICFile(
 		Util::getWideStringFromString(texPath).c_str(),
-		WIC_FLAGS_NONE,
-		&metadata,
-		scratchImg);
-
-	if (FAILED(ret))
-		return E_FAIL;
+		DirectX::WIC_FLAGS_NONE,
+		metadata,
+		*scratchImg);
+}
 
+HRESULT Loader::createImage(const std::string& texPath, const DirectX::TexMetadata& metadata, const DirectX::ScratchImage& scratchImg, ComPtr<ID3D12Resource>& buffer)
+{
 	const auto img = scratchImg.GetImage(0, 0, 0);
 
 	D3D12_HEAP_PROPERTIES heapProp = { };
@@ -62,7 +78,7 @@ HRESULT Loader::loadImageFromFile(const std::string& texPath, ComPtr<ID3D12Resou
 
 	ComPtr<ID3D12Resource> resource = nullptr;
 	{
-		ret = Resource::instance()->getDevice()->CreateCommittedResource(
+		auto ret = Resource::instance()->getDevice()->CreateCommittedResource(
 			&heapProp,
 			D3D12_HEAP_FLAG_NONE,
 			&resourceDesc,
@@ -80,8 +96,10 @@ HRESULT Loader::loadImageFromFile(const std::string& texPath, ComPtr<ID3D12Resou
 		ThrowIfFailed(ret);
 	}
 
-	m_resourceTable[texPath] = resource.Get();
+	// not locked while decoding. When two threads load the same image, the first one is kept
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const auto it = m_resourceTable.emplace(texPath, resource.Get()).first;
 
-	buffer = resource;
+	buffer = it->second;
 	return S_OK;
 }
\ No newline at end of file
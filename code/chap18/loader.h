@@ -4,9 +4,11 @@
 #pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
 #include <cstdint>
 #include <cstring>
+#include <DirectXTex.h>
 #include <Windows.h>
 #include <wrl.h>
 #include <map>
+#include <mutex>
 #pragma warning(pop)
 #include "debug.h"
 
@@ -36,6 +38,10 @@ public:
 		m_loader = nullptr;
 	}
 	HRESULT loadImageFromFile(const std::string& texPath, Microsoft::WRL::ComPtr<ID3D12Resource>& buffer);
+	bool findImage(const std::string& texPath, Microsoft::WRL::ComPtr<ID3D12Resource>& buffer);
+	// the decode is the slow part and can run on any thread. The texture is created from the image afterwards
+	static HRESULT decodeImage(const std::string& texPath, DirectX::TexMetadata* metadata, DirectX::ScratchImage* scratchImg);
+	HRESULT createImage(const std::string& texPath, const DirectX::TexMetadata& metadata, const DirectX::ScratchImage& scratchImg, Microsoft::WRL::ComPtr<ID3D12Resource>& buffer);
 
 private:
 	Loader() = default;
@@ -43,5 +49,6 @@ private:
 	void operator=(const Loader&) = delete;
 
 	static Loader* m_loader;
+	std::mutex m_mutex; // the images are loaded in parallel during the initialization
 	std::map<std::string, ID3D12Resource*> m_resourceTable;
 };
@@ -6,7 +6,9 @@
 #include <cstdio>
 #include <cassert>
 #include <dxgidebug.h>
+#include <string>
 #include <tchar.h>
+#include <vector>
 #include <windowsx.h>
 #pragma warning(pop)
 #include "config.h"
@@ -15,8 +17,12 @@
 #include "init.h"
 #include "input.h"
 #include "loader.h"
+#include "mesh_report.h"
+#include "motion_report.h"
 #include "pmd_actor.h"
 #include "render.h"
+#include "self_check.h"
+#include "util.h"
 
 #pragma comment(lib, "dxguid.lib")
 
@@ -29,6 +35,7 @@ static LRESULT WindowProcedure(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam
 static void tearDown(const WNDCLASSEX& wndClass, const HWND& hwnd);
 static void trackFrameTime();
 static float getFps();
+static bool drainMessages(Input::EventQueue* pInputQueue);
 
 static uint64_t s_frame = 0;
 
@@ -39,6 +46,17 @@ int main()
 int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 {
 #endif // _DEBUG
+	// headless. Nothing below is created
+	if (__argc >= 2 && std::string(__argv[1]) == "--mesh-report")
+		return MeshReport::run(std::vector<std::string>(__argv + 2, __argv + __argc));
+
+	if (__argc >= 2 && std::string(__argv[1]) == "--motion-report")
+		return MotionReport::run(std::vector<std::string>(__argv + 2, __argv + __argc));
+
+	if (__argc >= 2 && std::string(__argv[1]) == "--self-check")
+		return SelfCheck::run();
+
+	const LONGLONG launchTick = Util::getTick();
 	Debug::debugOutputFormatString("[Debug window]\n");
 
 	WNDCLASSEX w = { };
@@ -84,29 +102,32 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 		Render render;
 		ThrowIfFailed(render.init(hwnd));
 
-		MSG msg = {};
+		Input::EventQueue inputQueue(Util::getTickFrequency());
+		Input::RenderSink inputSink(&render);
 
 		for (s_frame = 0; ; ++s_frame)
 		{
+			ThrowIfFailed(render.waitForNextFrame());
+
+			// take all the input which has arrived so far, so that it is reflected in this frame
+			if (!drainMessages(&inputQueue))
+				break;
+
+			if (inputQueue.consume(&inputSink, Util::getTick()) == Action::kQuit)
+			{
+				render.waitForEndOfRendering();
+				break;
+			}
+
 			render.setFpsInImgui(getFps());
+			render.setInputLatencyInImgui(inputQueue.getLatencyInMs());
 			ThrowIfFailed(render.update());
 			ThrowIfFailed(render.render());
-			ThrowIfFailed(render.waitForEndOfRendering());
 			ThrowIfFailed(render.swap());
 
-			if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+			if (s_frame == 0)
 			{
-				if (msg.message == WM_QUIT)
-					break;
-
-				if (Input::processInputEvent(msg, &render) == Action::kQuit)
-				{
-					render.waitForEndOfRendering();
-					break;
-				}
-
-				TranslateMessage(&msg);
-				DispatchMessage(&msg);
+				Debug::debugOutputFormatString("Time to first frame: %.1f ms\n", Util::toMs(Util::getTick() - launchTick));
 			}
 
 			trackFrameTime();
@@ -212,6 +233,27 @@ UINT64 FrameCounter::getInUsec() const
 
 static FrameCounter frameCounter;
 
+bool drainMessages(Input::EventQueue* pInputQueue)
+{
+	MSG msg = {};
+
+	while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+	{
+		if (msg.message == WM_QUIT)
+			return false;
+
+		if (Input::isInputMessage(msg.message))
+		{
+			pInputQueue->push(Input::makeEvent(msg));
+		}
+
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+	}
+
+	return true;
+}
+
 void trackFrameTime()
 {
 	frameCounter.track();
@@ -0,0 +1,524 @@
+#include "mesh_optimizer.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+#pragma warning(pop)
+#include "debug.h"
+
+using namespace DirectX;
+
+namespace {
+	constexpr uint32_t kNone = UINT32_MAX;
+	constexpr uint32_t kOverdrawResolution = 256;
+
+	float getAxis(const XMFLOAT3& pos, uint32_t axis)
+	{
+		return axis == 0 ? pos.x : (axis == 1 ? pos.y : pos.z);
+	}
+
+	// counts the pixels a triangle covers, and the ones which pass the depth test
+	void rasterize(const std::array<XMFLOAT3, 3>& p, std::vector<float>* pDepth, uint64_t* pCovered, uint64_t* pShaded)
+	{
+		const float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+
+		if (std::abs(area) < FLT_EPSILON)
+			return;
+
+		// both faces are drawn, so either winding is inside
+		const float invArea = 1.0f / area;
+		const int32_t minX = std::max(0, static_cast<int32_t>(std::floor(std::min({ p[0].x, p[1].x, p[2].x }))));
+		const int32_t minY = std::max(0, static_cast<int32_t>(std::floor(std::min({ p[0].y, p[1].y, p[2].y }))));
+		const int32_t maxX = std::min(static_cast<int32_t>(kOverdrawResolution) - 1, static_cast<int32_t>(std::ceil(std::max({ p[0].x, p[1].x, p[2].x }))));
+		const int32_t maxY = std::min(static_cast<int32_t>(kOverdrawResolution) - 1, static_cast<int32_t>(std::ceil(std::max({ p[0].y, p[1].y, p[2].y }))));
+
+		for (int32_t y = minY; y <= maxY; ++y)
+		{
+			for (int32_t x = minX; x <= maxX; ++x)
+			{
+				const float cx = x + 0.5f;
+				const float cy = y + 0.5f;
+				const float b0 = ((p[1].x - cx) * (p[2].y - cy) - (p[2].x - cx) * (p[1].y - cy)) * invArea;
+				const float b1 = ((p[2].x - cx) * (p[0].y - cy) - (p[0].x - cx) * (p[2].y - cy)) * invArea;
+				const float b2 = 1.0f - b0 - b1;
+
+				if (b0 < 0.0f || b1 < 0.0f || b2 < 0.0f)
+					continue;
+
+				float& depth = pDepth->at(y * kOverdrawResolution + x);
+				const float z = b0 * p[0].z + b1 * p[1].z + b2 * p[2].z;
+
+				if (z >= depth)
+					continue;
+
+				*pCovered += depth == FLT_MAX ? 1 : 0;
+				*pShaded += 1;
+				depth = z;
+			}
+		}
+	}
+
+	// the area weighted center and normal of the triangles of a meshlet
+	void getCenterAndNormal(const Meshlet::Clusters& clusters, const Meshlet::Meshlet& meshlet, const std::vector<Meshlet::Vertex>& vertices, XMVECTOR* pCenter, XMVECTOR* pNormal)
+	{
+		XMVECTOR center = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0.0f;
+
+		for (uint32_t i = 0; i < meshlet.triangleCount; ++i)
+		{
+			std::array<XMVECTOR, 3> p = { };
+
+			for (uint32_t k = 0; k < 3; ++k)
+			{
+				const uint32_t idx = clusters.vertices.at(meshlet.vertexOffset + clusters.triangles.at((meshlet.triangleOffset + i) * 3 + k));
+				p[k] = XMLoadFloat3(&vertices.at(idx).pos);
+			}
+
+			const XMVECTOR cross = XMVector3Cross(XMVectorSubtract(p[1], p[0]), XMVectorSubtract(p[2], p[0]));
+			const float triangleArea = XMVectorGetX(XMVector3Length(cross));
+
+			center = XMVectorAdd(center, XMVectorScale(XMVectorAdd(XMVectorAdd(p[0], p[1]), p[2]), triangleArea / 3.0f));
+			normal = XMVectorAdd(normal, cross);
+			area += triangleArea;
+		}
+
+		*pCenter = area > FLT_EPSILON ? XMVectorScale(center, 1.0f / area) : center;
+		*pNormal = XMVectorGetX(XMVector3Length(normal)) > FLT_EPSILON ? XMVector3Normalize(normal) : XMVectorZero();
+	}
+} // namespace anonymous
+
+namespace MeshOptimizer {
+
+std::vector<uint16_t> optimizeVertexCache(const std::vector<uint16_t>& indices, uint32_t numVertices, uint32_t cacheSize)
+{
+	ThrowIfFalse(indices.size() % 3 == 0);
+
+	const uint32_t numTriangles = static_cast<uint32_t>(indices.size() / 3);
+
+	// the triangles around each vertex
+	std::vector<uint32_t> offsets(numVertices + 1, 0);
+	std::vector<uint32_t> adjacency(indices.size());
+
+	for (uint16_t idx : indices)
+	{
+		ThrowIfFalse(idx < numVertices);
+		++offsets.at(idx + 1);
+	}
+
+	std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+	{
+		std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+
+		for (uint32_t i = 0; i < indices.size(); ++i)
+		{
+			adjacency.at(cursors.at(indices.at(i))++) = i / 3;
+		}
+	}
+
+	std::vector<uint32_t> numLiveTriangles(numVertices);
+
+	for (uint32_t v = 0; v < numVertices; ++v)
+	{
+		numLiveTriangles.at(v) = offsets.at(v + 1) - offsets.at(v);
+	}
+
+	std::vector<uint32_t> timestamps(numVertices, 0);
+	std::vector<bool> emitted(numTriangles, false);
+	std::vector<uint32_t> deadEnds; // the vertices emitted lately, to go back to when a fan ends nowhere
+	std::vector<uint16_t> optimized;
+	uint32_t time = cacheSize + 1;
+	uint32_t cursor = 0;
+
+	auto skipDeadEnd = [&]() {
+		while (!deadEnds.empty())
+		{
+			const uint32_t v = deadEnds.back();
+			deadEnds.pop_back();
+
+			if (numLiveTriangles.at(v) > 0)
+				return v;
+		}
+
+		for (; cursor < numVertices; ++cursor)
+		{
+			if (numLiveTriangles.at(cursor) > 0)
+				return cursor;
+		}
+
+		return kNone;
+	};
+
+	uint32_t fanning = skipDeadEnd();
+
+	while (fanning != kNone)
+	{
+		std::vector<uint32_t> candidates;
+
+		// all the triangles left around the vertex
+		for (uint32_t a = offsets.at(fanning); a < offsets.at(fanning + 1); ++a)
+		{
+			const uint32_t t = adjacency.at(a);
+
+			if (emitted.at(t))
+				continue;
+
+			for (uint32_t k = 0; k < 3; ++k)
+			{
+				const uint16_t v = indices.at(t * 3 + k);
+				optimized.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				--numLiveTriangles.at(v);
+
+				if (time - timestamps.at(v) > cacheSize)
+				{
+					timestamps.at(v) = time++;
+				}
+			}
+
+			emitted.at(t) = true;
+		}
+
+		// the oldest vertex which is still in the cache after its own fan
+		uint32_t next = kNone;
+		int64_t bestPriority = -1;
+
+		for (uint32_t v : candidates)
+		{
+			if (numLiveTriangles.at(v) == 0)
+				continue;
+
+			int64_t priority = 0;
+
+			if (time - timestamps.at(v) + 2 * numLiveTriangles.at(v) <= cacheSize)
+			{
+				priority = time - timestamps.at(v);
+			}
+
+			if (priority > bestPriority)
+			{
+				next = v;
+				bestPriority = priority;
+			}
+		}
+
+		fanning = next != kNone ? next : skipDeadEnd();
+	}
+
+	return optimized;
+}
+
+void optimize(Meshlet::Clusters* pClusters, const std::vector<Meshlet::Vertex>& vertices, uint32_t cacheSize)
+{
+	ThrowIfFalse(pClusters != nullptr);
+
+	Meshlet::Clusters& clusters = *pClusters;
+
+	// the triangles of each meshlet for the cache, then its vertices in the order of their first use
+	for (const auto& meshlet : clusters.meshlets)
+	{
+		const auto first = clusters.triangles.begin() + meshlet.triangleOffset * 3;
+		const std::vector<uint16_t> local(first, first + meshlet.triangleCount * 3);
+		const std::vector<uint16_t> optimized = optimizeVertexCache(local, meshlet.vertexCount, cacheSize);
+
+		std::vector<uint32_t> remap(meshlet.vertexCount, kNone);
+		std::vector<uint32_t> meshletVertices;
+
+		for (size_t i = 0; i < optimized.size(); ++i)
+		{
+			const uint16_t v = optimized.at(i);
+
+			if (remap.at(v) == kNone)
+			{
+				remap.at(v) = static_cast<uint32_t>(meshletVertices.size());
+				meshletVertices.push_back(clusters.vertices.at(meshlet.vertexOffset + v));
+			}
+
+			clusters.triangles.at(meshlet.triangleOffset * 3 + i) = static_cast<uint8_t>(remap.at(v));
+		}
+
+		std::copy(meshletVertices.begin(), meshletVertices.end(), clusters.vertices.begin() + meshlet.vertexOffset);
+	}
+
+	// the center of the model, which the meshlets on the outside face away from
+	XMVECTOR modelCenter = XMVectorZero();
+	{
+		XMVECTOR minPos = XMVectorReplicate(FLT_MAX);
+		XMVECTOR maxPos = XMVectorReplicate(-FLT_MAX);
+
+		for (uint32_t idx : clusters.vertices)
+		{
+			minPos = XMVectorMin(minPos, XMLoadFloat3(&vertices.at(idx).pos));
+			maxPos = XMVectorMax(maxPos, XMLoadFloat3(&vertices.at(idx).pos));
+		}
+
+		if (!clusters.vertices.empty())
+		{
+			modelCenter = XMVectorScale(XMVectorAdd(minPos, maxPos), 0.5f);
+		}
+	}
+
+	Meshlet::Clusters ordered = { };
+	ordered.materialOffsets = clusters.materialOffsets;
+
+	for (size_t m = 0; m + 1 < clusters.materialOffsets.size(); ++m)
+	{
+		const uint32_t begin = clusters.materialOffsets.at(m);
+		const uint32_t end = clusters.materialOffsets.at(m + 1);
+		std::vector<std::pair<float, uint32_t>> keys;
+
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			XMVECTOR center = { };
+			XMVECTOR normal = { };
+			getCenterAndNormal(clusters, clusters.meshlets.at(i), vertices, &center, &normal);
+
+			keys.push_back({ XMVectorGetX(XMVector3Dot(XMVectorSubtract(center, modelCenter), normal)), i });
+		}
+
+		// the outermost first. The stable sort keeps the order of the builder on a tie
+		std::stable_sort(keys.begin(), keys.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+		for (const auto& [key, i] : keys)
+		{
+			const Meshlet::Meshlet& meshlet = clusters.meshlets.at(i);
+			Meshlet::Meshlet moved = meshlet;
+			moved.vertexOffset = static_cast<uint32_t>(ordered.vertices.size());
+			moved.triangleOffset = static_cast<uint32_t>(ordered.triangles.size() / 3);
+
+			ordered.vertices.insert(ordered.vertices.end(), clusters.vertices.begin() + meshlet.vertexOffset, clusters.vertices.begin() + meshlet.vertexOffset + meshlet.vertexCount);
+			ordered.triangles.insert(ordered.triangles.end(), clusters.triangles.begin() + meshlet.triangleOffset * 3, clusters.triangles.begin() + (meshlet.triangleOffset + meshlet.triangleCount) * 3);
+
+			for (uint32_t t = 0; t < meshlet.triangleCount * 3; ++t)
+			{
+				ordered.indices.push_back(static_cast<uint16_t>(ordered.vertices.at(moved.vertexOffset + ordered.triangles.at(moved.triangleOffset * 3 + t))));
+			}
+
+			ordered.meshlets.push_back(moved);
+			ordered.bounds.push_back(clusters.bounds.at(i));
+		}
+	}
+
+	// the indices after the last material are kept as they were
+	ordered.indices.insert(ordered.indices.end(), clusters.indices.begin() + ordered.indices.size(), clusters.indices.end());
+
+	clusters = std::move(ordered);
+}
+
+Stats getStats(const std::vector<Meshlet::Vertex>& vertices, const std::vector<uint16_t>& indices, uint32_t cacheSize)
+{
+	Stats stats = { };
+	stats.acmr = getAcmr(indices, static_cast<uint32_t>(vertices.size()), cacheSize, &stats.atvr);
+	stats.overdraw = getOverdraw(vertices, indices);
+	return stats;
+}
+
+float getAcmr(const std::vector<uint16_t>& indices, uint32_t numVertices, uint32_t cacheSize, float* pAtvr)
+{
+	// a vertex stays in the FIFO until cacheSize others are added after it
+	std::vector<uint32_t> timestamps(numVertices, 0);
+	std::vector<bool> used(numVertices, false);
+	uint32_t time = cacheSize + 1;
+	uint32_t numMisses = 0;
+	uint32_t numUsed = 0;
+
+	for (uint16_t idx : indices)
+	{
+		if (time - timestamps.at(idx) > cacheSize)
+		{
+			timestamps.at(idx) = time++;
+			++numMisses;
+		}
+
+		numUsed += used.at(idx) ? 0 : 1;
+		used.at(idx) = true;
+	}
+
+	if (pAtvr != nullptr)
+	{
+		*pAtvr = numUsed > 0 ? static_cast<float>(numMisses) / numUsed : 0.0f;
+	}
+
+	return indices.size() >= 3 ? static_cast<float>(numMisses) / (indices.size() / 3) : 0.0f;
+}
+
+float getOverdraw(const std::vector<Meshlet::Vertex>& vertices, const std::vector<uint16_t>& indices)
+{
+	XMFLOAT3 minPos = { FLT_MAX, FLT_MAX, FLT_MAX };
+	XMFLOAT3 maxPos = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	for (uint16_t idx : indices)
+	{
+		XMStoreFloat3(&minPos, XMVectorMin(XMLoadFloat3(&minPos), XMLoadFloat3(&vertices.at(idx).pos)));
+		XMStoreFloat3(&maxPos, XMVectorMax(XMLoadFloat3(&maxPos), XMLoadFloat3(&vertices.at(idx).pos)));
+	}
+
+	const float extent = std::max({ maxPos.x - minPos.x, maxPos.y - minPos.y, maxPos.z - minPos.z });
+
+	if (indices.empty() || extent <= 0.0f)
+		return 0.0f;
+
+	const float scale = kOverdrawResolution / extent;
+	std::vector<float> depth(kOverdrawResolution * kOverdrawResolution);
+	uint64_t covered = 0;
+	uint64_t shaded = 0;
+
+	// looking down each axis from both sides
+	for (uint32_t axis = 0; axis < 3; ++axis)
+	{
+		for (float sign : { 1.0f, -1.0f })
+		{
+			std::fill(depth.begin(), depth.end(), FLT_MAX);
+
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				std::array<XMFLOAT3, 3> p = { };
+
+				for (uint32_t k = 0; k < 3; ++k)
+				{
+					const XMFLOAT3& pos = vertices.at(indices.at(i + k)).pos;
+					p[k].x = (getAxis(pos, (axis + 1) % 3) - getAxis(minPos, (axis + 1) % 3)) * scale;
+					p[k].y = (getAxis(pos, (axis + 2) % 3) - getAxis(minPos, (axis + 2) % 3)) * scale;
+					p[k].z = getAxis(pos, axis) * sign;
+				}
+
+				rasterize(p, &depth, &covered, &shaded);
+			}
+		}
+	}
+
+	return covered > 0 ? static_cast<float>(shaded) / covered : 0.0f;
+}
+
+bool selfCheck()
+{
+	// the FIFO. A triangle of new vertices costs three, and the ones evicted are missed again
+	{
+		float atvr = 0.0f;
+
+		if (getAcmr({ 0, 1, 2, 0, 2, 3 }, 4, 16, &atvr) != 2.0f || atvr != 1.0f)
+			return false;
+
+		if (getAcmr({ 0, 1, 2, 3, 4, 5, 0, 1, 2 }, 6, 3, &atvr) != 3.0f || atvr != 1.5f)
+			return false;
+	}
+
+	// a grid in rows of triangles, and then the same in an order which jumps around
+	constexpr uint32_t kGridSize = 16;
+	std::vector<Meshlet::Vertex> vertices;
+	std::vector<uint16_t> indices;
+
+	for (uint32_t y = 0; y <= kGridSize; ++y)
+	{
+		for (uint32_t x = 0; x <= kGridSize; ++x)
+		{
+			vertices.push_back({ { static_cast<float>(x), static_cast<float>(y), 0.0f }, 0, 0, 1.0f });
+		}
+	}
+
+	for (uint32_t y = 0; y < kGridSize; ++y)
+	{
+		for (uint32_t x = 0; x < kGridSize; ++x)
+		{
+			const uint16_t i0 = static_cast<uint16_t>(y * (kGridSize + 1) + x);
+			const uint16_t i1 = static_cast<uint16_t>(i0 + kGridSize + 1);
+			indices.insert(indices.end(), { i0, i1, static_cast<uint16_t>(i0 + 1), static_cast<uint16_t>(i0 + 1), i1, static_cast<uint16_t>(i1 + 1) });
+		}
+	}
+
+	std::vector<uint16_t> scrambled;
+
+	for (uint32_t t = 0, numTriangles = static_cast<uint32_t>(indices.size() / 3); t < numTriangles; ++t)
+	{
+		const uint32_t from = (t * 97) % numTriangles; // 97 is prime to the number of triangles
+		scrambled.insert(scrambled.end(), indices.begin() + from * 3, indices.begin() + from * 3 + 3);
+	}
+
+	const auto optimized = optimizeVertexCache(scrambled, static_cast<uint32_t>(vertices.size()));
+
+	// the same triangles in the same winding
+	{
+		auto sorted = [](const std::vector<uint16_t>& list) {
+			std::vector<std::array<uint16_t, 3>> triangles;
+
+			for (size_t i = 0; i < list.size(); i += 3)
+			{
+				std::array<uint16_t, 3> triangle = { list.at(i), list.at(i + 1), list.at(i + 2) };
+				std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+				triangles.push_back(triangle);
+			}
+
+			std::sort(triangles.begin(), triangles.end());
+			return triangles;
+		};
+
+		if (sorted(optimized) != sorted(indices))
+			return false;
+	}
+
+	const uint32_t numVertices = static_cast<uint32_t>(vertices.size());
+
+	if (getAcmr(optimized, numVertices, kCacheSize) >= getAcmr(scrambled, numVertices, kCacheSize) * 0.5f)
+		return false;
+
+	if (getAcmr(optimized, numVertices, kCacheSize) > 0.8f)
+		return false;
+
+	// a quad is drawn once from the front and the back, and two stacked ones twice where they overlap from one side
+	{
+		const std::vector<Meshlet::Vertex> quads = {
+			{ { 0.0f, 0.0f, 0.0f } }, { { 0.0f, 1.0f, 0.0f } }, { { 1.0f, 0.0f, 0.0f } }, { { 1.0f, 1.0f, 0.0f } },
+			{ { 0.0f, 0.0f, 1.0f } }, { { 0.0f, 1.0f, 1.0f } }, { { 1.0f, 0.0f, 1.0f } }, { { 1.0f, 1.0f, 1.0f } },
+		};
+
+		if (getOverdraw(quads, { 0, 1, 2, 2, 1, 3 }) != 1.0f)
+			return false;
+
+		if (std::abs(getOverdraw(quads, { 0, 1, 2, 2, 1, 3, 4, 5, 6, 6, 5, 7 }) - 1.5f) > 0.01f)
+			return false;
+	}
+
+	// a box in a box. The outer one is drawn first, and hides the inner one from every side
+	{
+		std::vector<Meshlet::Vertex> boxes;
+		std::vector<uint16_t> boxIndices;
+		constexpr uint16_t kBox[] = { 0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5 };
+
+		for (float size : { 1.0f, 2.0f })
+		{
+			const uint16_t first = static_cast<uint16_t>(boxes.size());
+
+			for (uint32_t i = 0; i < 8; ++i)
+			{
+				boxes.push_back({ { (i & 1) ? size : -size, (i & 2) ? size : -size, (i & 4) ? size : -size } });
+			}
+
+			for (uint16_t idx : kBox)
+			{
+				boxIndices.push_back(static_cast<uint16_t>(first + idx));
+			}
+		}
+
+		const std::vector<uint32_t> indexCounts = { static_cast<uint32_t>(boxIndices.size()) };
+		Meshlet::Clusters clusters = Meshlet::build(boxes, boxIndices, indexCounts, 4, 2);
+		const float before = getOverdraw(boxes, clusters.indices);
+
+		optimize(&clusters, boxes);
+
+		if (!Meshlet::validate(clusters, boxes, boxIndices, indexCounts, 4, 2))
+			return false;
+
+		if (clusters.vertices.at(clusters.meshlets.front().vertexOffset) < 8 || getOverdraw(boxes, clusters.indices) >= before)
+			return false;
+	}
+
+	return true;
+}
+
+} // namespace MeshOptimizer
@@ -0,0 +1,35 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+#pragma warning(pop)
+#include "meshlet.h"
+
+// Reorders the triangles of the meshlets for the post-transform vertex cache (Tipsify, Sander et al. 2007),
+// and the meshlets of each material so that the ones on the outside, which hide the others, are drawn first.
+// The materials keep their ranges and their order, so the blending is not changed.
+namespace MeshOptimizer {
+
+constexpr uint32_t kCacheSize = 16; // the FIFO the statistics assume, and Tipsify is tuned for
+
+struct Stats
+{
+	float acmr = 0.0f; // vertex shader invocations per triangle. 0.5 at best, 3 at worst
+	float atvr = 0.0f; // per vertex. 1 at best
+	float overdraw = 0.0f; // pixels shaded per pixel covered, from six axis views with early depth test
+};
+
+// the new order of the triangles. The winding of each one is kept
+std::vector<uint16_t> optimizeVertexCache(const std::vector<uint16_t>& indices, uint32_t numVertices, uint32_t cacheSize = kCacheSize);
+void optimize(Meshlet::Clusters* pClusters, const std::vector<Meshlet::Vertex>& vertices, uint32_t cacheSize = kCacheSize);
+
+Stats getStats(const std::vector<Meshlet::Vertex>& vertices, const std::vector<uint16_t>& indices, uint32_t cacheSize = kCacheSize);
+float getAcmr(const std::vector<uint16_t>& indices, uint32_t numVertices, uint32_t cacheSize, float* pAtvr = nullptr);
+float getOverdraw(const std::vector<Meshlet::Vertex>& vertices, const std::vector<uint16_t>& indices);
+
+bool selfCheck();
+
+} // namespace MeshOptimizer
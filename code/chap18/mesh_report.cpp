@@ -0,0 +1,239 @@
+#include "mesh_report.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#pragma warning(pop)
+#include "config.h"
+#include "debug.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "meshlet.h"
+#include "model_cache.h"
+
+namespace {
+	const std::string kModelDir = "../resource/Model"; // the models PmdActor loads, the same files as chap12/Model
+	constexpr size_t kPmdHeaderSize = 3 + 4 + 20 + 256; // the signature, the version, the name and the comment
+	constexpr size_t kPmdVertexSize = 38;
+	constexpr size_t kPmdMaterialSize = 70;
+	constexpr size_t kPmdMaterialIndicesNumOffset = 46;
+
+	// only the vertices, the indices and the materials, which come first in the file
+	bool readGeometry(const std::string& path, std::vector<Meshlet::Vertex>* pVertices, std::vector<uint16_t>* pIndices, std::vector<uint32_t>* pIndexCounts)
+	{
+		FILE* fp = nullptr;
+		if (fopen_s(&fp, path.c_str(), "rb") != 0)
+			return false;
+
+		bool bRead = fseek(fp, kPmdHeaderSize, SEEK_SET) == 0;
+
+		uint32_t numVertices = 0;
+		bRead = bRead && fread(&numVertices, sizeof(numVertices), 1, fp) == 1;
+
+		for (uint32_t i = 0; bRead && i < numVertices; ++i)
+		{
+			uint8_t bytes[kPmdVertexSize] = { };
+			bRead = fread(bytes, sizeof(bytes), 1, fp) == 1;
+
+			// the position, the normal, the uv, two bones and the weight of the first in percent
+			Meshlet::Vertex v = { };
+			uint16_t bones[2] = { };
+			std::memcpy(&v.pos, bytes, sizeof(v.pos));
+			std::memcpy(bones, bytes + 32, sizeof(bones));
+			v.bone0 = bones[0];
+			v.bone1 = bones[1];
+			v.weight = bytes[36] / 100.0f;
+
+			pVertices->push_back(v);
+		}
+
+		uint32_t numIndices = 0;
+		bRead = bRead && fread(&numIndices, sizeof(numIndices), 1, fp) == 1;
+
+		pIndices->resize(numIndices);
+		bRead = bRead && (numIndices == 0 || fread(pIndices->data(), sizeof(uint16_t) * numIndices, 1, fp) == 1);
+
+		uint32_t numMaterials = 0;
+		bRead = bRead && fread(&numMaterials, sizeof(numMaterials), 1, fp) == 1;
+
+		for (uint32_t i = 0; bRead && i < numMaterials; ++i)
+		{
+			uint8_t bytes[kPmdMaterialSize] = { };
+			bRead = fread(bytes, sizeof(bytes), 1, fp) == 1;
+
+			uint32_t count = 0;
+			std::memcpy(&count, bytes + kPmdMaterialIndicesNumOffset, sizeof(count));
+			pIndexCounts->push_back(count);
+		}
+
+		ThrowIfFalse(fclose(fp) == 0);
+
+		return bRead;
+	}
+
+	float getRadius(const std::vector<Meshlet::Vertex>& vertices)
+	{
+		DirectX::XMFLOAT3 minPos = { FLT_MAX, FLT_MAX, FLT_MAX };
+		DirectX::XMFLOAT3 maxPos = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		for (const auto& v : vertices)
+		{
+			minPos = { std::min(minPos.x, v.pos.x), std::min(minPos.y, v.pos.y), std::min(minPos.z, v.pos.z) };
+			maxPos = { std::max(maxPos.x, v.pos.x), std::max(maxPos.y, v.pos.y), std::max(maxPos.z, v.pos.z) };
+		}
+
+		const float dx = maxPos.x - minPos.x;
+		const float dy = maxPos.y - minPos.y;
+		const float dz = maxPos.z - minPos.z;
+
+		return vertices.empty() ? 0.0f : std::sqrt(dx * dx + dy * dy + dz * dz) * 0.5f;
+	}
+
+	template <typename T>
+	bool isSameBytes(const std::vector<T>& a, const std::vector<T>& b)
+	{
+		return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), sizeof(T) * a.size()) == 0);
+	}
+
+	bool isSame(const Meshlet::Clusters& a, const Meshlet::Clusters& b)
+	{
+		return isSameBytes(a.meshlets, b.meshlets)
+			&& isSameBytes(a.bounds, b.bounds)
+			&& isSameBytes(a.vertices, b.vertices)
+			&& isSameBytes(a.triangles, b.triangles)
+			&& isSameBytes(a.materialOffsets, b.materialOffsets)
+			&& isSameBytes(a.indices, b.indices);
+	}
+} // namespace anonymous
+
+namespace MeshReport {
+
+int run(const std::vector<std::string>& pmdPaths)
+{
+	if (pmdPaths.empty())
+	{
+		printf("usage: --mesh-report <pmd files>\n");
+		return 1;
+	}
+
+	ModelCache modelCache;
+	ThrowIfFailed(modelCache.init(Config::kModelCacheDir));
+
+	printf("FIFO of %u vertices, overdraw from 6 axis views\n", MeshOptimizer::kCacheSize);
+	printf("%-32s %8s %8s | %-20s | %-20s | %-20s\n", "model", "tris", "meshlets", "ACMR auth/mlet/opt", "ATVR auth/mlet/opt", "overdraw auth/mlet/opt");
+
+	int exitCode = 0;
+
+	for (const auto& path : pmdPaths)
+	{
+		std::vector<Meshlet::Vertex> vertices;
+		std::vector<uint16_t> indices;
+		std::vector<uint32_t> indexCounts;
+
+		if (!readGeometry(path, &vertices, &indices, &indexCounts))
+		{
+			printf("%s: failed to read\n", path.c_str());
+			exitCode = 1;
+			continue;
+		}
+
+		const Meshlet::Clusters meshlets = Meshlet::build(vertices, indices, indexCounts);
+		const ModelCache::Model model = modelCache.load(vertices, indices, indexCounts);
+		const Meshlet::Clusters& optimized = model.clusters;
+
+		if (!Meshlet::validate(meshlets, vertices, indices, indexCounts) || !Meshlet::validate(optimized, vertices, indices, indexCounts))
+		{
+			printf("%s: invalid meshlets\n", path.c_str());
+			exitCode = 1;
+			continue;
+		}
+
+		const MeshOptimizer::Stats authoredStats = MeshOptimizer::getStats(vertices, indices);
+		const MeshOptimizer::Stats meshletStats = MeshOptimizer::getStats(vertices, meshlets.indices);
+		const MeshOptimizer::Stats optimizedStats = MeshOptimizer::getStats(vertices, optimized.indices);
+
+		printf("%-32s %8zd %8zd | %6.3f %6.3f %6.3f | %6.3f %6.3f %6.3f | %6.3f %6.3f %6.3f\n",
+			path.c_str(),
+			indices.size() / 3,
+			optimized.meshlets.size(),
+			authoredStats.acmr, meshletStats.acmr, optimizedStats.acmr,
+			authoredStats.atvr, meshletStats.atvr, optimizedStats.atvr,
+			authoredStats.overdraw, meshletStats.overdraw, optimizedStats.overdraw);
+
+		// the error is from the vertices of the full mesh to the triangles of the level
+		const float radius = getRadius(vertices);
+
+		for (size_t i = 0; i < model.lods.size(); ++i)
+		{
+			const MeshSimplifier::Lod& lod = model.lods.at(i);
+
+			printf("  lod%zd %8zd tris %5.1f%% | error %.4f, %.3f%% of the radius %.2f\n",
+				i + 1,
+				lod.indices.size() / 3,
+				100.0f * lod.indices.size() / std::max<size_t>(indices.size(), 1),
+				lod.error,
+				radius > 0.0f ? 100.0f * lod.error / radius : 0.0f,
+				radius);
+		}
+	}
+
+	modelCache.release();
+
+	return exitCode;
+}
+
+bool selfCheck()
+{
+	std::error_code ec;
+	uint32_t numModels = 0;
+
+	for (const auto& entry : std::filesystem::directory_iterator(kModelDir, ec))
+	{
+		if (entry.path().extension() != ".pmd")
+			continue;
+
+		const std::string path = entry.path().string();
+		std::vector<Meshlet::Vertex> vertices;
+		std::vector<uint16_t> indices;
+		std::vector<uint32_t> indexCounts;
+
+		if (!readGeometry(path, &vertices, &indices, &indexCounts))
+		{
+			printf("%s: failed to read\n", path.c_str());
+			return false;
+		}
+
+		const Meshlet::Clusters meshlets = Meshlet::build(vertices, indices, indexCounts);
+
+		if (!Meshlet::validate(meshlets, vertices, indices, indexCounts))
+		{
+			printf("%s: invalid meshlets\n", path.c_str());
+			return false;
+		}
+
+		if (!isSame(meshlets, Meshlet::build(vertices, indices, indexCounts)))
+		{
+			printf("%s: the meshlets differ between two builds\n", path.c_str());
+			return false;
+		}
+
+		++numModels;
+	}
+
+	// run from the directory of the project
+	if (ec || numModels == 0)
+	{
+		printf("no models in %s\n", kModelDir.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+} // namespace MeshReport
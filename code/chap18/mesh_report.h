@@ -0,0 +1,19 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <string>
+#include <vector>
+#pragma warning(pop)
+
+// A headless run over PMD files, which needs no window nor device: chap18.exe --mesh-report <pmd files>.
+// Prints the vertex cache (ACMR, ATVR) and the overdraw of the index buffers as authored, in the meshlet order,
+// and optimized, the triangles and the geometric error of the levels of detail, and writes them all to the model cache.
+namespace MeshReport {
+
+// returns the exit code of the process
+int run(const std::vector<std::string>& pmdPaths);
+// the meshlets of the bundled models, built twice. Valid, and the same both times
+bool selfCheck();
+
+} // namespace MeshReport
@@ -0,0 +1,838 @@
+#include "mesh_simplifier.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <tuple>
+#include <unordered_map>
+#pragma warning(pop)
+#include "debug.h"
+#include "mesh_optimizer.h"
+
+using namespace DirectX;
+
+namespace {
+	constexpr uint32_t kNone = UINT32_MAX;
+	constexpr float kWeightEpsilon = 1.0e-4f;
+
+	// the squared distance to the planes of the triangles, weighted by their areas. xx, xy, xz, xw, yy, yz, yw, zz, zw, ww
+	struct Quadric
+	{
+		std::array<double, 10> a = { };
+		double weight = 0.0;
+	};
+
+	struct Collapse
+	{
+		uint32_t from = 0;
+		uint32_t to = 0;
+		double cost = 0.0;
+	};
+
+	std::array<double, 3> sub(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return { static_cast<double>(a.x) - b.x, static_cast<double>(a.y) - b.y, static_cast<double>(a.z) - b.z };
+	}
+
+	std::array<double, 3> cross(const std::array<double, 3>& a, const std::array<double, 3>& b)
+	{
+		return { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+	}
+
+	double dot(const std::array<double, 3>& a, const std::array<double, 3>& b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	std::array<double, 3> getNormal(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2)
+	{
+		return cross(sub(p1, p0), sub(p2, p0));
+	}
+
+	Quadric makeQuadric(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2)
+	{
+		std::array<double, 3> n = getNormal(p0, p1, p2);
+		const double length = std::sqrt(dot(n, n));
+
+		if (length <= DBL_EPSILON)
+			return Quadric();
+
+		n = { n[0] / length, n[1] / length, n[2] / length };
+
+		const double d = -(n[0] * p0.x + n[1] * p0.y + n[2] * p0.z);
+		const double area = length * 0.5;
+
+		Quadric q = { };
+		{
+			q.a = { n[0] * n[0], n[0] * n[1], n[0] * n[2], n[0] * d, n[1] * n[1], n[1] * n[2], n[1] * d, n[2] * n[2], n[2] * d, d * d };
+			std::transform(q.a.begin(), q.a.end(), q.a.begin(), [area](double x) { return x * area; });
+			q.weight = area;
+		}
+		return q;
+	}
+
+	void add(Quadric* pDst, const Quadric& src)
+	{
+		std::transform(pDst->a.begin(), pDst->a.end(), src.a.begin(), pDst->a.begin(), std::plus<double>());
+		pDst->weight += src.weight;
+	}
+
+	// the mean squared distance
+	double evaluate(const Quadric& q, const Quadric& r, const XMFLOAT3& pos)
+	{
+		const double x = pos.x;
+		const double y = pos.y;
+		const double z = pos.z;
+		const auto& a = q.a;
+		const auto& b = r.a;
+
+		const double e = (a[0] + b[0]) * x * x + 2.0 * (a[1] + b[1]) * x * y + 2.0 * (a[2] + b[2]) * x * z + 2.0 * (a[3] + b[3]) * x
+			+ (a[4] + b[4]) * y * y + 2.0 * (a[5] + b[5]) * y * z + 2.0 * (a[6] + b[6]) * y
+			+ (a[7] + b[7]) * z * z + 2.0 * (a[8] + b[8]) * z
+			+ (a[9] + b[9]);
+
+		return std::max(0.0, e) / std::max(q.weight + r.weight, DBL_EPSILON);
+	}
+
+	// a weight of 1 and two same bones are one bone, and the bones in either order are the same pair
+	bool isSameSkin(const Meshlet::Vertex& a, const Meshlet::Vertex& b)
+	{
+		auto normalize = [](const Meshlet::Vertex& v) {
+			if (v.bone0 == v.bone1 || v.weight >= 1.0f - kWeightEpsilon)
+				return std::make_tuple(v.bone0, v.bone0, 1.0f);
+
+			if (v.weight <= kWeightEpsilon)
+				return std::make_tuple(v.bone1, v.bone1, 1.0f);
+
+			return v.bone0 < v.bone1 ? std::make_tuple(v.bone0, v.bone1, v.weight) : std::make_tuple(v.bone1, v.bone0, 1.0f - v.weight);
+		};
+
+		const auto [a0, a1, aw] = normalize(a);
+		const auto [b0, b1, bw] = normalize(b);
+
+		return a0 == b0 && a1 == b1 && std::abs(aw - bw) <= kWeightEpsilon;
+	}
+
+	float getDistance(const XMFLOAT3& p, const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c)
+	{
+		// the closest point on the triangle (Ericson 2004, 5.1.5)
+		const auto ab = sub(b, a);
+		const auto ac = sub(c, a);
+		const auto ap = sub(p, a);
+
+		auto distanceTo = [&p](const std::array<double, 3>& q) {
+			const std::array<double, 3> d = { p.x - q[0], p.y - q[1], p.z - q[2] };
+			return static_cast<float>(std::sqrt(dot(d, d)));
+		};
+		auto at = [&a, &ab, &ac](double v, double w) {
+			return std::array<double, 3>{ a.x + ab[0] * v + ac[0] * w, a.y + ab[1] * v + ac[1] * w, a.z + ab[2] * v + ac[2] * w };
+		};
+
+		const double d1 = dot(ab, ap);
+		const double d2 = dot(ac, ap);
+
+		if (d1 <= 0.0 && d2 <= 0.0)
+			return distanceTo(at(0.0, 0.0));
+
+		const auto bp = sub(p, b);
+		const double d3 = dot(ab, bp);
+		const double d4 = dot(ac, bp);
+
+		if (d3 >= 0.0 && d4 <= d3)
+			return distanceTo(at(1.0, 0.0));
+
+		const double vc = d1 * d4 - d3 * d2;
+
+		if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+			return distanceTo(at(d1 / (d1 - d3), 0.0));
+
+		const auto cp = sub(p, c);
+		const double d5 = dot(ab, cp);
+		const double d6 = dot(ac, cp);
+
+		if (d6 >= 0.0 && d5 <= d6)
+			return distanceTo(at(0.0, 1.0));
+
+		const double vb = d5 * d2 - d1 * d6;
+
+		if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+			return distanceTo(at(0.0, d2 / (d2 - d6)));
+
+		const double va = d3 * d6 - d5 * d4;
+
+		if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+		{
+			const double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			return distanceTo(at(1.0 - w, w));
+		}
+
+		const double denom = va + vb + vc;
+
+		if (std::abs(denom) <= DBL_EPSILON)
+			return distanceTo(at(0.0, 0.0));
+
+		return distanceTo(at(vb / denom, vc / denom));
+	}
+
+	// the triangles in the cells their boxes overlap, searched ring by ring around a point
+	class TriangleGrid
+	{
+	public:
+		TriangleGrid(const std::vector<Meshlet::Vertex>& vertices, std::vector<uint16_t>::const_iterator first, std::vector<uint16_t>::const_iterator last)
+			: m_vertices(vertices), m_first(first)
+		{
+			const size_t numTriangles = static_cast<size_t>(last - first) / 3;
+
+			for (auto it = first; it != last; ++it)
+			{
+				const XMFLOAT3& pos = vertices.at(*it).pos;
+				m_minPos = { std::min(m_minPos.x, pos.x), std::min(m_minPos.y, pos.y), std::min(m_minPos.z, pos.z) };
+				m_maxPos = { std::max(m_maxPos.x, pos.x), std::max(m_maxPos.y, pos.y), std::max(m_maxPos.z, pos.z) };
+			}
+
+			if (numTriangles == 0)
+				return;
+
+			const float extent = std::max({ m_maxPos.x - m_minPos.x, m_maxPos.y - m_minPos.y, m_maxPos.z - m_minPos.z });
+			m_cellSize = std::max(extent / kMaxCells, FLT_EPSILON);
+
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				m_numCells.at(axis) = std::min(kMaxCells, static_cast<int32_t>((getAxis(m_maxPos, axis) - getAxis(m_minPos, axis)) / m_cellSize) + 1);
+			}
+
+			m_cells.resize(static_cast<size_t>(m_numCells.at(0)) * m_numCells.at(1) * m_numCells.at(2));
+			m_stamps.assign(numTriangles, 0);
+
+			for (uint32_t i = 0; i < numTriangles; ++i)
+			{
+				std::array<int32_t, 3> minCell = { INT32_MAX, INT32_MAX, INT32_MAX };
+				std::array<int32_t, 3> maxCell = { INT32_MIN, INT32_MIN, INT32_MIN };
+
+				for (uint32_t k = 0; k < 3; ++k)
+				{
+					const auto cell = getCell(vertices.at(*(first + i * 3 + k)).pos);
+
+					for (uint32_t axis = 0; axis < 3; ++axis)
+					{
+						minCell.at(axis) = std::min(minCell.at(axis), cell.at(axis));
+						maxCell.at(axis) = std::max(maxCell.at(axis), cell.at(axis));
+					}
+				}
+
+				for (int32_t z = minCell[2]; z <= maxCell[2]; ++z)
+					for (int32_t y = minCell[1]; y <= maxCell[1]; ++y)
+						for (int32_t x = minCell[0]; x <= maxCell[0]; ++x)
+							m_cells.at(getCellIndex(x, y, z)).push_back(i);
+			}
+		}
+
+		// FLT_MAX if there is no triangle. A point out of the grid is searched from the nearest cell,
+		// which is no nearer to the cells of a ring than the point
+		float getDistance(const XMFLOAT3& pos)
+		{
+			if (m_cells.empty())
+				return FLT_MAX;
+
+			const auto center = getCell(pos);
+			const int32_t maxRing = *std::max_element(m_numCells.begin(), m_numCells.end());
+			float distance = FLT_MAX;
+
+			++m_stamp;
+
+			for (int32_t ring = 0; ring <= maxRing && distance > (ring - 1) * m_cellSize; ++ring)
+			{
+				for (int32_t z = center[2] - ring; z <= center[2] + ring; ++z)
+				{
+					for (int32_t y = center[1] - ring; y <= center[1] + ring; ++y)
+					{
+						for (int32_t x = center[0] - ring; x <= center[0] + ring; ++x)
+						{
+							const bool bOnRing = std::max({ std::abs(x - center[0]), std::abs(y - center[1]), std::abs(z - center[2]) }) == ring;
+
+							if (!bOnRing || x < 0 || y < 0 || z < 0 || x >= m_numCells[0] || y >= m_numCells[1] || z >= m_numCells[2])
+								continue;
+
+							for (uint32_t i : m_cells.at(getCellIndex(x, y, z)))
+							{
+								if (m_stamps.at(i) == m_stamp)
+									continue;
+
+								m_stamps.at(i) = m_stamp;
+
+								const auto it = m_first + i * 3;
+								distance = std::min(distance, ::getDistance(pos, m_vertices.at(*it).pos, m_vertices.at(*(it + 1)).pos, m_vertices.at(*(it + 2)).pos));
+							}
+						}
+					}
+				}
+			}
+
+			return distance;
+		}
+
+	private:
+		static constexpr int32_t kMaxCells = 32; // along the longest axis
+
+		static float getAxis(const XMFLOAT3& pos, uint32_t axis)
+		{
+			return axis == 0 ? pos.x : (axis == 1 ? pos.y : pos.z);
+		}
+
+		std::array<int32_t, 3> getCell(const XMFLOAT3& pos) const
+		{
+			std::array<int32_t, 3> cell = { };
+
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				const float offset = (getAxis(pos, axis) - getAxis(m_minPos, axis)) / m_cellSize;
+				cell.at(axis) = std::clamp(static_cast<int32_t>(std::floor(offset)), 0, m_numCells.at(axis) - 1);
+			}
+
+			return cell;
+		}
+
+		size_t getCellIndex(int32_t x, int32_t y, int32_t z) const
+		{
+			return (static_cast<size_t>(z) * m_numCells[1] + y) * m_numCells[0] + x;
+		}
+
+		const std::vector<Meshlet::Vertex>& m_vertices;
+		std::vector<uint16_t>::const_iterator m_first;
+		XMFLOAT3 m_minPos = { FLT_MAX, FLT_MAX, FLT_MAX };
+		XMFLOAT3 m_maxPos = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		float m_cellSize = 1.0f;
+		std::array<int32_t, 3> m_numCells = { 1, 1, 1 };
+		std::vector<std::vector<uint32_t>> m_cells;
+		std::vector<uint32_t> m_stamps; // per triangle, so that one in some cells is tested once a search
+		uint32_t m_stamp = 0;
+	};
+
+	float getRadius(const std::vector<Meshlet::Vertex>& vertices)
+	{
+		if (vertices.empty())
+			return 0.0f;
+
+		XMFLOAT3 minPos = { FLT_MAX, FLT_MAX, FLT_MAX };
+		XMFLOAT3 maxPos = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		for (const auto& v : vertices)
+		{
+			minPos = { std::min(minPos.x, v.pos.x), std::min(minPos.y, v.pos.y), std::min(minPos.z, v.pos.z) };
+			maxPos = { std::max(maxPos.x, v.pos.x), std::max(maxPos.y, v.pos.y), std::max(maxPos.z, v.pos.z) };
+		}
+
+		const auto diagonal = sub(maxPos, minPos);
+
+		return static_cast<float>(std::sqrt(dot(diagonal, diagonal)) * 0.5);
+	}
+} // namespace anonymous
+
+namespace MeshSimplifier {
+
+std::vector<uint16_t> simplify(const std::vector<Meshlet::Vertex>& vertices, const std::vector<uint16_t>& indices, const std::vector<uint32_t>& indexCounts,
+	size_t targetIndexCount, float maxError, std::vector<uint32_t>* pIndexCounts, float* pError)
+{
+	ThrowIfFalse(pIndexCounts != nullptr);
+	ThrowIfFalse(pError != nullptr);
+
+	const size_t numVertices = vertices.size();
+
+	// the degenerate triangles draw nothing, and are dropped
+	std::vector<std::array<uint32_t, 3>> triangles;
+	std::vector<uint32_t> triangleMaterials;
+	{
+		size_t indexOffset = 0;
+
+		for (uint32_t i = 0; i < indexCounts.size(); ++i)
+		{
+			ThrowIfFalse(indexOffset + indexCounts.at(i) <= indices.size());
+
+			for (size_t j = indexOffset; j + 3 <= indexOffset + indexCounts.at(i); j += 3)
+			{
+				const std::array<uint32_t, 3> triangle = { indices.at(j), indices.at(j + 1), indices.at(j + 2) };
+				ThrowIfFalse(triangle[0] < numVertices && triangle[1] < numVertices && triangle[2] < numVertices);
+
+				if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0])
+					continue;
+
+				triangles.push_back(triangle);
+				triangleMaterials.push_back(i);
+			}
+
+			indexOffset += indexCounts.at(i);
+		}
+	}
+
+	// the vertices of two materials, and the ones on an edge which is not between two triangles
+	std::vector<bool> locked(numVertices, false);
+	{
+		std::vector<uint32_t> vertexMaterials(numVertices, kNone);
+		std::unordered_map<uint64_t, uint32_t> edgeCounts;
+
+		for (size_t i = 0; i < triangles.size(); ++i)
+		{
+			for (uint32_t k = 0; k < 3; ++k)
+			{
+				const uint32_t a = triangles.at(i)[k];
+				const uint32_t b = triangles.at(i)[(k + 1) % 3];
+
+				if (vertexMaterials.at(a) != kNone && vertexMaterials.at(a) != triangleMaterials.at(i))
+				{
+					locked.at(a) = true;
+				}
+
+				vertexMaterials.at(a) = triangleMaterials.at(i);
+				++edgeCounts[(static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b)];
+			}
+		}
+
+		for (const auto& [edge, count] : edgeCounts)
+		{
+			if (count == 2)
+				continue;
+
+			locked.at(static_cast<uint32_t>(edge >> 32)) = true;
+			locked.at(static_cast<uint32_t>(edge)) = true;
+		}
+	}
+
+	std::vector<Quadric> quadrics(numVertices);
+	std::vector<std::vector<uint32_t>> vertexTriangles(numVertices);
+	std::vector<bool> alive(triangles.size(), true);
+
+	for (uint32_t i = 0; i < triangles.size(); ++i)
+	{
+		const auto& t = triangles.at(i);
+		const Quadric q = makeQuadric(vertices.at(t[0]).pos, vertices.at(t[1]).pos, vertices.at(t[2]).pos);
+
+		for (uint32_t v : t)
+		{
+			add(&quadrics.at(v), q);
+			vertexTriangles.at(v).push_back(i);
+		}
+	}
+
+	auto getNeighbors = [&](uint32_t v) {
+		std::vector<uint32_t> neighbors;
+
+		for (uint32_t t : vertexTriangles.at(v))
+		{
+			if (!alive.at(t))
+				continue;
+
+			for (uint32_t w : triangles.at(t))
+			{
+				if (w != v)
+				{
+					neighbors.push_back(w);
+				}
+			}
+		}
+
+		std::sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+
+		return neighbors;
+	};
+
+	// the two triangles of the edge are the only ones the vertices share, and no other triangle turns over
+	auto canCollapse = [&](uint32_t from, uint32_t to) {
+		const auto fromNeighbors = getNeighbors(from);
+		const auto toNeighbors = getNeighbors(to);
+		std::vector<uint32_t> common;
+		std::set_intersection(fromNeighbors.begin(), fromNeighbors.end(), toNeighbors.begin(), toNeighbors.end(), std::back_inserter(common));
+
+		if (common.size() != 2)
+			return false;
+
+		for (uint32_t t : vertexTriangles.at(from))
+		{
+			const auto& triangle = triangles.at(t);
+
+			if (!alive.at(t) || std::find(triangle.begin(), triangle.end(), to) != triangle.end())
+				continue;
+
+			std::array<XMFLOAT3, 3> p = { vertices.at(triangle[0]).pos, vertices.at(triangle[1]).pos, vertices.at(triangle[2]).pos };
+			const auto before = getNormal(p[0], p[1], p[2]);
+
+			for (uint32_t k = 0; k < 3; ++k)
+			{
+				if (triangle[k] == from)
+				{
+					p[k] = vertices.at(to).pos;
+				}
+			}
+
+			if (dot(before, getNormal(p[0], p[1], p[2])) <= 0.0)
+				return false;
+		}
+
+		return true;
+	};
+
+	const double maxCost = static_cast<double>(maxError) * maxError;
+	size_t numTriangles = triangles.size();
+	double largestCost = 0.0;
+
+	// in passes. A vertex next to a collapse waits for the next pass, so that the costs and the checks of a pass stay true
+	while (numTriangles * 3 > targetIndexCount)
+	{
+		std::vector<Collapse> collapses;
+
+		for (uint32_t i = 0; i < triangles.size(); ++i)
+		{
+			if (!alive.at(i))
+				continue;
+
+			for (uint32_t k = 0; k < 3; ++k)
+			{
+				const uint32_t a = triangles.at(i)[k];
+				const uint32_t b = triangles.at(i)[(k + 1) % 3];
+
+				if (!isSameSkin(vertices.at(a), vertices.at(b)))
+					continue;
+
+				Collapse best = { kNone, kNone, DBL_MAX };
+
+				for (const auto& [from, to] : { std::make_pair(a, b), std::make_pair(b, a) })
+				{
+					if (locked.at(from))
+						continue;
+
+					const double cost = evaluate(quadrics.at(from), quadrics.at(to), vertices.at(to).pos);
+
+					if (cost < best.cost)
+					{
+						best = { from, to, cost };
+					}
+				}
+
+				if (best.from != kNone && best.cost <= maxCost)
+				{
+					collapses.push_back(best);
+				}
+			}
+		}
+
+		// the ties by the vertices, so that the same input always gives the same levels
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+			return std::tie(a.cost, a.from, a.to) < std::tie(b.cost, b.from, b.to);
+		});
+
+		std::vector<bool> touched(numVertices, false);
+		size_t numCollapses = 0;
+
+		for (const auto& collapse : collapses)
+		{
+			if (numTriangles * 3 <= targetIndexCount)
+				break;
+
+			if (touched.at(collapse.from) || touched.at(collapse.to) || !canCollapse(collapse.from, collapse.to))
+				continue;
+
+			for (uint32_t t : vertexTriangles.at(collapse.from))
+			{
+				if (!alive.at(t))
+					continue;
+
+				auto& triangle = triangles.at(t);
+
+				for (uint32_t v : triangle)
+				{
+					touched.at(v) = true;
+				}
+
+				if (std::find(triangle.begin(), triangle.end(), collapse.to) != triangle.end())
+				{
+					alive.at(t) = false;
+					--numTriangles;
+					continue;
+				}
+
+				std::replace(triangle.begin(), triangle.end(), collapse.from, collapse.to);
+				vertexTriangles.at(collapse.to).push_back(t);
+			}
+
+			vertexTriangles.at(collapse.from).clear();
+			add(&quadrics.at(collapse.to), quadrics.at(collapse.from));
+			largestCost = std::max(largestCost, collapse.cost);
+			++numCollapses;
+		}
+
+		if (numCollapses == 0)
+			break;
+	}
+
+	// the triangles left, in the order they were in
+	std::vector<uint16_t> simplified;
+	pIndexCounts->assign(indexCounts.size(), 0);
+
+	for (size_t i = 0; i < triangles.size(); ++i)
+	{
+		if (!alive.at(i))
+			continue;
+
+		for (uint32_t v : triangles.at(i))
+		{
+			simplified.push_back(static_cast<uint16_t>(v));
+		}
+
+		pIndexCounts->at(triangleMaterials.at(i)) += 3;
+	}
+
+	*pError = static_cast<float>(std::sqrt(largestCost));
+
+	return simplified;
+}
+
+std::vector<Lod> buildLods(const std::vector<Meshlet::Vertex>& vertices, const std::vector<uint16_t>& indices, const std::vector<uint32_t>& indexCounts)
+{
+	const float radius = getRadius(vertices);
+	const uint32_t numVertices = static_cast<uint32_t>(vertices.size());
+
+	std::vector<Lod> lods;
+	const std::vector<uint16_t>* pIndices = &indices;
+	const std::vector<uint32_t>* pIndexCounts = &indexCounts;
+
+	for (uint32_t i = 0; i < kNumLods; ++i)
+	{
+		const size_t targetIndexCount = static_cast<size_t>(pIndices->size() / 3 * kTriangleRatio) * 3;
+		const float maxError = radius * kMaxRelativeError * static_cast<float>(1u << i);
+
+		std::vector<uint32_t> simplifiedCounts;
+		float quadricError = 0.0f;
+		const auto simplified = simplify(vertices, *pIndices, *pIndexCounts, targetIndexCount, maxError, &simplifiedCounts, &quadricError);
+
+		if (pIndices->empty() || simplified.size() * 10 > pIndices->size() * 9)
+			break;
+
+		Lod lod = { };
+		lod.indexCounts = simplifiedCounts;
+
+		// the triangles of each material reordered in its range
+		size_t indexOffset = 0;
+
+		for (uint32_t count : simplifiedCounts)
+		{
+			const std::vector<uint16_t> range(simplified.begin() + indexOffset, simplified.begin() + indexOffset + count);
+			const auto optimized = MeshOptimizer::optimizeVertexCache(range, numVertices);
+			lod.indices.insert(lod.indices.end(), optimized.begin(), optimized.end());
+
+			indexOffset += count;
+		}
+
+		// from the full mesh, and never less than the level above, so that a farther level is not chosen for a nearer actor
+		lod.error = measureError(vertices, indices, indexCounts, lod);
+
+		if (!lods.empty())
+		{
+			lod.error = std::max(lod.error, lods.back().error);
+		}
+
+		lods.push_back(std::move(lod));
+		pIndices = &lods.back().indices;
+		pIndexCounts = &lods.back().indexCounts;
+	}
+
+	return lods;
+}
+
+float measureError(const std::vector<Meshlet::Vertex>& vertices, const std::vector<uint16_t>& indices, const std::vector<uint32_t>& indexCounts, const Lod& lod)
+{
+	ThrowIfFalse(lod.indexCounts.size() == indexCounts.size());
+
+	float error = 0.0f;
+	size_t indexOffset = 0;
+	size_t lodIndexOffset = 0;
+	std::vector<bool> measured(vertices.size(), false);
+
+	for (size_t i = 0; i < indexCounts.size(); ++i)
+	{
+		const auto first = lod.indices.begin() + lodIndexOffset;
+		const auto last = first + lod.indexCounts.at(i);
+
+		// a vertex left is on the surface
+		for (auto it = first; it != last; ++it)
+		{
+			measured.at(*it) = true;
+		}
+
+		TriangleGrid grid(vertices, first, last);
+
+		for (size_t j = indexOffset; j < indexOffset + indexCounts.at(i); ++j)
+		{
+			const uint16_t v = indices.at(j);
+
+			if (measured.at(v))
+				continue;
+
+			measured.at(v) = true;
+			error = std::max(error, grid.getDistance(vertices.at(v).pos));
+		}
+
+		for (size_t j = indexOffset; j < indexOffset + indexCounts.at(i); ++j)
+		{
+			measured.at(indices.at(j)) = false;
+		}
+
+		for (auto it = first; it != last; ++it)
+		{
+			measured.at(*it) = false;
+		}
+
+		indexOffset += indexCounts.at(i);
+		lodIndexOffset += lod.indexCounts.at(i);
+	}
+
+	return error;
+}
+
+uint32_t selectLod(const std::vector<Lod>& lods, float distance, float screenScale, float maxScreenError)
+{
+	uint32_t lod = 0;
+
+	// the errors grow level by level
+	for (uint32_t i = 0; i < lods.size(); ++i)
+	{
+		if (lods.at(i).error * screenScale > maxScreenError * distance)
+			break;
+
+		lod = i + 1;
+	}
+
+	return lod;
+}
+
+bool selfCheck()
+{
+	// a flat hexagon around a vertex. The ones of the ring are on the border
+	std::vector<Meshlet::Vertex> vertices;
+
+	for (uint32_t i = 0; i < 6; ++i)
+	{
+		const float angle = XM_2PI * static_cast<float>(i) / 6.0f;
+		vertices.push_back({ { std::cos(angle), std::sin(angle), 0.0f } });
+	}
+
+	vertices.push_back({ { 0.0f, 0.0f, 0.0f } });
+
+	const std::vector<uint16_t> indices = { 6, 0, 1, 6, 1, 2, 6, 2, 3, 6, 3, 4, 6, 4, 5, 6, 5, 0 };
+
+	// the center collapses into the ring, and the ring stays
+	{
+		std::vector<uint32_t> counts;
+		float error = 1.0f;
+		const auto simplified = simplify(vertices, indices, { 18 }, 0, 1.0f, &counts, &error);
+
+		if (simplified.size() != 12 || counts != std::vector<uint32_t>{ 12 } || error > 1.0e-3f)
+			return false;
+
+		for (uint16_t v = 0; v < 6; ++v)
+		{
+			if (std::find(simplified.begin(), simplified.end(), v) == simplified.end())
+				return false;
+		}
+	}
+
+	// not into the vertices of other bones, nor across two materials
+	{
+		auto skinned = vertices;
+		skinned.back().bone0 = 1;
+
+		std::vector<uint32_t> counts;
+		float error = 0.0f;
+
+		if (simplify(skinned, indices, { 18 }, 0, 1.0f, &counts, &error) != indices)
+			return false;
+
+		if (simplify(vertices, indices, { 9, 9 }, 0, 1.0f, &counts, &error) != indices || counts != std::vector<uint32_t>{ 9, 9 })
+			return false;
+
+		// two bones in either order with the weights swapped are the same
+		auto swapped = vertices;
+
+		for (auto& v : swapped)
+		{
+			v = { v.pos, 2, 3, 0.25f };
+		}
+
+		swapped.back() = { swapped.back().pos, 3, 2, 0.75f };
+
+		if (simplify(swapped, indices, { 18 }, 0, 1.0f, &counts, &error).size() != 12)
+			return false;
+	}
+
+	// the error of the bent hexagon is the height of the center over the ring
+	{
+		auto bent = vertices;
+		bent.back().pos.z = 0.5f;
+
+		Lod lod = { };
+		float error = 0.0f;
+		lod.indices = simplify(bent, indices, { 18 }, 0, 1.0f, &lod.indexCounts, &error);
+
+		if (lod.indices.size() != 12 || std::abs(measureError(bent, indices, { 18 }, lod) - 0.5f) > 1.0e-3f)
+			return false;
+	}
+
+	// a flat grid loses the vertices inside level by level, with no error
+	{
+		constexpr uint32_t kSize = 9;
+		std::vector<Meshlet::Vertex> grid;
+		std::vector<uint16_t> gridIndices;
+
+		for (uint32_t y = 0; y < kSize; ++y)
+		{
+			for (uint32_t x = 0; x < kSize; ++x)
+			{
+				grid.push_back({ { static_cast<float>(x), static_cast<float>(y), 0.0f } });
+
+				if (x + 1 < kSize && y + 1 < kSize)
+				{
+					const uint16_t v = static_cast<uint16_t>(y * kSize + x);
+					gridIndices.insert(gridIndices.end(), { v, static_cast<uint16_t>(v + kSize), static_cast<uint16_t>(v + 1), static_cast<uint16_t>(v + 1), static_cast<uint16_t>(v + kSize), static_cast<uint16_t>(v + kSize + 1) });
+				}
+			}
+		}
+
+		const auto lods = buildLods(grid, gridIndices, { static_cast<uint32_t>(gridIndices.size()) });
+
+		if (lods.size() < 2)
+			return false;
+
+		size_t numIndices = gridIndices.size();
+
+		for (const auto& lod : lods)
+		{
+			if (lod.indices.size() >= numIndices || lod.indexCounts.front() != lod.indices.size() || lod.error > 1.0e-4f)
+				return false;
+
+			numIndices = lod.indices.size();
+		}
+	}
+
+	// the nearer the actor, the finer the level
+	{
+		std::vector<Lod> lods(3);
+		lods.at(0).error = 0.01f;
+		lods.at(1).error = 0.02f;
+		lods.at(2).error = 0.04f;
+
+		if (selectLod(lods, 1.0f, 1000.0f, 1.0f) != 0 || selectLod(lods, 15.0f, 1000.0f, 1.0f) != 1 || selectLod(lods, 1000.0f, 1000.0f, 1.0f) != 3)
+			return false;
+
+		if (selectLod({ }, 1000.0f, 1000.0f, 1.0f) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+} // namespace MeshSimplifier
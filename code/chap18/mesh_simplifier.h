@@ -0,0 +1,39 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <cstdint>
+#include <vector>
+#pragma warning(pop)
+#include "meshlet.h"
+
+// The levels of detail of a model, simplified by collapsing an edge into one of its vertices at the least quadric error (Garland and Heckbert 1997).
+// No vertex is added nor moved, so the levels draw from the vertex buffer of the model, and a vertex left is skinned as it was.
+// A vertex collapses only into one moved by the same bones with the same weight. The ones on the border of a material,
+// which include the seams of the uv and the normals since those split the vertices, and the ones shared by two materials stay.
+namespace MeshSimplifier {
+
+constexpr uint32_t kNumLods = 3; // below the full mesh
+constexpr float kTriangleRatio = 0.5f; // of a level to the one above
+constexpr float kMaxRelativeError = 0.01f; // of the radius of the model, for the first level. Doubled level by level
+
+struct Lod
+{
+	std::vector<uint16_t> indices; // the materials one after another, in the order of the model
+	std::vector<uint32_t> indexCounts; // per material
+	float error = 0.0f; // how far the surface may be from the full mesh, in the units of the model
+};
+
+// stops at targetIndexCount, or before a collapse of more than maxError. *pError is the largest one made
+std::vector<uint16_t> simplify(const std::vector<Meshlet::Vertex>& vertices, const std::vector<uint16_t>& indices, const std::vector<uint32_t>& indexCounts,
+	size_t targetIndexCount, float maxError, std::vector<uint32_t>* pIndexCounts, float* pError);
+// each from the one above, ordered for the vertex cache. A level which would remove less than a tenth of the triangles is not made, nor the ones below
+std::vector<Lod> buildLods(const std::vector<Meshlet::Vertex>& vertices, const std::vector<uint16_t>& indices, const std::vector<uint32_t>& indexCounts);
+// the largest distance of a vertex of the full mesh to the triangles of its material in the level
+float measureError(const std::vector<Meshlet::Vertex>& vertices, const std::vector<uint16_t>& indices, const std::vector<uint32_t>& indexCounts, const Lod& lod);
+// the level whose error covers at most maxScreenError pixels at the distance. screenScale is in pixels per unit at the distance of 1
+uint32_t selectLod(const std::vector<Lod>& lods, float distance, float screenScale, float maxScreenError);
+
+bool selfCheck();
+
+} // namespace MeshSimplifier
@@ -0,0 +1,607 @@
+#include "meshlet.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <utility>
+#pragma warning(pop)
+#include "debug.h"
+
+using namespace DirectX;
+
+namespace {
+	constexpr uint32_t kNone = UINT32_MAX;
+	constexpr float kMinConeDot = 0.1f; // a cone wider than this has its apex too far away to cull anything
+
+	using Triangle = std::array<uint32_t, 3>;
+
+	XMVECTOR loadPos(const std::vector<Meshlet::Vertex>& vertices, uint32_t idx)
+	{
+		return XMLoadFloat3(&vertices.at(idx).pos);
+	}
+
+	// the unit normal in the winding of the model, or zero if the triangle has no area
+	XMVECTOR getNormal(const std::vector<Meshlet::Vertex>& vertices, const Triangle& triangle)
+	{
+		const XMVECTOR p0 = loadPos(vertices, triangle[0]);
+		const XMVECTOR normal = XMVector3Cross(XMVectorSubtract(loadPos(vertices, triangle[1]), p0), XMVectorSubtract(loadPos(vertices, triangle[2]), p0));
+		const float length = XMVectorGetX(XMVector3Length(normal));
+
+		return length > FLT_EPSILON ? XMVectorScale(normal, 1.0f / length) : XMVectorZero();
+	}
+
+	std::vector<Triangle> getTriangles(const Meshlet::Clusters& clusters, const Meshlet::Meshlet& meshlet)
+	{
+		std::vector<Triangle> triangles;
+
+		for (uint32_t i = 0; i < meshlet.triangleCount; ++i)
+		{
+			Triangle triangle = { };
+
+			for (uint32_t k = 0; k < 3; ++k)
+			{
+				triangle[k] = clusters.vertices.at(meshlet.vertexOffset + clusters.triangles.at((meshlet.triangleOffset + i) * 3 + k));
+			}
+
+			triangles.push_back(triangle);
+		}
+
+		return triangles;
+	}
+
+	// the smallest index first, so that the same triangle compares equal in whatever order it was written
+	Triangle rotateToMin(const Triangle& triangle)
+	{
+		const size_t first = std::min_element(triangle.begin(), triangle.end()) - triangle.begin();
+		return { triangle[first], triangle[(first + 1) % 3], triangle[(first + 2) % 3] };
+	}
+
+	Meshlet::Bounds computeBounds(const Meshlet::Clusters& clusters, const Meshlet::Meshlet& meshlet, const std::vector<Meshlet::Vertex>& vertices)
+	{
+		Meshlet::Bounds bounds = { };
+
+		// the sphere around the box of the vertices
+		{
+			XMVECTOR minPos = XMVectorReplicate(FLT_MAX);
+			XMVECTOR maxPos = XMVectorReplicate(-FLT_MAX);
+
+			for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+			{
+				const XMVECTOR pos = loadPos(vertices, clusters.vertices.at(meshlet.vertexOffset + i));
+				minPos = XMVectorMin(minPos, pos);
+				maxPos = XMVectorMax(maxPos, pos);
+			}
+
+			const XMVECTOR center = XMVectorScale(XMVectorAdd(minPos, maxPos), 0.5f);
+			float radius = 0.0f;
+
+			for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+			{
+				const XMVECTOR pos = loadPos(vertices, clusters.vertices.at(meshlet.vertexOffset + i));
+				radius = std::max(radius, XMVectorGetX(XMVector3Length(XMVectorSubtract(pos, center))));
+			}
+
+			XMStoreFloat3(&bounds.center, center);
+			bounds.radius = radius;
+			bounds.coneApex = bounds.center;
+		}
+
+		// the bone with the most weight. The smaller index wins a tie
+		bool bRigid = true;
+		{
+			std::vector<std::pair<uint32_t, float>> weights;
+
+			auto add = [&weights](uint32_t bone, float weight) {
+				auto it = std::find_if(weights.begin(), weights.end(), [bone](const auto& w) { return w.first == bone; });
+
+				if (it == weights.end())
+				{
+					weights.push_back({ bone, weight });
+					return;
+				}
+
+				it->second += weight;
+			};
+
+			for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+			{
+				const Meshlet::Vertex& v = vertices.at(clusters.vertices.at(meshlet.vertexOffset + i));
+				add(v.bone0, v.weight);
+				add(v.bone1, 1.0f - v.weight);
+			}
+
+			std::sort(weights.begin(), weights.end(), [](const auto& a, const auto& b) { return a.second != b.second ? a.second > b.second : a.first < b.first; });
+			bounds.bone = weights.front().first;
+
+			// the cone holds only while the dominant bone alone moves the meshlet
+			for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+			{
+				const Meshlet::Vertex& v = vertices.at(clusters.vertices.at(meshlet.vertexOffset + i));
+				const bool bBone0 = v.bone0 == bounds.bone && (v.weight >= 1.0f || v.bone1 == bounds.bone);
+				const bool bBone1 = v.bone1 == bounds.bone && v.weight <= 0.0f;
+				bRigid &= bBone0 || bBone1;
+			}
+		}
+
+		if (!bRigid)
+			return bounds;
+
+		// the normal cone, with the apex behind the planes of all the triangles
+		const auto triangles = getTriangles(clusters, meshlet);
+		std::vector<XMVECTOR> normals;
+		XMVECTOR axis = XMVectorZero();
+
+		for (const auto& triangle : triangles)
+		{
+			const XMVECTOR normal = getNormal(vertices, triangle);
+			normals.push_back(normal);
+			axis = XMVectorAdd(axis, normal);
+		}
+
+		if (XMVectorGetX(XMVector3Length(axis)) <= FLT_EPSILON)
+			return bounds;
+
+		axis = XMVector3Normalize(axis);
+
+		const XMVECTOR center = XMLoadFloat3(&bounds.center);
+		float minDot = 1.0f;
+		float maxT = 0.0f;
+
+		for (size_t i = 0; i < triangles.size(); ++i)
+		{
+			const XMVECTOR normal = normals.at(i);
+
+			if (XMVector3Equal(normal, XMVectorZero()))
+				continue;
+
+			const float dn = XMVectorGetX(XMVector3Dot(normal, axis));
+			minDot = std::min(minDot, dn);
+
+			if (dn <= kMinConeDot)
+				return bounds;
+
+			const float dc = XMVectorGetX(XMVector3Dot(XMVectorSubtract(center, loadPos(vertices, triangles.at(i)[0])), normal)); // of the center in front of the plane
+			maxT = std::max(maxT, dc / dn);
+		}
+
+		XMStoreFloat3(&bounds.coneApex, XMVectorSubtract(center, XMVectorScale(axis, maxT)));
+		XMStoreFloat3(&bounds.coneAxis, axis);
+		bounds.coneCutoff = std::sqrt(std::max(0.0f, 1.0f - minDot * minDot));
+
+		return bounds;
+	}
+
+	// the triangles around each vertex, as ranges of one list
+	struct Adjacency
+	{
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> triangles;
+	};
+
+	Adjacency getAdjacency(const std::vector<Triangle>& triangles, size_t numVertices)
+	{
+		Adjacency adjacency = { };
+		adjacency.offsets.assign(numVertices + 1, 0);
+
+		for (const auto& triangle : triangles)
+		{
+			for (uint32_t idx : triangle)
+			{
+				++adjacency.offsets.at(idx + 1);
+			}
+		}
+
+		for (size_t i = 1; i < adjacency.offsets.size(); ++i)
+		{
+			adjacency.offsets.at(i) += adjacency.offsets.at(i - 1);
+		}
+
+		std::vector<uint32_t> cursors(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+		adjacency.triangles.resize(triangles.size() * 3);
+
+		for (uint32_t t = 0; t < triangles.size(); ++t)
+		{
+			for (uint32_t idx : triangles.at(t))
+			{
+				adjacency.triangles.at(cursors.at(idx)++) = t;
+			}
+		}
+
+		return adjacency;
+	}
+
+	// localIdxes is kNone for all the vertices on entry and on return
+	void buildMaterial(const std::vector<Meshlet::Vertex>& vertices, const std::vector<Triangle>& triangles, uint32_t maxVertices, uint32_t maxTriangles, std::vector<uint32_t>* pLocalIdxes, Meshlet::Clusters* pClusters)
+	{
+		std::vector<uint32_t>& localIdxes = *pLocalIdxes;
+		const Adjacency adjacency = getAdjacency(triangles, vertices.size());
+		std::vector<bool> used(triangles.size(), false);
+		uint32_t cursor = 0; // the triangles before it are used
+
+		std::vector<XMFLOAT3> centroids;
+
+		for (const auto& triangle : triangles)
+		{
+			XMFLOAT3 centroid = { };
+			XMStoreFloat3(&centroid, XMVectorScale(XMVectorAdd(XMVectorAdd(loadPos(vertices, triangle[0]), loadPos(vertices, triangle[1])), loadPos(vertices, triangle[2])), 1.0f / 3.0f));
+			centroids.push_back(centroid);
+		}
+
+		auto getNumNewVertices = [&](uint32_t t) {
+			uint32_t count = 0;
+
+			for (uint32_t idx : triangles.at(t))
+			{
+				count += localIdxes.at(idx) == kNone ? 1 : 0;
+			}
+
+			return count;
+		};
+
+		while (true)
+		{
+			while (cursor < triangles.size() && used.at(cursor))
+			{
+				++cursor;
+			}
+
+			if (cursor == triangles.size())
+				break;
+
+			Meshlet::Meshlet meshlet = { };
+			meshlet.vertexOffset = static_cast<uint32_t>(pClusters->vertices.size());
+			meshlet.triangleOffset = static_cast<uint32_t>(pClusters->triangles.size() / 3);
+
+			XMVECTOR centroidSum = XMVectorZero();
+			uint32_t next = cursor;
+
+			while (next != kNone)
+			{
+				if (meshlet.vertexCount + getNumNewVertices(next) > maxVertices || meshlet.triangleCount == maxTriangles)
+					break;
+
+				// add the triangle
+				for (uint32_t idx : triangles.at(next))
+				{
+					if (localIdxes.at(idx) == kNone)
+					{
+						localIdxes.at(idx) = meshlet.vertexCount++;
+						pClusters->vertices.push_back(idx);
+					}
+
+					pClusters->triangles.push_back(static_cast<uint8_t>(localIdxes.at(idx)));
+					pClusters->indices.push_back(static_cast<uint16_t>(idx));
+				}
+
+				++meshlet.triangleCount;
+				used.at(next) = true;
+				centroidSum = XMVectorAdd(centroidSum, XMLoadFloat3(&centroids.at(next)));
+
+				// the neighbor which adds the fewest vertices, then the first one
+				next = kNone;
+				uint32_t bestNumNew = 4;
+
+				for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+				{
+					const uint32_t idx = pClusters->vertices.at(meshlet.vertexOffset + i);
+
+					for (uint32_t a = adjacency.offsets.at(idx); a < adjacency.offsets.at(idx + 1); ++a)
+					{
+						const uint32_t t = adjacency.triangles.at(a);
+
+						if (used.at(t))
+							continue;
+
+						const uint32_t numNew = getNumNewVertices(t);
+
+						if (numNew < bestNumNew || (numNew == bestNumNew && t < next))
+						{
+							next = t;
+							bestNumNew = numNew;
+						}
+					}
+				}
+
+				if (next != kNone)
+					continue;
+
+				// no neighbor is left, so the nearest piece of the material
+				const XMVECTOR centroid = XMVectorScale(centroidSum, 1.0f / meshlet.triangleCount);
+				float bestDistance = FLT_MAX;
+
+				for (uint32_t t = cursor; t < triangles.size(); ++t)
+				{
+					if (used.at(t))
+						continue;
+
+					const float distance = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&centroids.at(t)), centroid)));
+
+					if (distance < bestDistance)
+					{
+						next = t;
+						bestDistance = distance;
+					}
+				}
+			}
+
+			for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+			{
+				localIdxes.at(pClusters->vertices.at(meshlet.vertexOffset + i)) = kNone;
+			}
+
+			pClusters->meshlets.push_back(meshlet);
+			pClusters->bounds.push_back(computeBounds(*pClusters, meshlet, vertices));
+		}
+	}
+} // namespace anonymous
+
+namespace Meshlet {
+
+Clusters build(const std::vector<Vertex>& vertices, const std::vector<uint16_t>& indices, const std::vector<uint32_t>& indexCounts, uint32_t maxVertices, uint32_t maxTriangles)
+{
+	ThrowIfFalse(3 <= maxVertices && maxVertices <= 256); // a local index is a byte
+	ThrowIfFalse(maxTriangles > 0);
+
+	Clusters clusters = { };
+	std::vector<uint32_t> localIdxes(vertices.size(), kNone);
+	uint32_t indexOffset = 0;
+
+	for (uint32_t count : indexCounts)
+	{
+		ThrowIfFalse(count % 3 == 0);
+		ThrowIfFalse(indexOffset + count <= indices.size());
+
+		std::vector<Triangle> triangles;
+
+		for (uint32_t i = indexOffset; i < indexOffset + count; i += 3)
+		{
+			triangles.push_back({ indices.at(i), indices.at(i + 1), indices.at(i + 2) });
+		}
+
+		clusters.materialOffsets.push_back(static_cast<uint32_t>(clusters.meshlets.size()));
+		buildMaterial(vertices, triangles, maxVertices, maxTriangles, &localIdxes, &clusters);
+
+		indexOffset += count;
+	}
+
+	clusters.materialOffsets.push_back(static_cast<uint32_t>(clusters.meshlets.size()));
+
+	// the indices after the last material are not drawn, and stay as they were
+	clusters.indices.insert(clusters.indices.end(), indices.begin() + indexOffset, indices.end());
+
+	return clusters;
+}
+
+Bounds transform(const Bounds& bounds, FXMMATRIX m)
+{
+	Bounds transformed = bounds;
+	XMStoreFloat3(&transformed.center, XMVector3Transform(XMLoadFloat3(&bounds.center), m));
+	XMStoreFloat3(&transformed.coneApex, XMVector3Transform(XMLoadFloat3(&bounds.coneApex), m));
+
+	if (bounds.hasCone())
+	{
+		XMStoreFloat3(&transformed.coneAxis, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&bounds.coneAxis), m)));
+	}
+
+	return transformed;
+}
+
+bool isBackfacing(const Bounds& bounds, const XMFLOAT3& eye)
+{
+	if (!bounds.hasCone())
+		return false;
+
+	const XMVECTOR direction = XMVector3Normalize(XMVectorSubtract(XMLoadFloat3(&bounds.coneApex), XMLoadFloat3(&eye)));
+	return XMVectorGetX(XMVector3Dot(direction, XMLoadFloat3(&bounds.coneAxis))) >= bounds.coneCutoff;
+}
+
+bool validate(const Clusters& clusters, const std::vector<Vertex>& vertices, const std::vector<uint16_t>& indices, const std::vector<uint32_t>& indexCounts, uint32_t maxVertices, uint32_t maxTriangles)
+{
+	if (clusters.materialOffsets.size() != indexCounts.size() + 1 || clusters.materialOffsets.back() != clusters.meshlets.size())
+		return false;
+
+	if (clusters.bounds.size() != clusters.meshlets.size() || clusters.indices.size() != indices.size())
+		return false;
+
+	uint32_t indexOffset = 0;
+
+	for (size_t m = 0; m < indexCounts.size(); ++m)
+	{
+		std::vector<Triangle> expected;
+
+		for (uint32_t i = indexOffset; i < indexOffset + indexCounts.at(m); i += 3)
+		{
+			expected.push_back(rotateToMin({ indices.at(i), indices.at(i + 1), indices.at(i + 2) }));
+		}
+
+		std::vector<Triangle> actual;
+		uint32_t reorderedOffset = indexOffset;
+
+		for (uint32_t i = clusters.materialOffsets.at(m); i < clusters.materialOffsets.at(m + 1); ++i)
+		{
+			const Meshlet& meshlet = clusters.meshlets.at(i);
+			const Bounds& bounds = clusters.bounds.at(i);
+
+			if (meshlet.vertexCount > maxVertices || meshlet.triangleCount == 0 || meshlet.triangleCount > maxTriangles)
+				return false;
+
+			for (uint32_t t = meshlet.triangleOffset * 3; t < (meshlet.triangleOffset + meshlet.triangleCount) * 3; ++t)
+			{
+				if (clusters.triangles.at(t) >= meshlet.vertexCount)
+					return false;
+			}
+
+			for (uint32_t v = 0; v < meshlet.vertexCount; ++v)
+			{
+				const XMVECTOR pos = loadPos(vertices, clusters.vertices.at(meshlet.vertexOffset + v));
+				const float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(pos, XMLoadFloat3(&bounds.center))));
+
+				if (distance > bounds.radius * 1.0001f + 1e-4f)
+					return false;
+			}
+
+			for (const auto& triangle : getTriangles(clusters, meshlet))
+			{
+				// the index list draws the meshlet as a range
+				for (uint32_t k = 0; k < 3; ++k)
+				{
+					if (clusters.indices.at(reorderedOffset++) != triangle[k])
+						return false;
+				}
+
+				actual.push_back(rotateToMin(triangle));
+
+				const XMVECTOR normal = getNormal(vertices, triangle);
+
+				if (!bounds.hasCone() || XMVector3Equal(normal, XMVectorZero()))
+					continue;
+
+				// in the cone, and the apex behind the plane
+				const float minDot = std::sqrt(1.0f - bounds.coneCutoff * bounds.coneCutoff);
+
+				if (XMVectorGetX(XMVector3Dot(normal, XMLoadFloat3(&bounds.coneAxis))) < minDot - 1e-3f)
+					return false;
+
+				const XMVECTOR apexToTriangle = XMVectorSubtract(XMLoadFloat3(&bounds.coneApex), loadPos(vertices, triangle[0]));
+
+				if (XMVectorGetX(XMVector3Dot(apexToTriangle, normal)) > 1e-3f * (1.0f + bounds.radius))
+					return false;
+			}
+		}
+
+		if (reorderedOffset != indexOffset + indexCounts.at(m))
+			return false;
+
+		// each triangle once, in its winding
+		std::sort(expected.begin(), expected.end());
+		std::sort(actual.begin(), actual.end());
+
+		if (actual != expected)
+			return false;
+
+		indexOffset += indexCounts.at(m);
+	}
+
+	return true;
+}
+
+bool selfCheck()
+{
+	// a grid of quads on one bone, a strip of separate triangles, an empty material, and a box over two bones
+	constexpr uint32_t kGridSize = 20; // quads a side
+	std::vector<Vertex> vertices;
+	std::vector<uint16_t> indices;
+	std::vector<uint32_t> indexCounts;
+
+	for (uint32_t y = 0; y <= kGridSize; ++y)
+	{
+		for (uint32_t x = 0; x <= kGridSize; ++x)
+		{
+			vertices.push_back({ { static_cast<float>(x), static_cast<float>(y), 0.0f }, 0, 0, 1.0f });
+		}
+	}
+
+	for (uint32_t y = 0; y < kGridSize; ++y)
+	{
+		for (uint32_t x = 0; x < kGridSize; ++x)
+		{
+			const uint16_t i0 = static_cast<uint16_t>(y * (kGridSize + 1) + x);
+			const uint16_t i1 = static_cast<uint16_t>(i0 + kGridSize + 1);
+
+			// clockwise seen from -z, so that the faces look toward -z
+			indices.insert(indices.end(), { i0, i1, static_cast<uint16_t>(i0 + 1), static_cast<uint16_t>(i0 + 1), i1, static_cast<uint16_t>(i1 + 1) });
+		}
+	}
+
+	indexCounts.push_back(static_cast<uint32_t>(indices.size()));
+
+	for (uint32_t i = 0; i < 5; ++i)
+	{
+		const uint16_t first = static_cast<uint16_t>(vertices.size());
+		const float x = 100.0f * i;
+		vertices.push_back({ { x, 0.0f, 0.0f }, 1, 0, 1.0f });
+		vertices.push_back({ { x, 1.0f, 0.0f }, 1, 0, 1.0f });
+		vertices.push_back({ { x + 1.0f, 0.0f, 0.0f }, 1, 0, 1.0f });
+		indices.insert(indices.end(), { first, static_cast<uint16_t>(first + 1), static_cast<uint16_t>(first + 2) });
+	}
+
+	indexCounts.push_back(15);
+	indexCounts.push_back(0);
+
+	{
+		const uint16_t first = static_cast<uint16_t>(vertices.size());
+
+		for (uint32_t i = 0; i < 8; ++i)
+		{
+			vertices.push_back({ { (i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f }, 2, 3, 0.5f });
+		}
+
+		constexpr uint16_t kBox[] = { 0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5 };
+
+		for (uint16_t idx : kBox)
+		{
+			indices.push_back(static_cast<uint16_t>(first + idx));
+		}
+
+		indexCounts.push_back(_countof(kBox));
+	}
+
+	const Clusters clusters = build(vertices, indices, indexCounts);
+
+	if (!validate(clusters, vertices, indices, indexCounts))
+		return false;
+
+	// the same every time
+	{
+		const Clusters again = build(vertices, indices, indexCounts);
+
+		if (again.vertices != clusters.vertices || again.triangles != clusters.triangles || again.indices != clusters.indices)
+			return false;
+	}
+
+	// the grid needs 441 vertices and 800 triangles. A meshlet of 7 by 7 vertices holds 72 of them
+	const uint32_t numGridMeshlets = clusters.materialOffsets.at(1) - clusters.materialOffsets.at(0);
+
+	if (numGridMeshlets < 800 / kMaxTriangles + 1 || numGridMeshlets > 16)
+		return false;
+
+	// the separate triangles are gathered into one meshlet, and the empty material has none
+	if (clusters.materialOffsets.at(2) - clusters.materialOffsets.at(1) != 1 || clusters.materialOffsets.at(3) != clusters.materialOffsets.at(2))
+		return false;
+
+	// the grid faces -z on one bone
+	{
+		const Bounds& bounds = clusters.bounds.at(0);
+
+		if (!bounds.hasCone() || bounds.bone != 0 || bounds.coneAxis.z > -0.999f)
+			return false;
+
+		if (isBackfacing(bounds, { 5.0f, 5.0f, -10.0f }) || !isBackfacing(bounds, { 5.0f, 5.0f, 10.0f }))
+			return false;
+
+		// turned around by the bone
+		const Bounds turned = transform(bounds, XMMatrixRotationY(XM_PI) * XMMatrixTranslation(0.0f, 0.0f, 5.0f));
+
+		if (!isBackfacing(turned, { 0.0f, 5.0f, -10.0f }) || isBackfacing(turned, { 0.0f, 5.0f, 20.0f }))
+			return false;
+	}
+
+	// the box looks every way, and is blended over two bones
+	if (clusters.bounds.back().hasCone() || clusters.bounds.back().bone != 2)
+		return false;
+
+	// the limits hold when they are small
+	{
+		const Clusters small = build(vertices, indices, indexCounts, 8, 6);
+
+		if (!validate(small, vertices, indices, indexCounts, 8, 6) || small.meshlets.size() <= clusters.meshlets.size())
+			return false;
+	}
+
+	return true;
+}
+
+} // namespace Meshlet
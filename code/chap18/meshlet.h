@@ -0,0 +1,72 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+#pragma warning(pop)
+
+// The triangles of each material split into meshlets, small clusters which are culled on their own.
+// A meshlet grows from a triangle through its neighbors, the ones which add the fewest vertices first.
+// The layout is the one of the mesh shaders. The vertices index into the model, and the triangles into the vertices of the meshlet.
+// The triangles are also written back as a plain index list in the meshlet order, so that the input assembler draws a meshlet as a range.
+namespace Meshlet {
+
+constexpr uint32_t kMaxVertices = 64;
+constexpr uint32_t kMaxTriangles = 124;
+
+struct Vertex
+{
+	DirectX::XMFLOAT3 pos = { };
+	uint32_t bone0 = 0;
+	uint32_t bone1 = 0;
+	float weight = 1.0f; // of bone0
+};
+
+struct Meshlet
+{
+	uint32_t vertexOffset = 0; // into Clusters::vertices
+	uint32_t vertexCount = 0;
+	uint32_t triangleOffset = 0; // into Clusters::triangles, in triangles
+	uint32_t triangleCount = 0;
+};
+static_assert(sizeof(Meshlet) == 16);
+
+// in the bind pose, and moved by the dominant bone at run time
+struct Bounds
+{
+	DirectX::XMFLOAT3 center = { };
+	float radius = 0.0f;
+	DirectX::XMFLOAT3 coneApex = { };
+	uint32_t bone = 0; // with the most weight in the meshlet
+	DirectX::XMFLOAT3 coneAxis = { };
+	float coneCutoff = 1.0f; // the meshlet faces away when dot(normalize(coneApex - eye), coneAxis) >= coneCutoff
+
+	// false when the normals spread over a half sphere, or a vertex is moved by another bone than the dominant one
+	bool hasCone() const { return coneCutoff < 1.0f; }
+};
+static_assert((sizeof(Bounds) % 16) == 0);
+
+struct Clusters
+{
+	std::vector<Meshlet> meshlets; // the ones of a material one after another
+	std::vector<Bounds> bounds; // per meshlet
+	std::vector<uint32_t> vertices;
+	std::vector<uint8_t> triangles; // three per triangle, in the winding of the model
+	std::vector<uint32_t> materialOffsets; // the first meshlet of each material, and the number of meshlets at the end
+	std::vector<uint16_t> indices; // the triangles in the meshlet order. The ranges of the materials stay where they were
+};
+
+// indexCounts is per material. The same input always gives the same meshlets
+Clusters build(const std::vector<Vertex>& vertices, const std::vector<uint16_t>& indices, const std::vector<uint32_t>& indexCounts, uint32_t maxVertices = kMaxVertices, uint32_t maxTriangles = kMaxTriangles);
+// moves the sphere and the cone by m, which is the palette matrix of the dominant bone and the world
+Bounds transform(const Bounds& bounds, DirectX::FXMMATRIX m);
+bool isBackfacing(const Bounds& bounds, const DirectX::XMFLOAT3& eye);
+inline uint32_t getIndexCount(const Meshlet& meshlet) { return meshlet.triangleCount * 3; }
+// false if the clusters do not cover the triangles once each, break a limit, or a bound does not hold its triangles
+bool validate(const Clusters& clusters, const std::vector<Vertex>& vertices, const std::vector<uint16_t>& indices, const std::vector<uint32_t>& indexCounts, uint32_t maxVertices = kMaxVertices, uint32_t maxTriangles = kMaxTriangles);
+
+bool selfCheck();
+
+} // namespace Meshlet
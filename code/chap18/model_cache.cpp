@@ -0,0 +1,310 @@
+#include "model_cache.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#pragma warning(pop)
+#include "debug.h"
+#include "mesh_optimizer.h"
+#include "util.h"
+
+namespace {
+	template <typename T>
+	void writeVector(const std::vector<T>& src, std::vector<uint8_t>* pDst)
+	{
+		const uint32_t count = static_cast<uint32_t>(src.size());
+		const uint8_t* const countBytes = reinterpret_cast<const uint8_t*>(&count);
+		const uint8_t* const bytes = reinterpret_cast<const uint8_t*>(src.data());
+
+		pDst->insert(pDst->end(), countBytes, countBytes + sizeof(count));
+		pDst->insert(pDst->end(), bytes, bytes + sizeof(T) * src.size());
+	}
+
+	// false if the data ends before the vector
+	template <typename T>
+	bool readVector(const std::vector<uint8_t>& src, size_t* pOffset, std::vector<T>* pDst)
+	{
+		uint32_t count = 0;
+
+		if (src.size() - *pOffset < sizeof(count))
+			return false;
+
+		std::memcpy(&count, src.data() + *pOffset, sizeof(count));
+		*pOffset += sizeof(count);
+
+		if ((src.size() - *pOffset) / sizeof(T) < count)
+			return false;
+
+		pDst->resize(count);
+		std::memcpy(pDst->data(), src.data() + *pOffset, sizeof(T) * count);
+		*pOffset += sizeof(T) * count;
+
+		return true;
+	}
+
+	bool readFile(const std::string& path, std::vector<uint8_t>* data)
+	{
+		FILE* fp = nullptr;
+		if (fopen_s(&fp, path.c_str(), "rb") != 0)
+			return false;
+
+		ThrowIfFalse(fseek(fp, 0, SEEK_END) == 0);
+		const long size = ftell(fp);
+		ThrowIfFalse(fseek(fp, 0, SEEK_SET) == 0);
+
+		data->resize(static_cast<size_t>(size));
+		const bool bRead = (size == 0) || (fread(data->data(), data->size(), 1, fp) == 1);
+		ThrowIfFalse(fclose(fp) == 0);
+
+		return bRead;
+	}
+} // namespace anonymous
+
+HRESULT ModelCache::init(const char* cacheDir)
+{
+	ThrowIfFalse(cacheDir != nullptr);
+
+	m_cacheDir = cacheDir;
+
+	std::error_code ec;
+	std::filesystem::create_directories(m_cacheDir, ec);
+
+	return S_OK;
+}
+
+void ModelCache::release()
+{
+	Debug::debugOutputFormatString("Model cache: hit %u, miss %u\n", m_numHits, m_numMisses);
+}
+
+ModelCache::Model ModelCache::load(const std::vector<Meshlet::Vertex>& vertices, const std::vector<uint16_t>& indices, const std::vector<uint32_t>& indexCounts)
+{
+	const uint64_t key = computeKey(vertices, indices, indexCounts);
+	const std::string path = getEntryPath(key);
+	Model model = { };
+
+	// the sizes are checked, so that a broken entry is built again
+	auto isValid = [&]() {
+		if (model.clusters.indices.size() != indices.size() || model.clusters.materialOffsets.size() != indexCounts.size() + 1)
+			return false;
+
+		return std::all_of(model.lods.begin(), model.lods.end(), [&](const MeshSimplifier::Lod& lod) {
+			return lod.indexCounts.size() == indexCounts.size() && std::reduce(lod.indexCounts.begin(), lod.indexCounts.end(), size_t(0)) == lod.indices.size()
+				&& std::all_of(lod.indices.begin(), lod.indices.end(), [&](uint16_t v) { return v < vertices.size(); });
+		});
+	};
+
+	if (std::vector<uint8_t> data; readFile(path, &data) && deserialize(data, &model) && isValid())
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_numHits;
+
+		return model;
+	}
+
+	Debug::debugOutputFormatString("Model cache miss: %016llx. Run with --mesh-report to build it offline\n", static_cast<unsigned long long>(key));
+
+	model = build(vertices, indices, indexCounts);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	++m_numMisses;
+
+	// not fatal. It is built again on the next run
+	FILE* fp = nullptr;
+	if (fopen_s(&fp, path.c_str(), "wb") == 0)
+	{
+		const auto data = serialize(model);
+		ThrowIfFalse(fwrite(data.data(), data.size(), 1, fp) == 1);
+		ThrowIfFalse(fclose(fp) == 0);
+	}
+
+	return model;
+}
+
+ModelCache::Model ModelCache::build(const std::vector<Meshlet::Vertex>& vertices, const std::vector<uint16_t>& indices, const std::vector<uint32_t>& indexCounts)
+{
+	Model model = { };
+	model.clusters = Meshlet::build(vertices, indices, indexCounts);
+	MeshOptimizer::optimize(&model.clusters, vertices);
+	model.lods = MeshSimplifier::buildLods(vertices, indices, indexCounts);
+
+	return model;
+}
+
+uint64_t ModelCache::computeKey(const std::vector<Meshlet::Vertex>& vertices, const std::vector<uint16_t>& indices, const std::vector<uint32_t>& indexCounts)
+{
+	Util::Fnv1a hasher;
+	hasher.add(kVersion);
+	hasher.add(Meshlet::kMaxVertices);
+	hasher.add(Meshlet::kMaxTriangles);
+	hasher.add(MeshOptimizer::kCacheSize);
+	hasher.add(MeshSimplifier::kNumLods);
+	hasher.add(MeshSimplifier::kTriangleRatio);
+	hasher.add(MeshSimplifier::kMaxRelativeError);
+
+	// the sizes first, so that moving an element from one list to the next changes the key
+	hasher.add(vertices.size());
+
+	for (const auto& v : vertices)
+	{
+		hasher.addBytes(&v.pos, sizeof(v.pos));
+		hasher.add(v.bone0);
+		hasher.add(v.bone1);
+		hasher.add(v.weight);
+	}
+
+	hasher.add(indices.size());
+	hasher.addBytes(indices.data(), sizeof(uint16_t) * indices.size());
+	hasher.add(indexCounts.size());
+	hasher.addBytes(indexCounts.data(), sizeof(uint32_t) * indexCounts.size());
+
+	return hasher.get();
+}
+
+std::vector<uint8_t> ModelCache::serialize(const Model& model)
+{
+	const Meshlet::Clusters& clusters = model.clusters;
+
+	std::vector<uint8_t> data;
+	writeVector(std::vector<uint32_t>{ kFileMagic, kVersion }, &data);
+	writeVector(clusters.meshlets, &data);
+	writeVector(clusters.bounds, &data);
+	writeVector(clusters.vertices, &data);
+	writeVector(clusters.triangles, &data);
+	writeVector(clusters.materialOffsets, &data);
+	writeVector(clusters.indices, &data);
+
+	// the number of the levels, then each one
+	writeVector(std::vector<uint32_t>{ static_cast<uint32_t>(model.lods.size()) }, &data);
+
+	for (const auto& lod : model.lods)
+	{
+		writeVector(lod.indices, &data);
+		writeVector(lod.indexCounts, &data);
+		writeVector(std::vector<float>{ lod.error }, &data);
+	}
+
+	return data;
+}
+
+bool ModelCache::deserialize(const std::vector<uint8_t>& data, Model* pModel)
+{
+	ThrowIfFalse(pModel != nullptr);
+
+	size_t offset = 0;
+	std::vector<uint32_t> header;
+
+	if (!readVector(data, &offset, &header) || header != std::vector<uint32_t>{ kFileMagic, kVersion })
+		return false;
+
+	Meshlet::Clusters clusters = { };
+
+	if (!readVector(data, &offset, &clusters.meshlets)
+		|| !readVector(data, &offset, &clusters.bounds)
+		|| !readVector(data, &offset, &clusters.vertices)
+		|| !readVector(data, &offset, &clusters.triangles)
+		|| !readVector(data, &offset, &clusters.materialOffsets)
+		|| !readVector(data, &offset, &clusters.indices))
+		return false;
+
+	std::vector<uint32_t> numLods;
+
+	if (!readVector(data, &offset, &numLods) || numLods.size() != 1 || numLods.front() > MeshSimplifier::kNumLods)
+		return false;
+
+	std::vector<MeshSimplifier::Lod> lods(numLods.front());
+
+	for (auto& lod : lods)
+	{
+		std::vector<float> error;
+
+		if (!readVector(data, &offset, &lod.indices) || !readVector(data, &offset, &lod.indexCounts) || !readVector(data, &offset, &error) || error.size() != 1)
+			return false;
+
+		lod.error = error.front();
+	}
+
+	if (offset != data.size())
+		return false;
+
+	pModel->clusters = std::move(clusters);
+	pModel->lods = std::move(lods);
+
+	return true;
+}
+
+bool ModelCache::selfCheck()
+{
+	// two triangles in a material, one in the next
+	const std::vector<Meshlet::Vertex> vertices = {
+		{ { 0.0f, 0.0f, 0.0f } }, { { 0.0f, 1.0f, 0.0f } }, { { 1.0f, 0.0f, 0.0f } }, { { 1.0f, 1.0f, 0.0f } },
+	};
+	const std::vector<uint16_t> indices = { 0, 1, 2, 2, 1, 3, 0, 2, 1 };
+	const std::vector<uint32_t> indexCounts = { 6, 3 };
+
+	Model model = build(vertices, indices, indexCounts);
+
+	// the quads are too small to simplify, so a level is made up
+	model.lods.push_back({ { 0, 1, 2, 0, 2, 1 }, { 3, 3 }, 0.5f });
+
+	const auto data = serialize(model);
+
+	// the same model back
+	{
+		Model loaded = { };
+
+		if (!deserialize(data, &loaded))
+			return false;
+
+		if (serialize(loaded) != data || !Meshlet::validate(loaded.clusters, vertices, indices, indexCounts))
+			return false;
+
+		if (loaded.lods.size() != 1 || loaded.lods.front().indexCounts != model.lods.front().indexCounts || loaded.lods.front().error != 0.5f)
+			return false;
+	}
+
+	// a truncated file, and one of another version
+	{
+		Model loaded = { };
+
+		if (deserialize(std::vector<uint8_t>(data.begin(), data.end() - 1), &loaded) || deserialize({ }, &loaded))
+			return false;
+
+		auto stale = data;
+		stale.at(sizeof(uint32_t) * 2) ^= 0xff; // the version
+
+		if (deserialize(stale, &loaded))
+			return false;
+	}
+
+	// the geometry is in the key
+	{
+		const uint64_t key = computeKey(vertices, indices, indexCounts);
+
+		if (computeKey(vertices, indices, indexCounts) != key)
+			return false;
+
+		if (computeKey(vertices, { 0, 1, 2, 2, 1, 3, 0, 2, 3 }, indexCounts) == key || computeKey(vertices, indices, { 3, 6 }) == key)
+			return false;
+
+		auto moved = vertices;
+		moved.back().pos.z = 1.0f;
+
+		if (computeKey(moved, indices, indexCounts) == key)
+			return false;
+	}
+
+	return true;
+}
+
+std::string ModelCache::getEntryPath(uint64_t key) const
+{
+	char name[32] = "";
+	ThrowIfFalse(sprintf_s(name, "%016llx.meshlets", static_cast<unsigned long long>(key)) != -1);
+
+	return (std::filesystem::path(m_cacheDir) / name).string();
+}
@@ -0,0 +1,48 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#pragma warning(pop)
+#include "mesh_simplifier.h"
+#include "meshlet.h"
+
+// The meshlets, the index buffers and the levels of detail of the models, built and optimized once and kept in files
+// keyed by the hash of the geometry and kVersion. A miss builds them at load time and writes them back.
+// The entries are also written offline by the mesh report (--mesh-report), so a warm cache builds nothing.
+class ModelCache
+{
+public:
+	struct Model
+	{
+		Meshlet::Clusters clusters;
+		std::vector<MeshSimplifier::Lod> lods; // below the full mesh, whose indices are the ones of the clusters
+	};
+
+	HRESULT init(const char* cacheDir);
+	void release();
+
+	Model load(const std::vector<Meshlet::Vertex>& vertices, const std::vector<uint16_t>& indices, const std::vector<uint32_t>& indexCounts);
+
+	// Meshlet::build(), MeshOptimizer::optimize() and MeshSimplifier::buildLods()
+	static Model build(const std::vector<Meshlet::Vertex>& vertices, const std::vector<uint16_t>& indices, const std::vector<uint32_t>& indexCounts);
+	static uint64_t computeKey(const std::vector<Meshlet::Vertex>& vertices, const std::vector<uint16_t>& indices, const std::vector<uint32_t>& indexCounts);
+	static std::vector<uint8_t> serialize(const Model& model);
+	static bool deserialize(const std::vector<uint8_t>& data, Model* pModel);
+	static bool selfCheck();
+
+private:
+	static constexpr uint32_t kFileMagic = 0x4c444f4d; // "MODL"
+	static constexpr uint32_t kVersion = 2; // bump when build() gives another model for the same geometry
+
+	std::string getEntryPath(uint64_t key) const;
+
+	std::string m_cacheDir;
+	std::mutex m_mutex; // the actors are loaded in parallel
+	uint32_t m_numHits = 0;
+	uint32_t m_numMisses = 0;
+};
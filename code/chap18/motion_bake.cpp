@@ -0,0 +1,274 @@
+#include "motion_bake.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#pragma warning(pop)
+#include "debug.h"
+#include "util.h"
+
+#undef min
+#undef max
+
+using namespace DirectX;
+
+namespace {
+	constexpr uint16_t kComponentMask = 0x7fff;
+	constexpr float kComponentRange = 0.70710678f; // the smallest three are within 1 / sqrt(2)
+	constexpr float kComponentStep = 2.0f * kComponentRange / kComponentMask;
+
+	// the order of the components in the decoded vector, the largest one last, back to x, y, z and w
+	constexpr uint32_t kSwizzles[4][4] = {
+		{ 3, 0, 1, 2 },
+		{ 0, 3, 1, 2 },
+		{ 0, 1, 3, 2 },
+		{ 0, 1, 2, 3 },
+	};
+} // namespace anonymous
+
+namespace MotionBake {
+
+void encodeRotation(FXMVECTOR rotation, uint16_t* pDst)
+{
+	XMFLOAT4 q = { };
+	XMStoreFloat4(&q, XMQuaternionNormalize(rotation));
+
+	float c[4] = { q.x, q.y, q.z, q.w };
+	const uint32_t largest = static_cast<uint32_t>(std::max_element(c, c + 4, [](float a, float b) { return std::abs(a) < std::abs(b); }) - c);
+
+	// q and -q are the same rotation, so the largest one is made positive and is not stored
+	const float sign = (c[largest] < 0.0f) ? -1.0f : 1.0f;
+	uint32_t n = 0;
+
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		if (i == largest)
+			continue;
+
+		const float u = std::round((sign * c[i] + kComponentRange) / kComponentStep);
+		pDst[n++] = static_cast<uint16_t>(std::clamp(u, 0.0f, static_cast<float>(kComponentMask)));
+	}
+
+	pDst[0] |= static_cast<uint16_t>((largest & 1) << 15);
+	pDst[1] |= static_cast<uint16_t>((largest >> 1) << 15);
+}
+
+XMVECTOR decodeRotation(const uint16_t* pSrc)
+{
+	const uint32_t largest = (pSrc[0] >> 15) | ((pSrc[1] >> 15) << 1);
+
+	XMVECTOR v = XMVectorSetInt(pSrc[0], pSrc[1], pSrc[2], 0);
+	v = XMVectorAndInt(v, XMVectorSetInt(kComponentMask, kComponentMask, kComponentMask, 0));
+	v = XMVectorMultiplyAdd(XMConvertVectorUIntToFloat(v, 0), XMVectorReplicate(kComponentStep), XMVectorReplicate(-kComponentRange));
+
+	// the largest one from the unit length, into w before the swizzle
+	const XMVECTOR largestValue = XMVectorSqrt(XMVectorMax(XMVectorSubtract(XMVectorSplatOne(), XMVector3Dot(v, v)), XMVectorZero()));
+	v = XMVectorSelect(v, largestValue, g_XMSelect0001);
+
+	const uint32_t* swizzle = kSwizzles[largest];
+	return XMVectorSwizzle(v, swizzle[0], swizzle[1], swizzle[2], swizzle[3]);
+}
+
+// by the chord and not acos() of the dot, which has no precision near 1 in float
+float getAngle(FXMVECTOR a, FXMVECTOR b)
+{
+	const XMVECTOR na = XMQuaternionNormalize(a);
+	XMVECTOR nb = XMQuaternionNormalize(b);
+
+	if (XMVectorGetX(XMQuaternionDot(na, nb)) < 0.0f)
+		nb = XMVectorNegate(nb);
+
+	return 4.0f * std::atan2(XMVectorGetX(XMVector4Length(XMVectorSubtract(na, nb))), XMVectorGetX(XMVector4Length(XMVectorAdd(na, nb))));
+}
+
+Track bakeTrack(uint32_t bone, uint32_t numFrames, const Sampler& sample)
+{
+	Track track = { };
+	track.bone = bone;
+	track.rotations.resize(3 * static_cast<size_t>(numFrames));
+
+	std::vector<XMFLOAT3> translations(numFrames);
+	XMVECTOR minTranslation = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maxTranslation = XMVectorReplicate(-FLT_MAX);
+
+	for (uint32_t frameNo = 0; frameNo < numFrames; ++frameNo)
+	{
+		XMVECTOR rotation = XMQuaternionIdentity();
+		XMVECTOR translation = XMVectorZero();
+		sample(frameNo, &rotation, &translation);
+
+		encodeRotation(rotation, &track.rotations.at(3 * static_cast<size_t>(frameNo)));
+		XMStoreFloat3(&translations.at(frameNo), translation);
+		minTranslation = XMVectorMin(minTranslation, translation);
+		maxTranslation = XMVectorMax(maxTranslation, translation);
+	}
+
+	if (numFrames == 0)
+		return track;
+
+	XMStoreFloat3(&track.translationMin, minTranslation);
+	XMStoreFloat3(&track.translationStep, XMVectorScale(XMVectorSubtract(maxTranslation, minTranslation), 1.0f / UINT16_MAX));
+
+	if (XMVector3Equal(minTranslation, maxTranslation))
+		return track;
+
+	track.translations.resize(3 * static_cast<size_t>(numFrames));
+
+	for (uint32_t frameNo = 0; frameNo < numFrames; ++frameNo)
+	{
+		const float* t = &translations.at(frameNo).x;
+		const float* minT = &track.translationMin.x;
+		const float* step = &track.translationStep.x;
+
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			const float u = (step[i] > 0.0f) ? std::round((t[i] - minT[i]) / step[i]) : 0.0f;
+			track.translations.at(3 * static_cast<size_t>(frameNo) + i) = static_cast<uint16_t>(std::clamp(u, 0.0f, static_cast<float>(UINT16_MAX)));
+		}
+	}
+
+	return track;
+}
+
+void decode(const Track& track, uint32_t frameNo, XMVECTOR* pRotation, XMVECTOR* pTranslation)
+{
+	const size_t offset = 3 * static_cast<size_t>(frameNo);
+	*pRotation = decodeRotation(track.rotations.data() + offset);
+
+	if (track.translations.empty())
+	{
+		*pTranslation = XMLoadFloat3(&track.translationMin);
+		return;
+	}
+
+	const uint16_t* t = track.translations.data() + offset;
+	const XMVECTOR u = XMConvertVectorUIntToFloat(XMVectorSetInt(t[0], t[1], t[2], 0), 0);
+	*pTranslation = XMVectorMultiplyAdd(u, XMLoadFloat3(&track.translationStep), XMLoadFloat3(&track.translationMin));
+}
+
+Report measure(const Clip& clip, const std::vector<Sampler>& samplers)
+{
+	ThrowIfFalse(samplers.size() == clip.tracks.size());
+
+	Report report = { };
+	const size_t numSamples = static_cast<size_t>(clip.numFrames) * clip.tracks.size();
+
+	for (const Track& track : clip.tracks)
+	{
+		report.numBytes += sizeof(track) + sizeof(uint16_t) * (track.rotations.size() + track.translations.size());
+	}
+
+	if (numSamples == 0)
+		return report;
+
+	// both into the same buffers, so that the two loops do the same stores
+	std::vector<std::pair<XMVECTOR, XMVECTOR>> exact(numSamples);
+	std::vector<std::pair<XMVECTOR, XMVECTOR>> decoded(numSamples);
+
+	LONGLONG tick = Util::getTick();
+	{
+		for (size_t i = 0; i < clip.tracks.size(); ++i)
+		{
+			for (uint32_t frameNo = 0; frameNo < clip.numFrames; ++frameNo)
+			{
+				auto& [rotation, translation] = exact.at(i * clip.numFrames + frameNo);
+				rotation = XMQuaternionIdentity();
+				translation = XMVectorZero();
+				samplers.at(i)(frameNo, &rotation, &translation);
+			}
+		}
+	}
+	report.sampleTimeInUs = Util::toUs(Util::getTick() - tick) / numSamples;
+
+	tick = Util::getTick();
+	{
+		for (size_t i = 0; i < clip.tracks.size(); ++i)
+		{
+			for (uint32_t frameNo = 0; frameNo < clip.numFrames; ++frameNo)
+			{
+				auto& [rotation, translation] = decoded.at(i * clip.numFrames + frameNo);
+				decode(clip.tracks.at(i), frameNo, &rotation, &translation);
+			}
+		}
+	}
+	report.decodeTimeInUs = Util::toUs(Util::getTick() - tick) / numSamples;
+
+	for (size_t i = 0; i < clip.tracks.size(); ++i)
+	{
+		const Track& track = clip.tracks.at(i);
+		const float range = XMVectorGetX(XMVector3Length(XMVectorScale(XMLoadFloat3(&track.translationStep), UINT16_MAX)));
+
+		for (uint32_t frameNo = 0; frameNo < clip.numFrames; ++frameNo)
+		{
+			const size_t idx = i * clip.numFrames + frameNo;
+			const float translationError = XMVectorGetX(XMVector3Length(XMVectorSubtract(exact.at(idx).second, decoded.at(idx).second)));
+
+			report.maxRotationError = std::max(report.maxRotationError, getAngle(exact.at(idx).first, decoded.at(idx).first));
+			report.maxTranslationError = std::max(report.maxTranslationError, translationError);
+			report.maxRelativeTranslationError = std::max(report.maxRelativeTranslationError, (range > 0.0f) ? translationError / range : translationError);
+		}
+	}
+
+	return report;
+}
+
+bool selfCheck()
+{
+	// the largest component in each place and with each sign, and ones at the edges of the range
+	const XMVECTOR rotations[] = {
+		XMQuaternionIdentity(),
+		XMVectorSet(0.0f, 0.0f, 0.0f, -1.0f),
+		XMQuaternionRotationRollPitchYaw(0.3f, -1.2f, 2.5f),
+		XMQuaternionRotationRollPitchYaw(-2.9f, 0.1f, 0.4f),
+		XMVectorSet(0.9f, -0.1f, 0.3f, 0.2f),
+		XMVectorSet(-0.1f, -0.9f, 0.3f, 0.2f),
+		XMVectorSet(0.1f, 0.3f, -0.9f, -0.2f),
+		XMVectorSet(0.5f, 0.5f, 0.5f, 0.5f),
+		XMVectorSet(0.70710678f, 0.0f, -0.70710678f, 0.0f),
+	};
+
+	for (const XMVECTOR& rotation : rotations)
+	{
+		uint16_t packed[3] = { };
+		encodeRotation(rotation, packed);
+
+		if (getAngle(rotation, decodeRotation(packed)) > kMaxRotationError)
+			return false;
+	}
+
+	// a track which turns and moves, against its sampler. The other stays in place and keeps no translations
+	constexpr uint32_t kNumFrames = 90;
+	const std::vector<Sampler> samplers = {
+		[](uint32_t frameNo, XMVECTOR* pRotation, XMVECTOR* pTranslation) {
+			const float t = static_cast<float>(frameNo) / kNumFrames;
+			*pRotation = XMQuaternionRotationRollPitchYaw(6.0f * t, -3.0f * t, 1.0f);
+			*pTranslation = XMVectorSet(10.0f * t, -2.0f, std::sin(7.0f * t), 0.0f);
+		},
+		[](uint32_t, XMVECTOR* pRotation, XMVECTOR* pTranslation) {
+			*pRotation = XMQuaternionRotationRollPitchYaw(0.2f, 0.0f, 0.0f);
+			*pTranslation = XMVectorSet(1.0f, 2.0f, 3.0f, 0.0f);
+		},
+	};
+
+	Clip clip = { };
+	clip.numFrames = kNumFrames;
+
+	for (uint32_t i = 0; i < samplers.size(); ++i)
+	{
+		clip.tracks.push_back(bakeTrack(i, kNumFrames, samplers.at(i)));
+	}
+
+	if (clip.tracks.at(0).translations.size() != 3 * kNumFrames || !clip.tracks.at(1).translations.empty())
+		return false;
+
+	const Report report = measure(clip, samplers);
+
+	return report.maxRotationError <= kMaxRotationError
+		&& report.maxRelativeTranslationError <= kMaxTranslationError
+		&& report.numBytes < sizeof(Track) * 2 + sizeof(uint16_t) * kNumFrames * 9 + 1;
+}
+
+} // namespace MotionBake
@@ -0,0 +1,62 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <DirectXMath.h>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#pragma warning(pop)
+
+// The motions sampled at every frame into fixed rate tracks, so that the playback reads a frame instead of
+// searching the keyframes and solving their Bezier curves. A rotation is packed in 48 bits by the smallest three
+// of its components, 15 bits each, and the index of the largest one in the two bits left. A translation is 16 bits
+// a component over the range of its track, and a track which does not move keeps none.
+namespace MotionBake {
+
+constexpr float kMaxRotationError = 1e-3f; // radians, of a decoded rotation to the sampled one
+constexpr float kMaxTranslationError = 1e-4f; // of the range of the track
+
+struct Track
+{
+	uint32_t bone = 0;
+	std::vector<uint16_t> rotations; // three a frame
+	std::vector<uint16_t> translations; // three a frame. Empty if the track does not move
+	DirectX::XMFLOAT3 translationMin = { };
+	DirectX::XMFLOAT3 translationStep = { }; // of a unit of the 16 bits
+};
+
+struct Clip
+{
+	uint32_t numFrames = 0;
+	std::vector<Track> tracks;
+};
+
+// the exact rotation as a quaternion and the translation at a frame
+using Sampler = std::function<void(uint32_t frameNo, DirectX::XMVECTOR* pRotation, DirectX::XMVECTOR* pTranslation)>;
+
+struct Report
+{
+	size_t numBytes = 0; // of the tracks
+	float maxRotationError = 0.0f; // radians
+	float maxTranslationError = 0.0f; // in the units of the model
+	float maxRelativeTranslationError = 0.0f; // of the range of the track
+	float sampleTimeInUs = 0.0f; // a bone a frame, by the sampler
+	float decodeTimeInUs = 0.0f; // a bone a frame, by decode()
+};
+
+// a rotation into three 16 bit words, and back. Shared with the motion compressor
+void encodeRotation(DirectX::FXMVECTOR rotation, uint16_t* pDst);
+DirectX::XMVECTOR decodeRotation(const uint16_t* pSrc);
+// radians, of the rotation from one quaternion to the other
+float getAngle(DirectX::FXMVECTOR a, DirectX::FXMVECTOR b);
+
+Track bakeTrack(uint32_t bone, uint32_t numFrames, const Sampler& sample);
+// frameNo must be below the number of the frames of the clip
+void decode(const Track& track, uint32_t frameNo, DirectX::XMVECTOR* pRotation, DirectX::XMVECTOR* pTranslation);
+// the tracks against the samplers they were baked from, one per track, at every frame
+Report measure(const Clip& clip, const std::vector<Sampler>& samplers);
+
+bool selfCheck();
+
+} // namespace MotionBake
@@ -0,0 +1,553 @@
+#include "motion_cache.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#pragma warning(pop)
+#include "debug.h"
+#include "motion_bake.h"
+#include "util.h"
+
+#undef min
+#undef max
+
+using namespace DirectX;
+
+namespace {
+	constexpr float kCurveUnit = 127.0f; // of a coordinate of the curve, as in the VMD
+	constexpr size_t kVmdHeaderSize = 30 + 20; // the signature and the name of the model
+	constexpr size_t kVmdMorphSize = 23;
+	constexpr size_t kVmdCameraSize = 61;
+	constexpr size_t kVmdLightSize = 28;
+	constexpr size_t kVmdSelfShadowSize = 9;
+	constexpr size_t kVmdIkBoneNameSize = 20;
+
+#pragma pack(push, 1)
+	struct VmdMotion
+	{
+		char boneName[15] = { };
+		uint32_t frameNo = 0;
+		XMFLOAT3 location = { };
+		XMFLOAT4 quaternion = { };
+		uint8_t bezier[64] = { }; // the curves of x, y, z and the rotation, of which the one of the rotation is used
+	};
+#pragma pack(pop)
+	static_assert(sizeof(VmdMotion) == 111);
+
+#pragma pack(push, 1)
+	struct PackedKey
+	{
+		uint32_t frameNo = 0;
+		uint16_t rotation[3] = { };
+		uint8_t curve[4] = { }; // x and y of p1, then of p2
+	};
+#pragma pack(pop)
+	static_assert(sizeof(PackedKey) == 14);
+
+	template <typename T>
+	void writeVector(const std::vector<T>& src, std::vector<uint8_t>* pDst)
+	{
+		const uint32_t count = static_cast<uint32_t>(src.size());
+		const uint8_t* const countBytes = reinterpret_cast<const uint8_t*>(&count);
+		const uint8_t* const bytes = reinterpret_cast<const uint8_t*>(src.data());
+
+		pDst->insert(pDst->end(), countBytes, countBytes + sizeof(count));
+		pDst->insert(pDst->end(), bytes, bytes + sizeof(T) * src.size());
+	}
+
+	// false if the data ends before the vector
+	template <typename T>
+	bool readVector(const std::vector<uint8_t>& src, size_t* pOffset, std::vector<T>* pDst)
+	{
+		uint32_t count = 0;
+
+		if (src.size() - *pOffset < sizeof(count))
+			return false;
+
+		std::memcpy(&count, src.data() + *pOffset, sizeof(count));
+		*pOffset += sizeof(count);
+
+		if ((src.size() - *pOffset) / sizeof(T) < count)
+			return false;
+
+		pDst->resize(count);
+		std::memcpy(pDst->data(), src.data() + *pOffset, sizeof(T) * count);
+		*pOffset += sizeof(T) * count;
+
+		return true;
+	}
+
+	bool readFile(const std::string& path, std::vector<uint8_t>* data)
+	{
+		FILE* fp = nullptr;
+		if (fopen_s(&fp, path.c_str(), "rb") != 0)
+			return false;
+
+		ThrowIfFalse(fseek(fp, 0, SEEK_END) == 0);
+		const long size = ftell(fp);
+		ThrowIfFalse(fseek(fp, 0, SEEK_SET) == 0);
+
+		data->resize(static_cast<size_t>(size));
+		const bool bRead = (size == 0) || (fread(data->data(), data->size(), 1, fp) == 1);
+		ThrowIfFalse(fclose(fp) == 0);
+
+		return bRead;
+	}
+
+	// false if the data ends before the value
+	bool readBytes(const std::vector<uint8_t>& src, size_t* pOffset, void* pDst, size_t size)
+	{
+		if (src.size() - *pOffset < size)
+			return false;
+
+		std::memcpy(pDst, src.data() + *pOffset, size);
+		*pOffset += size;
+
+		return true;
+	}
+
+	// the records of a VMD which the actors do not play
+	bool skipRecords(const std::vector<uint8_t>& src, size_t* pOffset, size_t recordSize)
+	{
+		uint32_t count = 0;
+
+		if (!readBytes(src, pOffset, &count, sizeof(count)) || (src.size() - *pOffset) / recordSize < count)
+			return false;
+
+		*pOffset += recordSize * count;
+
+		return true;
+	}
+
+	uint8_t packCurve(float v)
+	{
+		return static_cast<uint8_t>(std::clamp(std::round(v * kCurveUnit), 0.0f, kCurveUnit));
+	}
+} // namespace anonymous
+
+HRESULT MotionCache::init(const char* cacheDir)
+{
+	ThrowIfFalse(cacheDir != nullptr);
+
+	m_cacheDir = cacheDir;
+
+	std::error_code ec;
+	std::filesystem::create_directories(m_cacheDir, ec);
+
+	return S_OK;
+}
+
+void MotionCache::release()
+{
+	Debug::debugOutputFormatString("Motion cache: hit %u, miss %u\n", m_numHits, m_numMisses);
+}
+
+MotionCache::Motion MotionCache::load(const std::string& vmdPath)
+{
+	std::vector<uint8_t> vmd;
+	ThrowIfFalse(readFile(vmdPath, &vmd));
+
+	const uint64_t key = computeKey(vmd);
+	const std::string path = getEntryPath(key);
+	Motion motion;
+
+	if (std::vector<uint8_t> data; readFile(path, &data) && deserialize(data, &motion))
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_numHits;
+
+		return motion;
+	}
+
+	Debug::debugOutputFormatString("Motion cache miss: %s. Run with --motion-report to build it offline\n", vmdPath.c_str());
+
+	ThrowIfFalse(parseVmd(vmd, &motion));
+	motion.tracks = MotionCompressor::compress(motion.tracks, { MotionCompressor::kMaxRotationError, MotionCompressor::kMaxTranslationError });
+
+	const auto data = serialize(motion);
+	ThrowIfFalse(deserialize(data, &motion));
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	++m_numMisses;
+
+	// not fatal. It is compressed again on the next run
+	FILE* fp = nullptr;
+	if (fopen_s(&fp, path.c_str(), "wb") == 0)
+	{
+		ThrowIfFalse(fwrite(data.data(), data.size(), 1, fp) == 1);
+		ThrowIfFalse(fclose(fp) == 0);
+	}
+
+	return motion;
+}
+
+bool MotionCache::readVmd(const std::string& vmdPath, Motion* pMotion)
+{
+	std::vector<uint8_t> vmd;
+
+	return readFile(vmdPath, &vmd) && parseVmd(vmd, pMotion);
+}
+
+bool MotionCache::parseVmd(const std::vector<uint8_t>& vmd, Motion* pMotion)
+{
+	ThrowIfFalse(pMotion != nullptr);
+
+	size_t offset = kVmdHeaderSize;
+	uint32_t numKeys = 0;
+
+	if (vmd.size() < offset || !readBytes(vmd, &offset, &numKeys, sizeof(numKeys)) || (vmd.size() - offset) / sizeof(VmdMotion) < numKeys)
+		return false;
+
+	Motion motion;
+	std::map<std::string, std::vector<MotionCompressor::Key>> keys;
+
+	for (uint32_t i = 0; i < numKeys; ++i)
+	{
+		VmdMotion vmdMotion = { };
+		ThrowIfFalse(readBytes(vmd, &offset, &vmdMotion, sizeof(vmdMotion)));
+
+		MotionCompressor::Key key = { };
+		key.frameNo = vmdMotion.frameNo;
+		key.rotation = vmdMotion.quaternion;
+		key.offset = vmdMotion.location;
+		key.p1 = { vmdMotion.bezier[3] / kCurveUnit, vmdMotion.bezier[7] / kCurveUnit };
+		key.p2 = { vmdMotion.bezier[11] / kCurveUnit, vmdMotion.bezier[15] / kCurveUnit };
+
+		keys[std::string(vmdMotion.boneName, strnlen(vmdMotion.boneName, sizeof(vmdMotion.boneName)))].push_back(key);
+		motion.duration = std::max(motion.duration, key.frameNo);
+	}
+
+	if (!skipRecords(vmd, &offset, kVmdMorphSize)
+		|| !skipRecords(vmd, &offset, kVmdCameraSize)
+		|| !skipRecords(vmd, &offset, kVmdLightSize)
+		|| !skipRecords(vmd, &offset, kVmdSelfShadowSize))
+		return false;
+
+	// the older files end before the IK switches
+	if (uint32_t numIkSwitches = 0; readBytes(vmd, &offset, &numIkSwitches, sizeof(numIkSwitches)))
+	{
+		for (uint32_t i = 0; i < numIkSwitches; ++i)
+		{
+			IkSwitch ikSwitch;
+			uint8_t visible = 0; // not used
+			uint32_t numBones = 0;
+
+			if (!readBytes(vmd, &offset, &ikSwitch.frameNo, sizeof(ikSwitch.frameNo))
+				|| !readBytes(vmd, &offset, &visible, sizeof(visible))
+				|| !readBytes(vmd, &offset, &numBones, sizeof(numBones)))
+				return false;
+
+			for (uint32_t j = 0; j < numBones; ++j)
+			{
+				char name[kVmdIkBoneNameSize] = "";
+				uint8_t flag = 0;
+
+				if (!readBytes(vmd, &offset, name, sizeof(name)) || !readBytes(vmd, &offset, &flag, sizeof(flag)))
+					return false;
+
+				ikSwitch.bones.push_back({ std::string(name, strnlen(name, sizeof(name))), flag != 0 });
+			}
+
+			motion.ikSwitches.push_back(std::move(ikSwitch));
+		}
+	}
+
+	for (auto& [boneName, boneKeys] : keys)
+	{
+		std::stable_sort(boneKeys.begin(), boneKeys.end(), [](const auto& a, const auto& b) { return a.frameNo < b.frameNo; });
+		motion.tracks.push_back({ boneName, std::move(boneKeys) });
+	}
+
+	*pMotion = std::move(motion);
+
+	return true;
+}
+
+uint64_t MotionCache::computeKey(const std::vector<uint8_t>& vmd)
+{
+	Util::Fnv1a hasher;
+	hasher.add(kVersion);
+	hasher.add(MotionCompressor::kMaxRotationError);
+	hasher.add(MotionCompressor::kMaxTranslationError);
+	hasher.add(vmd.size());
+	hasher.addBytes(vmd.data(), vmd.size());
+
+	return hasher.get();
+}
+
+std::vector<uint8_t> MotionCache::serialize(const Motion& motion)
+{
+	std::vector<uint8_t> data;
+	writeVector(std::vector<uint32_t>{ kFileMagic, kVersion, motion.duration, static_cast<uint32_t>(motion.tracks.size()), static_cast<uint32_t>(motion.ikSwitches.size()) }, &data);
+
+	for (const auto& track : motion.tracks)
+	{
+		std::vector<PackedKey> keys(track.keys.size());
+		std::vector<XMFLOAT3> offsets;
+
+		for (size_t i = 0; i < keys.size(); ++i)
+		{
+			const MotionCompressor::Key& key = track.keys.at(i);
+
+			keys.at(i).frameNo = key.frameNo;
+			MotionBake::encodeRotation(XMLoadFloat4(&key.rotation), keys.at(i).rotation);
+			keys.at(i).curve[0] = packCurve(key.p1.x);
+			keys.at(i).curve[1] = packCurve(key.p1.y);
+			keys.at(i).curve[2] = packCurve(key.p2.x);
+			keys.at(i).curve[3] = packCurve(key.p2.y);
+			offsets.push_back(key.offset);
+		}
+
+		// one offset for a track which does not move
+		if (std::all_of(offsets.begin(), offsets.end(), [&](const XMFLOAT3& o) { return std::memcmp(&o, &offsets.front(), sizeof(o)) == 0; }))
+			offsets.resize(std::min<size_t>(offsets.size(), 1));
+
+		writeVector(std::vector<char>(track.boneName.begin(), track.boneName.end()), &data);
+		writeVector(keys, &data);
+		writeVector(offsets, &data);
+	}
+
+	for (const auto& ikSwitch : motion.ikSwitches)
+	{
+		std::vector<uint8_t> flags;
+
+		for (const auto& [boneName, bEnabled] : ikSwitch.bones)
+		{
+			flags.push_back(bEnabled ? 1 : 0);
+		}
+
+		writeVector(std::vector<uint32_t>{ ikSwitch.frameNo }, &data);
+		writeVector(flags, &data);
+
+		for (const auto& [boneName, bEnabled] : ikSwitch.bones)
+		{
+			writeVector(std::vector<char>(boneName.begin(), boneName.end()), &data);
+		}
+	}
+
+	return data;
+}
+
+bool MotionCache::deserialize(const std::vector<uint8_t>& data, Motion* pMotion)
+{
+	ThrowIfFalse(pMotion != nullptr);
+
+	size_t offset = 0;
+	std::vector<uint32_t> header;
+
+	if (!readVector(data, &offset, &header) || header.size() != 5 || header.at(0) != kFileMagic || header.at(1) != kVersion || header.at(3) > data.size() || header.at(4) > data.size())
+		return false;
+
+	Motion motion;
+	motion.duration = header.at(2);
+	motion.tracks.resize(header.at(3));
+	motion.ikSwitches.resize(header.at(4));
+
+	for (auto& track : motion.tracks)
+	{
+		std::vector<char> name;
+		std::vector<PackedKey> keys;
+		std::vector<XMFLOAT3> offsets;
+
+		if (!readVector(data, &offset, &name) || !readVector(data, &offset, &keys) || !readVector(data, &offset, &offsets))
+			return false;
+
+		if (offsets.size() != keys.size() && !(offsets.size() == 1 && !keys.empty()))
+			return false;
+
+		track.boneName.assign(name.begin(), name.end());
+		track.keys.resize(keys.size());
+
+		for (size_t i = 0; i < keys.size(); ++i)
+		{
+			MotionCompressor::Key& key = track.keys.at(i);
+			const PackedKey& packed = keys.at(i);
+
+			key.frameNo = packed.frameNo;
+			XMStoreFloat4(&key.rotation, MotionBake::decodeRotation(packed.rotation));
+			key.offset = offsets.at(std::min(i, offsets.size() - 1));
+			key.p1 = { packed.curve[0] / kCurveUnit, packed.curve[1] / kCurveUnit };
+			key.p2 = { packed.curve[2] / kCurveUnit, packed.curve[3] / kCurveUnit };
+		}
+	}
+
+	for (auto& ikSwitch : motion.ikSwitches)
+	{
+		std::vector<uint32_t> frameNo;
+		std::vector<uint8_t> flags;
+
+		if (!readVector(data, &offset, &frameNo) || frameNo.size() != 1 || !readVector(data, &offset, &flags))
+			return false;
+
+		ikSwitch.frameNo = frameNo.front();
+
+		for (const uint8_t flag : flags)
+		{
+			std::vector<char> name;
+
+			if (!readVector(data, &offset, &name))
+				return false;
+
+			ikSwitch.bones.push_back({ std::string(name.begin(), name.end()), flag != 0 });
+		}
+	}
+
+	if (offset != data.size())
+		return false;
+
+	*pMotion = std::move(motion);
+
+	return true;
+}
+
+std::string MotionCache::getEntryPath(uint64_t key) const
+{
+	char name[32] = "";
+	ThrowIfFalse(sprintf_s(name, "%016llx.motion", static_cast<unsigned long long>(key)) != -1);
+
+	return (std::filesystem::path(m_cacheDir) / name).string();
+}
+
+bool MotionCache::selfCheck()
+{
+	// a bone which turns and one which moves too, and one with no keys
+	std::vector<MotionCompressor::Track> tracks(3);
+	tracks.at(0).boneName = "a";
+	tracks.at(1).boneName = "b";
+	tracks.at(2).boneName = "c";
+
+	for (uint32_t frameNo = 0; frameNo < 40; ++frameNo)
+	{
+		MotionCompressor::Key key = { };
+		key.frameNo = frameNo;
+		XMStoreFloat4(&key.rotation, XMQuaternionRotationRollPitchYaw(0.02f * frameNo, 0.0f, 0.0f));
+		key.p1 = { 20.0f / kCurveUnit, 20.0f / kCurveUnit };
+		key.p2 = { 107.0f / kCurveUnit, 107.0f / kCurveUnit };
+		tracks.at(1).keys.push_back(key);
+
+		key.offset = { 0.0f, 0.1f * frameNo * frameNo, 0.0f };
+		tracks.at(0).keys.push_back(key);
+	}
+
+	// a VMD of the keys, the last first, with no morphs, cameras, lights nor shadows, and an IK switch
+	std::vector<uint8_t> vmd(kVmdHeaderSize);
+	{
+		const auto append = [&vmd](const void* src, size_t size) {
+			vmd.insert(vmd.end(), static_cast<const uint8_t*>(src), static_cast<const uint8_t*>(src) + size);
+		};
+
+		const uint32_t numKeys = static_cast<uint32_t>(tracks.at(0).keys.size() + tracks.at(1).keys.size());
+		append(&numKeys, sizeof(numKeys));
+
+		for (const auto& track : { tracks.at(1), tracks.at(0) })
+		{
+			for (auto it = track.keys.rbegin(); it != track.keys.rend(); ++it)
+			{
+				VmdMotion vmdMotion = { };
+				std::memcpy(vmdMotion.boneName, track.boneName.c_str(), track.boneName.size());
+				vmdMotion.frameNo = it->frameNo;
+				vmdMotion.location = it->offset;
+				vmdMotion.quaternion = it->rotation;
+				vmdMotion.bezier[3] = packCurve(it->p1.x);
+				vmdMotion.bezier[7] = packCurve(it->p1.y);
+				vmdMotion.bezier[11] = packCurve(it->p2.x);
+				vmdMotion.bezier[15] = packCurve(it->p2.y);
+				append(&vmdMotion, sizeof(vmdMotion));
+			}
+		}
+
+		const uint32_t counts[] = { 0, 0, 0, 0, 1, 30 }; // the records skipped, then an IK switch at frame 30
+		append(counts, sizeof(counts));
+
+		const uint8_t visible = 1;
+		const uint32_t numBones = 1;
+		const char name[kVmdIkBoneNameSize] = "ik";
+		const uint8_t flag = 0;
+		append(&visible, sizeof(visible));
+		append(&numBones, sizeof(numBones));
+		append(name, sizeof(name));
+		append(&flag, sizeof(flag));
+	}
+
+	// the keys as authored, by frame, and the IK switch
+	Motion authored;
+	{
+		if (!parseVmd(vmd, &authored) || authored.duration != 39 || authored.tracks.size() != 2)
+			return false;
+
+		for (size_t i = 0; i < authored.tracks.size(); ++i)
+		{
+			const auto& track = authored.tracks.at(i);
+			const auto& source = tracks.at(i);
+
+			if (track.boneName != source.boneName || track.keys.size() != source.keys.size()
+				|| std::memcmp(track.keys.data(), source.keys.data(), sizeof(MotionCompressor::Key) * source.keys.size()) != 0)
+				return false;
+		}
+
+		if (authored.ikSwitches.size() != 1 || authored.ikSwitches.front().frameNo != 30
+			|| authored.ikSwitches.front().bones != std::vector<std::pair<std::string, bool>>{ { "ik", false } })
+			return false;
+
+		// the IK switches are optional, the keys are not
+		Motion motion;
+
+		if (!parseVmd(std::vector<uint8_t>(vmd.begin(), vmd.end() - (sizeof(uint32_t) * 3 + 2 + kVmdIkBoneNameSize)), &motion) || !motion.ikSwitches.empty()
+			|| parseVmd(std::vector<uint8_t>(vmd.begin(), vmd.begin() + kVmdHeaderSize + 100), &motion))
+			return false;
+	}
+
+	Motion compressed = authored;
+	compressed.tracks = MotionCompressor::compress(authored.tracks, { MotionCompressor::kMaxRotationError, MotionCompressor::kMaxTranslationError });
+	compressed.tracks.push_back(tracks.at(2));
+	const auto data = serialize(compressed);
+
+	// the same motion back, and the same bytes from it
+	{
+		Motion loaded;
+
+		if (!deserialize(data, &loaded) || serialize(loaded) != data || loaded.tracks.size() != compressed.tracks.size()
+			|| loaded.duration != authored.duration || loaded.ikSwitches.size() != 1 || loaded.ikSwitches.front().bones != authored.ikSwitches.front().bones)
+			return false;
+
+		for (size_t i = 0; i < authored.tracks.size(); ++i)
+		{
+			const MotionCompressor::Error error = MotionCompressor::measure(authored.tracks.at(i).keys, loaded.tracks.at(i).keys);
+
+			if (loaded.tracks.at(i).keys.size() != compressed.tracks.at(i).keys.size()
+				|| error.rotation > MotionCompressor::kMaxRotationError
+				|| error.translation > MotionCompressor::kMaxTranslationError)
+				return false;
+		}
+	}
+
+	// a truncated file, and one of another version
+	{
+		Motion loaded;
+
+		if (deserialize(std::vector<uint8_t>(data.begin(), data.end() - 1), &loaded) || deserialize({ }, &loaded))
+			return false;
+
+		auto stale = data;
+		stale.at(sizeof(uint32_t) * 2) ^= 0xff; // the version
+
+		if (deserialize(stale, &loaded))
+			return false;
+	}
+
+	// any byte of the VMD is in the key
+	{
+		auto changed = vmd;
+		changed.back() ^= 1;
+
+		if (computeKey(changed) == computeKey(vmd))
+			return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#pragma warning(pop)
+#include "motion_compressor.h"
+
+// The motions of the VMD files with the keyframes reduced by MotionCompressor, kept in files keyed by the hash of the
+// bytes of the VMD, the error budget and kVersion. A hit is the whole motion, so the VMD is not parsed.
+// A key is 14 bytes in the file: the frame, the packed rotation and the curve. The offsets are 12 bytes a key,
+// or one for the track if it does not move. A miss compresses at load time and writes it back, and the entries are
+// also written offline by the motion report (--motion-report).
+class MotionCache
+{
+public:
+	struct IkSwitch
+	{
+		uint32_t frameNo = 0;
+		std::vector<std::pair<std::string, bool>> bones; // the IK of the bone is on or off from the frame
+	};
+
+	// what the actors play of a VMD: the keyframes of the bones and the IK switches
+	struct Motion
+	{
+		uint32_t duration = 0; // the last frame of the keys
+		std::vector<MotionCompressor::Track> tracks;
+		std::vector<IkSwitch> ikSwitches; // by frame
+	};
+
+	HRESULT init(const char* cacheDir);
+	void release();
+
+	// the motion with the tracks as loaded back from the file, which are the ones measured
+	Motion load(const std::string& vmdPath);
+
+	// the motion as authored, with the tracks ordered by the name of the bone
+	static bool readVmd(const std::string& vmdPath, Motion* pMotion);
+	static bool parseVmd(const std::vector<uint8_t>& vmd, Motion* pMotion);
+	static uint64_t computeKey(const std::vector<uint8_t>& vmd);
+	static std::vector<uint8_t> serialize(const Motion& motion);
+	static bool deserialize(const std::vector<uint8_t>& data, Motion* pMotion);
+	static bool selfCheck();
+
+private:
+	static constexpr uint32_t kFileMagic = 0x4e544f4d; // "MOTN"
+	static constexpr uint32_t kVersion = 2; // bump when MotionCompressor::compress() gives other keys for the same motion
+
+	std::string getEntryPath(uint64_t key) const;
+
+	std::string m_cacheDir;
+	std::mutex m_mutex; // the actors are loaded in parallel
+	uint32_t m_numHits = 0;
+	uint32_t m_numMisses = 0;
+};
@@ -0,0 +1,430 @@
+#include "motion_compressor.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#pragma warning(pop)
+#include "debug.h"
+#include "motion_bake.h"
+
+#undef min
+#undef max
+
+using namespace DirectX;
+
+namespace {
+	constexpr float kCurveUnit = 127.0f; // of a coordinate of the curve in the VMD
+	constexpr uint8_t kBezierIterations = 12; // as PmdActor samples the curve
+	constexpr XMFLOAT2 kLinearP1 = { 20.0f / kCurveUnit, 20.0f / kCurveUnit }; // the straight line, as the VMD has it
+	constexpr XMFLOAT2 kLinearP2 = { 107.0f / kCurveUnit, 107.0f / kCurveUnit };
+	constexpr float kRegularization = 1e-4f; // a pull of the fitted curve toward the straight line, of the trace of the normal matrix
+
+	float quantizeCurve(float v)
+	{
+		return std::round(std::clamp(v, 0.0f, 1.0f) * kCurveUnit) / kCurveUnit;
+	}
+
+	// the value as stored, so that the error is measured on it
+	MotionCompressor::Key makeKey(uint32_t frameNo, FXMVECTOR rotation, FXMVECTOR offset)
+	{
+		uint16_t packed[3] = { };
+		MotionBake::encodeRotation(rotation, packed);
+
+		MotionCompressor::Key key = { };
+		key.frameNo = frameNo;
+		XMStoreFloat4(&key.rotation, MotionBake::decodeRotation(packed));
+		XMStoreFloat3(&key.offset, offset);
+		key.p1 = kLinearP1;
+		key.p2 = kLinearP2;
+
+		return key;
+	}
+
+	// of the frames from the first key, in units of the budget. Within it if not above 1
+	float getError(const std::vector<MotionCompressor::Key>& keys, const std::vector<std::pair<XMVECTOR, XMVECTOR>>& frames, uint32_t firstFrameNo, uint32_t from, uint32_t to, const MotionCompressor::Error& maxError)
+	{
+		float error = 0.0f;
+
+		for (uint32_t i = from; i <= to; ++i)
+		{
+			XMVECTOR rotation = { };
+			XMVECTOR offset = { };
+			ThrowIfFalse(MotionCompressor::sample(keys, firstFrameNo + i, &rotation, &offset));
+
+			error = std::max(error, MotionBake::getAngle(rotation, frames.at(i).first) / maxError.rotation);
+			error = std::max(error, XMVectorGetX(XMVector3Length(XMVectorSubtract(offset, frames.at(i).second))) / maxError.translation);
+		}
+
+		return error;
+	}
+
+	// least squares on the y of the control points. With their x at a third and two thirds, x is t, and y is a cubic of t
+	// whose two middle terms are the unknowns. The share of the way at a frame is taken from the angle and from the
+	// distance, each weighed by its span in units of its budget
+	void fitCurve(const MotionCompressor::Key& fromKey, const MotionCompressor::Key& toKey, const std::vector<std::pair<XMVECTOR, XMVECTOR>>& frames, uint32_t from, uint32_t to, const MotionCompressor::Error& maxError, MotionCompressor::Key* pKey)
+	{
+		const XMVECTOR fromRotation = XMLoadFloat4(&fromKey.rotation);
+		const XMVECTOR fromOffset = XMLoadFloat3(&fromKey.offset);
+		const XMVECTOR span = XMVectorSubtract(XMLoadFloat3(&toKey.offset), fromOffset);
+		const float angle = MotionBake::getAngle(fromRotation, XMLoadFloat4(&toKey.rotation));
+		const float distance = XMVectorGetX(XMVector3Length(span));
+		const float rotationWeight = angle / maxError.rotation;
+		const float translationWeight = distance / maxError.translation;
+
+		double normal[2][2] = { };
+		double rhs[2] = { };
+
+		auto add = [&](double t, double share, double weight) {
+			const double b0 = 3.0 * t * (1.0 - t) * (1.0 - t);
+			const double b1 = 3.0 * t * t * (1.0 - t);
+			const double r = share - t * t * t;
+			const double w = weight * weight;
+
+			normal[0][0] += w * b0 * b0;
+			normal[0][1] += w * b0 * b1;
+			normal[1][1] += w * b1 * b1;
+			rhs[0] += w * b0 * r;
+			rhs[1] += w * b1 * r;
+		};
+
+		for (uint32_t i = from + 1; i < to; ++i)
+		{
+			const double t = static_cast<double>(i - from) / static_cast<double>(to - from);
+
+			if (angle > 0.0f)
+				add(t, MotionBake::getAngle(fromRotation, frames.at(i).first) / angle, rotationWeight);
+
+			if (distance > 0.0f)
+				add(t, XMVectorGetX(XMVector3Dot(XMVectorSubtract(frames.at(i).second, fromOffset), span)) / (distance * distance), translationWeight);
+		}
+
+		const double lambda = kRegularization * (normal[0][0] + normal[1][1]) + 1e-12;
+		normal[0][0] += lambda;
+		normal[1][1] += lambda;
+		rhs[0] += lambda / 3.0;
+		rhs[1] += lambda * 2.0 / 3.0;
+
+		const double det = normal[0][0] * normal[1][1] - normal[0][1] * normal[0][1];
+		const double y1 = (rhs[0] * normal[1][1] - rhs[1] * normal[0][1]) / det;
+		const double y2 = (rhs[1] * normal[0][0] - rhs[0] * normal[0][1]) / det;
+
+		*pKey = toKey;
+		pKey->p1 = { quantizeCurve(1.0f / 3.0f), quantizeCurve(static_cast<float>(y1)) };
+		pKey->p2 = { quantizeCurve(2.0f / 3.0f), quantizeCurve(static_cast<float>(y2)) };
+	}
+} // namespace anonymous
+
+namespace MotionCompressor {
+
+float getYfromXOnBezier(float x, const XMFLOAT2& a, const XMFLOAT2& b, uint8_t n)
+{
+	if (a.x == a.y && b.x == b.y)
+		return x;
+
+	float t = x;
+	const float k0 = 1 + 3 * a.x - 3 * b.x; // coefficient of t^3
+	const float k1 = 3 * b.x - 6 * a.x; // coefficient of t^2
+	const float k2 = 3 * a.x; // coefficient of t
+
+	constexpr float epsilon = 0.0005f;
+
+	for (int32_t i = 0; i < n; ++i)
+	{
+		const float ft = k0 * t * t * t + k1 * t * t + k2 * t - x;
+
+		if (-epsilon <= ft && ft <= epsilon)
+			break;
+
+		t -= ft / 2;
+	}
+
+	const float r = 1 - t;
+
+	return (t * t * t) + (3 * t * t * r * b.y) + (3 * t * r * r * a.y);
+}
+
+bool sample(const std::vector<Key>& keys, uint32_t frameNo, XMVECTOR* pRotation, XMVECTOR* pOffset)
+{
+	auto rit = std::find_if(
+		keys.rbegin(),
+		keys.rend(),
+		[frameNo](const Key& key)
+		{
+			return key.frameNo <= frameNo;
+		});
+
+	if (rit == keys.rend())
+		return false;
+
+	*pRotation = XMLoadFloat4(&rit->rotation);
+	*pOffset = XMLoadFloat3(&rit->offset);
+	auto it = rit.base();
+
+	if (it != keys.end())
+	{
+		float t = static_cast<float>(frameNo - rit->frameNo) / static_cast<float>(it->frameNo - rit->frameNo);
+		t = getYfromXOnBezier(t, it->p1, it->p2, kBezierIterations);
+		*pRotation = XMQuaternionSlerp(*pRotation, XMLoadFloat4(&it->rotation), t);
+		*pOffset = XMVectorLerp(*pOffset, XMLoadFloat3(&it->offset), t);
+	}
+
+	return true;
+}
+
+std::vector<Key> reduce(const std::vector<Key>& keys, const Error& maxError)
+{
+	ThrowIfFalse(maxError.rotation > 0.0f && maxError.translation > 0.0f);
+
+	if (keys.empty())
+		return { };
+
+	const uint32_t firstFrameNo = keys.front().frameNo;
+	const uint32_t numFrames = keys.back().frameNo - firstFrameNo + 1;
+
+	std::vector<std::pair<XMVECTOR, XMVECTOR>> frames(numFrames);
+
+	for (uint32_t i = 0; i < numFrames; ++i)
+	{
+		ThrowIfFalse(sample(keys, firstFrameNo + i, &frames.at(i).first, &frames.at(i).second));
+	}
+
+	std::vector<Key> reduced = { makeKey(firstFrameNo, frames.front().first, frames.front().second) };
+
+	// a bone which stays within the budget of its first key needs no other
+	if (getError(reduced, frames, firstFrameNo, 0, numFrames - 1, maxError) <= 1.0f)
+		return reduced;
+
+	// the straight line, the fitted curve, and the curve of the keys if the segment is one of theirs.
+	// The best one, and whether it is within the budget
+	auto fit = [&](uint32_t from, uint32_t to, Key* pKey) {
+		const Key toKey = makeKey(firstFrameNo + to, frames.at(to).first, frames.at(to).second);
+		std::vector<Key> candidates = { toKey, toKey };
+		fitCurve(reduced.back(), toKey, frames, from, to, maxError, &candidates.back());
+
+		const auto next = std::upper_bound(keys.begin(), keys.end(), firstFrameNo + from, [](uint32_t frameNo, const Key& key) { return frameNo < key.frameNo; });
+
+		if (next != keys.end() && next->frameNo == firstFrameNo + to)
+		{
+			candidates.push_back(toKey);
+			candidates.back().p1 = next->p1;
+			candidates.back().p2 = next->p2;
+		}
+
+		float bestError = FLT_MAX;
+
+		for (const Key& candidate : candidates)
+		{
+			const float error = getError({ reduced.back(), candidate }, frames, firstFrameNo, from + 1, to, maxError);
+
+			if (error < bestError)
+			{
+				bestError = error;
+				*pKey = candidate;
+			}
+		}
+
+		return bestError <= 1.0f;
+	};
+
+	uint32_t from = 0;
+
+	while (from < numFrames - 1)
+	{
+		const uint32_t remaining = numFrames - 1 - from;
+
+		// the next frame is taken even above the budget, which is only the error of the packed rotation.
+		// Then by doubling while it fits, and by halving between the last fit and the first miss
+		Key key = { };
+		fit(from, from + 1, &key);
+		uint32_t good = 1;
+		uint32_t bad = 0;
+
+		for (uint32_t length = 2; good < remaining; length *= 2)
+		{
+			length = std::min(length, remaining);
+			Key candidate = { };
+
+			if (!fit(from, from + length, &candidate))
+			{
+				bad = length;
+				break;
+			}
+
+			good = length;
+			key = candidate;
+		}
+
+		while (bad > good + 1)
+		{
+			const uint32_t length = (good + bad) / 2;
+			Key candidate = { };
+
+			if (fit(from, from + length, &candidate))
+			{
+				good = length;
+				key = candidate;
+			}
+			else
+			{
+				bad = length;
+			}
+		}
+
+		// a key of the motion further on, with its own curve, may fit where the frames before it did not
+		for (auto it = std::lower_bound(keys.begin(), keys.end(), firstFrameNo + from + bad, [](const Key& k, uint32_t frameNo) { return k.frameNo < frameNo; });
+			bad > good + 1 && it != keys.begin() && (it - 1)->frameNo > firstFrameNo + from + good;
+			--it)
+		{
+			Key candidate = { };
+
+			if (fit(from, (it - 1)->frameNo - firstFrameNo, &candidate))
+			{
+				good = (it - 1)->frameNo - firstFrameNo - from;
+				key = candidate;
+				break;
+			}
+		}
+
+		reduced.push_back(key);
+		from += good;
+	}
+
+	// never more than the keys of the motion, which are within the budget but for the packed rotations
+	if (reduced.size() >= keys.size())
+	{
+		std::vector<Key> packed;
+
+		for (const Key& k : keys)
+		{
+			packed.push_back(makeKey(k.frameNo, XMLoadFloat4(&k.rotation), XMLoadFloat3(&k.offset)));
+			packed.back().p1 = k.p1;
+			packed.back().p2 = k.p2;
+		}
+
+		const Error error = measure(keys, packed);
+
+		if (error.rotation <= maxError.rotation && error.translation <= maxError.translation)
+			return packed;
+	}
+
+	return reduced;
+}
+
+std::vector<Track> compress(const std::vector<Track>& tracks, const Error& maxError)
+{
+	std::vector<Track> compressed;
+
+	for (const Track& track : tracks)
+	{
+		std::vector<Key> keys = track.keys;
+		std::stable_sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) { return a.frameNo < b.frameNo; });
+
+		compressed.push_back({ track.boneName, reduce(keys, maxError) });
+	}
+
+	std::sort(compressed.begin(), compressed.end(), [](const Track& a, const Track& b) { return a.boneName < b.boneName; });
+
+	return compressed;
+}
+
+Error measure(const std::vector<Key>& keys, const std::vector<Key>& reduced)
+{
+	Error error = { };
+
+	if (keys.empty() && reduced.empty())
+		return error;
+
+	uint32_t firstFrameNo = UINT32_MAX;
+	uint32_t lastFrameNo = 0;
+
+	for (const auto* pKeys : { &keys, &reduced })
+	{
+		if (pKeys->empty())
+			continue;
+
+		firstFrameNo = std::min(firstFrameNo, pKeys->front().frameNo);
+		lastFrameNo = std::max(lastFrameNo, pKeys->back().frameNo);
+	}
+
+	for (uint32_t frameNo = firstFrameNo; frameNo <= lastFrameNo; ++frameNo)
+	{
+		XMVECTOR rotations[2] = { XMQuaternionIdentity(), XMQuaternionIdentity() };
+		XMVECTOR offsets[2] = { XMVectorZero(), XMVectorZero() };
+		sample(keys, frameNo, &rotations[0], &offsets[0]);
+		sample(reduced, frameNo, &rotations[1], &offsets[1]);
+
+		error.rotation = std::max(error.rotation, MotionBake::getAngle(rotations[0], rotations[1]));
+		error.translation = std::max(error.translation, XMVectorGetX(XMVector3Length(XMVectorSubtract(offsets[0], offsets[1]))));
+	}
+
+	return error;
+}
+
+bool selfCheck()
+{
+	const Error maxError = { kMaxRotationError, kMaxTranslationError };
+
+	// a key at every frame, as a capture has, which turns with an ease and moves on a line for a while
+	std::vector<Key> captured;
+
+	for (uint32_t frameNo = 10; frameNo < 250; ++frameNo)
+	{
+		const float t = static_cast<float>(frameNo) / 60.0f;
+		Key key = { };
+		key.frameNo = frameNo;
+		XMStoreFloat4(&key.rotation, XMQuaternionRotationRollPitchYaw(0.3f * std::sin(t), 1.5f * t * t / (1.0f + t * t), 0.0f));
+		key.offset = { std::min(t, 2.0f), 0.0f, 0.5f };
+		key.p1 = kLinearP1;
+		key.p2 = kLinearP2;
+		captured.push_back(key);
+	}
+
+	const std::vector<Key> reduced = reduce(captured, maxError);
+	const Error capturedError = measure(captured, reduced);
+
+	if (reduced.empty() || reduced.front().frameNo != 10 || reduced.back().frameNo != 249 || reduced.size() * 4 > captured.size())
+		return false;
+
+	if (capturedError.rotation > maxError.rotation || capturedError.translation > maxError.translation)
+		return false;
+
+	// before the first key it stays in the bind pose, as it did
+	{
+		XMVECTOR rotation = { };
+		XMVECTOR offset = { };
+
+		if (sample(reduced, 9, &rotation, &offset))
+			return false;
+	}
+
+	// a few keys with their own curves, which are kept with them
+	std::vector<Key> authored(3);
+	authored.at(1).frameNo = 30;
+	XMStoreFloat4(&authored.at(1).rotation, XMQuaternionRotationRollPitchYaw(0.0f, 1.0f, 0.0f));
+	authored.at(1).p1 = { 100.0f / kCurveUnit, 10.0f / kCurveUnit };
+	authored.at(1).p2 = { 30.0f / kCurveUnit, 120.0f / kCurveUnit };
+	authored.at(2).frameNo = 45;
+	authored.at(2).offset = { 0.0f, 3.0f, 0.0f };
+	authored.at(2).p1 = kLinearP1;
+	authored.at(2).p2 = kLinearP2;
+
+	const std::vector<Key> reducedAuthored = reduce(authored, maxError);
+	const Error authoredError = measure(authored, reducedAuthored);
+
+	if (reducedAuthored.size() > authored.size() || authoredError.rotation > maxError.rotation || authoredError.translation > maxError.translation)
+		return false;
+
+	// one which does not move is a key
+	std::vector<Key> still(60);
+
+	for (uint32_t i = 0; i < still.size(); ++i)
+	{
+		still.at(i).frameNo = i;
+	}
+
+	return reduce(still, maxError).size() == 1 && reduce({ }, maxError).empty() && compress({ { "b", still }, { "a", { } } }, maxError).front().boneName == "a";
+}
+
+} // namespace MotionCompressor
@@ -0,0 +1,57 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <DirectXMath.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#pragma warning(pop)
+
+// The keyframes of a bone reduced to the fewest which stay within an angular and a positional error budget of the
+// motion as authored, at every frame it plays. The motion is sampled at every frame, then a key is laid as far from
+// the previous one as the budget allows, with the curve of the segment fitted by least squares on the y of its
+// Bezier control points, whose x are fixed at a third, so that the curve is a cubic of the frame. The curve is the one
+// of the VMD, 7 bits a coordinate, and the rotation of a key is packed as in MotionBake, so a reduced key is stored as is.
+namespace MotionCompressor {
+
+constexpr float kMaxRotationError = 2e-3f; // radians, a bone at a frame. Above the error of a packed rotation
+constexpr float kMaxTranslationError = 1e-3f; // in the units of the model, a bone at a frame
+
+// a keyframe of a bone, as the VMD has it
+struct Key
+{
+	uint32_t frameNo = 0;
+	DirectX::XMFLOAT4 rotation = { 0.0f, 0.0f, 0.0f, 1.0f }; // quaternion
+	DirectX::XMFLOAT3 offset = { };
+	DirectX::XMFLOAT2 p1 = { }; // Bezier control points of the curve from the previous key into this one
+	DirectX::XMFLOAT2 p2 = { };
+};
+
+struct Track
+{
+	std::string boneName;
+	std::vector<Key> keys; // by frame
+};
+
+struct Error
+{
+	float rotation = 0.0f; // radians
+	float translation = 0.0f; // in the units of the model
+};
+
+// the curve of the VMD from the previous key, t of the segment into the share of the way
+float getYfromXOnBezier(float x, const DirectX::XMFLOAT2& a, const DirectX::XMFLOAT2& b, uint8_t n);
+// false before the first key. After the last one, it is held
+bool sample(const std::vector<Key>& keys, uint32_t frameNo, DirectX::XMVECTOR* pRotation, DirectX::XMVECTOR* pOffset);
+
+// the keys by frame. The ones returned are packed, and are within maxError of the keys at every frame of them
+std::vector<Key> reduce(const std::vector<Key>& keys, const Error& maxError);
+// each track reduced, ordered by the name of the bone
+std::vector<Track> compress(const std::vector<Track>& tracks, const Error& maxError);
+// the largest one between the two at every frame of either, where the bind pose is before the first key
+Error measure(const std::vector<Key>& keys, const std::vector<Key>& reduced);
+
+bool selfCheck();
+
+} // namespace MotionCompressor
@@ -0,0 +1,134 @@
+#include "motion_report.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <algorithm>
+#include <cstdio>
+#pragma warning(pop)
+#include "config.h"
+#include "debug.h"
+#include "motion_cache.h"
+#include "motion_compressor.h"
+#include "util.h"
+
+#undef min
+#undef max
+
+namespace {
+	constexpr size_t kVmdMotionSize = 111; // a key of a bone in the VMD
+
+	// a bone at a frame, over every frame of the motion as the actor plays it
+	float getSampleTimeInUs(const std::vector<MotionCompressor::Track>& tracks, uint32_t numFrames)
+	{
+		DirectX::XMVECTOR sum = DirectX::XMVectorZero();
+		const LONGLONG start = Util::getTick();
+
+		for (const auto& track : tracks)
+		{
+			for (uint32_t frameNo = 0; frameNo < numFrames; ++frameNo)
+			{
+				DirectX::XMVECTOR rotation = DirectX::XMQuaternionIdentity();
+				DirectX::XMVECTOR offset = DirectX::XMVectorZero();
+				MotionCompressor::sample(track.keys, frameNo, &rotation, &offset);
+				sum = DirectX::XMVectorAdd(sum, DirectX::XMVectorAdd(rotation, offset));
+			}
+		}
+
+		const float timeInUs = Util::toUs(Util::getTick() - start);
+
+		// kept, so that the loop is not optimized away
+		ThrowIfFalse(!DirectX::XMVector4IsNaN(sum));
+
+		return timeInUs / std::max<size_t>(tracks.size() * numFrames, 1);
+	}
+} // namespace anonymous
+
+namespace MotionReport {
+
+int run(const std::vector<std::string>& vmdPaths)
+{
+	if (vmdPaths.empty())
+	{
+		printf("usage: --motion-report <vmd files>\n");
+		return 1;
+	}
+
+	MotionCache motionCache;
+	ThrowIfFailed(motionCache.init(Config::kMotionCacheDir));
+
+	printf("budget %.4f rad and %.4f a bone at a frame, %zd bytes a key in the VMD\n", MotionCompressor::kMaxRotationError, MotionCompressor::kMaxTranslationError, kVmdMotionSize);
+	printf("%-32s %6s %6s | %-15s | %-17s %6s | %-17s | %-15s\n", "motion", "tracks", "frames", "keys auth/comp", "bytes auth/comp", "ratio", "max error rad/pos", "sample us a bone");
+
+	int exitCode = 0;
+
+	for (const auto& path : vmdPaths)
+	{
+		MotionCache::Motion authored;
+
+		if (!MotionCache::readVmd(path, &authored))
+		{
+			printf("%s: failed to read\n", path.c_str());
+			exitCode = 1;
+			continue;
+		}
+
+		const MotionCache::Motion motion = motionCache.load(path);
+		const std::vector<MotionCompressor::Track>& tracks = authored.tracks;
+		const std::vector<MotionCompressor::Track>& compressed = motion.tracks;
+		const uint32_t numFrames = authored.duration + 1;
+
+		size_t numKeys = 0;
+		size_t numCompressedKeys = 0;
+		MotionCompressor::Error maxError = { };
+
+		for (const auto& track : tracks)
+		{
+			const auto it = std::find_if(compressed.begin(), compressed.end(), [&](const auto& t) { return t.boneName == track.boneName; });
+
+			if (it == compressed.end())
+			{
+				printf("%s: %s is missing\n", path.c_str(), track.boneName.c_str());
+				exitCode = 1;
+				continue;
+			}
+
+			const MotionCompressor::Error error = MotionCompressor::measure(track.keys, it->keys);
+			maxError.rotation = std::max(maxError.rotation, error.rotation);
+			maxError.translation = std::max(maxError.translation, error.translation);
+
+			numKeys += track.keys.size();
+			numCompressedKeys += it->keys.size();
+		}
+
+		// the bytes of the cache entry, which has the IK switches too
+		const size_t numBytes = kVmdMotionSize * numKeys;
+		const size_t numCompressedBytes = MotionCache::serialize(motion).size();
+
+		printf("%-32s %6zd %6u | %6zd %8zd | %8zd %8zd %5.1fx | %8.5f %8.5f | %6.3f %8.3f\n",
+			path.c_str(),
+			tracks.size(),
+			numFrames,
+			numKeys,
+			numCompressedKeys,
+			numBytes,
+			numCompressedBytes,
+			static_cast<float>(numBytes) / std::max<size_t>(numCompressedBytes, 1),
+			maxError.rotation,
+			maxError.translation,
+			getSampleTimeInUs(tracks, numFrames),
+			getSampleTimeInUs(compressed, numFrames));
+
+		if (maxError.rotation > MotionCompressor::kMaxRotationError || maxError.translation > MotionCompressor::kMaxTranslationError)
+		{
+			printf("%s: above the budget\n", path.c_str());
+			exitCode = 1;
+		}
+	}
+
+	motionCache.release();
+
+	return exitCode;
+}
+
+} // namespace MotionReport
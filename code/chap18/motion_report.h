@@ -0,0 +1,17 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <string>
+#include <vector>
+#pragma warning(pop)
+
+// A headless run over VMD files, which needs no window nor device: chap18.exe --motion-report <vmd files>.
+// Prints the keys and the bytes of the motions as authored and compressed, the largest error of a bone at a frame,
+// and the cost of sampling them, and writes them all to the motion cache.
+namespace MotionReport {
+
+// returns the exit code of the process
+int run(const std::vector<std::string>& vmdPaths);
+
+} // namespace MotionReport
@@ -5,6 +5,7 @@ enum class UiEvent {
 	kUpdateAutoMovePos,
 	kUpdateAutoLightPos,
 	kUpdateHighLuminanceThreshold,
+	kUpdateAnimationLod,
 };
 
 struct UiEventDataUpdateAutoMovePos {
@@ -19,6 +20,10 @@ struct UiEventDataUpdateHighLuminanceThreshold {
 	float val = 0.0f;
 };
 
+struct UiEventDataUpdateAnimationLod {
+	bool flag = false;
+};
+
 class Observer
 {
 public:
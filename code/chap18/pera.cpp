@@ -30,14 +30,11 @@ HRESULT Pera::compileShaders()
 {
 	ComPtr<ID3DBlob> errBlob = nullptr;
 
-	auto result = D3DCompileFromFile(
+	auto result = Resource::instance()->getShaderCache()->load(
 		L"peraVertex.hlsl",
 		nullptr,
-		D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		"main",
-		Constant::kVsShaderModel,
-		0,
-		0,
+		Constant::kDxcVsShaderModel,
 		m_vs.ReleaseAndGetAddressOf(),
 		errBlob.ReleaseAndGetAddressOf());
 
@@ -47,14 +44,11 @@ HRESULT Pera::compileShaders()
 	}
 	ThrowIfFailed(result);
 
-	result = D3DCompileFromFile(
+	result = Resource::instance()->getShaderCache()->load(
 		L"peraPixel.hlsl",
 		nullptr,
-		D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		"peraPs",
-		Constant::kPsShaderModel,
-		0,
-		0,
+		Constant::kDxcPsShaderModel,
 		m_ps_bokehH.ReleaseAndGetAddressOf(),
 		errBlob.ReleaseAndGetAddressOf());
 
@@ -64,14 +58,11 @@ HRESULT Pera::compileShaders()
 	}
 	ThrowIfFailed(result);
 
-	result = D3DCompileFromFile(
+	result = Resource::instance()->getShaderCache()->load(
 		L"peraPixel.hlsl",
 		nullptr,
-		D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		"verticalBokehPs",
-		Constant::kPsShaderModel,
-		0,
-		0,
+		Constant::kDxcPsShaderModel,
 		m_ps_bokehV.ReleaseAndGetAddressOf(),
 		errBlob.ReleaseAndGetAddressOf());
 
@@ -81,14 +72,11 @@ HRESULT Pera::compileShaders()
 	}
 	ThrowIfFailed(result);
 
-	result = D3DCompileFromFile(
+	result = Resource::instance()->getShaderCache()->load(
 		L"peraPixel.hlsl",
 		nullptr,
-		D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		"effectPs",
-		Constant::kPsShaderModel,
-		0,
-		0,
+		Constant::kDxcPsShaderModel,
 		m_ps_effect.ReleaseAndGetAddressOf(),
 		errBlob.ReleaseAndGetAddressOf());
 
@@ -197,11 +185,10 @@ HRESULT Pera::createPipelineState()
 		}
 		ThrowIfFailed(result);
 
-		result = Resource::instance()->getDevice()->CreateRootSignature(
-			0,
+		result = Resource::instance()->getPipelineCache()->createRootSignature(
 			rsBlob->GetBufferPointer(),
 			rsBlob->GetBufferSize(),
-			IID_PPV_ARGS(m_rootSignature_bokeh.ReleaseAndGetAddressOf()));
+			m_rootSignature_bokeh.ReleaseAndGetAddressOf());
 		ThrowIfFailed(result);
 
 		result = m_rootSignature_bokeh.Get()->SetName(Util::getWideStringFromString("peraRootSignatureBokeh").c_str());
@@ -253,11 +240,10 @@ HRESULT Pera::createPipelineState()
 		}
 		ThrowIfFailed(result);
 
-		result = Resource::instance()->getDevice()->CreateRootSignature(
-			0,
+		result = Resource::instance()->getPipelineCache()->createRootSignature(
 			rsBlob->GetBufferPointer(),
 			rsBlob->GetBufferSize(),
-			IID_PPV_ARGS(m_rootSignature_effect.ReleaseAndGetAddressOf()));
+			m_rootSignature_effect.ReleaseAndGetAddressOf());
 		ThrowIfFailed(result);
 
 		result = m_rootSignature_effect.Get()->SetName(Util::getWideStringFromString("peraRootSignatureEffect").c_str());
@@ -292,9 +278,9 @@ HRESULT Pera::createPipelineState()
 			gpsDesc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
 		}
 
-		auto result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+		auto result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
 			&gpsDesc,
-			IID_PPV_ARGS(m_pipelineState_bokehH.ReleaseAndGetAddressOf()));
+			m_pipelineState_bokehH.ReleaseAndGetAddressOf());
 		ThrowIfFailed(result);
 
 		result = m_pipelineState_bokehH.Get()->SetName(Util::getWideStringFromString("peraPipelineStateBokehH").c_str());
@@ -305,9 +291,9 @@ HRESULT Pera::createPipelineState()
 			gpsDesc.PS.BytecodeLength = m_ps_bokehV.Get()->GetBufferSize();
 		}
 
-		result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+		result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
 			&gpsDesc,
-			IID_PPV_ARGS(m_pipelineState_bokehV.ReleaseAndGetAddressOf()));
+			m_pipelineState_bokehV.ReleaseAndGetAddressOf());
 		ThrowIfFailed(result);
 
 		result = m_pipelineState_bokehV.Get()->SetName(Util::getWideStringFromString("peraPipelineStateBokehV").c_str());
@@ -320,9 +306,9 @@ HRESULT Pera::createPipelineState()
 			gpsDesc.PS.BytecodeLength = m_ps_effect.Get()->GetBufferSize();
 		}
 
-		result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+		result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
 			&gpsDesc,
-			IID_PPV_ARGS(m_pipelineState_effect.ReleaseAndGetAddressOf()));
+			m_pipelineState_effect.ReleaseAndGetAddressOf());
 		ThrowIfFailed(result);
 
 		result = m_pipelineState_effect.Get()->SetName(Util::getWideStringFromString("peraPipelineStateEffect").c_str());
@@ -332,17 +318,17 @@ HRESULT Pera::createPipelineState()
 	return S_OK;
 }
 
-HRESULT Pera::render(const D3D12_CPU_DESCRIPTOR_HANDLE* pRtvHeap, ID3D12DescriptorHeap* pSrvHeap, D3D12_GPU_DESCRIPTOR_HANDLE srvGpuHandle)
+HRESULT Pera::render(ID3D12GraphicsCommandList* commandList, const D3D12_CPU_DESCRIPTOR_HANDLE* pRtvHeap, D3D12_GPU_DESCRIPTOR_HANDLE srvGpuHandle)
 {
 	constexpr bool bBokehMode = true;
 
 	if (bBokehMode)
 	{
-		ThrowIfFailed(renderBokeh(pRtvHeap, pSrvHeap, srvGpuHandle));
+		ThrowIfFailed(renderBokeh(commandList, pRtvHeap, srvGpuHandle));
 	}
 	else
 	{
-		ThrowIfFailed(renderEffect(pRtvHeap, pSrvHeap, srvGpuHandle));
+		ThrowIfFailed(renderEffect(commandList, pRtvHeap, srvGpuHandle));
 	}
 
 	return S_OK;
@@ -478,7 +464,7 @@ HRESULT Pera::createBokehResource()
 		{
 			heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 			heapDesc.NumDescriptors = 1;
-			heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+			heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 			heapDesc.NodeMask = 0;
 		}
 
@@ -499,6 +485,8 @@ HRESULT Pera::createBokehResource()
 		Resource::instance()->getDevice()->CreateConstantBufferView(
 			&cbViewDesc,
 			m_cbvHeap.Get()->GetCPUDescriptorHandleForHeapStart());
+
+		m_cbvTable = Resource::instance()->getDescriptorAllocator()->stage(m_cbvHeap.Get()->GetCPUDescriptorHandleForHeapStart(), 1);
 	}
 
 	return S_OK;
@@ -567,7 +555,7 @@ HRESULT Pera::createOffscreenResource()
 		{
 			heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 			heapDesc.NumDescriptors = 1;
-			heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+			heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 			heapDesc.NodeMask = 0;
 		}
 
@@ -596,6 +584,8 @@ HRESULT Pera::createOffscreenResource()
 			m_offscreenBuffer.Get(),
 			&viewDesc,
 			m_offscreenSrvHeap.Get()->GetCPUDescriptorHandleForHeapStart());
+
+		m_offscreenSrvTable = Resource::instance()->getDescriptorAllocator()->stage(m_offscreenSrvHeap.Get()->GetCPUDescriptorHandleForHeapStart(), 1);
 	}
 
 	return S_OK;
@@ -611,7 +601,7 @@ HRESULT Pera::createEffectBufferAndView()
 		{
 			heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 			heapDesc.NumDescriptors = 1;
-			heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+			heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 			heapDesc.NodeMask = 0;
 		}
 
@@ -637,30 +627,17 @@ HRESULT Pera::createEffectBufferAndView()
 			m_effectTexBuffer.Get(),
 			&rsvDesc,
 			m_effectSrvHeap.Get()->GetCPUDescriptorHandleForHeapStart());
+
+		m_effectSrvTable = Resource::instance()->getDescriptorAllocator()->stage(m_effectSrvHeap.Get()->GetCPUDescriptorHandleForHeapStart(), 1);
 	}
 
 	return S_OK;
 }
 
-HRESULT Pera::renderBokeh(const D3D12_CPU_DESCRIPTOR_HANDLE* pRtvHeap, ID3D12DescriptorHeap* pSrvHeap, D3D12_GPU_DESCRIPTOR_HANDLE srvGpuHandle)
+HRESULT Pera::renderBokeh(ID3D12GraphicsCommandList* commandList, const D3D12_CPU_DESCRIPTOR_HANDLE* pRtvHeap, D3D12_GPU_DESCRIPTOR_HANDLE srvGpuHandle)
 {
 	ThrowIfFalse(pRtvHeap != nullptr);
-	ThrowIfFalse(pSrvHeap != nullptr);
-
-	ID3D12GraphicsCommandList* commandList = Resource::instance()->getCommandList();
-
-	// first, horizontal bokeh
-	commandList->SetGraphicsRootSignature(m_rootSignature_bokeh.Get());
-	commandList->SetPipelineState(m_pipelineState_bokehH.Get());
-
-	commandList->SetDescriptorHeaps(1, &pSrvHeap);
-	commandList->SetGraphicsRootDescriptorTable(0, srvGpuHandle);
-
-	commandList->SetDescriptorHeaps(1, m_cbvHeap.GetAddressOf());
-	{
-		D3D12_GPU_DESCRIPTOR_HANDLE handle = m_cbvHeap.Get()->GetGPUDescriptorHandleForHeapStart();
-		commandList->SetGraphicsRootDescriptorTable(1, handle);
-	}
+	ThrowIfFalse(commandList != nullptr);
 
 	{
 		// render to off screen buffer
@@ -678,45 +655,52 @@ HRESULT Pera::renderBokeh(const D3D12_CPU_DESCRIPTOR_HANDLE* pRtvHeap, ID3D12Des
 		commandList->RSSetScissorRects(1, &scissorRect);
 	}
 
-	commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-	commandList->IASetVertexBuffers(0, 1, &m_peraVertexBufferView);
-	commandList->DrawInstanced(4, 1, 0, 0);
+	// first, horizontal bokeh
+	{
+		const uint64_t key = BundleCache::makeKey("pera.bokehH", { reinterpret_cast<uint64_t>(this), srvGpuHandle.ptr });
 
-	// vertical bokeh
-	commandList->SetPipelineState(m_pipelineState_bokehV.Get()); // to access vertical bokeh shader
+		Resource::instance()->getBundleCache()->execute(commandList, key, [&](ID3D12GraphicsCommandList* bundle) {
+			bundle->SetGraphicsRootSignature(m_rootSignature_bokeh.Get());
+			bundle->SetPipelineState(m_pipelineState_bokehH.Get());
+
+			bundle->SetGraphicsRootDescriptorTable(0, srvGpuHandle);
+
+			bundle->SetGraphicsRootDescriptorTable(1, m_cbvTable.getGpuHandle());
+
+			bundle->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+			bundle->IASetVertexBuffers(0, 1, &m_peraVertexBufferView);
+			bundle->DrawInstanced(4, 1, 0, 0);
+			});
+	}
 
 	commandList->OMSetRenderTargets(1, pRtvHeap, false, nullptr);
 
-	// read off screen texture which is applied horizontal bokeh
-	commandList->SetDescriptorHeaps(1, m_offscreenSrvHeap.GetAddressOf());
+	// vertical bokeh
 	{
-		D3D12_GPU_DESCRIPTOR_HANDLE handle = m_offscreenSrvHeap.Get()->GetGPUDescriptorHandleForHeapStart();
-		commandList->SetGraphicsRootDescriptorTable(0, handle);
-	}
+		const uint64_t key = BundleCache::makeKey("pera.bokehV", { reinterpret_cast<uint64_t>(this) });
 
-	commandList->DrawInstanced(4, 1, 0, 0);
+		Resource::instance()->getBundleCache()->execute(commandList, key, [&](ID3D12GraphicsCommandList* bundle) {
+			bundle->SetGraphicsRootSignature(m_rootSignature_bokeh.Get());
+			bundle->SetPipelineState(m_pipelineState_bokehV.Get()); // to access vertical bokeh shader
+
+			// read off screen texture which is applied horizontal bokeh
+			bundle->SetGraphicsRootDescriptorTable(0, m_offscreenSrvTable.getGpuHandle());
+
+			bundle->SetGraphicsRootDescriptorTable(1, m_cbvTable.getGpuHandle());
+
+			bundle->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+			bundle->IASetVertexBuffers(0, 1, &m_peraVertexBufferView);
+			bundle->DrawInstanced(4, 1, 0, 0);
+			});
+	}
 
 	return S_OK;
 }
 
-HRESULT Pera::renderEffect(const D3D12_CPU_DESCRIPTOR_HANDLE* pRtvHeap, ID3D12DescriptorHeap* pSrvHeap, D3D12_GPU_DESCRIPTOR_HANDLE srvGpuHandle)
+HRESULT Pera::renderEffect(ID3D12GraphicsCommandList* commandList, const D3D12_CPU_DESCRIPTOR_HANDLE* pRtvHeap, D3D12_GPU_DESCRIPTOR_HANDLE srvGpuHandle)
 {
 	ThrowIfFalse(pRtvHeap != nullptr);
-	ThrowIfFalse(pSrvHeap != nullptr);
-
-	ID3D12GraphicsCommandList* commandList = Resource::instance()->getCommandList();
-
-	commandList->SetGraphicsRootSignature(m_rootSignature_effect.Get());
-	commandList->SetPipelineState(m_pipelineState_effect.Get());
-
-	commandList->SetDescriptorHeaps(1, &pSrvHeap);
-	commandList->SetGraphicsRootDescriptorTable(0, srvGpuHandle);
-
-	commandList->SetDescriptorHeaps(1, m_effectSrvHeap.GetAddressOf());
-	{
-		D3D12_GPU_DESCRIPTOR_HANDLE handle = m_effectSrvHeap.Get()->GetGPUDescriptorHandleForHeapStart();
-		commandList->SetGraphicsRootDescriptorTable(1, handle);
-	}
+	ThrowIfFalse(commandList != nullptr);
 
 	commandList->OMSetRenderTargets(1, pRtvHeap, false, nullptr);
 
@@ -730,9 +714,20 @@ HRESULT Pera::renderEffect(const D3D12_CPU_DESCRIPTOR_HANDLE* pRtvHeap, ID3D12De
 		commandList->RSSetScissorRects(1, &scissorRect);
 	}
 
-	commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-	commandList->IASetVertexBuffers(0, 1, &m_peraVertexBufferView);
-	commandList->DrawInstanced(4, 1, 0, 0);
+	const uint64_t key = BundleCache::makeKey("pera.effect", { reinterpret_cast<uint64_t>(this), srvGpuHandle.ptr });
+
+	Resource::instance()->getBundleCache()->execute(commandList, key, [&](ID3D12GraphicsCommandList* bundle) {
+		bundle->SetGraphicsRootSignature(m_rootSignature_effect.Get());
+		bundle->SetPipelineState(m_pipelineState_effect.Get());
+
+		bundle->SetGraphicsRootDescriptorTable(0, srvGpuHandle);
+
+		bundle->SetGraphicsRootDescriptorTable(1, m_effectSrvTable.getGpuHandle());
+
+		bundle->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+		bundle->IASetVertexBuffers(0, 1, &m_peraVertexBufferView);
+		bundle->DrawInstanced(4, 1, 0, 0);
+		});
 
 	return S_OK;
 }
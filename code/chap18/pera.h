@@ -7,6 +7,7 @@
 #include <d3d12.h>
 #include <wrl.h>
 #pragma warning(pop)
+#include "descriptor_allocator.h"
 
 class Pera
 {
@@ -14,15 +15,15 @@ public:
 	HRESULT createResources();
 	HRESULT compileShaders();
 	HRESULT createPipelineState();
-	HRESULT render(const D3D12_CPU_DESCRIPTOR_HANDLE* pRtvHeap, ID3D12DescriptorHeap* pSrvHeap, D3D12_GPU_DESCRIPTOR_HANDLE srvGpuHandle);
+	HRESULT render(ID3D12GraphicsCommandList* commandList, const D3D12_CPU_DESCRIPTOR_HANDLE* pRtvHeap, D3D12_GPU_DESCRIPTOR_HANDLE srvGpuHandle);
 
 private:
 	HRESULT createVertexBufferResource();
 	HRESULT createBokehResource();
 	HRESULT createOffscreenResource();
 	HRESULT createEffectBufferAndView();
-	HRESULT renderBokeh(const D3D12_CPU_DESCRIPTOR_HANDLE* pRtvHeap, ID3D12DescriptorHeap* pSrvHeap, D3D12_GPU_DESCRIPTOR_HANDLE srvGpuHandle);
-	HRESULT renderEffect(const D3D12_CPU_DESCRIPTOR_HANDLE* pRtvHeap, ID3D12DescriptorHeap* pSrvHeap, D3D12_GPU_DESCRIPTOR_HANDLE srvGpuHandle);
+	HRESULT renderBokeh(ID3D12GraphicsCommandList* commandList, const D3D12_CPU_DESCRIPTOR_HANDLE* pRtvHeap, D3D12_GPU_DESCRIPTOR_HANDLE srvGpuHandle);
+	HRESULT renderEffect(ID3D12GraphicsCommandList* commandList, const D3D12_CPU_DESCRIPTOR_HANDLE* pRtvHeap, D3D12_GPU_DESCRIPTOR_HANDLE srvGpuHandle);
 
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> m_rootSignature_bokeh = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> m_rootSignature_effect = nullptr;
@@ -38,8 +39,11 @@ private:
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_offscreenBuffer = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_effectTexBuffer = nullptr;
 	D3D12_VERTEX_BUFFER_VIEW m_peraVertexBufferView = { };
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_cbvHeap = nullptr; // Gaussian param
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_cbvHeap = nullptr; // Gaussian param. staging
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_offscreenRtvHeap = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_offscreenSrvHeap = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_effectSrvHeap = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_offscreenSrvHeap = nullptr; // staging
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_effectSrvHeap = nullptr; // staging
+	DescriptorTable m_cbvTable;
+	DescriptorTable m_offscreenSrvTable;
+	DescriptorTable m_effectSrvTable;
 };
@@ -0,0 +1,429 @@
+#include "pipeline_cache.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <cstdio>
+#pragma warning(pop)
+#include "debug.h"
+#include "util.h"
+
+namespace {
+	void addShader(Util::Fnv1a* hasher, const D3D12_SHADER_BYTECODE& shader)
+	{
+		hasher->add(shader.BytecodeLength);
+		hasher->addBytes(shader.pShaderBytecode, shader.BytecodeLength);
+	}
+} // namespace anonymous
+
+HRESULT PipelineCache::init(ID3D12Device* device, const char* filePath)
+{
+	ThrowIfFalse(device != nullptr);
+	ThrowIfFalse(filePath != nullptr);
+
+	m_device = device;
+	m_filePath = filePath;
+
+	// the library needs ID3D12Device1. Without it the cache still dedups within the run
+	if (FAILED(m_device.As(&m_device1)))
+	{
+		m_device1.Reset();
+		Debug::debugOutputFormatString("ID3D12PipelineLibrary is not available\n");
+		return S_OK;
+	}
+
+	return loadLibrary();
+}
+
+void PipelineCache::release()
+{
+	ThrowIfFailed(saveLibrary());
+
+	Debug::debugOutputFormatString("Pipeline cache: root signature created %u shared %u, PSO created %u loaded %u shared %u\n",
+		m_stats.rootSignatureCreated,
+		m_stats.rootSignatureShared,
+		m_stats.pipelineCreated,
+		m_stats.pipelineLoaded,
+		m_stats.pipelineShared);
+
+	m_pipelineStates.clear();
+	m_rootSignatureKeys.clear();
+	m_rootSignatures.clear();
+	m_library.Reset();
+	m_libraryBlob.clear();
+	m_device1.Reset();
+	m_device.Reset();
+}
+
+HRESULT PipelineCache::createRootSignature(const void* blob, size_t size, ID3D12RootSignature** ppRootSignature)
+{
+	ThrowIfFalse(blob != nullptr);
+	ThrowIfFalse(ppRootSignature != nullptr);
+
+	const uint64_t key = computeRootSignatureKey(blob, size);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_rootSignatures.find(key);
+
+	if (it == m_rootSignatures.end())
+	{
+		Microsoft::WRL::ComPtr<ID3D12RootSignature> rootSignature = nullptr;
+
+		const auto result = m_device->CreateRootSignature(0, blob, size, IID_PPV_ARGS(rootSignature.GetAddressOf()));
+		if (FAILED(result))
+			return result;
+
+		m_rootSignatureKeys.emplace(rootSignature.Get(), key);
+		it = m_rootSignatures.emplace(key, rootSignature).first;
+		++m_stats.rootSignatureCreated;
+	}
+	else
+	{
+		++m_stats.rootSignatureShared;
+	}
+
+	return it->second.CopyTo(ppRootSignature);
+}
+
+HRESULT PipelineCache::createGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC* desc, ID3D12PipelineState** ppPipelineState)
+{
+	ThrowIfFalse(desc != nullptr);
+	ThrowIfFalse(ppPipelineState != nullptr);
+
+	uint64_t key = 0;
+	std::wstring name;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// the root signature is a part of the key, so it must come from this cache
+		const auto rsIt = m_rootSignatureKeys.find(desc->pRootSignature);
+		ThrowIfFalse(rsIt != m_rootSignatureKeys.end());
+
+		key = computePipelineKey(*desc, rsIt->second);
+		name = getPipelineName(key);
+
+		if (const auto it = m_pipelineStates.find(key); it != m_pipelineStates.end())
+		{
+			++m_stats.pipelineShared;
+			return it->second.CopyTo(ppPipelineState);
+		}
+
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState = nullptr;
+
+		// fails with E_INVALIDARG when the name is not in the library
+		if (m_library != nullptr && SUCCEEDED(m_library->LoadGraphicsPipeline(name.c_str(), desc, IID_PPV_ARGS(pipelineState.GetAddressOf()))))
+		{
+			++m_stats.pipelineLoaded;
+			return m_pipelineStates.emplace(key, pipelineState).first->second.CopyTo(ppPipelineState);
+		}
+	}
+
+	// not locked while the driver compiles, so that the modules initialized in parallel do not wait for each other
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState = nullptr;
+
+	const auto result = m_device->CreateGraphicsPipelineState(desc, IID_PPV_ARGS(pipelineState.GetAddressOf()));
+	if (FAILED(result))
+		return result;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const auto [it, bInserted] = m_pipelineStates.emplace(key, pipelineState);
+
+	if (bInserted)
+	{
+		++m_stats.pipelineCreated;
+
+		if (m_library != nullptr)
+		{
+			ThrowIfFailed(m_library->StorePipeline(name.c_str(), pipelineState.Get()));
+			m_bDirty = true;
+		}
+	}
+	else
+	{
+		// another thread has created the same one meanwhile
+		++m_stats.pipelineShared;
+	}
+
+	return it->second.CopyTo(ppPipelineState);
+}
+
+uint64_t PipelineCache::computeRootSignatureKey(const void* blob, size_t size)
+{
+	Util::Fnv1a hasher;
+	hasher.add(size);
+	hasher.addBytes(blob, size);
+
+	return hasher.get();
+}
+
+uint64_t PipelineCache::computePipelineKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureKey)
+{
+	Util::Fnv1a hasher;
+	hasher.add(kKeyVersion);
+	hasher.add(rootSignatureKey);
+
+	addShader(&hasher, desc.VS);
+	addShader(&hasher, desc.PS);
+	addShader(&hasher, desc.DS);
+	addShader(&hasher, desc.HS);
+	addShader(&hasher, desc.GS);
+
+	hasher.add(desc.StreamOutput.NumEntries);
+	for (UINT i = 0; i < desc.StreamOutput.NumEntries; ++i)
+	{
+		const auto& entry = desc.StreamOutput.pSODeclaration[i];
+		hasher.add(entry.Stream);
+		hasher.addString(entry.SemanticName);
+		hasher.add(entry.SemanticIndex);
+		hasher.add(entry.StartComponent);
+		hasher.add(entry.ComponentCount);
+		hasher.add(entry.OutputSlot);
+	}
+	hasher.add(desc.StreamOutput.NumStrides);
+	hasher.addBytes(desc.StreamOutput.pBufferStrides, sizeof(UINT) * desc.StreamOutput.NumStrides);
+	hasher.add(desc.StreamOutput.RasterizedStream);
+
+	// field by field since the structs have padding
+	hasher.add(desc.BlendState.AlphaToCoverageEnable);
+	hasher.add(desc.BlendState.IndependentBlendEnable);
+	for (const auto& rt : desc.BlendState.RenderTarget)
+	{
+		hasher.add(rt.BlendEnable);
+		hasher.add(rt.LogicOpEnable);
+		hasher.add(rt.SrcBlend);
+		hasher.add(rt.DestBlend);
+		hasher.add(rt.BlendOp);
+		hasher.add(rt.SrcBlendAlpha);
+		hasher.add(rt.DestBlendAlpha);
+		hasher.add(rt.BlendOpAlpha);
+		hasher.add(rt.LogicOp);
+		hasher.add(rt.RenderTargetWriteMask);
+	}
+	hasher.add(desc.SampleMask);
+
+	hasher.add(desc.RasterizerState.FillMode);
+	hasher.add(desc.RasterizerState.CullMode);
+	hasher.add(desc.RasterizerState.FrontCounterClockwise);
+	hasher.add(desc.RasterizerState.DepthBias);
+	hasher.add(desc.RasterizerState.DepthBiasClamp);
+	hasher.add(desc.RasterizerState.SlopeScaledDepthBias);
+	hasher.add(desc.RasterizerState.DepthClipEnable);
+	hasher.add(desc.RasterizerState.MultisampleEnable);
+	hasher.add(desc.RasterizerState.AntialiasedLineEnable);
+	hasher.add(desc.RasterizerState.ForcedSampleCount);
+	hasher.add(desc.RasterizerState.ConservativeRaster);
+
+	hasher.add(desc.DepthStencilState.DepthEnable);
+	hasher.add(desc.DepthStencilState.DepthWriteMask);
+	hasher.add(desc.DepthStencilState.DepthFunc);
+	hasher.add(desc.DepthStencilState.StencilEnable);
+	hasher.add(desc.DepthStencilState.StencilReadMask);
+	hasher.add(desc.DepthStencilState.StencilWriteMask);
+	for (const auto& face : { desc.DepthStencilState.FrontFace, desc.DepthStencilState.BackFace })
+	{
+		hasher.add(face.StencilFailOp);
+		hasher.add(face.StencilDepthFailOp);
+		hasher.add(face.StencilPassOp);
+		hasher.add(face.StencilFunc);
+	}
+
+	hasher.add(desc.InputLayout.NumElements);
+	for (UINT i = 0; i < desc.InputLayout.NumElements; ++i)
+	{
+		const auto& element = desc.InputLayout.pInputElementDescs[i];
+		hasher.addString(element.SemanticName);
+		hasher.add(element.SemanticIndex);
+		hasher.add(element.Format);
+		hasher.add(element.InputSlot);
+		hasher.add(element.AlignedByteOffset);
+		hasher.add(element.InputSlotClass);
+		hasher.add(element.InstanceDataStepRate);
+	}
+
+	hasher.add(desc.IBStripCutValue);
+	hasher.add(desc.PrimitiveTopologyType);
+	hasher.add(desc.NumRenderTargets);
+	for (const auto format : desc.RTVFormats)
+	{
+		hasher.add(format);
+	}
+	hasher.add(desc.DSVFormat);
+	hasher.add(desc.SampleDesc.Count);
+	hasher.add(desc.SampleDesc.Quality);
+	hasher.add(desc.NodeMask);
+	hasher.add(desc.Flags);
+
+	return hasher.get();
+}
+
+std::wstring PipelineCache::getPipelineName(uint64_t key)
+{
+	constexpr wchar_t kHex[] = L"0123456789abcdef";
+	std::wstring name = L"pso_";
+
+	for (int32_t shift = 60; shift >= 0; shift -= 4)
+	{
+		name += kHex[(key >> shift) & 0xf];
+	}
+
+	return name;
+}
+
+HRESULT PipelineCache::loadLibrary()
+{
+	FILE* fp = nullptr;
+
+	if (fopen_s(&fp, m_filePath.c_str(), "rb") == 0)
+	{
+		uint32_t header[2] = { };
+
+		if (fread(header, sizeof(header), 1, fp) == 1 && header[0] == kFileMagic && header[1] == kKeyVersion)
+		{
+			ThrowIfFalse(fseek(fp, 0, SEEK_END) == 0);
+			const long end = ftell(fp);
+			ThrowIfFalse(fseek(fp, sizeof(header), SEEK_SET) == 0);
+
+			if (end > static_cast<long>(sizeof(header)))
+			{
+				m_libraryBlob.resize(static_cast<size_t>(end) - sizeof(header));
+
+				if (fread(m_libraryBlob.data(), m_libraryBlob.size(), 1, fp) != 1)
+				{
+					m_libraryBlob.clear();
+				}
+			}
+		}
+
+		ThrowIfFalse(fclose(fp) == 0);
+	}
+
+	if (!m_libraryBlob.empty())
+	{
+		const auto result = m_device1->CreatePipelineLibrary(m_libraryBlob.data(), m_libraryBlob.size(), IID_PPV_ARGS(m_library.ReleaseAndGetAddressOf()));
+
+		if (SUCCEEDED(result))
+		{
+			Debug::debugOutputFormatString("Pipeline library is loaded from %s (%zd bytes)\n", m_filePath.c_str(), m_libraryBlob.size());
+			return S_OK;
+		}
+
+		// D3D12_ERROR_DRIVER_VERSION_MISMATCH or D3D12_ERROR_ADAPTER_NOT_FOUND when the driver or GPU is changed
+		Debug::debugOutputFormatString("Pipeline library is discarded (0x%08x)\n", static_cast<uint32_t>(result));
+		m_libraryBlob.clear();
+	}
+
+	const auto result = m_device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(m_library.ReleaseAndGetAddressOf()));
+	ThrowIfFailed(result);
+
+	// rewrite the file even if nothing new is stored, to drop an invalid one
+	m_bDirty = true;
+
+	return S_OK;
+}
+
+HRESULT PipelineCache::saveLibrary()
+{
+	if (m_library == nullptr || !m_bDirty)
+		return S_OK;
+
+	std::vector<uint8_t> data(m_library->GetSerializedSize());
+	auto result = m_library->Serialize(data.data(), data.size());
+	ThrowIfFailed(result);
+
+	// not fatal. The PSOs are created again on the next run
+	FILE* fp = nullptr;
+	if (fopen_s(&fp, m_filePath.c_str(), "wb") != 0)
+	{
+		Debug::debugOutputFormatString("failed to open %s\n", m_filePath.c_str());
+		return S_OK;
+	}
+
+	const uint32_t header[2] = { kFileMagic, kKeyVersion };
+	ThrowIfFalse(fwrite(header, sizeof(header), 1, fp) == 1);
+	ThrowIfFalse(fwrite(data.data(), data.size(), 1, fp) == 1);
+	ThrowIfFalse(fclose(fp) == 0);
+
+	m_bDirty = false;
+
+	return S_OK;
+}
+
+bool PipelineCache::selfCheck()
+{
+	const uint8_t vs[] = { 0x44, 0x58, 0x42, 0x43, 0x01, 0x02, 0x03, 0x04 };
+	const char semantic[] = "POSITION";
+	const D3D12_INPUT_ELEMENT_DESC inputLayout[] = {
+		{ semantic, 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	};
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = { };
+	{
+		desc.VS = { vs, sizeof(vs) };
+		desc.SampleMask = UINT_MAX;
+		desc.InputLayout = { inputLayout, _countof(inputLayout) };
+		desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+		desc.NumRenderTargets = 1;
+		desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.SampleDesc = { 1, 0 };
+	}
+	const uint64_t key = computePipelineKey(desc, 1);
+
+	// the same contents behind other pointers, and the fields which are not a part of the key
+	{
+		const std::vector<uint8_t> vsCopy(std::begin(vs), std::end(vs));
+		const std::string semanticCopy = semantic;
+		D3D12_INPUT_ELEMENT_DESC inputLayoutCopy = inputLayout[0];
+		inputLayoutCopy.SemanticName = semanticCopy.c_str();
+
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC other = desc;
+		other.VS = { vsCopy.data(), vsCopy.size() };
+		other.InputLayout = { &inputLayoutCopy, 1 };
+		other.pRootSignature = reinterpret_cast<ID3D12RootSignature*>(&other);
+		other.CachedPSO = { vs, sizeof(vs) };
+
+		if (computePipelineKey(other, 1) != key)
+			return false;
+	}
+
+	// a shader change, a state change and a root signature change give new keys
+	{
+		std::vector<uint8_t> vsChanged(std::begin(vs), std::end(vs));
+		vsChanged.back() ^= 1;
+
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC other = desc;
+		other.VS = { vsChanged.data(), vsChanged.size() };
+
+		if (computePipelineKey(other, 1) == key)
+			return false;
+
+		other = desc;
+		other.RTVFormats[0] = DXGI_FORMAT_B8G8R8A8_UNORM;
+
+		if (computePipelineKey(other, 1) == key)
+			return false;
+
+		other = desc;
+		other.BlendState.RenderTarget[0].RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
+
+		if (computePipelineKey(other, 1) == key)
+			return false;
+
+		if (computePipelineKey(desc, 2) == key)
+			return false;
+	}
+
+	{
+		const uint8_t rs0[] = { 1, 2, 3, 4 };
+		const uint8_t rs1[] = { 1, 2, 3, 5 };
+
+		if (computeRootSignatureKey(rs0, sizeof(rs0)) != computeRootSignatureKey(std::vector<uint8_t>(std::begin(rs0), std::end(rs0)).data(), sizeof(rs0)))
+			return false;
+
+		if (computeRootSignatureKey(rs0, sizeof(rs0)) == computeRootSignatureKey(rs1, sizeof(rs1)))
+			return false;
+	}
+
+	if (getPipelineName(0x0123456789abcdefull) != L"pso_0123456789abcdef")
+		return false;
+
+	return true;
+}
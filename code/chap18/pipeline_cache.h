@@ -0,0 +1,61 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <cstdint>
+#include <d3d12.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <wrl.h>
+#pragma warning(pop)
+
+// Root signatures and PSOs are deduplicated by the hash of their description, within the run
+// and across the actors. The PSOs are also kept in an ID3D12PipelineLibrary which is saved on exit
+// and loaded on the next run. A driver change is detected by the library itself, and a shader change
+// gives a new key since the bytecode is a part of it.
+class PipelineCache
+{
+public:
+	HRESULT init(ID3D12Device* device, const char* filePath);
+	void release();
+
+	HRESULT createRootSignature(const void* blob, size_t size, ID3D12RootSignature** ppRootSignature);
+	HRESULT createGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC* desc, ID3D12PipelineState** ppPipelineState);
+
+	static uint64_t computeRootSignatureKey(const void* blob, size_t size);
+	// pointers are followed, so two descriptions built from different copies of the same shader or input layout give the same key
+	static uint64_t computePipelineKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureKey);
+	static std::wstring getPipelineName(uint64_t key);
+	static bool selfCheck();
+
+private:
+	static constexpr uint32_t kFileMagic = 0x434f5350; // "PSOC"
+	static constexpr uint32_t kKeyVersion = 1; // bump when computePipelineKey() changes
+
+	HRESULT loadLibrary();
+	HRESULT saveLibrary();
+
+	Microsoft::WRL::ComPtr<ID3D12Device> m_device = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Device1> m_device1 = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12PipelineLibrary> m_library = nullptr;
+	std::vector<uint8_t> m_libraryBlob; // must outlive m_library
+	std::string m_filePath;
+	bool m_bDirty = false;
+
+	std::mutex m_mutex;
+	std::unordered_map<uint64_t, Microsoft::WRL::ComPtr<ID3D12RootSignature>> m_rootSignatures;
+	std::unordered_map<ID3D12RootSignature*, uint64_t> m_rootSignatureKeys;
+	std::unordered_map<uint64_t, Microsoft::WRL::ComPtr<ID3D12PipelineState>> m_pipelineStates;
+
+	struct Stats
+	{
+		uint32_t rootSignatureCreated = 0;
+		uint32_t rootSignatureShared = 0;
+		uint32_t pipelineCreated = 0;
+		uint32_t pipelineLoaded = 0;
+		uint32_t pipelineShared = 0;
+	} m_stats;
+};
@@ -4,7 +4,11 @@
 #pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
 #include <algorithm>
 #include <array>
+#include <cfloat>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
+#include <numeric>
 #include <d3dcompiler.h>
 #include <d3dx12.h>
 #include <DirectXTex.h>
@@ -14,12 +18,16 @@
 #include "constant.h"
 #include "debug.h"
 #include "init.h"
-#include "loader.h"
+#include "motion_cache.h"
 #include "util.h"
 
 #undef min
 #undef max
 
+#define MESHLET_CONE_CULLING (0)
+#define BAKED_MOTION (0) // about 4x the memory of the keyframes
+#define COMPRESSED_MOTION (1) // through the motion cache. Not with BAKED_MOTION, which bakes the keys as authored
+
 #pragma comment(lib, "d3dcompiler.lib")
 #pragma comment(lib, "Winmm.lib")
 
@@ -61,58 +69,6 @@ struct PMDBone
 #pragma pack()
 static_assert(sizeof(PMDBone) == 39);
 
-#pragma pack(1)
-struct VMDMotion
-{
-	char boneName[15] = { };
-	uint32_t frameNo = 0;
-	DirectX::XMFLOAT3 location = { };
-	DirectX::XMFLOAT4 quaternion = { };
-	uint8_t bezier[64] = { };
-};
-#pragma pack()
-static_assert(sizeof(VMDMotion) == 111);
-
-#pragma pack(1)
-struct VMDMorph
-{
-	char name[15] = { };
-	uint32_t frameNo = 0;
-	float weight = 0.0f;
-};
-#pragma pack()
-static_assert(sizeof(VMDMorph) == 23);
-
-#pragma pack(1)
-struct VMDCamera
-{
-	uint32_t frameNo = 0;
-	float distance = 0.0f;
-	DirectX::XMFLOAT3 pos = { };
-	DirectX::XMFLOAT3 eulerAngle = { };
-	uint8_t interpolation[24] = { };
-	uint32_t fov = 0;
-	uint8_t persFlg = 0;
-};
-#pragma pack()
-static_assert(sizeof(VMDCamera) == 61);
-
-struct VMDLight
-{
-	DirectX::XMFLOAT3 rgb = { };
-	DirectX::XMFLOAT3 vec = { };
-};
-
-#pragma pack(1)
-struct VMDSelfShadow
-{
-	uint32_t frameNo = 0;
-	uint8_t mode = 0;
-	float distance = 0.0f;
-};
-#pragma pack()
-static_assert(sizeof(VMDSelfShadow) == 9);
-
 static constexpr D3D12_INPUT_ELEMENT_DESC kInputLayout[] = {
 	{
 		"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0,
@@ -207,18 +163,22 @@ static const std::string kMotionDir = "../resource/Motion";
 static const std::string kToonDir = "../resource/toon";
 static constexpr char kSignature[] = "Pmd";
 static constexpr size_t kNumSignature = 3;
+static constexpr uint32_t kMotionFps = 30;
+// the bones which only sway, and the ones under them, are left out by the animation level of detail
+static const std::string kSecondaryBoneNames[] = { "", "XJ[g", "", "", "ȸ", "lN^C", "{" };
 const std::vector<UINT16> s_debugIndices = { 0, 1, 2, 3, 4, 5 };
 
-static HRESULT setViewportScissor(int32_t width, int32_t height);
+static HRESULT setViewportScissor(ID3D12GraphicsCommandList* list, int32_t width, int32_t height);
 static std::string getModelPath(PmdActor::Model model);
 static std::string getMotionPath();
 static std::string getTexturePathFromModelAndTexPath(const std::string& modelPath, const char* texPath);
+static D3D12_SHADER_RESOURCE_VIEW_DESC getTextureSrvDesc(DXGI_FORMAT format);
 template<typename T>
 static std::pair<HRESULT, D3D12_VERTEX_BUFFER_VIEW>
 createVertexBufferResource(ComPtr<ID3D12Resource>* vertResource, const std::vector<T>& vertices);
 static std::pair<HRESULT, D3D12_INDEX_BUFFER_VIEW> createIndexBufferResource(ComPtr<ID3D12Resource>* ibResource, const std::vector<UINT16>& indices);
 static HRESULT createBufferResource(ComPtr<ID3D12Resource>* vertResource, size_t width);
-static float getYfromXOnBezier(float x, const DirectX::XMFLOAT2& a, const DirectX::XMFLOAT2& b, uint8_t n);
+static DirectX::XMMATRIX getBoneMatrix(const DirectX::XMFLOAT3& startPos, const DirectX::XMVECTOR& rotation, const DirectX::XMVECTOR& offset);
 static DirectX::XMMATRIX lookAtMatrix(const DirectX::XMVECTOR& origin, const DirectX::XMVECTOR& lookat, const DirectX::XMFLOAT3& up, const DirectX::XMFLOAT3& right);
 static DirectX::XMMATRIX lookAtMatrix(const DirectX::XMVECTOR& lookat, const DirectX::XMFLOAT3& up, const DirectX::XMFLOAT3& right);
 
@@ -246,10 +206,30 @@ PmdActor::PmdActor()
 HRESULT PmdActor::loadAsset(Model model)
 {
 	ThrowIfFailed(loadPmd(model));
+	createBounds();
+	ThrowIfFailed(createDrawArguments(&m_indirectDraw, 2 /* [0] mesh, [1] shadow */, "pmdActor"));
 	ThrowIfFailed(loadVmd());
+	m_animationLod.init(1, static_cast<uint32_t>(m_boneMatrices.size()));
 	return S_OK;
 }
 
+HRESULT PmdActor::enableCrowd(uint32_t numInstances, uint32_t numPhases, float spacing)
+{
+	ThrowIfFalse(!m_materials.empty()); // after loadAsset()
+	ThrowIfFalse(numInstances > 0);
+	ThrowIfFalse(0 < numPhases && numPhases <= numInstances);
+
+	m_numCrowdInstances = numInstances;
+	m_numCrowdPhases = numPhases;
+	m_crowdPlacements = getCrowdPlacements(numInstances, spacing);
+	m_animationLod.init(numPhases, static_cast<uint32_t>(m_boneMatrices.size()));
+
+	ThrowIfFailed(createCrowdResource());
+
+	// an instance per actor. The planar shadow copy is left out of the crowd
+	return createDrawArguments(&m_crowdIndirectDraw, numInstances, "pmdCrowd");
+}
+
 void PmdActor::enableAnimation(bool enable)
 {
 	static DWORD offset = 0;
@@ -264,30 +244,142 @@ void PmdActor::enableAnimation(bool enable)
 	m_animationStartTime = timeGetTime() - offset;
 }
 
-void PmdActor::update(bool animationReversed)
+void PmdActor::computePose(PmdPose* pPose, AnimationLod::Level level)
 {
-	using namespace DirectX;
+	ThrowIfFalse(pPose != nullptr);
 
 	static float angle = 0.0f;
-	const auto worldMat = DirectX::XMMatrixRotationY(angle);
+	pPose->world = DirectX::XMMatrixRotationY(angle);
+
+	// the first step is at the full level, for the time the lower ones are told against
+	const AnimationLod::Level stepLevel = m_animationLod.hasFullCost() ? level : AnimationLod::Level::kFull;
+	const uint32_t numSlots = isCrowd() ? m_numCrowdPhases : 1;
+	const size_t numBones = m_boneMatrices.size();
+
+	// the instances of a phase share the palette
+	pPose->bones.resize(numBones * numSlots);
+	m_animationLod.beginStep();
+
+	for (uint32_t slot = 0; slot < numSlots; ++slot)
+	{
+		uint32_t aheadSteps = 0;
+
+		if (m_animationLod.isDue(slot, stepLevel, &aheadSteps))
+		{
+			const uint32_t frameOffset = isCrowd() ? getPhaseFrameOffset(slot) : 0;
+			updateMotion(frameOffset, aheadSteps * 1000 / Config::kSimulationHz, stepLevel);
+			m_animationLod.setKey(slot, stepLevel, aheadSteps, m_boneMatrices.data());
+		}
+
+		m_animationLod.getPalette(slot, pPose->bones.data() + numBones * slot);
+	}
+
+	m_animationLod.endStep(stepLevel);
+}
+
+void PmdActor::applyPose(const PmdPose& pose, const Culling::Views& views)
+{
+	// the GPU may still read the slices of the previous frames
+	selectTransformSlice(Resource::instance()->getFrameIndex());
+	updateMaterialSlice();
+
+	*m_worldMatrixPointer = pose.world;
+
+	if (isCrowd())
+	{
+		ThrowIfFalse(pose.bones.size() == m_boneMatrices.size() * m_numCrowdPhases);
+
+		uint8_t* const pSlice = m_mappedCrowd + m_crowdSliceSize * m_frameIndex;
+		std::copy(pose.bones.begin(), pose.bones.end(), reinterpret_cast<DirectX::XMMATRIX*>(pSlice + m_crowdPalettesOffset));
+
+		updateCrowdBounds(pose);
+		return;
+	}
+
+	ThrowIfFalse(pose.bones.size() == m_boneMatrices.size());
+	std::copy(pose.bones.begin(), pose.bones.end(), m_boneMatrixPointer);
+
+	// the planar shadow copy is drawn too
+	const Culling::Aabb bound = Culling::transform(Culling::skin(m_boneBounds, pose.bones.data()), pose.world);
+	m_bound = Culling::merge(bound, Culling::transformCorners(bound, views.planarShadow));
+}
+
+void PmdActor::cull(const PmdPose& pose, const Culling::Views& views, bool bInCamera, bool bInLight)
+{
+	if (isCrowd())
+	{
+		cullCrowd(pose, views, bInCamera, bInLight);
+		prioritizeTextures();
+		return;
+	}
+
+	m_bVisibleInCamera = bInCamera;
+	m_screenHeight = bInCamera ? Culling::getScreenHeight(m_bound, views) : 0.0f;
+	m_lod = selectLod(Culling::getDistance(m_bound, views.eye), views);
+
+	std::vector<bool> visibleInCamera(m_drawIndexCounts.size(), false);
+	std::vector<bool> visibleInLight(m_drawIndexCounts.size(), false);
+
+	for (size_t i = 0; i < m_materials.size() && (bInCamera || bInLight); ++i)
+	{
+		const Culling::Aabb materialBound = Culling::transform(Culling::skin(m_materialBoneBounds.at(i), pose.bones.data()), pose.world);
 
-	*m_worldMatrixPointer = worldMat;
+		const bool bMaterialInCamera = bInCamera
+			&& Culling::intersects(views.camera, Culling::merge(materialBound, Culling::transformCorners(materialBound, views.planarShadow)));
+		const bool bMaterialInLight = bInLight && Culling::intersects(views.light, materialBound);
 
-	updateMotion();
+		if (!bMaterialInCamera && !bMaterialInLight)
+			continue;
+
+		// a level of detail has no meshlets, and draws the material at once
+		if (m_lod > 0)
+		{
+			const size_t j = m_lodCommandOffsets.at(m_lod) + i;
+			visibleInCamera.at(j) = bMaterialInCamera;
+			visibleInLight.at(j) = bMaterialInLight;
+			continue;
+		}
+
+		// then the meshlets of the material
+		for (uint32_t j = m_meshlets.materialOffsets.at(i); j < m_meshlets.materialOffsets.at(i + 1); ++j)
+		{
+			const Culling::Aabb meshletBound = Culling::transform(Culling::skin(m_meshletBoneBounds.at(j), pose.bones.data()), pose.world);
+
+			visibleInCamera.at(j) = bMaterialInCamera
+				&& Culling::intersects(views.camera, Culling::merge(meshletBound, Culling::transformCorners(meshletBound, views.planarShadow)));
+			visibleInLight.at(j) = bMaterialInLight && Culling::intersects(views.light, meshletBound);
+
+#if MESHLET_CONE_CULLING
+			// off, since the pipeline draws both faces, and the planar shadow copy is drawn by the same commands
+			if (visibleInCamera.at(j))
+			{
+				const Meshlet::Bounds& bounds = m_meshlets.bounds.at(j);
+				visibleInCamera.at(j) = !Meshlet::isBackfacing(Meshlet::transform(bounds, pose.bones.at(bounds.bone) * pose.world), views.eye);
+			}
+#endif // MESHLET_CONE_CULLING
+		}
+	}
+
+	m_indirectDraw.update(m_frameIndex, visibleInCamera, 2 /* [0] mesh, [1] shadow */);
+	m_shadowRanges = getVisibleRanges(m_drawIndexCounts, visibleInLight);
+
+	prioritizeTextures();
 }
 
-HRESULT PmdActor::renderShadow(ID3D12GraphicsCommandList* list, ID3D12DescriptorHeap* sceneDescHeap, ID3D12DescriptorHeap* depthHeap) const
+HRESULT PmdActor::renderShadow(ID3D12GraphicsCommandList* list, D3D12_GPU_DESCRIPTOR_HANDLE sceneDescHandle, ID3D12DescriptorHeap* depthHeap) const
 {
 	ThrowIfFalse(list != nullptr);
-	ThrowIfFalse(sceneDescHeap != nullptr);
 	ThrowIfFalse(depthHeap != nullptr);
 
+	if (m_shadowRanges.empty())
+		return S_OK;
+
 	ThrowIfFailed(setCommonPipelineConfig(list));
 
-	setViewportScissor(Config::kShadowBufferWidth, Config::kShadowBufferHeight);
+	setViewportScissor(list, Config::kShadowBufferWidth, Config::kShadowBufferHeight);
 
 	ThrowIfFalse(m_shadowPipelineState != nullptr);
-	list->SetPipelineState(m_shadowPipelineState.Get());
+	list->SetPipelineState(isCrowd() ? m_crowdShadowPipelineState.Get() : m_shadowPipelineState.Get());
 
 	ThrowIfFalse(getRootSignature() != nullptr);
 	list->SetGraphicsRootSignature(getRootSignature());
@@ -305,93 +397,112 @@ HRESULT PmdActor::renderShadow(ID3D12GraphicsCommandList* list, ID3D12Descriptor
 
 	// bind to b0: view & proj matrix
 	{
-		ThrowIfFalse(sceneDescHeap != nullptr);
-		list->SetDescriptorHeaps(1, &sceneDescHeap);
 		list->SetGraphicsRootDescriptorTable(
 			0, // b0
-			sceneDescHeap->GetGPUDescriptorHandleForHeapStart());
+			sceneDescHandle);
 	}
 
 	// bind to b1: transform matrix
 	{
-		list->SetDescriptorHeaps(1, m_transformDescHeap.GetAddressOf());
 		list->SetGraphicsRootDescriptorTable(
 			1, // b1
-			m_transformDescHeap->GetGPUDescriptorHandleForHeapStart());
+			getTransformGpuDescHandle());
 	}
 
-	// bind to b2: material
+	// bind to b2: the palette. The whole mesh in one draw, so the material is not used
 	{
-		list->SetDescriptorHeaps(1, m_materialDescHeap.GetAddressOf());
+		list->SetGraphicsRoot32BitConstant(
+			2, // b2
+			0, // paletteOffset
+			1);
 	}
 
 	// draw call
-	list->DrawIndexedInstanced(m_indicesNum, 1, 0, 0, 0);
+	if (isCrowd())
+	{
+		const D3D12_GPU_VIRTUAL_ADDRESS slice = m_crowdResource->GetGPUVirtualAddress() + m_crowdSliceSize * m_frameIndex;
+		list->SetGraphicsRootShaderResourceView(6, slice);
+		list->SetGraphicsRootShaderResourceView(7, slice + m_crowdPalettesOffset);
+
+		// the level of detail of the crowd
+		for (const auto& [start, count] : m_shadowRanges)
+		{
+			list->DrawIndexedInstanced(count, m_numVisibleCrowdInstances, start, 0, 0);
+		}
+	}
+	else
+	{
+		// the materials seen from the light, the neighbors in one draw
+		for (const auto& [start, count] : m_shadowRanges)
+		{
+			list->DrawIndexedInstanced(count, 1, start, 0, 0);
+		}
+	}
 
 	return S_OK;
 }
 
-HRESULT PmdActor::render(ID3D12GraphicsCommandList* list, ID3D12DescriptorHeap* sceneDescHeap, ID3D12DescriptorHeap* depthLightSrvHeap) const
+HRESULT PmdActor::render(ID3D12GraphicsCommandList* list, D3D12_GPU_DESCRIPTOR_HANDLE sceneDescHandle, D3D12_GPU_DESCRIPTOR_HANDLE depthLightSrvHandle) const
 {
 	ThrowIfFalse(list != nullptr);
-	ThrowIfFalse(sceneDescHeap != nullptr);
+
+	if (!m_bVisibleInCamera)
+		return S_OK;
 
 	ThrowIfFailed(setCommonPipelineConfig(list));
 
 	ThrowIfFalse(getPipelineState() != nullptr);
-	list->SetPipelineState(getPipelineState());
+	list->SetPipelineState(isCrowd() ? m_crowdPipelineState.Get() : getPipelineState());
 
 	ThrowIfFalse(getRootSignature() != nullptr);
 	list->SetGraphicsRootSignature(getRootSignature());
 
 	// bind to root param 0: view & proj matrix
 	{
-		ThrowIfFalse(sceneDescHeap != nullptr);
-		list->SetDescriptorHeaps(1, &sceneDescHeap);
 		list->SetGraphicsRootDescriptorTable(
 			0, // root param 0
-			sceneDescHeap->GetGPUDescriptorHandleForHeapStart());
+			sceneDescHandle);
 	}
 
 	// bind to root param 1: transform matrix
 	{
-		list->SetDescriptorHeaps(1, m_transformDescHeap.GetAddressOf());
 		list->SetGraphicsRootDescriptorTable(
 			1, // root param 1
-			m_transformDescHeap->GetGPUDescriptorHandleForHeapStart());
+			getTransformGpuDescHandle());
 	}
 
 	// bind to root param 3: depth map texture
 	{
-		list->SetDescriptorHeaps(1, &depthLightSrvHeap);
 		list->SetGraphicsRootDescriptorTable(
 			3, // root param 3
-			depthLightSrvHeap->GetGPUDescriptorHandleForHeapStart());
+			depthLightSrvHandle);
 	}
 
-	// bind to root param 2: material
-	// draw call
+	// bind to root param 4: materials (structured buffer)
 	{
-		list->SetDescriptorHeaps(1, m_materialDescHeap.GetAddressOf());
-
-		const auto cbvSrvIncSize = Resource::instance()->getDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV) * 5;
-		auto materialH = m_materialDescHeap->GetGPUDescriptorHandleForHeapStart();
-		UINT indexOffset = 0;
-
-		for (const auto& m : m_materials)
-		{
-			list->SetGraphicsRootDescriptorTable(
-				2, // root param 2
-				materialH);
+		list->SetGraphicsRootShaderResourceView(
+			4, // root param 4
+			m_materialResource->GetGPUVirtualAddress() + m_materialSliceSize * m_frameIndex);
+	}
 
-			constexpr UINT kInstanceCount = 2; // [0] mesh, [1] shadow
-			list->DrawIndexedInstanced(m.indicesNum, kInstanceCount, indexOffset, 0, 0);
+	// bind to root param 5: textures (bindless)
+	{
+		list->SetGraphicsRootDescriptorTable(
+			5, // root param 5
+			m_textureDescTable.getGpuHandle());
+	}
 
-			materialH.ptr += cbvSrvIncSize;
-			indexOffset += m.indicesNum;
-		}
+	// bind to root param 6, 7: instances and palettes of the crowd (structured buffers)
+	if (isCrowd())
+	{
+		const D3D12_GPU_VIRTUAL_ADDRESS slice = m_crowdResource->GetGPUVirtualAddress() + m_crowdSliceSize * m_frameIndex;
+		list->SetGraphicsRootShaderResourceView(6, slice);
+		list->SetGraphicsRootShaderResourceView(7, slice + m_crowdPalettesOffset);
 	}
 
+	// bind to root param 2 and draw, a command per material
+	(isCrowd() ? m_crowdIndirectDraw : m_indirectDraw).execute(list, m_frameIndex);
+
 	return S_OK;
 }
 
@@ -481,14 +592,11 @@ HRESULT PmdActor::loadShaders()
 
 	ComPtr<ID3DBlob> errorBlob = nullptr;
 
-	auto ret = D3DCompileFromFile(
+	auto ret = Resource::instance()->getShaderCache()->load(
 		L"BasicVertexShader.hlsl",
 		nullptr,
-		D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		"BasicVs",
-		Constant::kVsShaderModel,
-		D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-		0,
+		Constant::kDxcVsShaderModel,
 		m_vsBlob.ReleaseAndGetAddressOf(),
 		errorBlob.ReleaseAndGetAddressOf()
 	);
@@ -500,14 +608,11 @@ HRESULT PmdActor::loadShaders()
 	ThrowIfFailed(ret);
 
 
-	ret = D3DCompileFromFile(
+	ret = Resource::instance()->getShaderCache()->load(
 		L"BasicPixelShader.hlsl",
 		nullptr,
-		D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		"MrtWithShadowMapPs",
-		Constant::kPsShaderModel,
-		D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-		0,
+		Constant::kDxcPsShaderModel,
 		m_psBlob.ReleaseAndGetAddressOf(),
 		errorBlob.ReleaseAndGetAddressOf()
 	);
@@ -519,14 +624,11 @@ HRESULT PmdActor::loadShaders()
 	ThrowIfFailed(ret);
 
 
-	ret = D3DCompileFromFile(
+	ret = Resource::instance()->getShaderCache()->load(
 		L"BasicVertexShader.hlsl",
 		nullptr,
-		D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		"shadowVs",
-		Constant::kVsShaderModel,
-		D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-		0,
+		Constant::kDxcVsShaderModel,
 		m_shadowVsBlob.ReleaseAndGetAddressOf(),
 		errorBlob.ReleaseAndGetAddressOf());
 
@@ -536,6 +638,36 @@ HRESULT PmdActor::loadShaders()
 	}
 	ThrowIfFailed(ret);
 
+
+	ret = Resource::instance()->getShaderCache()->load(
+		L"BasicVertexShader.hlsl",
+		nullptr,
+		"CrowdVs",
+		Constant::kDxcVsShaderModel,
+		m_crowdVsBlob.ReleaseAndGetAddressOf(),
+		errorBlob.ReleaseAndGetAddressOf());
+
+	if (FAILED(ret))
+	{
+		Debug::outputDebugMessage(errorBlob.Get());
+	}
+	ThrowIfFailed(ret);
+
+
+	ret = Resource::instance()->getShaderCache()->load(
+		L"BasicVertexShader.hlsl",
+		nullptr,
+		"crowdShadowVs",
+		Constant::kDxcVsShaderModel,
+		m_crowdShadowVsBlob.ReleaseAndGetAddressOf(),
+		errorBlob.ReleaseAndGetAddressOf());
+
+	if (FAILED(ret))
+	{
+		Debug::outputDebugMessage(errorBlob.Get());
+	}
+	ThrowIfFailed(ret);
+
 	return S_OK;
 }
 
@@ -593,9 +725,19 @@ HRESULT PmdActor::createPipelineState()
 		// D3D12_PIPELINE_STATE_FLAGS Flags;
 	}
 
-	auto ret = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+	auto ret = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
+		&gpipeDesc,
+		m_pipelineState.ReleaseAndGetAddressOf());
+	ThrowIfFailed(ret);
+
+	// for crowd
+	{
+		gpipeDesc.VS = { m_crowdVsBlob->GetBufferPointer(), m_crowdVsBlob->GetBufferSize() };
+	}
+
+	ret = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
 		&gpipeDesc,
-		IID_PPV_ARGS(m_pipelineState.ReleaseAndGetAddressOf()));
+		m_crowdPipelineState.ReleaseAndGetAddressOf());
 	ThrowIfFailed(ret);
 
 	// for shadow
@@ -609,9 +751,19 @@ HRESULT PmdActor::createPipelineState()
 		gpipeDesc.RTVFormats[2] = DXGI_FORMAT_UNKNOWN;
 	}
 
-	ret = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+	ret = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
+		&gpipeDesc,
+		m_shadowPipelineState.ReleaseAndGetAddressOf());
+	ThrowIfFailed(ret);
+
+	// for crowd shadow
+	{
+		gpipeDesc.VS = { m_crowdShadowVsBlob->GetBufferPointer(), m_crowdShadowVsBlob->GetBufferSize() };
+	}
+
+	ret = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
 		&gpipeDesc,
-		IID_PPV_ARGS(m_shadowPipelineState.ReleaseAndGetAddressOf()));
+		m_crowdShadowPipelineState.ReleaseAndGetAddressOf());
 	ThrowIfFailed(ret);
 
 	return S_OK;
@@ -625,9 +777,8 @@ HRESULT PmdActor::createRootSignature(ComPtr<ID3D12RootSignature>* rootSignature
 	const D3D12_DESCRIPTOR_RANGE descTblRange[] = {
 		CD3DX12_DESCRIPTOR_RANGE(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0, 1 /* register space */),
 		CD3DX12_DESCRIPTOR_RANGE(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 1),
-		CD3DX12_DESCRIPTOR_RANGE(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 2),
-		CD3DX12_DESCRIPTOR_RANGE(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 4, 0),
 		CD3DX12_DESCRIPTOR_RANGE(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 4),
+		CD3DX12_DESCRIPTOR_RANGE(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX /* unbounded */, 0, 3 /* register space */),
 	};
 
 	const D3D12_ROOT_PARAMETER rootParams[] = {
@@ -647,21 +798,54 @@ HRESULT PmdActor::createRootSignature(ComPtr<ID3D12RootSignature>* rootSignature
 			},
 			.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL,
 		},
+		{
+			.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS,
+			.Constants = {
+				.ShaderRegister = 2,
+				.RegisterSpace = 0,
+				.Num32BitValues = 2, // IndirectDrawCommand::materialIdx and paletteOffset
+			},
+			.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL,
+		},
 		{
 			.ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE,
 			.DescriptorTable = {
-				.NumDescriptorRanges = 2,
+				.NumDescriptorRanges = 1,
 				.pDescriptorRanges = &descTblRange[2],
 			},
 			.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL,
 		},
+		{
+			.ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV,
+			.Descriptor = {
+				.ShaderRegister = 0,
+				.RegisterSpace = 2,
+			},
+			.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL,
+		},
 		{
 			.ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE,
 			.DescriptorTable = {
 				.NumDescriptorRanges = 1,
-				.pDescriptorRanges = &descTblRange[4],
+				.pDescriptorRanges = &descTblRange[3],
 			},
-			.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL,
+			.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL,
+		},
+		{
+			.ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV,
+			.Descriptor = {
+				.ShaderRegister = 0,
+				.RegisterSpace = 4,
+			},
+			.ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX,
+		},
+		{
+			.ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV,
+			.Descriptor = {
+				.ShaderRegister = 1,
+				.RegisterSpace = 4,
+			},
+			.ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX,
 		},
 	};
 
@@ -684,7 +868,7 @@ HRESULT PmdActor::createRootSignature(ComPtr<ID3D12RootSignature>* rootSignature
 	}
 
 	const D3D12_ROOT_SIGNATURE_DESC rootSignatureDesc = {
-		.NumParameters = 4,
+		.NumParameters = _countof(rootParams),
 		.pParameters = &rootParams[0],
 		.NumStaticSamplers = 3,
 		.pStaticSamplers = &samplerDescs[0],
@@ -706,11 +890,10 @@ HRESULT PmdActor::createRootSignature(ComPtr<ID3D12RootSignature>* rootSignature
 	}
 	ThrowIfFailed(ret);
 
-	ret = Resource::instance()->getDevice()->CreateRootSignature(
-		0,
+	ret = Resource::instance()->getPipelineCache()->createRootSignature(
 		rootSigBlob->GetBufferPointer(),
 		rootSigBlob->GetBufferSize(),
-		IID_PPV_ARGS(rootSignature->ReleaseAndGetAddressOf())
+		rootSignature->ReleaseAndGetAddressOf()
 	);
 	ThrowIfFailed(ret);
 
@@ -736,7 +919,7 @@ constexpr D3D12_PRIMITIVE_TOPOLOGY PmdActor::getPrimitiveTopology() const
 
 HRESULT PmdActor::setCommonPipelineConfig(ID3D12GraphicsCommandList* list) const
 {
-	setViewportScissor(Config::kWindowWidth, Config::kWindowHeight);
+	setViewportScissor(list, Config::kWindowWidth, Config::kWindowHeight);
 	list->IASetPrimitiveTopology(getPrimitiveTopology());
 	list->IASetVertexBuffers(0, 1, &m_vbView);
 	list->IASetIndexBuffer(&m_ibView);
@@ -833,18 +1016,14 @@ HRESULT PmdActor::loadPmd(Model model)
 				m_materials[i].material.ambient = pmdMaterials[i].ambient;
 			}
 
-			m_toonResources.resize(pmdMaterials.size());
-			m_textureResources.resize(pmdMaterials.size());
-			m_sphResources.resize(pmdMaterials.size());
-			m_spaResources.resize(pmdMaterials.size());
+			// the textures are streamed after the materials are created. See createMaterialResrouces()
+			m_toonPaths.assign(pmdMaterials.size(), std::string());
+			m_texturePaths.assign(pmdMaterials.size(), std::string());
+			m_sphPaths.assign(pmdMaterials.size(), std::string());
+			m_spaPaths.assign(pmdMaterials.size(), std::string());
 
 			for (uint32_t i = 0; i < pmdMaterials.size(); ++i)
 			{
-				m_toonResources[i] = nullptr;
-				m_textureResources[i] = nullptr;
-				m_sphResources[i] = nullptr;
-				m_spaResources[i] = nullptr;
-
 				{
 					std::string toonFilePath = kToonDir + "/";
 					char toonFileName[16] = "";
@@ -857,7 +1036,7 @@ HRESULT PmdActor::loadPmd(Model model)
 
 					toonFilePath += toonFileName;
 
-					ThrowIfFailed(Loader::instance()->loadImageFromFile(toonFilePath, m_toonResources[i]));
+					m_toonPaths[i] = toonFilePath;
 				}
 
 				if (strlen(pmdMaterials[i].texFilePath) == 0)
@@ -913,20 +1092,17 @@ HRESULT PmdActor::loadPmd(Model model)
 
 				if (!texFileName.empty())
 				{
-					const auto texFilePath = getTexturePathFromModelAndTexPath(modelPath, texFileName.c_str());
-					ThrowIfFailed(Loader::instance()->loadImageFromFile(texFilePath, m_textureResources[i]));
+					m_texturePaths[i] = getTexturePathFromModelAndTexPath(modelPath, texFileName.c_str());
 				}
 
 				if (!sphFileName.empty())
 				{
-					const auto sphFilePath = getTexturePathFromModelAndTexPath(modelPath, sphFileName.c_str());
-					ThrowIfFailed(Loader::instance()->loadImageFromFile(sphFilePath, m_sphResources[i]));
+					m_sphPaths[i] = getTexturePathFromModelAndTexPath(modelPath, sphFileName.c_str());
 				}
 
 				if (!spaFileName.empty())
 				{
-					const auto spaFilePath = getTexturePathFromModelAndTexPath(modelPath, spaFileName.c_str());
-					ThrowIfFailed(Loader::instance()->loadImageFromFile(spaFilePath, m_spaResources[i]));
+					m_spaPaths[i] = getTexturePathFromModelAndTexPath(modelPath, spaFileName.c_str());
 				}
 			}
 		}
@@ -967,20 +1143,69 @@ HRESULT PmdActor::loadPmd(Model model)
 				const std::string& parentName = m_boneNameArray.at(bone.parentNo);
 				m_boneNodeTable[parentName].children.emplace_back(&m_boneNodeTable[bone.boneName]);
 			}
+
+			// the secondary bones, and the ones under them
+			m_secondaryBones.assign(pmdBones.size(), false);
+
+			auto markSecondary = [this](const BoneNode& node, auto& self) -> void {
+				m_secondaryBones.at(node.boneIdx) = true;
+
+				for (const BoneNode* child : node.children)
+				{
+					self(*child, self);
+				}
+			};
+
+			for (uint32_t i = 0; i < pmdBones.size(); ++i)
+			{
+				const std::string& boneName = m_boneNameArray.at(i);
+				const bool bSecondary = std::any_of(std::begin(kSecondaryBoneNames), std::end(kSecondaryBoneNames), [&boneName](const std::string& name) {
+					return boneName.find(name) != std::string::npos;
+				});
+
+				if (bSecondary && !m_secondaryBones.at(i))
+				{
+					markSecondary(*m_boneNodeAddressArray.at(i), markSecondary);
+				}
+			}
 		}
 
 		{
 			m_boneMatrices.resize(pmdBones.size());
 			std::fill(m_boneMatrices.begin(), m_boneMatrices.end(), DirectX::XMMatrixIdentity());
 		}
+
+		// a motion is bound by the names of the bones, and moves them about their bind positions down the tree
+		{
+			Util::Fnv1a hasher;
+			hasher.add(pmdBones.size());
+
+			for (uint32_t i = 0; i < pmdBones.size(); ++i)
+			{
+				const BoneNode* node = m_boneNodeAddressArray.at(i);
+				hasher.addString(m_boneNameArray.at(i).c_str());
+				hasher.addBytes(&node->startPos, sizeof(node->startPos));
+				hasher.add(node->children.size());
+
+				for (const BoneNode* child : node->children)
+				{
+					hasher.add(child->boneIdx);
+				}
+			}
+
+			m_bindingKey = hasher.get();
+		}
 	}
 	ThrowIfFalse(fclose(fp) == 0);
 
+	createMeshlets();
 	ThrowIfFailed(createResources());
 
 	Debug::debugOutputFormatString("Vertex num  : %d\n", m_vertNum);
 	Debug::debugOutputFormatString("Index num   : %d\n", m_indicesNum);
 	Debug::debugOutputFormatString("Material num: %zd\n", m_materials.size());
+	Debug::debugOutputFormatString("Meshlet num : %zd\n", m_meshlets.meshlets.size());
+	Debug::debugOutputFormatString("LOD num     : %zd\n", m_lods.size());
 	Debug::debugOutputFormatString("Bone num    : %zd\n", m_boneMatrices.size());
 
 #define PRINT_DEBUG_IK_DATA (1)
@@ -1018,101 +1243,123 @@ HRESULT PmdActor::loadPmd(Model model)
 HRESULT PmdActor::loadVmd()
 {
 	const std::string motionPath = getMotionPath();
+	MotionCache::Motion motion;
+
+#if BAKED_MOTION
+	// the keys as authored, so that the error of the bake does not stack on the one of the compression
+	ThrowIfFalse(MotionCache::readVmd(motionPath, &motion));
+#elif COMPRESSED_MOTION
+	// a hit is the compressed keys and the IK switches, and the VMD is not parsed
+	motion = Resource::instance()->getMotionCache()->load(motionPath);
+#else
+	ThrowIfFalse(MotionCache::readVmd(motionPath, &motion));
+#endif // BAKED_MOTION
 
-	FILE* fp = nullptr;
-	ThrowIfFalse(fopen_s(&fp, motionPath.c_str(), "rb") == 0);
-	{
-		// skip 50 bytes from the beginning
-		ThrowIfFalse(fseek(fp, 50, SEEK_SET) == 0);
+	size_t numKeys = 0;
 
-		uint32_t motionDataNum = 0;
-		ThrowIfFalse(fread(&motionDataNum, sizeof(motionDataNum), 1, fp) == 1);
+	for (const MotionCompressor::Track& track : motion.tracks)
+	{
+		m_motionData[track.boneName] = track.keys;
+		numKeys += track.keys.size();
+	}
 
-		std::vector<VMDMotion> vmdMotionData(motionDataNum);
-		ThrowIfFalse(fread(vmdMotionData.data(), sizeof(VMDMotion), motionDataNum, fp) == motionDataNum);
+	for (const MotionCache::IkSwitch& ikSwitch : motion.ikSwitches)
+	{
+		VMDIkEnable& ikEnable = m_ikEnableData.emplace_back();
+		ikEnable.frameNo = ikSwitch.frameNo;
 
-		uint32_t morphCount = 0;
-		ThrowIfFalse(fread(&morphCount, sizeof(morphCount), 1, fp) == 1);
+		for (const auto& [boneName, bEnabled] : ikSwitch.bones)
+		{
+			ikEnable.ikEnableTable[boneName] = bEnabled;
+		}
+	}
 
-		std::vector<VMDMorph> morphs(morphCount);
-		fread(morphs.data(), sizeof(VMDMorph), morphCount, fp);
+	m_duration = motion.duration;
 
-		uint32_t vmdCameraCount = 0;
-		ThrowIfFalse(fread(&vmdCameraCount, sizeof(vmdCameraCount), 1, fp) == 1);
+	// the tracks are ordered by the name of the bone
+	{
+		Util::Fnv1a hasher;
+		hasher.add(motion.tracks.size());
 
-		std::vector<VMDCamera> cameraData(vmdCameraCount);
-		ThrowIfFalse(fread(cameraData.data(), sizeof(VMDCamera), vmdCameraCount, fp) == vmdCameraCount);
+		for (const MotionCompressor::Track& track : motion.tracks)
+		{
+			hasher.addString(track.boneName.c_str());
+			hasher.add(track.keys.size());
 
-		uint32_t vmdLightCount = 0;
-		ThrowIfFalse(fread(&vmdLightCount, sizeof(vmdLightCount), 1, fp) == 1);
+			for (const MotionCompressor::Key& key : track.keys)
+			{
+				hasher.add(key.frameNo);
+				hasher.addBytes(&key.rotation, sizeof(key.rotation));
+				hasher.addBytes(&key.offset, sizeof(key.offset));
+				hasher.addBytes(&key.p1, sizeof(key.p1));
+				hasher.addBytes(&key.p2, sizeof(key.p2));
+			}
+		}
 
-		std::vector<VMDLight> lights(vmdLightCount);
-		ThrowIfFalse(fread(lights.data(), sizeof(VMDLight), vmdLightCount, fp) == vmdLightCount);
+		m_motionKey = hasher.get();
+	}
 
-		uint32_t selfShadowCount = 0;
-		ThrowIfFalse(fread(&selfShadowCount, sizeof(selfShadowCount), 1, fp) == 1);
+	Debug::debugOutputFormatString("Motion num  : %zu\n", numKeys);
+	Debug::debugOutputFormatString("Duration    : %d\n", m_duration);
 
-		std::vector<VMDSelfShadow> selfShadowData(selfShadowCount);
-		ThrowIfFalse(fread(selfShadowData.data(), sizeof(VMDSelfShadow), selfShadowCount, fp) == selfShadowCount);
+#if BAKED_MOTION
+	bakeMotion();
+#endif // BAKED_MOTION
 
-		uint32_t ikSwitchCount = 0;
-		ThrowIfFalse(fread(&ikSwitchCount, sizeof(ikSwitchCount), 1, fp) <= 1);
+	return S_OK;
+}
 
-		m_ikEnableData.resize(ikSwitchCount);
+void PmdActor::bakeMotion()
+{
+	m_bakedMotion = MotionBake::Clip();
+	m_bakedMotion.numFrames = m_duration + 1;
 
-		for (auto& ikEnable : m_ikEnableData)
-		{
-			ThrowIfFalse(fread(&ikEnable.frameNo, sizeof(ikEnable.frameNo), 1, fp) == 1);
+	std::vector<MotionBake::Sampler> samplers;
+	size_t numKeyframeBytes = 0;
+	size_t numBakedBytes = 0;
 
-			// visibility flag won't be used
-			uint8_t visibleFlg = 0;
-			ThrowIfFalse(fread(&visibleFlg, sizeof(visibleFlg), 1, fp) == 1);
+	for (const auto& [boneName, keys] : m_motionData)
+	{
+		const auto itBoneNode = m_boneNodeTable.find(boneName);
 
-			uint32_t ikBoneCount = 0;
-			ThrowIfFalse(fread(&ikBoneCount, sizeof(ikBoneCount), 1, fp) == 1);
+		if (itBoneNode == m_boneNodeTable.end())
+			continue;
 
-			for (uint32_t i = 0; i < ikBoneCount; ++i)
+		// before the first key the bone stays in the bind pose, as the keyframes leave it
+		const std::vector<MotionCompressor::Key>* pKeys = &keys;
+		samplers.emplace_back([pKeys](uint32_t frameNo, DirectX::XMVECTOR* pRotation, DirectX::XMVECTOR* pOffset) {
+			if (!MotionCompressor::sample(*pKeys, frameNo, pRotation, pOffset))
 			{
-				char ikBoneName[20] = "";
-				ThrowIfFalse(fread(ikBoneName, _countof(ikBoneName), 1, fp) == 1);
-
-				uint8_t flg = 0;
-				ThrowIfFalse(fread(&flg, sizeof(flg), 1, fp) == 1);
-
-				ikEnable.ikEnableTable[ikBoneName] = flg;
+				*pRotation = DirectX::XMQuaternionIdentity();
+				*pOffset = DirectX::XMVectorZero();
 			}
-		}
-
-		for (const VMDMotion& vmdMotion : vmdMotionData)
-		{
-			m_motionData[vmdMotion.boneName].emplace_back(
-				Motion(
-					vmdMotion.frameNo,
-					DirectX::XMLoadFloat4(&vmdMotion.quaternion),
-					vmdMotion.location,
-					DirectX::XMFLOAT2(static_cast<float>(vmdMotion.bezier[3]) / 127.0f, static_cast<float>(vmdMotion.bezier[7]) / 127.0f),
-					DirectX::XMFLOAT2(static_cast<float>(vmdMotion.bezier[11]) / 127.0f, static_cast<float>(vmdMotion.bezier[15]) / 127.0f)));
-
-			m_duration = std::max<uint32_t>(m_duration, vmdMotion.frameNo);
-		}
-
-		for (auto& motionData : m_motionData)
-		{
-			std::sort(
-				motionData.second.begin(),
-				motionData.second.end(),
-				[](const Motion& lval, const Motion& rval)
-				{
-					return lval.frameNo <= rval.frameNo;
-				});
-		}
+		});
 
-		Debug::debugOutputFormatString("Motion num  : %d\n", motionDataNum);
-		Debug::debugOutputFormatString("Duration    : %d\n", m_duration);
+		const MotionBake::Track& track = m_bakedMotion.tracks.emplace_back(MotionBake::bakeTrack(itBoneNode->second.boneIdx, m_bakedMotion.numFrames, samplers.back()));
+		numKeyframeBytes += sizeof(keys) + sizeof(MotionCompressor::Key) * keys.size();
+		numBakedBytes += sizeof(track) + sizeof(uint16_t) * (track.rotations.size() + track.translations.size());
 	}
-	ThrowIfFalse(fclose(fp) == 0);
 
-	return S_OK;
+	Debug::debugOutputFormatString("Baked motion: %u frames, %zu tracks, %zu KB (keyframes %zu KB)\n",
+		m_bakedMotion.numFrames,
+		m_bakedMotion.tracks.size(),
+		numBakedBytes / 1024,
+		numKeyframeBytes / 1024);
+
+#ifdef _DEBUG
+	// every frame of every track through both, so only in a debug build
+	const MotionBake::Report report = MotionBake::measure(m_bakedMotion, samplers);
+
+	Debug::debugOutputFormatString("Baked motion: %.3f us a bone (keyframes %.3f us), max error %.2e rad, %.2e (%.2e of the range)\n",
+		report.decodeTimeInUs,
+		report.sampleTimeInUs,
+		report.maxRotationError,
+		report.maxTranslationError,
+		report.maxRelativeTranslationError);
+
+	ThrowIfFalse(report.maxRotationError <= MotionBake::kMaxRotationError);
+	ThrowIfFalse(report.maxRelativeTranslationError <= MotionBake::kMaxTranslationError);
+#endif // _DEBUG
 }
 
 HRESULT PmdActor::createBlackTexture()
@@ -1250,7 +1497,7 @@ HRESULT PmdActor::createDebugResources()
 HRESULT PmdActor::createTransformResource()
 {
 	{
-		const size_t w = Util::alignmentedSize(sizeof(DirectX::XMMATRIX) * (1 + m_boneMatrices.size()), 256);
+		m_transformSliceSize = Util::alignmentedSize(sizeof(DirectX::XMMATRIX) * (1 + m_boneMatrices.size()), 256);
 
 		D3D12_HEAP_PROPERTIES heapProp = { };
 		{
@@ -1264,7 +1511,7 @@ HRESULT PmdActor::createTransformResource()
 		{
 			resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
 			resourceDesc.Alignment = 0;
-			resourceDesc.Width = w;
+			resourceDesc.Width = m_transformSliceSize * Config::kNumFramesInFlight; // a slice per frame in flight
 			resourceDesc.Height = 1;
 			resourceDesc.DepthOrArraySize = 1;
 			resourceDesc.MipLevels = 1;
@@ -1286,28 +1533,30 @@ HRESULT PmdActor::createTransformResource()
 
 	// map and copy bone matrices
 	{
+		// layout of each slice
 		// [0]: world matrix
 		// [1] .. [N]: bone matrices
-		DirectX::XMMATRIX* mappedMatrices = nullptr;
-
 		auto result = m_transformResource.Get()->Map(
 			0,
 			nullptr,
-			reinterpret_cast<void**>(&mappedMatrices));
+			reinterpret_cast<void**>(&m_mappedTransform));
 		ThrowIfFailed(result);
 
-		std::copy(m_boneMatrices.begin(), m_boneMatrices.end(), mappedMatrices + 1);
+		for (UINT i = 0; i < Config::kNumFramesInFlight; ++i)
+		{
+			selectTransformSlice(i);
+			std::copy(m_boneMatrices.begin(), m_boneMatrices.end(), m_boneMatrixPointer);
+		}
 
-		m_worldMatrixPointer = mappedMatrices;
-		m_boneMatrixPointer = mappedMatrices + 1;
+		selectTransformSlice(0);
 	}
 
 	{
 		D3D12_DESCRIPTOR_HEAP_DESC heapDesc = { };
 		{
 			heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-			heapDesc.NumDescriptors = 1;
-			heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+			heapDesc.NumDescriptors = Config::kNumFramesInFlight;
+			heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 			heapDesc.NodeMask = 0;
 		}
 
@@ -1317,196 +1566,684 @@ HRESULT PmdActor::createTransformResource()
 		ThrowIfFailed(ret);
 	}
 
+	for (UINT i = 0; i < Config::kNumFramesInFlight; ++i)
 	{
 		D3D12_CONSTANT_BUFFER_VIEW_DESC viewDesc = { };
 		{
-			viewDesc.BufferLocation = m_transformResource->GetGPUVirtualAddress();
-			viewDesc.SizeInBytes = static_cast<UINT>(m_transformResource->GetDesc().Width);
+			viewDesc.BufferLocation = m_transformResource->GetGPUVirtualAddress() + m_transformSliceSize * i;
+			viewDesc.SizeInBytes = static_cast<UINT>(m_transformSliceSize);
 		}
-		auto handle = m_transformDescHeap->GetCPUDescriptorHandleForHeapStart();
+		const auto handle = CD3DX12_CPU_DESCRIPTOR_HANDLE(
+			m_transformDescHeap->GetCPUDescriptorHandleForHeapStart(),
+			i,
+			Resource::instance()->getDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV));
 
 		Resource::instance()->getDevice()->CreateConstantBufferView(
 			&viewDesc,
 			handle);
 	}
 
+	m_transformDescTable = Resource::instance()->getDescriptorAllocator()->stage(m_transformDescHeap->GetCPUDescriptorHandleForHeapStart(), Config::kNumFramesInFlight);
+
 	return S_OK;
 }
 
-HRESULT PmdActor::createMaterialResrouces()
+HRESULT PmdActor::createDrawArguments(IndirectDraw* pDraw, UINT instanceCount, const std::string& name)
 {
-	const auto materialBufferSize = Util::alignmentedSize(sizeof(MaterialForHlsl), 256);
-	const UINT64 materialNum = m_materials.size();
-	ThrowIfFalse(materialNum == m_textureResources.size());
-	ThrowIfFalse(materialNum == m_sphResources.size());
-	ThrowIfFalse(materialNum == m_spaResources.size());
-	ThrowIfFalse(materialNum == m_toonResources.size());
-	ThrowIfFalse(m_whiteTextureResource != nullptr);
-	ThrowIfFalse(m_blackTextureResource != nullptr);
+	ThrowIfFalse(pDraw != nullptr);
 
-	// create resource (CBV)
-	//ID3D12Resource* materialResource = nullptr;
-	{
-		D3D12_HEAP_PROPERTIES heapProp = { };
-		{
-			heapProp.Type = D3D12_HEAP_TYPE_UPLOAD;
-			heapProp.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-			heapProp.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-			heapProp.CreationNodeMask = 1;
-			heapProp.VisibleNodeMask = 1;
-		}
-		D3D12_RESOURCE_DESC resourceDesc = { };
-		{
-			resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-			resourceDesc.Alignment = 0;
-			resourceDesc.Width = materialBufferSize * materialNum;
-			resourceDesc.Height = 1;
-			resourceDesc.DepthOrArraySize = 1;
-			resourceDesc.MipLevels = 1;
-			resourceDesc.Format = DXGI_FORMAT_UNKNOWN;
-			resourceDesc.SampleDesc = { 1, 0 };
-			resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-			resourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-		}
+	std::vector<uint32_t> materialIdxes;
 
-		auto ret = Resource::instance()->getDevice()->CreateCommittedResource(
-			&heapProp,
-			D3D12_HEAP_FLAG_NONE,
-			&resourceDesc,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(m_materialResource.ReleaseAndGetAddressOf()));
-		ThrowIfFailed(ret);
+	for (uint32_t i = 0; i < m_materials.size(); ++i)
+	{
+		materialIdxes.insert(materialIdxes.end(), m_meshlets.materialOffsets.at(i + 1) - m_meshlets.materialOffsets.at(i), i);
 	}
 
-	// copy
+	for (size_t i = 0; i < m_lods.size(); ++i)
 	{
-		UINT8* pMapMaterial = nullptr;
-		auto ret = m_materialResource->Map(0, nullptr, reinterpret_cast<void**>(&pMapMaterial));
-		ThrowIfFailed(ret);
-
-		for (const auto& m : m_materials)
+		for (uint32_t j = 0; j < m_materials.size(); ++j)
 		{
-			*reinterpret_cast<MaterialForHlsl*>(pMapMaterial) = m.material;
-			pMapMaterial += materialBufferSize;
+			materialIdxes.push_back(j);
 		}
+	}
+
+	// the palette of an instance is picked by the shader, so the commands start at 0
+	const auto commands = IndirectDraw::build(m_drawIndexCounts, materialIdxes, instanceCount, 0);
+
+	return pDraw->init(Resource::instance()->getDevice(), getRootSignature(), 2 /* root param 2 */, commands, name);
+}
+
+HRESULT PmdActor::createCrowdResource()
+{
+	const size_t instancesSize = Util::alignmentedSize(sizeof(CrowdInstance) * m_numCrowdInstances, 256);
+	const size_t palettesSize = sizeof(DirectX::XMMATRIX) * m_boneMatrices.size() * m_numCrowdPhases;
 
-		m_materialResource->Unmap(0, nullptr);
+	m_crowdPalettesOffset = instancesSize;
+	m_crowdSliceSize = Util::alignmentedSize(instancesSize + palettesSize, 256);
+
+	ThrowIfFailed(createBufferResource(&m_crowdResource, m_crowdSliceSize * Config::kNumFramesInFlight)); // a slice per frame in flight
+
+	auto result = m_crowdResource->SetName(Util::getWideStringFromString("pmdCrowdBuffer").c_str());
+	ThrowIfFailed(result);
+
+	result = m_crowdResource->Map(0, nullptr, reinterpret_cast<void**>(&m_mappedCrowd));
+	ThrowIfFailed(result);
+
+	// the rest pose until the first applyPose()
+	for (UINT i = 0; i < Config::kNumFramesInFlight; ++i)
+	{
+		uint8_t* const pSlice = m_mappedCrowd + m_crowdSliceSize * i;
+		std::vector<uint32_t> instanceIdxes(m_numCrowdInstances);
+		std::iota(instanceIdxes.begin(), instanceIdxes.end(), 0);
+
+		packCrowdInstances(m_crowdPlacements, instanceIdxes, DirectX::XMMatrixIdentity(), static_cast<uint32_t>(m_boneMatrices.size()), m_numCrowdPhases, reinterpret_cast<CrowdInstance*>(pSlice));
+
+		for (uint32_t phase = 0; phase < m_numCrowdPhases; ++phase)
+		{
+			std::copy(m_boneMatrices.begin(), m_boneMatrices.end(), reinterpret_cast<DirectX::XMMATRIX*>(pSlice + m_crowdPalettesOffset) + m_boneMatrices.size() * phase);
+		}
 	}
 
-	// create view (CBV + SRV)
+	return S_OK;
+}
+
+void PmdActor::createMeshlets()
+{
+	std::vector<Meshlet::Vertex> vertices;
+	std::vector<uint32_t> indexCounts;
+
+	for (UINT i = 0; i < m_vertNum; ++i)
 	{
-		D3D12_DESCRIPTOR_HEAP_DESC heapDesc = { };
+		const PmdVertexForDx& v = m_vertices.at(i);
+		vertices.push_back({ v.pos, v.boneNo[0], v.boneNo[1], v.boneWeight / 100.0f });
+	}
+
+	for (const auto& material : m_materials)
+	{
+		indexCounts.push_back(material.indicesNum);
+	}
+
+	// built and optimized offline, or on the first load
+	ModelCache::Model model = Resource::instance()->getModelCache()->load(vertices, m_indices, indexCounts);
+	m_meshlets = std::move(model.clusters);
+	m_lods = std::move(model.lods);
+
+#ifdef _DEBUG
+	ThrowIfFalse(Meshlet::validate(m_meshlets, vertices, m_indices, indexCounts));
+#endif // _DEBUG
+
+	// the materials draw the same triangles from the same ranges, in the optimized order
+	m_indices = m_meshlets.indices;
+	m_meshletIndexCounts.clear();
+
+	for (const auto& meshlet : m_meshlets.meshlets)
+	{
+		m_meshletIndexCounts.push_back(Meshlet::getIndexCount(meshlet));
+	}
+
+	// the levels of detail after the full mesh, from the same vertices
+	m_drawIndexCounts = m_meshletIndexCounts;
+	m_lodCommandOffsets = { 0, static_cast<uint32_t>(m_drawIndexCounts.size()) };
+
+	for (const auto& lod : m_lods)
+	{
+		m_indices.insert(m_indices.end(), lod.indices.begin(), lod.indices.end());
+		m_drawIndexCounts.insert(m_drawIndexCounts.end(), lod.indexCounts.begin(), lod.indexCounts.end());
+		m_lodCommandOffsets.push_back(static_cast<uint32_t>(m_drawIndexCounts.size()));
+	}
+}
+
+void PmdActor::createBounds()
+{
+	std::vector<Culling::Aabb> boneBounds(m_boneMatrices.size());
+	UINT indexOffset = 0;
+
+	m_materialBoneBounds.clear();
+
+	// the vertices which are drawn, as the materials draw them
+	for (const auto& material : m_materials)
+	{
+		std::vector<Culling::Aabb> materialBoneBounds(m_boneMatrices.size());
+
+		for (UINT i = indexOffset; i < indexOffset + material.indicesNum; ++i)
 		{
-			heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-			heapDesc.NumDescriptors = static_cast<UINT>(materialNum) * 5; // CBV (material) + SRV (tex) + SRV (sph) + SRV (spa) + SRV(toon)
-			heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-			heapDesc.NodeMask = 0;
+			const PmdVertexForDx& v = m_vertices.at(m_indices.at(i));
+			const float weight = v.boneWeight / 100.0f;
+
+			Culling::addInfluence(&boneBounds, v.pos, v.boneNo[0], v.boneNo[1], weight);
+			Culling::addInfluence(&materialBoneBounds, v.pos, v.boneNo[0], v.boneNo[1], weight);
 		}
 
-		auto ret = Resource::instance()->getDevice()->CreateDescriptorHeap(
-			&heapDesc,
-			IID_PPV_ARGS(m_materialDescHeap.ReleaseAndGetAddressOf()));
-		ThrowIfFailed(ret);
+		m_materialBoneBounds.push_back(Culling::compact(materialBoneBounds));
+		indexOffset += material.indicesNum;
+	}
+
+	m_boneBounds = Culling::compact(boneBounds);
+	m_meshletBoneBounds.clear();
+	indexOffset = 0;
+
+	for (UINT count : m_meshletIndexCounts)
+	{
+		std::vector<Culling::Aabb> meshletBoneBounds(m_boneMatrices.size());
 
-		D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = { };
+		for (UINT i = indexOffset; i < indexOffset + count; ++i)
 		{
-			cbvDesc.BufferLocation = m_materialResource->GetGPUVirtualAddress();
-			cbvDesc.SizeInBytes = static_cast<UINT>(materialBufferSize);
+			const PmdVertexForDx& v = m_vertices.at(m_indices.at(i));
+			Culling::addInfluence(&meshletBoneBounds, v.pos, v.boneNo[0], v.boneNo[1], v.boneWeight / 100.0f);
 		}
 
-		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = { };
+		m_meshletBoneBounds.push_back(Culling::compact(meshletBoneBounds));
+		indexOffset += count;
+	}
+}
+
+void PmdActor::updateCrowdBounds(const PmdPose& pose)
+{
+	const size_t numBones = m_boneMatrices.size();
+
+	// the instances of a phase have the same pose, so the same box where they stand
+	std::vector<Culling::Aabb> phaseBounds;
+
+	for (uint32_t phase = 0; phase < m_numCrowdPhases; ++phase)
+	{
+		phaseBounds.push_back(Culling::skin(m_boneBounds, pose.bones.data() + numBones * phase));
+	}
+
+	m_crowdInstanceBounds.resize(m_numCrowdInstances);
+	m_bound = Culling::Aabb();
+
+	for (uint32_t i = 0; i < m_numCrowdInstances; ++i)
+	{
+		m_crowdInstanceBounds.at(i) = Culling::transform(phaseBounds.at(getCrowdPhase(i, m_numCrowdPhases)), pose.world * m_crowdPlacements.at(i));
+		m_bound = Culling::merge(m_bound, m_crowdInstanceBounds.at(i));
+	}
+}
+
+void PmdActor::cullCrowd(const PmdPose& pose, const Culling::Views& views, bool bInCamera, bool bInLight)
+{
+	std::vector<uint32_t> instanceIdxes;
+	bool bVisibleInCamera = false;
+	bool bVisibleInLight = false;
+	float distance = FLT_MAX;
+	float screenHeight = 0.0f;
+
+	for (uint32_t i = 0; i < m_numCrowdInstances && (bInCamera || bInLight); ++i)
+	{
+		const Culling::Aabb& bound = m_crowdInstanceBounds.at(i);
+		const bool bInstanceInCamera = bInCamera && Culling::intersects(views.camera, bound);
+		const bool bInstanceInLight = bInLight && Culling::intersects(views.light, bound);
+
+		if (!bInstanceInCamera && !bInstanceInLight)
+			continue;
+
+		// both passes draw the same instances
+		instanceIdxes.push_back(i);
+		bVisibleInCamera |= bInstanceInCamera;
+		bVisibleInLight |= bInstanceInLight;
+		distance = std::min(distance, Culling::getDistance(bound, views.eye));
+
+		if (bInstanceInCamera)
 		{
-			srvDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-			srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-			srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-			srvDesc.Texture2D.MostDetailedMip = 0;
-			srvDesc.Texture2D.MipLevels = 1;
-			srvDesc.Texture2D.PlaneSlice = 0;
-			srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+			screenHeight = std::max(screenHeight, Culling::getScreenHeight(bound, views));
 		}
+	}
 
-		auto descHeapH = m_materialDescHeap->GetCPUDescriptorHandleForHeapStart();
-		const auto inc = Resource::instance()->getDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	// the instances share the commands, so the level of the nearest one
+	m_lod = selectLod(distance, views);
 
-		for (uint32_t i = 0; i < materialNum; ++i)
+	const uint32_t firstCommand = m_lodCommandOffsets.at(m_lod);
+	const uint32_t lastCommand = m_lodCommandOffsets.at(m_lod + 1);
+	const UINT firstIndex = std::reduce(m_drawIndexCounts.begin(), m_drawIndexCounts.begin() + firstCommand, 0u);
+	const UINT numIndices = std::reduce(m_drawIndexCounts.begin() + firstCommand, m_drawIndexCounts.begin() + lastCommand, 0u);
+
+	m_bVisibleInCamera = bVisibleInCamera;
+	m_screenHeight = screenHeight;
+	m_shadowRanges.clear();
+
+	if (bVisibleInLight)
+	{
+		m_shadowRanges.push_back({ firstIndex, numIndices });
+	}
+
+	uint8_t* const pSlice = m_mappedCrowd + m_crowdSliceSize * m_frameIndex;
+	m_numVisibleCrowdInstances = packCrowdInstances(m_crowdPlacements, instanceIdxes, pose.world, static_cast<uint32_t>(m_boneMatrices.size()), m_numCrowdPhases, reinterpret_cast<CrowdInstance*>(pSlice));
+
+	// the materials are not culled one by one, since each would need the boxes of all the instances
+	std::vector<bool> visible(m_crowdIndirectDraw.getNumCommands(), false);
+	std::fill(visible.begin() + firstCommand, visible.begin() + lastCommand, true);
+
+	m_crowdIndirectDraw.update(m_frameIndex, visible, m_numVisibleCrowdInstances);
+}
+
+uint32_t PmdActor::selectLod(float distance, const Culling::Views& views) const
+{
+	// the world has no scale, so the errors in the units of the model are the ones in the world
+	return MeshSimplifier::selectLod(m_lods, distance, views.screenScale, Config::kLodMaxScreenError);
+}
+
+uint32_t PmdActor::getPhaseFrameOffset(uint32_t phase) const
+{
+	// spread over the whole motion, so that the neighbors are out of step
+	return static_cast<uint32_t>(static_cast<uint64_t>(m_duration) * phase / m_numCrowdPhases);
+}
+
+std::vector<DirectX::XMMATRIX> PmdActor::getCrowdPlacements(uint32_t numInstances, float spacing)
+{
+	const int32_t halfSide = static_cast<int32_t>(std::ceil(std::sqrt(static_cast<float>(numInstances)) / 2.0f));
+
+	std::vector<std::pair<int32_t, int32_t>> cells;
+
+	for (int32_t z = -halfSide; z <= halfSide; ++z)
+	{
+		for (int32_t x = -halfSide; x <= halfSide; ++x)
 		{
-			Resource::instance()->getDevice()->CreateConstantBufferView(&cbvDesc, descHeapH);
+			cells.push_back({ x, z });
+		}
+	}
 
-			cbvDesc.BufferLocation += materialBufferSize; // pointing to GPU virtual address
-			descHeapH.ptr += inc;
+	std::stable_sort(cells.begin(), cells.end(), [](const auto& a, const auto& b) {
+		return a.first * a.first + a.second * a.second < b.first * b.first + b.second * b.second;
+		});
 
-			if (m_textureResources[i] == nullptr)
-			{
-				srvDesc.Format = m_whiteTextureResource->GetDesc().Format;
-				Resource::instance()->getDevice()->CreateShaderResourceView(m_whiteTextureResource.Get(), &srvDesc, descHeapH);
-			}
-			else
-			{
-				srvDesc.Format = m_textureResources[i]->GetDesc().Format;
-				Resource::instance()->getDevice()->CreateShaderResourceView(m_textureResources[i].Get(), &srvDesc, descHeapH);
-			}
+	ThrowIfFalse(cells.size() >= numInstances);
 
-			descHeapH.ptr += inc;
+	std::vector<DirectX::XMMATRIX> placements;
 
-			if (m_sphResources[i] == nullptr)
+	for (uint32_t i = 0; i < numInstances; ++i)
+	{
+		placements.push_back(DirectX::XMMatrixTranslation(cells.at(i).first * spacing, 0.0f, cells.at(i).second * spacing));
+	}
+
+	return placements;
+}
+
+uint32_t PmdActor::packCrowdInstances(const std::vector<DirectX::XMMATRIX>& placements, const std::vector<uint32_t>& instanceIdxes, const DirectX::XMMATRIX& world, uint32_t numBones, uint32_t numPhases, CrowdInstance* pDst)
+{
+	ThrowIfFalse(pDst != nullptr);
+
+	for (uint32_t i = 0; i < instanceIdxes.size(); ++i)
+	{
+		const uint32_t idx = instanceIdxes.at(i);
+
+		CrowdInstance instance = { };
+		{
+			instance.world = world * placements.at(idx);
+			instance.paletteOffset = numBones * getCrowdPhase(idx, numPhases);
+		}
+
+		// a write combined buffer. Written once in order
+		std::memcpy(&pDst[i], &instance, sizeof(instance));
+	}
+
+	return static_cast<uint32_t>(instanceIdxes.size());
+}
+
+std::vector<std::pair<UINT, UINT>> PmdActor::getVisibleRanges(const std::vector<UINT>& indexCounts, const std::vector<bool>& visible)
+{
+	ThrowIfFalse(indexCounts.size() == visible.size());
+
+	std::vector<std::pair<UINT, UINT>> ranges; // the start index and the count
+	UINT indexOffset = 0;
+
+	for (size_t i = 0; i < indexCounts.size(); ++i)
+	{
+		const UINT count = indexCounts.at(i);
+
+		if (visible.at(i) && count > 0)
+		{
+			if (!ranges.empty() && ranges.back().first + ranges.back().second == indexOffset)
 			{
-				srvDesc.Format = m_whiteTextureResource->GetDesc().Format;
-				Resource::instance()->getDevice()->CreateShaderResourceView(m_whiteTextureResource.Get(), &srvDesc, descHeapH);
+				ranges.back().second += count;
 			}
 			else
 			{
-				srvDesc.Format = m_sphResources[i]->GetDesc().Format;
-				Resource::instance()->getDevice()->CreateShaderResourceView(m_sphResources[i].Get(), &srvDesc, descHeapH);
+				ranges.push_back({ indexOffset, count });
 			}
+		}
 
-			descHeapH.ptr += inc;
+		indexOffset += count;
+	}
 
-			if (m_spaResources[i] == nullptr)
-			{
-				srvDesc.Format = m_blackTextureResource->GetDesc().Format;
-				Resource::instance()->getDevice()->CreateShaderResourceView(m_blackTextureResource.Get(), &srvDesc, descHeapH);
-			}
-			else
+	return ranges;
+}
+
+bool PmdActor::selfCheck()
+{
+	using namespace DirectX;
+
+	constexpr uint32_t kNumInstances = 10;
+	constexpr uint32_t kNumPhases = 3;
+	constexpr uint32_t kNumBones = 4;
+
+	const auto placements = getCrowdPlacements(kNumInstances, 10.0f);
+	const XMMATRIX world = XMMatrixRotationY(0.5f);
+
+	// the palettes the simulation would write, one per phase
+	std::vector<XMMATRIX> palettes;
+
+	for (uint32_t phase = 0; phase < kNumPhases; ++phase)
+	{
+		for (uint32_t bone = 0; bone < kNumBones; ++bone)
+		{
+			palettes.push_back(XMMatrixTranslation(static_cast<float>(phase), static_cast<float>(bone), 0.0f));
+		}
+	}
+
+	std::vector<uint32_t> instanceIdxes(kNumInstances);
+	std::iota(instanceIdxes.begin(), instanceIdxes.end(), 0);
+
+	std::vector<CrowdInstance> instances(kNumInstances);
+
+	if (packCrowdInstances(placements, instanceIdxes, world, kNumBones, kNumPhases, instances.data()) != kNumInstances)
+		return false;
+
+	auto equals = [](const XMMATRIX& a, const XMMATRIX& b) { return std::memcmp(&a, &b, sizeof(XMMATRIX)) == 0; };
+
+	// the same as kNumInstances actors, each posed with the motion of its phase and placed on its own
+	for (uint32_t i = 0; i < kNumInstances; ++i)
+	{
+		const uint32_t phase = getCrowdPhase(i, kNumPhases);
+
+		if (!equals(instances.at(i).world, world * placements.at(i)))
+			return false;
+
+		for (uint32_t bone = 0; bone < kNumBones; ++bone)
+		{
+			const XMMATRIX expected = XMMatrixTranslation(static_cast<float>(phase), static_cast<float>(bone), 0.0f);
+
+			if (!equals(palettes.at(instances.at(i).paletteOffset + bone), expected))
+				return false;
+		}
+	}
+
+	// the culled ones are left out, and the rest keep their places and phases
+	{
+		const std::vector<uint32_t> visibleIdxes = { 1, 4, 8 };
+		std::vector<CrowdInstance> visible(visibleIdxes.size());
+
+		if (packCrowdInstances(placements, visibleIdxes, world, kNumBones, kNumPhases, visible.data()) != visibleIdxes.size())
+			return false;
+
+		for (uint32_t i = 0; i < visible.size(); ++i)
+		{
+			const uint32_t idx = visibleIdxes.at(i);
+
+			if (!equals(visible.at(i).world, instances.at(idx).world) || visible.at(i).paletteOffset != instances.at(idx).paletteOffset)
+				return false;
+		}
+	}
+
+	// the materials seen from the light, the neighbors merged. An empty material does not split a range
+	{
+		const std::vector<std::pair<UINT, UINT>> expected = { { 0, 42 }, { 48, 9 } };
+
+		if (getVisibleRanges({ 30, 0, 12, 6, 9 }, { true, false, true, false, true }) != expected)
+			return false;
+
+		if (!getVisibleRanges({ 30, 12 }, { false, false }).empty())
+			return false;
+	}
+
+	// the first one stays where the single actor was, and no two share a place
+	if (!equals(placements.at(0), XMMatrixIdentity()))
+		return false;
+
+	for (uint32_t i = 0; i < kNumInstances; ++i)
+	{
+		for (uint32_t j = i + 1; j < kNumInstances; ++j)
+		{
+			if (equals(placements.at(i), placements.at(j)))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+void PmdActor::selectTransformSlice(UINT frameIndex)
+{
+	ThrowIfFalse(frameIndex < Config::kNumFramesInFlight);
+
+	m_frameIndex = frameIndex;
+	m_worldMatrixPointer = reinterpret_cast<DirectX::XMMATRIX*>(m_mappedTransform + m_transformSliceSize * frameIndex);
+	m_boneMatrixPointer = m_worldMatrixPointer + 1;
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE PmdActor::getTransformGpuDescHandle() const
+{
+	return m_transformDescTable.getGpuHandle(m_frameIndex);
+}
+
+HRESULT PmdActor::createMaterialResrouces()
+{
+	const UINT64 materialNum = m_materials.size();
+	ThrowIfFalse(materialNum == m_texturePaths.size());
+	ThrowIfFalse(materialNum == m_sphPaths.size());
+	ThrowIfFalse(materialNum == m_spaPaths.size());
+	ThrowIfFalse(materialNum == m_toonPaths.size());
+	ThrowIfFalse(m_whiteTextureResource != nullptr);
+	ThrowIfFalse(m_blackTextureResource != nullptr);
+	ThrowIfFalse(m_grayGradiationTextureResource != nullptr);
+
+	// slots of the bindless table: a slot per placeholder and a slot per streamed file.
+	// The materials point to the placeholders first. The slot of a file is not read by any frame
+	// until a material is patched to it, so its descriptor can be written while the GPU is running
+	struct Stream
+	{
+		std::string path;
+		uint32_t slot = 0;
+		UINT indicesNum = 0; // drawn with it
+		std::vector<std::pair<uint32_t, uint32_t MaterialForHlsl::*>> users;
+	};
+
+	std::vector<ID3D12Resource*> textures; // the first view of each slot
+	std::vector<Stream> streams;
+	{
+		std::unordered_map<ID3D12Resource*, uint32_t> placeholderIdxes;
+		std::unordered_map<std::string, uint32_t> streamIdxes;
+
+		auto addTexture = [&](uint32_t materialIdx, uint32_t MaterialForHlsl::* member, const std::string& path, ID3D12Resource* placeholder) {
+			const auto [it, inserted] = placeholderIdxes.try_emplace(placeholder, static_cast<uint32_t>(textures.size()));
+
+			if (inserted)
 			{
-				srvDesc.Format = m_spaResources[i]->GetDesc().Format;
-				Resource::instance()->getDevice()->CreateShaderResourceView(m_spaResources[i].Get(), &srvDesc, descHeapH);
+				textures.push_back(placeholder);
 			}
 
-			descHeapH.ptr += inc;
+			m_materials[materialIdx].material.*member = it->second;
+
+			if (path.empty())
+				return;
+
+			const auto [streamIt, streamInserted] = streamIdxes.try_emplace(path, static_cast<uint32_t>(streams.size()));
 
-			if (m_toonResources[i] == nullptr)
+			if (streamInserted)
 			{
-				srvDesc.Format = m_grayGradiationTextureResource->GetDesc().Format;
-				Resource::instance()->getDevice()->CreateShaderResourceView(m_grayGradiationTextureResource.Get(), &srvDesc, descHeapH);
+				streams.push_back({ path, static_cast<uint32_t>(textures.size()) });
+				textures.push_back(placeholder);
 			}
-			else
+
+			Stream& stream = streams.at(streamIt->second);
+			stream.indicesNum += m_materials[materialIdx].indicesNum;
+			stream.users.push_back({ materialIdx, member });
+		};
+
+		for (uint32_t i = 0; i < materialNum; ++i)
+		{
+			addTexture(i, &MaterialForHlsl::texIdx, m_texturePaths[i], m_whiteTextureResource.Get());
+			addTexture(i, &MaterialForHlsl::sphIdx, m_sphPaths[i], m_whiteTextureResource.Get());
+			addTexture(i, &MaterialForHlsl::spaIdx, m_spaPaths[i], m_blackTextureResource.Get());
+			addTexture(i, &MaterialForHlsl::toonIdx, m_toonPaths[i], m_grayGradiationTextureResource.Get());
+		}
+	}
+
+	// create resource (structured buffer). A slice per frame in flight, since the texture indices change while streaming
+	{
+		m_materialSliceSize = Util::alignmentedSize(sizeof(MaterialForHlsl) * materialNum, 256);
+
+		D3D12_HEAP_PROPERTIES heapProp = { };
+		{
+			heapProp.Type = D3D12_HEAP_TYPE_UPLOAD;
+			heapProp.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+			heapProp.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+			heapProp.CreationNodeMask = 1;
+			heapProp.VisibleNodeMask = 1;
+		}
+		D3D12_RESOURCE_DESC resourceDesc = { };
+		{
+			resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+			resourceDesc.Alignment = 0;
+			resourceDesc.Width = m_materialSliceSize * Config::kNumFramesInFlight;
+			resourceDesc.Height = 1;
+			resourceDesc.DepthOrArraySize = 1;
+			resourceDesc.MipLevels = 1;
+			resourceDesc.Format = DXGI_FORMAT_UNKNOWN;
+			resourceDesc.SampleDesc = { 1, 0 };
+			resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+			resourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+		}
+
+		auto ret = Resource::instance()->getDevice()->CreateCommittedResource(
+			&heapProp,
+			D3D12_HEAP_FLAG_NONE,
+			&resourceDesc,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(m_materialResource.ReleaseAndGetAddressOf()));
+		ThrowIfFailed(ret);
+
+		ret = m_materialResource->SetName(Util::getWideStringFromString("pmdMaterialBuffer").c_str());
+		ThrowIfFailed(ret);
+	}
+
+	// map and copy to every slice
+	{
+		auto ret = m_materialResource->Map(0, nullptr, reinterpret_cast<void**>(&m_mappedMaterials));
+		ThrowIfFailed(ret);
+
+		for (UINT i = 0; i < Config::kNumFramesInFlight; ++i)
+		{
+			MaterialForHlsl* pMapMaterial = reinterpret_cast<MaterialForHlsl*>(m_mappedMaterials + m_materialSliceSize * i);
+
+			for (const auto& m : m_materials)
 			{
-				srvDesc.Format = m_toonResources[i]->GetDesc().Format;
-				Resource::instance()->getDevice()->CreateShaderResourceView(m_toonResources[i].Get(), &srvDesc, descHeapH);
+				*pMapMaterial++ = m.material;
 			}
+		}
 
-			descHeapH.ptr += inc;
+		m_materialSliceVersions.fill(m_materialVersion);
+	}
+
+	// create view (SRV for each slot)
+	{
+		m_textureDescTable = Resource::instance()->getDescriptorAllocator()->allocate(static_cast<uint32_t>(textures.size()));
+		m_textures.assign(textures.begin(), textures.end());
+
+		for (uint32_t i = 0; i < textures.size(); ++i)
+		{
+			const D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = getTextureSrvDesc(textures[i]->GetDesc().Format);
+			Resource::instance()->getDevice()->CreateShaderResourceView(textures[i], &srvDesc, m_textureDescTable.getCpuHandle(i));
 		}
 	}
 
+	// the callbacks run on the render thread. The actor must not move until they are done.
+	// In the order of the requests until cull() gives the priorities
+	const UINT totalIndicesNum = std::accumulate(m_materials.begin(), m_materials.end(), 0u, [](UINT sum, const Material& m) { return sum + m.indicesNum; });
+
+	for (const Stream& stream : streams)
+	{
+		m_waitingTextures.push_back({ stream.path, stream.slot, static_cast<float>(stream.indicesNum) / static_cast<float>(std::max(totalIndicesNum, 1u)) });
+
+		Resource::instance()->getTextureStreamer()->request(
+			stream.path,
+			0.0f,
+			[this, slot = stream.slot, users = stream.users](ID3D12Resource* resource) { onTextureStreamed(resource, slot, users); });
+	}
+
+	// a CBV padded to 256 bytes and 5 descriptors (CBV + tex + sph + spa + toon) per material before
+	Debug::debugOutputFormatString("Material buffer: %llu bytes (was %llu), texture descriptors: %zd (was %llu), streaming %zd textures\n",
+		sizeof(MaterialForHlsl) * materialNum,
+		Util::alignmentedSize(sizeof(MaterialForHlsl), 256) * materialNum,
+		textures.size(),
+		materialNum * 5,
+		streams.size());
+
 	return S_OK;
 }
 
-void PmdActor::updateMotion()
+void PmdActor::updateMaterialSlice()
 {
-	using namespace DirectX;
+	// a slice catches up with the patched textures when its frame comes again
+	uint32_t& version = m_materialSliceVersions.at(m_frameIndex);
+
+	if (version == m_materialVersion)
+		return;
 
-	constexpr uint32_t kFps = 30;
-	const DWORD elapsedTime = timeGetTime() - m_animationStartTime;
-	uint32_t frameNo = static_cast<uint32_t>(kFps * (elapsedTime / 1000.0f));
+	MaterialForHlsl* pMapMaterial = reinterpret_cast<MaterialForHlsl*>(m_mappedMaterials + m_materialSliceSize * m_frameIndex);
 
-	if (frameNo > m_duration)
+	for (const auto& m : m_materials)
 	{
-		m_animationStartTime = timeGetTime();
-		frameNo = 0;
+		*pMapMaterial++ = m.material;
 	}
 
+	version = m_materialVersion;
+}
+
+void PmdActor::onTextureStreamed(ID3D12Resource* resource, uint32_t slot, const std::vector<std::pair<uint32_t, uint32_t MaterialForHlsl::*>>& users)
+{
+	m_waitingTextures.erase(
+		std::remove_if(m_waitingTextures.begin(), m_waitingTextures.end(), [slot](const WaitingTexture& texture) { return texture.slot == slot; }),
+		m_waitingTextures.end());
+
+	// the placeholder is kept
+	if (resource == nullptr)
+		return;
+
+	const D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = getTextureSrvDesc(resource->GetDesc().Format);
+	Resource::instance()->getDevice()->CreateShaderResourceView(resource, &srvDesc, m_textureDescTable.getCpuHandle(slot));
+	m_textures.at(slot) = resource;
+
+	for (const auto& [materialIdx, member] : users)
+	{
+		m_materials.at(materialIdx).material.*member = slot;
+	}
+
+	++m_materialVersion;
+}
+
+void PmdActor::prioritizeTextures() const
+{
+	// the share of the screen which waits for the texture. Out of the camera, it stays at the bottom
+	if (m_screenHeight <= 0.0f)
+		return;
+
+	for (const WaitingTexture& texture : m_waitingTextures)
+	{
+		Resource::instance()->getTextureStreamer()->prioritize(texture.path, m_screenHeight * texture.share);
+	}
+}
+
+void PmdActor::updateMotion(uint32_t frameOffset, DWORD aheadTime, AnimationLod::Level level)
+{
+	const DWORD elapsedTime = timeGetTime() - m_animationStartTime + aheadTime;
+	const uint64_t elapsedFrames = static_cast<uint64_t>(elapsedTime) * kMotionFps / 1000;
+	const bool bSecondaryBones = AnimationLod::hasSecondaryBones(level);
+
+	// wrapped instead of restarting the clock, which the phases of the crowd share within a step
+	uint32_t frameNo = static_cast<uint32_t>((elapsedFrames + frameOffset) % (static_cast<uint64_t>(m_duration) + 1));
+	frameNo -= frameNo % Config::kPoseCacheFrameQuantum;
+
+	// the actors and the phases at the same frame of the motion share the pose before the IK
+	const PoseCache::Key key = { m_motionKey, m_bindingKey, frameNo, bSecondaryBones };
+	Resource::instance()->getPoseCache()->get(key, &m_boneMatrices, [&]() { evaluateMotion(frameNo, bSecondaryBones); });
+
+	IKSolve(frameNo, level);
+}
+
+void PmdActor::evaluateMotion(uint32_t frameNo, bool bSecondaryBones)
+{
+	using namespace DirectX;
+
 	// clear bone matrices with identity
 	std::fill(m_boneMatrices.begin(), m_boneMatrices.end(), DirectX::XMMatrixIdentity());
 
@@ -1536,63 +2273,49 @@ void PmdActor::updateMotion()
 			const BoneNode node = m_boneNodeTable[boneMotion.first];
 			const XMFLOAT3& pos = node.startPos;
 			const XMMATRIX mat = XMMatrixTranslation(-pos.x, -pos.y, -pos.z)
-				* XMMatrixRotationQuaternion(boneMotion.second[0].quaternion)
+				* XMMatrixRotationQuaternion(XMLoadFloat4(&boneMotion.second[0].rotation))
 				* XMMatrixTranslation(pos.x, pos.y, pos.z);
 			m_boneMatrices[node.boneIdx] = mat;
 		}
 	}
 #endif // TEST1
 
-	for (const std::pair<std::string, std::vector<Motion>>& boneMotion : m_motionData)
+#if BAKED_MOTION
+	for (const MotionBake::Track& track : m_bakedMotion.tracks)
 	{
-		const auto itBoneNode = m_boneNodeTable.find(boneMotion.first);
-
-		if (itBoneNode == m_boneNodeTable.end())
+		// left in the bind pose, where they follow their parents
+		if (!bSecondaryBones && m_secondaryBones.at(track.bone))
 			continue;
 
-		const std::vector<Motion> motions = boneMotion.second;
+		XMVECTOR rotation = { };
+		XMVECTOR offset = { };
+		MotionBake::decode(track, std::min(frameNo, m_bakedMotion.numFrames - 1), &rotation, &offset);
 
-		auto rit = std::find_if(
-			motions.rbegin(),
-			motions.rend(),
-			[frameNo](const Motion& motion)
-			{
-				return motion.frameNo <= frameNo;
-			});
+		m_boneMatrices[track.bone] = getBoneMatrix(m_boneNodeAddressArray.at(track.bone)->startPos, rotation, offset);
+	}
+#else
+	for (const auto& [boneName, keys] : m_motionData)
+	{
+		const auto itBoneNode = m_boneNodeTable.find(boneName);
 
-		if (rit == motions.rend())
+		if (itBoneNode == m_boneNodeTable.end())
 			continue;
 
-		XMMATRIX rotation = DirectX::XMMatrixIdentity();
-		XMVECTOR offset = XMLoadFloat3(&rit->offset);
-		auto it = rit.base();
+		// left in the bind pose, where they follow their parents
+		if (!bSecondaryBones && m_secondaryBones.at(itBoneNode->second.boneIdx))
+			continue;
 
-		if (it != motions.end())
-		{
-			// interpolation with Bezier curve
-			float t = static_cast<float>(frameNo - rit->frameNo) / static_cast<float>(it->frameNo - rit->frameNo);
-			t = getYfromXOnBezier(t, it->p1, it->p2, 12);
-			rotation = XMMatrixRotationQuaternion(XMQuaternionSlerp(rit->quaternion, it->quaternion, t));
-			offset = DirectX::XMVectorLerp(offset, XMLoadFloat3(&it->offset), t);
-		}
-		else
-		{
-			rotation = XMMatrixRotationQuaternion(rit->quaternion);
-		}
+		XMVECTOR rotation = { };
+		XMVECTOR offset = { };
 
-		const BoneNode node = m_boneNodeTable[boneMotion.first];
-		const XMMATRIX mat = DirectX::XMMatrixTranslation(-node.startPos.x, -node.startPos.y, -node.startPos.z)
-			* rotation
-			* DirectX::XMMatrixTranslation(node.startPos.x, node.startPos.y, node.startPos.z);
+		if (!MotionCompressor::sample(keys, frameNo, &rotation, &offset))
+			continue;
 
-		m_boneMatrices[node.boneIdx] = mat * DirectX::XMMatrixTranslationFromVector(offset);
+		m_boneMatrices[itBoneNode->second.boneIdx] = getBoneMatrix(itBoneNode->second.startPos, rotation, offset);
 	}
+#endif // BAKED_MOTION
 
 	recursiveMatrixMultiply(m_boneNodeTable["Z^["], DirectX::XMMatrixIdentity());
-
-	IKSolve(frameNo);
-
-	std::copy(m_boneMatrices.begin(), m_boneMatrices.end(), m_boneMatrixPointer);
 }
 
 void PmdActor::recursiveMatrixMultiply(const BoneNode& node, const DirectX::XMMATRIX& mat)
@@ -1605,8 +2328,11 @@ void PmdActor::recursiveMatrixMultiply(const BoneNode& node, const DirectX::XMMA
 	}
 }
 
-void PmdActor::IKSolve([[maybe_unused]] uint32_t frameNo)
+void PmdActor::IKSolve([[maybe_unused]] uint32_t frameNo, AnimationLod::Level level)
 {
+	if (!AnimationLod::hasIk(level))
+		return;
+
 	const auto it = find_if(
 		m_ikEnableData.rbegin(),
 		m_ikEnableData.rend(),
@@ -1617,6 +2343,10 @@ void PmdActor::IKSolve([[maybe_unused]] uint32_t frameNo)
 
 	for (const PmdIk& ik : m_pmdIks)
 	{
+		// the IK of the hair and the ties
+		if (!AnimationLod::hasSecondaryBones(level) && m_secondaryBones.at(ik.boneIdx))
+			continue;
+
 		if (it != m_ikEnableData.rend())
 		{
 			const auto ikEnableIt = it->ikEnableTable.find(m_boneNameArray[ik.boneIdx]);
@@ -1826,13 +2556,13 @@ void PmdActor::solveCCDIK(const PmdIk& ik)
 	}
 }
 
-static HRESULT setViewportScissor(int32_t width, int32_t height)
+static HRESULT setViewportScissor(ID3D12GraphicsCommandList* list, int32_t width, int32_t height)
 {
 	const D3D12_VIEWPORT viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height));
-	Resource::instance()->getCommandList()->RSSetViewports(1, &viewport);
+	list->RSSetViewports(1, &viewport);
 
 	const D3D12_RECT scissorRect = CD3DX12_RECT(0, 0, width, height);
-	Resource::instance()->getCommandList()->RSSetScissorRects(1, &scissorRect);
+	list->RSSetScissorRects(1, &scissorRect);
 
 	return S_OK;
 }
@@ -1876,6 +2606,22 @@ static std::string getTexturePathFromModelAndTexPath(const std::string& modelPat
 	return folderPath + texPath;
 }
 
+static D3D12_SHADER_RESOURCE_VIEW_DESC getTextureSrvDesc(DXGI_FORMAT format)
+{
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = { };
+	{
+		srvDesc.Format = format;
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.Texture2D.MostDetailedMip = 0;
+		srvDesc.Texture2D.MipLevels = 1;
+		srvDesc.Texture2D.PlaneSlice = 0;
+		srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+	}
+
+	return srvDesc;
+}
+
 template<typename T>
 static std::pair<HRESULT, D3D12_VERTEX_BUFFER_VIEW>
 createVertexBufferResource(ComPtr<ID3D12Resource>* vertResource, const std::vector<T>& vertices)
@@ -1980,31 +2726,13 @@ static HRESULT createBufferResource(ComPtr<ID3D12Resource>* resource, size_t wid
 	return S_OK;
 }
 
-static float getYfromXOnBezier(float x, const DirectX::XMFLOAT2& a, const DirectX::XMFLOAT2& b, uint8_t n)
+// the rotation around the start of the bone, then the offset
+static DirectX::XMMATRIX getBoneMatrix(const DirectX::XMFLOAT3& startPos, const DirectX::XMVECTOR& rotation, const DirectX::XMVECTOR& offset)
 {
-	if (a.x == a.y && b.x == b.y)
-		return x;
-
-	float t = x;
-	const float k0 = 1 + 3 * a.x - 3 * b.x; // coefficient of t^3
-	const float k1 = 3 * b.x - 6 * a.x; // coefficient of t^2
-	const float k2 = 3 * a.x; // coefficient of t
-
-	constexpr float epsilon = 0.0005f;
-
-	for (int32_t i = 0; i < n; ++i)
-	{
-		const float ft = k0 * t * t * t + k1 * t * t + k2 * t - x;
-
-		if (-epsilon <= ft && ft <= epsilon)
-			break;
-
-		t -= ft / 2;
-	}
-
-	const float r = 1 - t;
-
-	return (t * t * t) + (3 * t * t * r * b.y) + (3 * t * r * r * a.y);
+	return DirectX::XMMatrixTranslation(-startPos.x, -startPos.y, -startPos.z)
+		* DirectX::XMMatrixRotationQuaternion(rotation)
+		* DirectX::XMMatrixTranslation(startPos.x, startPos.y, startPos.z)
+		* DirectX::XMMatrixTranslationFromVector(offset);
 }
 
 static DirectX::XMMATRIX lookAtMatrix(const DirectX::XMVECTOR& origin, const DirectX::XMVECTOR& lookat, const DirectX::XMFLOAT3& up, const DirectX::XMFLOAT3& right)
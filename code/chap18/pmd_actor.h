@@ -2,6 +2,7 @@
 #pragma warning(push, 0)
 #include <codeanalysis/warnings.h>
 #pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <array>
 #include <d3d12.h>
 #include <DirectXMath.h>
 #include <map>
@@ -11,6 +12,15 @@
 #include <vector>
 #include <wrl.h>
 #pragma warning(pop)
+#include "animation_lod.h"
+#include "config.h"
+#include "culling.h"
+#include "descriptor_allocator.h"
+#include "indirect_draw.h"
+#include "mesh_simplifier.h"
+#include "meshlet.h"
+#include "motion_bake.h"
+#include "motion_compressor.h"
 
 enum class BoneType
 {
@@ -49,6 +59,7 @@ struct PmdVertexForDx
 };
 static_assert((sizeof(PmdVertexForDx) % 4) == 0); // must be aligned with 4 bytes
 
+// an element of the material structured buffer. The textures are indices into the bindless texture table
 struct MaterialForHlsl
 {
 	DirectX::XMFLOAT3 diffuse = { };
@@ -56,7 +67,13 @@ struct MaterialForHlsl
 	DirectX::XMFLOAT3 specular = { };
 	float specularity = 0.0f;
 	DirectX::XMFLOAT3 ambient = { };
+	uint32_t texIdx = 0;
+	uint32_t sphIdx = 0;
+	uint32_t spaIdx = 0;
+	uint32_t toonIdx = 0;
+	uint32_t padding = 0;
 };
+static_assert((sizeof(MaterialForHlsl) % 16) == 0); // keep the stride aligned with float4
 
 struct AdditionalMaterial
 {
@@ -82,26 +99,21 @@ struct BoneNode
 	std::vector<BoneNode*> children;
 };
 
-struct Motion
+// the result of the animation. Computed on the simulation thread, then copied to the GPU on the render thread
+struct PmdPose
 {
-	uint32_t frameNo = 0;
-	DirectX::XMVECTOR quaternion = { };
-	DirectX::XMFLOAT3 offset = { };
-	DirectX::XMFLOAT2 p1 = { }; // Bezier curve control point 0
-	DirectX::XMFLOAT2 p2 = { }; // Bezier curve control point 1
-
-	Motion(uint32_t fno,
-		const DirectX::XMVECTOR& q,
-		const DirectX::XMFLOAT3& ofst,
-		const DirectX::XMFLOAT2& ip1,
-		const DirectX::XMFLOAT2& ip2)
-		: frameNo(fno)
-		, quaternion(q)
-		, offset(ofst)
-		, p1(ip1)
-		, p2(ip2)
-	{ }
+	DirectX::XMMATRIX world = DirectX::XMMatrixIdentity();
+	std::vector<DirectX::XMMATRIX> bones; // a palette per phase, one after another, in the crowd mode
+};
+
+// an element of the instance structured buffer of the crowd
+struct CrowdInstance
+{
+	DirectX::XMMATRIX world = DirectX::XMMatrixIdentity();
+	uint32_t paletteOffset = 0; // the first bone matrix of the instance in the palette buffer
+	uint32_t padding[3] = { };
 };
+static_assert(sizeof(CrowdInstance) == 80);
 
 struct VMDIkEnable
 {
@@ -125,12 +137,40 @@ public:
 
 	PmdActor();
 	HRESULT loadAsset(Model model);
+	// draws numInstances copies of the model, the animation staggered in numPhases offsets
+	HRESULT enableCrowd(uint32_t numInstances, uint32_t numPhases, float spacing);
+	bool isCrowd() const { return m_numCrowdInstances > 0; }
 	void enableAnimation(bool enable);
-	void update(bool animationReversed);
-	HRESULT renderShadow(ID3D12GraphicsCommandList* list, ID3D12DescriptorHeap* sceneDescHeap, ID3D12DescriptorHeap* depthHeap) const;
-	HRESULT render(ID3D12GraphicsCommandList* list, ID3D12DescriptorHeap* sceneDescHeap, ID3D12DescriptorHeap* depthLightSrvHeap) const;
+	// the level is picked by the render thread from getScreenHeight()
+	void computePose(PmdPose* pPose, AnimationLod::Level level);
+	// the views give the planar shadow, which is in the bound
+	void applyPose(const PmdPose& pose, const Culling::Views& views);
+	// after applyPose(). bInCamera and bInLight are the tests of getBound(). The materials and the instances are culled here
+	void cull(const PmdPose& pose, const Culling::Views& views, bool bInCamera, bool bInLight);
+	const Culling::Aabb& getBound() const { return m_bound; }
+	// of the nearest instance in the camera view, in pixels. 0 if none is seen
+	float getScreenHeight() const { return m_screenHeight; }
+	const AnimationLod& getAnimationLod() const { return m_animationLod; }
+	HRESULT renderShadow(ID3D12GraphicsCommandList* list, D3D12_GPU_DESCRIPTOR_HANDLE sceneDescHandle, ID3D12DescriptorHeap* depthHeap) const;
+	HRESULT render(ID3D12GraphicsCommandList* list, D3D12_GPU_DESCRIPTOR_HANDLE sceneDescHandle, D3D12_GPU_DESCRIPTOR_HANDLE depthLightSrvHandle) const;
+
+	// the instances nearest to the origin first
+	static std::vector<DirectX::XMMATRIX> getCrowdPlacements(uint32_t numInstances, float spacing);
+	static uint32_t getCrowdPhase(uint32_t instance, uint32_t numPhases) { return instance % numPhases; }
+	// the instances in instanceIdxes, packed from the front. Returns the number written
+	static uint32_t packCrowdInstances(const std::vector<DirectX::XMMATRIX>& placements, const std::vector<uint32_t>& instanceIdxes, const DirectX::XMMATRIX& world, uint32_t numBones, uint32_t numPhases, CrowdInstance* pDst);
+	// the index ranges of the visible materials, the neighbors merged into one draw
+	static std::vector<std::pair<UINT, UINT>> getVisibleRanges(const std::vector<UINT>& indexCounts, const std::vector<bool>& visible);
+	static bool selfCheck();
 
 private:
+	struct WaitingTexture
+	{
+		std::string path;
+		uint32_t slot = 0;
+		float share = 0.0f; // of the indices drawn with it
+	};
+
 	HRESULT loadShaders();
 	HRESULT createPipelineState();
 	HRESULT createRootSignature(Microsoft::WRL::ComPtr<ID3D12RootSignature>* rootSignature);
@@ -141,6 +181,8 @@ private:
 
 	HRESULT loadPmd(Model model);
 	HRESULT loadVmd();
+	// the motion at every frame into m_bakedMotion. Checked against the keyframes in a debug build
+	void bakeMotion();
 	HRESULT createResources();
 	HRESULT createWhiteTexture();
 	HRESULT createBlackTexture();
@@ -148,9 +190,26 @@ private:
 	HRESULT createDebugResources();
 	HRESULT createTransformResource();
 	HRESULT createMaterialResrouces();
-	void updateMotion();
+	HRESULT createDrawArguments(IndirectDraw* pDraw, UINT instanceCount, const std::string& name);
+	HRESULT createCrowdResource();
+	void createMeshlets();
+	void createBounds();
+	void updateCrowdBounds(const PmdPose& pose);
+	void cullCrowd(const PmdPose& pose, const Culling::Views& views, bool bInCamera, bool bInLight);
+	uint32_t selectLod(float distance, const Culling::Views& views) const;
+	uint32_t getPhaseFrameOffset(uint32_t phase) const;
+	void selectTransformSlice(UINT frameIndex);
+	void updateMaterialSlice();
+	void onTextureStreamed(ID3D12Resource* resource, uint32_t slot, const std::vector<std::pair<uint32_t, uint32_t MaterialForHlsl::*>>& users);
+	// after the culling, from getScreenHeight()
+	void prioritizeTextures() const;
+	D3D12_GPU_DESCRIPTOR_HANDLE getTransformGpuDescHandle() const;
+	// aheadTime in ms, for a key ahead of now. The level leaves out the secondary bones
+	void updateMotion(uint32_t frameOffset, DWORD aheadTime, AnimationLod::Level level);
+	// the pose before the IK, into m_boneMatrices
+	void evaluateMotion(uint32_t frameNo, bool bSecondaryBones);
 	void recursiveMatrixMultiply(const BoneNode& node, const DirectX::XMMATRIX& mat);
-	void IKSolve(uint32_t frameNo);
+	void IKSolve(uint32_t frameNo, AnimationLod::Level level);
 	void solveLookAt(const PmdIk& ik);
 	void solveCosineIK(const PmdIk& ik);
 	void solveCCDIK(const PmdIk& ik);
@@ -161,6 +220,10 @@ private:
 	Microsoft::WRL::ComPtr<ID3DBlob> m_vsBlob = nullptr;
 	Microsoft::WRL::ComPtr<ID3DBlob> m_psBlob = nullptr;
 	Microsoft::WRL::ComPtr<ID3DBlob> m_shadowVsBlob = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> m_crowdPipelineState = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> m_crowdShadowPipelineState = nullptr;
+	Microsoft::WRL::ComPtr<ID3DBlob> m_crowdVsBlob = nullptr;
+	Microsoft::WRL::ComPtr<ID3DBlob> m_crowdShadowVsBlob = nullptr;
 
 	bool m_bAnimation = false;
 	DWORD m_animationStartTime = 0;
@@ -173,17 +236,41 @@ private:
 	D3D12_VERTEX_BUFFER_VIEW m_vbView = { };
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_ibResource = nullptr;
 	D3D12_INDEX_BUFFER_VIEW m_ibView = { };
+	IndirectDraw m_indirectDraw; // a command per meshlet, and per material of each level of detail
+	Meshlet::Clusters m_meshlets; // m_indices is in their order
+	std::vector<UINT> m_meshletIndexCounts;
+	std::vector<MeshSimplifier::Lod> m_lods; // their indices follow the ones of the meshlets in m_indices
+	std::vector<UINT> m_drawIndexCounts; // of the commands. The meshlets, then the materials of each level
+	std::vector<uint32_t> m_lodCommandOffsets; // the first command of each level, and the number of the commands at the end
+	uint32_t m_lod = 0; // picked in cull(). 0 is the full mesh
+	std::vector<Culling::BoneBound> m_boneBounds; // of the whole model
+	std::vector<std::vector<Culling::BoneBound>> m_materialBoneBounds;
+	std::vector<std::vector<Culling::BoneBound>> m_meshletBoneBounds;
+	Culling::Aabb m_bound; // of all that is drawn, in the world
+	bool m_bVisibleInCamera = true;
+	float m_screenHeight = FLT_MAX;
+	std::vector<std::pair<UINT, UINT>> m_shadowRanges; // empty when nothing is seen from the light
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_materialResource = nullptr;
-	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> m_toonResources;
-	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> m_textureResources;
-	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> m_sphResources;
-	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> m_spaResources;
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_materialDescHeap = nullptr;
+	size_t m_materialSliceSize = 0;
+	uint8_t* m_mappedMaterials = nullptr;
+	uint32_t m_materialVersion = 0; // bumped when a streamed texture is patched in
+	std::array<uint32_t, Config::kNumFramesInFlight> m_materialSliceVersions = { };
+	std::vector<std::string> m_toonPaths; // streamed. Empty when the material has none
+	std::vector<std::string> m_texturePaths;
+	std::vector<std::string> m_sphPaths;
+	std::vector<std::string> m_spaPaths;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> m_textures; // per slot of m_textureDescTable
+	std::vector<WaitingTexture> m_waitingTextures; // until their callbacks run
+	DescriptorTable m_textureDescTable; // bindless. Indexed by MaterialForHlsl::texIdx and so on
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_whiteTextureResource = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_blackTextureResource = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_grayGradiationTextureResource = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_transformDescHeap = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_transformDescHeap = nullptr; // staging
+	DescriptorTable m_transformDescTable; // a CBV per frame in flight
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_transformResource = nullptr;
+	uint8_t* m_mappedTransform = nullptr;
+	size_t m_transformSliceSize = 0;
+	UINT m_frameIndex = 0;
 	DirectX::XMMATRIX* m_worldMatrixPointer = nullptr; // needs to be aligned 16 bytes
 	DirectX::XMMATRIX* m_boneMatrixPointer = nullptr;
 	uint32_t m_duration = 0;
@@ -191,10 +278,26 @@ private:
 	std::vector<std::string> m_boneNameArray;
 	std::vector<BoneNode*> m_boneNodeAddressArray;
 	std::vector<uint32_t> m_kneeIdxes;
+	std::vector<bool> m_secondaryBones; // the hair, the skirts and so on, which only sway, and the bones under them
+	AnimationLod m_animationLod;
 	std::vector<DirectX::XMMATRIX> m_boneMatrices;
-	std::unordered_map<std::string, std::vector<Motion>> m_motionData;
+	std::unordered_map<std::string, std::vector<MotionCompressor::Key>> m_motionData; // the keys of each bone, by frame
 	std::vector<PmdIk> m_pmdIks;
 	std::vector<VMDIkEnable> m_ikEnableData;
+	uint64_t m_motionKey = 0; // of the pose cache
+	uint64_t m_bindingKey = 0;
+	MotionBake::Clip m_bakedMotion; // empty if not baked
+
+	uint32_t m_numCrowdInstances = 0; // 0 if this is a single actor
+	uint32_t m_numCrowdPhases = 0;
+	std::vector<DirectX::XMMATRIX> m_crowdPlacements;
+	IndirectDraw m_crowdIndirectDraw;
+	std::vector<Culling::Aabb> m_crowdInstanceBounds;
+	uint32_t m_numVisibleCrowdInstances = 0;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_crowdResource = nullptr; // the instances, then the palettes. A slice per frame in flight
+	uint8_t* m_mappedCrowd = nullptr;
+	size_t m_crowdSliceSize = 0;
+	size_t m_crowdPalettesOffset = 0; // in a slice
 
 	D3D12_VERTEX_BUFFER_VIEW m_debugVbView = { };
 	D3D12_INDEX_BUFFER_VIEW m_debugIbView = { };
@@ -0,0 +1,201 @@
+#include "pose_cache.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <algorithm>
+#include <cmath>
+#pragma warning(pop)
+#include "debug.h"
+#include "util.h"
+
+#undef min
+#undef max
+
+using namespace DirectX;
+
+namespace {
+	constexpr float kEvaluateCostWeight = 1.0f / 16.0f; // of a miss in the average
+
+	// about the work of PmdActor::updateMotion() for a bone: a slerp between two keys, then down the chain
+	void evaluateSyntheticPose(uint32_t frameNo, std::vector<XMMATRIX>* pPose)
+	{
+		const float t = static_cast<float>(frameNo % 30) / 30.0f;
+		const XMVECTOR q0 = XMQuaternionRotationRollPitchYaw(0.1f, 0.2f, 0.3f);
+		const XMVECTOR q1 = XMQuaternionRotationRollPitchYaw(-0.3f, 0.5f, 0.1f);
+
+		for (size_t i = 0; i < pPose->size(); ++i)
+		{
+			const XMMATRIX local = XMMatrixRotationQuaternion(XMQuaternionSlerp(q0, q1, t)) * XMMatrixTranslation(0.0f, static_cast<float>(i % 7), 0.0f);
+			pPose->at(i) = (i == 0) ? local : local * pPose->at(i - 1);
+		}
+	}
+} // namespace anonymous
+
+size_t PoseCache::KeyHasher::operator()(const Key& key) const
+{
+	Util::Fnv1a hasher;
+	hasher.add(key.motion);
+	hasher.add(key.binding);
+	hasher.add(key.frameNo);
+	hasher.add(key.bSecondaryBones);
+	return static_cast<size_t>(hasher.get());
+}
+
+void PoseCache::get(const Key& key, std::vector<XMMATRIX>* pPose, const std::function<void()>& evaluate)
+{
+	ThrowIfFalse(pPose != nullptr);
+	const LONGLONG start = Util::getTick();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (const auto it = m_entries.find(key); it != m_entries.end())
+		{
+			it->second.lastUse = ++m_numUses;
+			pPose->assign(it->second.pose.begin(), it->second.pose.end());
+
+			++m_stats.numHits;
+			m_stats.savedInUs += std::max(m_evaluateCostInUs - Util::toUs(Util::getTick() - start), 0.0f);
+			return;
+		}
+	}
+
+	// out of the lock, since it is the expensive part
+	const LONGLONG evaluateStart = Util::getTick();
+	evaluate();
+	const float costInUs = Util::toUs(Util::getTick() - evaluateStart);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	++m_stats.numMisses;
+	m_evaluateCostInUs = (m_evaluateCostInUs > 0.0f) ? m_evaluateCostInUs + (costInUs - m_evaluateCostInUs) * kEvaluateCostWeight : costInUs;
+
+	if (m_entries.size() >= kMaxEntries)
+	{
+		const auto lru = std::min_element(m_entries.begin(), m_entries.end(), [](const auto& a, const auto& b) { return a.second.lastUse < b.second.lastUse; });
+		m_entries.erase(lru);
+	}
+
+	Entry& entry = m_entries[key];
+	entry.pose = *pPose;
+	entry.lastUse = ++m_numUses;
+
+	// a miss costs the lookup and the copy on top
+	m_stats.savedInUs -= Util::toUs(Util::getTick() - start) - costInUs;
+}
+
+PoseCache::Stats PoseCache::takeStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const Stats stats = m_stats;
+	m_stats = Stats();
+	return stats;
+}
+
+void PoseCache::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries.clear();
+	m_stats = Stats();
+}
+
+bool PoseCache::selfCheck()
+{
+	PoseCache cache;
+	uint32_t numEvaluations = 0;
+
+	auto get = [&](uint32_t frameNo, bool bSecondaryBones) {
+		std::vector<XMMATRIX> pose(4);
+		cache.get({ 1, 2, frameNo, bSecondaryBones }, &pose, [&]() {
+			std::fill(pose.begin(), pose.end(), XMMatrixTranslation(static_cast<float>(frameNo), 0.0f, 0.0f));
+			++numEvaluations;
+		});
+		return XMVectorGetX(pose.at(3).r[3]);
+	};
+
+	// the second one is a hit, with the pose of the first. The other frame and the other level are not
+	if (get(5, true) != 5.0f || get(5, true) != 5.0f || numEvaluations != 1)
+		return false;
+
+	if (get(6, true) != 6.0f || get(5, false) != 5.0f || numEvaluations != 3)
+		return false;
+
+	Stats stats = cache.takeStats();
+
+	if (stats.numHits != 1 || stats.numMisses != 3 || cache.takeStats().numMisses != 0)
+		return false;
+
+	// full. The least recently used one goes, the one just used stays
+	for (uint32_t frameNo = 100; frameNo < 100 + kMaxEntries; ++frameNo)
+	{
+		if (frameNo == 100 + kMaxEntries / 2)
+			get(5, true);
+
+		get(frameNo, true);
+	}
+
+	if (cache.m_entries.size() != kMaxEntries)
+		return false;
+
+	numEvaluations = 0;
+	get(5, true);
+	get(6, true);
+
+	return numEvaluations == 1;
+}
+
+void PoseCache::benchmark()
+{
+	constexpr uint32_t kNumBones = 122; // of the Miku model
+	constexpr uint32_t kNumPhases = 16;
+	constexpr uint32_t kNumSteps = 600; // 10 s at 60 Hz
+	constexpr uint32_t kDuration = 1200; // frames of the motion
+
+	for (const uint32_t numActors : { 1u, 16u, 64u, 256u })
+	{
+		PoseCache cache;
+		std::vector<XMMATRIX> pose(kNumBones);
+		LONGLONG uncachedTicks = 0;
+		LONGLONG cachedTicks = 0;
+		Stats total;
+
+		for (uint32_t step = 0; step < kNumSteps; ++step)
+		{
+			// the motion at 30 fps, the actors round robin on the phases spread over it
+			auto getFrameNo = [&](uint32_t actor) {
+				return (step / 2 + kDuration * (actor % kNumPhases) / kNumPhases) % kDuration;
+			};
+
+			LONGLONG tick = Util::getTick();
+			{
+				for (uint32_t actor = 0; actor < numActors; ++actor)
+				{
+					evaluateSyntheticPose(getFrameNo(actor), &pose);
+				}
+			}
+			uncachedTicks += Util::getTick() - tick;
+
+			tick = Util::getTick();
+			{
+				for (uint32_t actor = 0; actor < numActors; ++actor)
+				{
+					const uint32_t frameNo = getFrameNo(actor);
+					cache.get({ 1, 1, frameNo, true }, &pose, [&]() { evaluateSyntheticPose(frameNo, &pose); });
+				}
+			}
+			cachedTicks += Util::getTick() - tick;
+
+			const Stats stats = cache.takeStats();
+			total.numHits += stats.numHits;
+			total.numMisses += stats.numMisses;
+			total.savedInUs += stats.savedInUs;
+		}
+
+		Debug::debugOutputFormatString("Pose cache %u actors on %u phases: %.1f%% hits, uncached %.1f us, cached %.1f us a step, %.1f us saved as estimated\n",
+			numActors,
+			std::min(numActors, kNumPhases),
+			100.0f * total.numHits / std::max(total.numHits + total.numMisses, 1u),
+			Util::toUs(uncachedTicks) / kNumSteps,
+			Util::toUs(cachedTicks) / kNumSteps,
+			total.savedInUs / kNumSteps);
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#pragma warning(pop)
+
+// The poses of the motions before the IK, shared by the actors and the phases which play the same motion on the same bones
+// at the same frame. The frame is the one of the motion at 30 fps, so the steps of the simulation at 60 Hz hit it too.
+// The IK is solved on the copy of each actor.
+class PoseCache
+{
+public:
+	struct Key
+	{
+		uint64_t motion = 0; // the hash of the keyframes
+		uint64_t binding = 0; // the hash of the bones they move
+		uint32_t frameNo = 0;
+		bool bSecondaryBones = true;
+
+		bool operator==(const Key& rhs) const = default;
+	};
+
+	// since the last takeStats()
+	struct Stats
+	{
+		uint32_t numHits = 0;
+		uint32_t numMisses = 0;
+		float savedInUs = 0.0f; // the evaluations not made, less the lookups and the copies. Negative if the cache costs more
+	};
+
+	static constexpr size_t kMaxEntries = 256; // the least recently used one is dropped
+
+	// evaluate fills *pPose on a miss
+	void get(const Key& key, std::vector<DirectX::XMMATRIX>* pPose, const std::function<void()>& evaluate);
+	Stats takeStats();
+	void clear();
+
+	static bool selfCheck();
+	// synthetic actors on a few phases, with and without the cache. Meant for a release build
+	static void benchmark();
+
+private:
+	struct KeyHasher
+	{
+		size_t operator()(const Key& key) const;
+	};
+
+	struct Entry
+	{
+		std::vector<DirectX::XMMATRIX> pose;
+		uint64_t lastUse = 0;
+	};
+
+	std::mutex m_mutex;
+	std::unordered_map<Key, Entry, KeyHasher> m_entries;
+	uint64_t m_numUses = 0;
+	float m_evaluateCostInUs = 0.0f; // averaged over the misses
+	Stats m_stats;
+};
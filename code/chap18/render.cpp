@@ -2,23 +2,37 @@
 #pragma warning(push, 0)
 #include <codeanalysis/warnings.h>
 #pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <algorithm>
 #include <cassert>
+#include <cfloat>
 #include <d3dx12.h>
 #include <functional>
 #include <DirectXMath.h>
+#include <optional>
 #include <synchapi.h>
+#include <thread>
 #pragma warning(pop)
+#include "animation_lod.h"
 #include "config.h"
 #include "constant.h"
 #include "debug.h"
 #include "init.h"
+#include "init_graph.h"
 #include "pixif.h"
 #include "pmd_actor.h"
+#include "pose_cache.h"
 #include "util.h"
 
 #pragma comment(lib, "DirectXTex.lib")
 
 #define NO_UPDATE_TEXTURE_FROM_CPU (1)
+#define MULTITHREADED_RECORDING (1)
+#define SIMULATION_THREAD (1)
+#define TRANSIENT_ALIASING (1)
+#define PARALLEL_INIT (1)
+#define CROWD_MODE (0)
+#define BVH_BENCHMARK (0)
+#define POSE_CACHE_BENCHMARK (0)
 
 using namespace Microsoft::WRL;
 
@@ -29,8 +43,16 @@ namespace {
 	constexpr float kClearColorPeraRenderTarget[] = { 1.0f, 1.0f, 1.0f, 1.0f };
 	constexpr DirectX::XMFLOAT4 kPlaneVec(0.0f, 1.0f, 0.0f, 0.0f);
 	constexpr DirectX::XMFLOAT3 kParallelLightVec(1.0f, -1.0f, 1.0f);
+	constexpr uint64_t kRecordTimeInterval = 600; // frames
+
+	// frame graph. The passes are in submission order, and the off-screen buffers follow kOffScreen in OffScreenResource::Type order
+	enum class GraphPass : FrameGraph::PassId { kClear, kShadow, kBase, kSsao, kBloom, kDof, kPera, kOverlay };
+	enum class GraphResource : FrameGraph::ResourceId { kBackBuffer, kDepth, kLightDepth, kOffScreen };
+
+	constexpr FrameGraph::PassId toGraphId(GraphPass pass) { return static_cast<FrameGraph::PassId>(pass); }
+	constexpr FrameGraph::ResourceId toGraphId(GraphResource resource) { return static_cast<FrameGraph::ResourceId>(resource); }
+	constexpr FrameGraph::ResourceId toGraphId(OffScreenResource::Type type) { return toGraphId(GraphResource::kOffScreen) + static_cast<FrameGraph::ResourceId>(type); }
 
-	HRESULT createFence(UINT64 initVal, ComPtr<ID3D12Fence>* fence);
 	HRESULT createDepthBuffer(ComPtr<ID3D12Resource>* resource, ComPtr<ID3D12DescriptorHeap>* descHeap, ComPtr<ID3D12DescriptorHeap>* srvDescHeap);
 	HRESULT createLightDepthBuffer(ComPtr<ID3D12Resource>* resource, ComPtr<ID3D12DescriptorHeap>* dsvHeap, ComPtr<ID3D12DescriptorHeap>* srvHeap);
 	HRESULT clearRenderTarget(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE handle, const float col[4]);
@@ -41,18 +63,35 @@ namespace {
 	DirectX::XMFLOAT3 computeRotation(DirectX::XMFLOAT3 dst, DirectX::XMFLOAT3 src, DirectX::XMFLOAT3 axis, float angle);
 } // namespace anonymous
 
-HRESULT OffScreenResource::createResource(DXGI_FORMAT format)
+HRESULT OffScreenResource::createResource(DXGI_FORMAT format, [[maybe_unused]] const std::array<FrameGraph::Lifetime, kNumResource>& lifetimes)
 {
 	// create resource for render-to-texture
 	{
 #if NO_UPDATE_TEXTURE_FROM_CPU
-		const D3D12_HEAP_PROPERTIES heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT, 0, 0);
+		[[maybe_unused]] const D3D12_HEAP_PROPERTIES heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT, 0, 0);
 #else
-		const D3D12_HEAP_PROPERTIES heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_CPU_PAGE_PROPERTY_WRITE_BACK, D3D12_MEMORY_POOL_L0, 0, 0);
+		[[maybe_unused]] const D3D12_HEAP_PROPERTIES heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_CPU_PAGE_PROPERTY_WRITE_BACK, D3D12_MEMORY_POOL_L0, 0, 0);
 #endif // NO_UPDATE_TEXTURE_FROM_CPU
 
 		D3D12_RESOURCE_DESC resDesc = Resource::instance()->getFrameBuffer(0)->GetDesc();
 
+#if TRANSIENT_ALIASING
+		// the buffers which are not alive at the same time share the memory
+		for (size_t i = 0; i < m_resources.size(); ++i)
+		{
+			const D3D12_CLEAR_VALUE clearValue = CD3DX12_CLEAR_VALUE(format, kClearColor.at(i));
+
+			const uint32_t idx = m_transientAllocator.add("baseBuffer" + std::to_string(i), resDesc, clearValue, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, lifetimes.at(i));
+			ThrowIfFalse(idx == i);
+		}
+
+		ThrowIfFailed(m_transientAllocator.allocate(Resource::instance()->getDevice()));
+
+		for (size_t i = 0; i < m_resources.size(); ++i)
+		{
+			m_resources.at(i) = m_transientAllocator.getResource(static_cast<uint32_t>(i));
+		}
+#else
 		for (size_t i = 0; auto& resource : m_resources)
 		{
 			const D3D12_CLEAR_VALUE clearValue = CD3DX12_CLEAR_VALUE(format, kClearColor.at(i));
@@ -70,6 +109,7 @@ HRESULT OffScreenResource::createResource(DXGI_FORMAT format)
 
 			++i;
 		}
+#endif // TRANSIENT_ALIASING
 	}
 
 #if NO_UPDATE_TEXTURE_FROM_CPU
@@ -133,7 +173,7 @@ HRESULT OffScreenResource::createResource(DXGI_FORMAT format)
 		const D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {
 			.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
 			.NumDescriptors = kNumResource,
-			.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE,
+			.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE,
 			.NodeMask = 0,
 		};
 
@@ -169,52 +209,28 @@ HRESULT OffScreenResource::createResource(DXGI_FORMAT format)
 				handle);
 			handle.ptr += Resource::instance()->getDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 		}
-	}
-
-	return S_OK;
-}
-
-HRESULT OffScreenResource::clearRenderTargets(ID3D12GraphicsCommandList* list) const
-{
-	D3D12_CPU_DESCRIPTOR_HANDLE handle = m_rtvHeap.Get()->GetCPUDescriptorHandleForHeapStart();
 
-	for (size_t i = 0; i < m_resources.size(); ++i)
-	{
-		const D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-			m_resources.at(i).Get(),
-			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-			D3D12_RESOURCE_STATE_RENDER_TARGET,
-			0);
-
-		list->ResourceBarrier(1, &barrier);
-		list->ClearRenderTargetView(handle, kClearColor.at(i), 0, nullptr);
-
-		handle.ptr += Resource::instance()->getDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+		m_srvTable = Resource::instance()->getDescriptorAllocator()->stage(m_srvHeap.Get()->GetCPUDescriptorHandleForHeapStart(), kNumResource);
 	}
 
 	return S_OK;
 }
 
-HRESULT OffScreenResource::buildBarrier(ID3D12GraphicsCommandList* list, Type type, D3D12_RESOURCE_STATES stateBefore, D3D12_RESOURCE_STATES stateAfter) const
+HRESULT OffScreenResource::clearRenderTarget(ID3D12GraphicsCommandList* list, Type type) const
 {
-	const D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-		m_resources.at(static_cast<size_t>(type)).Get(),
-		stateBefore,
-		stateAfter);
-	list->ResourceBarrier(1, &barrier);
+	// an aliased buffer has to be cleared as the first operation after it is activated
+	list->ClearRenderTargetView(getRtvCpuDescHandle(type), kClearColor.at(static_cast<size_t>(type)), 0, nullptr);
 
 	return S_OK;
 }
 
-HRESULT OffScreenResource::buildBarrier(ID3D12GraphicsCommandList* list, D3D12_RESOURCE_STATES stateBefore, D3D12_RESOURCE_STATES stateAfter) const
+bool OffScreenResource::isAliased([[maybe_unused]] Type type) const
 {
-	for (size_t i = 0; i < kNumResource; ++i)
-	{
-		auto result = buildBarrier(list, static_cast<Type>(i), stateBefore, stateAfter);
-		ThrowIfFailed(result);
-	}
-
-	return S_OK;
+#if TRANSIENT_ALIASING
+	return m_transientAllocator.isAliased(static_cast<uint32_t>(type));
+#else
+	return false;
+#endif // TRANSIENT_ALIASING
 }
 
 Microsoft::WRL::ComPtr<ID3D12Resource> OffScreenResource::getResource(Type type) const
@@ -227,11 +243,6 @@ Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> OffScreenResource::getRtvHeap() con
 	return m_rtvHeap;
 }
 
-Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> OffScreenResource::getSrvHeap() const
-{
-	return m_srvHeap;
-}
-
 D3D12_CPU_DESCRIPTOR_HANDLE OffScreenResource::getRtvCpuDescHandle(Type type) const
 {
 	const UINT incSize = Resource::instance()->getDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
@@ -241,9 +252,7 @@ D3D12_CPU_DESCRIPTOR_HANDLE OffScreenResource::getRtvCpuDescHandle(Type type) co
 
 D3D12_GPU_DESCRIPTOR_HANDLE OffScreenResource::getSrvGpuDescHandle(Type type) const
 {
-	const UINT incSize = Resource::instance()->getDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-	const CD3DX12_GPU_DESCRIPTOR_HANDLE handle(m_srvHeap.Get()->GetGPUDescriptorHandleForHeapStart(), static_cast<INT>(type), incSize);
-	return handle;
+	return m_srvTable.getGpuHandle(static_cast<uint32_t>(type));
 }
 
 void Render::onNotify(UiEvent uiEvent, const void* uiEventData)
@@ -258,6 +267,9 @@ void Render::onNotify(UiEvent uiEvent, const void* uiEventData)
 	case UiEvent::kUpdateHighLuminanceThreshold:
 		updateHighLuminanceThreshold(reinterpret_cast<const UiEventDataUpdateHighLuminanceThreshold*>(uiEventData)->val);
 		break;
+	case UiEvent::kUpdateAnimationLod:
+		m_bAnimationLod = reinterpret_cast<const UiEventDataUpdateAnimationLod*>(uiEventData)->flag;
+		break;
 	default:
 		Debug::debugOutputFormatString("unhandled UI event. (%d)\n", uiEvent);
 		ThrowIfFalse(false);
@@ -267,69 +279,209 @@ void Render::onNotify(UiEvent uiEvent, const void* uiEventData)
 HRESULT Render::init(HWND hwnd)
 {
 	m_parallelLightVec = kParallelLightVec;
-	ThrowIfFailed(createFence(m_fenceVal, &m_pFence));
+	ThrowIfFailed(m_fenceQueue.init(Resource::instance()->getDevice(), Resource::instance()->getCommandQueue()));
+	ThrowIfFailed(m_framePacer.init(Resource::instance()->getSwapChain(), Config::kMaxFrameLatency));
+
+#if BVH_BENCHMARK
+	Bvh::benchmark(); // meant for a release build
+#endif // BVH_BENCHMARK
+#if POSE_CACHE_BENCHMARK
+	PoseCache::benchmark(); // meant for a release build
+#endif // POSE_CACHE_BENCHMARK
+
+	// the steps only share the device and the caches, which are thread safe
+	InitGraph graph;
+	using Affinity = InitGraph::Affinity;
 
-	ThrowIfFailed(createDepthBuffer(&m_depthResource, &m_dsvHeap, &m_depthSrvHeap));
-	ThrowIfFailed(createLightDepthBuffer(&m_lightDepthResource, &m_lightDepthDsvHeap, &m_lightDepthSrvHeap));
-	ThrowIfFailed(createSceneMatrixBuffer());
-	ThrowIfFailed(createViews());
+	const auto depth = graph.add("depth", [this]()
+		{
+			ThrowIfFailed(createDepthBuffer(&m_depthResource, &m_dsvHeap, &m_depthSrvHeap));
+			ThrowIfFailed(createLightDepthBuffer(&m_lightDepthResource, &m_lightDepthDsvHeap, &m_lightDepthSrvHeap));
+			m_depthSrvTable = Resource::instance()->getDescriptorAllocator()->stage(m_depthSrvHeap.Get()->GetCPUDescriptorHandleForHeapStart(), 1);
+			m_lightDepthSrvTable = Resource::instance()->getDescriptorAllocator()->stage(m_lightDepthSrvHeap.Get()->GetCPUDescriptorHandleForHeapStart(), 1);
+			return S_OK;
+		});
+	graph.add("scene", [this]()
+		{
+			ThrowIfFailed(createSceneMatrixBuffer());
+			return createViews();
+		});
+	graph.add("common", []()
+		{
+			ThrowIfFailed(CommonResource::init());
+			return s_toolkit.init();
+		});
+	graph.add("actor", [this]()
+		{
+			m_pmdActors.resize(1);
+			ThrowIfFailed(m_pmdActors[0].loadAsset(PmdActor::Model::kMiku));
+#if CROWD_MODE
+			ThrowIfFailed(m_pmdActors[0].enableCrowd(Config::kNumCrowdInstances, Config::kNumCrowdPhases, Config::kCrowdSpacing));
+#endif // CROWD_MODE
 
-	ThrowIfFailed(CommonResource::init());
-	ThrowIfFailed(s_toolkit.init());
+			for (auto& actor : m_pmdActors)
+			{
+				actor.enableAnimation(m_bAnimationEnabled);
+				m_actorBvhIds.push_back(m_actorBvh.insert(actor.getBound()));
+			}
+			m_bAnimationEnabledInSim = m_bAnimationEnabled;
+
+			// the full level until the actors are culled
+			m_actorScreenHeights = std::vector<std::atomic<float>>(m_pmdActors.size());
+			std::for_each(m_actorScreenHeights.begin(), m_actorScreenHeights.end(), [](std::atomic<float>& height) { height = FLT_MAX; });
+			return S_OK;
+		});
+	graph.add("offScreen", [this]()
+		{
+			ThrowIfFailed(createFrameGraph());
 
-	m_pmdActors.resize(1);
-	ThrowIfFailed(m_pmdActors[0].loadAsset(PmdActor::Model::kMiku));
+			// the off-screen buffers are placed by their lifetimes in the frame graph
+			std::array<FrameGraph::Lifetime, OffScreenResource::kNumResource> lifetimes = { };
 
-	for (auto& actor : m_pmdActors)
-	{
-		actor.enableAnimation(m_bAnimationEnabled);
-	}
+			for (size_t i = 0; i < lifetimes.size(); ++i)
+			{
+				const auto lifetime = m_frameGraph.getLifetime(toGraphId(static_cast<OffScreenResource::Type>(i)));
+				ThrowIfFalse(lifetime.has_value());
+				lifetimes.at(i) = *lifetime;
+			}
 
-	ThrowIfFailed(m_offScreenResource.createResource(Constant::kDefaultRtFormat));
-	ThrowIfFailed(m_pera.createResources());
-	ThrowIfFailed(m_pera.compileShaders());
-	ThrowIfFailed(m_pera.createPipelineState());
+			ThrowIfFailed(m_offScreenResource.createResource(Constant::kDefaultRtFormat, lifetimes));
+
+			for (size_t i = 0; i < lifetimes.size(); ++i)
+			{
+				const auto type = static_cast<OffScreenResource::Type>(i);
+				m_frameGraph.setResource(toGraphId(type), m_offScreenResource.getResource(type).Get());
+				m_frameGraph.setAliased(toGraphId(type), m_offScreenResource.isAliased(type));
+			}
+			return S_OK;
+		}, { depth });
+	graph.add("pera", [this]()
+		{
+			ThrowIfFailed(m_pera.createResources());
+			ThrowIfFailed(m_pera.compileShaders());
+			return m_pera.createPipelineState();
+		});
+	graph.add("floor", [this]() { return m_floor.init(); });
+	graph.add("bloom", [this]() { return m_bloom.init(Config::kWindowWidth, Config::kWindowHeight); });
+	graph.add("dof", [this]() { return m_dof.init(Config::kWindowWidth, Config::kWindowHeight); });
+	graph.add("ssao", [this]() { return m_ssao.init(Config::kWindowWidth, Config::kWindowHeight); });
+	graph.add("shadow", [this]() { return m_shadow.init(); });
+	graph.add("graph", [this]() { return m_graph.init(); });
+	graph.add("timeStamp", [this]() { return m_timeStamp.init(); });
+	graph.add("commandLists", [this]() { return m_commandLists.init(Resource::instance()->getDevice(), kNumPassLists, "pass"); });
+	graph.add("dxtk", [this]() { return m_dxtkIf.init(Resource::instance()->getDevice(), Constant::kDefaultRtFormat, Constant::kDefaultDrtFormat); });
+
+	// ImGui and Effekseer keep their state per thread
+	graph.add("imgui", [this, hwnd]()
+		{
+			ThrowIfFailed(m_imguif.init(hwnd));
+			m_imguif.addObserver(this);
+			return S_OK;
+		}, { }, Affinity::kMainThread);
+	graph.add("effekseer", [this]()
+		{
+			ThrowIfFailed(initEffekseer());
+			ThrowIfFailed(m_effekseerProxy.load());
+			return m_effekseerProxy.play();
+		}, { }, Affinity::kMainThread);
 
-	ThrowIfFailed(m_floor.init());
-	ThrowIfFailed(m_bloom.init(Config::kWindowWidth, Config::kWindowHeight));
-	ThrowIfFailed(m_dof.init(Config::kWindowWidth, Config::kWindowHeight));
-	ThrowIfFailed(m_ssao.init(Config::kWindowWidth, Config::kWindowHeight));
-	ThrowIfFailed(m_shadow.init());
-	ThrowIfFailed(m_graph.init());
-	ThrowIfFailed(m_imguif.init(hwnd));
-	m_imguif.addObserver(this);
-	ThrowIfFailed(initEffekseer());
-	ThrowIfFailed(m_effekseerProxy.load());
-	ThrowIfFailed(m_effekseerProxy.play());
-	ThrowIfFailed(m_dxtkIf.init(Resource::instance()->getDevice(), Constant::kDefaultRtFormat, Constant::kDefaultDrtFormat));
+#if PARALLEL_INIT
+	const uint32_t numThreads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+#else
+	const uint32_t numThreads = 0;
+#endif // PARALLEL_INIT
+	ThrowIfFailed(graph.run(numThreads));
+	graph.report();
+
+	// the textures are written from the CPU, so the upload batch of DXTK is the only copy on the queue.
+	// It is submitted once, after everything has been created
 	{
 		auto f = std::bind(&Render::waitForEndOfRenderingInternal, this, std::placeholders::_1);
 		ThrowIfFailed(m_dxtkIf.upload(Resource::instance()->getCommandQueue(), f));
 	}
 
-	ThrowIfFailed(m_timeStamp.init());
+#if MULTITHREADED_RECORDING
+	{
+		const uint32_t numWorkers = std::clamp(std::thread::hardware_concurrency(), 1u, kNumPassLists);
+		m_workerPool.start(numWorkers);
+		Debug::debugOutputFormatString("Recording threads: %u\n", numWorkers);
+	}
+#endif // MULTITHREADED_RECORDING
+
+#if SIMULATION_THREAD
+	m_simulation.start(Config::kSimulationHz, [this](SceneSnapshot* pSnapshot) { simulate(pSnapshot); });
+#endif // SIMULATION_THREAD
 
 	return S_OK;
 }
 
 void Render::teardown()
 {
+	m_simulation.stop();
+	ThrowIfFailed(waitForEndOfRendering());
+	m_workerPool.stop();
+
 	CommonResource::tearDown();
 	s_toolkit.teardown();
 	m_imguif.teardown();
 	m_imguif.removeObserver(this);
 }
 
+HRESULT Render::waitForNextFrame()
+{
+	return m_framePacer.waitForSwapChain();
+}
+
 HRESULT Render::update()
 {
-	updateMvpMatrix(m_bAnimationReversed);
+	m_framePacer.markUpdateStart();
+
+	ThrowIfFailed(beginFrame());
+
+	const SceneSnapshot& snapshot = acquireSnapshot();
+
+	updateMvpMatrix(snapshot);
 
-	for (auto& actor : m_pmdActors)
+	// patches the materials of the actors before their slices for this frame are written
+	Resource::instance()->getTextureStreamer()->update(Config::kTextureStreamingBytesPerFrame);
+
+	// the actors and their materials out of the camera and the light are not drawn. The levels of detail are picked in pixels
+	const Culling::Views views = Culling::makeViews(
+		m_cpuSceneParam.view * m_cpuSceneParam.proj,
+		m_cpuSceneParam.lightCamera,
+		m_cpuSceneParam.shadow,
+		m_cpuSceneParam.eye,
+		0.5f * Config::kWindowHeight * DirectX::XMVectorGetY(m_cpuSceneParam.proj.r[1]));
+
+	for (size_t i = 0; i < m_pmdActors.size(); ++i)
 	{
-		actor.update(m_bAnimationReversed);
+		m_pmdActors.at(i).applyPose(snapshot.poses.at(i), views);
+		m_actorBvh.update(m_actorBvhIds.at(i), m_pmdActors.at(i).getBound());
 	}
 
-	m_graph.set(m_timeStamp.getInUsec(TimeStamp::Index::k0, TimeStamp::Index::k3) / 1000.0f);
+	m_actorBvh.refit();
+
+	{
+		std::vector<uint32_t> ids;
+		std::vector<bool> inCamera(m_pmdActors.size(), false);
+		std::vector<bool> inLight(m_pmdActors.size(), false);
+
+		m_actorBvh.queryFrustum(views.camera, &ids);
+		std::for_each(ids.begin(), ids.end(), [&inCamera](uint32_t id) { inCamera.at(id) = true; });
+
+		ids.clear();
+		m_actorBvh.queryFrustum(views.light, &ids);
+		std::for_each(ids.begin(), ids.end(), [&inLight](uint32_t id) { inLight.at(id) = true; });
+
+		for (size_t i = 0; i < m_pmdActors.size(); ++i)
+		{
+			const uint32_t id = m_actorBvhIds.at(i);
+			m_pmdActors.at(i).cull(snapshot.poses.at(i), views, inCamera.at(id), inLight.at(id));
+			m_actorScreenHeights.at(i) = m_pmdActors.at(i).getScreenHeight();
+		}
+	}
+
+	m_graph.set(m_timeStamp.getInUsec(TimeStamp::Index::k0, TimeStamp::Index::k3, Resource::instance()->getFrameIndex()) / 1000.0f);
 	m_graph.update();
 	m_effekseerProxy.update();
 
@@ -338,8 +490,6 @@ HRESULT Render::update()
 
 HRESULT Render::render()
 {
-	ID3D12CommandAllocator* const allocator = Resource::instance()->getCommandAllocator();
-	ID3D12GraphicsCommandList* const list = Resource::instance()->getCommandList();
 	ID3D12CommandQueue* const queue = Resource::instance()->getCommandQueue();
 
 	ID3D12Resource* backBufferResource = nullptr;
@@ -354,26 +504,68 @@ HRESULT Render::render()
 		rtvH.ptr += bbIdx * static_cast<SIZE_T>(Resource::instance()->getDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV));
 	}
 
-	// reset command allocator & list
+	// the barriers of all the passes are derived here, before the lists are recorded in parallel
 	{
-		ThrowIfFailed(allocator->Reset());
-		ThrowIfFailed(list->Reset(allocator, nullptr));
+		m_frameGraph.setResource(toGraphId(GraphResource::kBackBuffer), backBufferResource);
+		ThrowIfFailed(m_frameGraph.compile());
 	}
 
-	// wait unti the back buffer is available
+	// reset command allocators & lists. The allocators of this frame slot have been retired in beginFrame()
 	{
-		const D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-			backBufferResource,
-			D3D12_RESOURCE_STATE_PRESENT,
-			D3D12_RESOURCE_STATE_RENDER_TARGET,
-			0);
-		list->ResourceBarrier(1, &barrier);
+		ThrowIfFailed(m_commandLists.reset(Resource::instance()->getFrameIndex()));
 	}
 
+	// ImGui is not thread safe. The UI is built here, so that its callbacks do not run while the lists are recorded
 	{
-		m_imguif.setRenderTime(m_timeStamp.getInUsec(TimeStamp::Index::k0, TimeStamp::Index::k3) / 1000.0f);
+		m_imguif.setRenderTime(m_timeStamp.getInUsec(TimeStamp::Index::k0, TimeStamp::Index::k3, Resource::instance()->getFrameIndex()) / 1000.0f);
+		m_imguif.setLatency(m_framePacer.getCpuLatencyInMs(), m_framePacer.getGpuLatencyInMs(), m_framePacer.getDisplayLatencyInMs());
+		m_imguif.setAnimationTime(m_animationTimeInMs, m_animationSavedTimeInMs);
+		m_imguif.setPoseCacheStats(m_poseCacheHitRate, m_poseCacheSavedTimeInMs);
+		m_imguif.newFrame();
+		m_imguif.build();
 	}
 
+	// record the passes in parallel, then submit them in dependency order
+	{
+		// sampled now and then. Compare with ENABLE_BUNDLES (0) in bundle_cache.cpp
+		std::optional<Util::TimeCounter> recordTime;
+
+		if (m_numRecordedFrames++ % kRecordTimeInterval == 0)
+		{
+			recordTime.emplace("record command lists");
+		}
+
+		m_workerPool.push([&]() {
+			recordShadowPassList(m_commandLists.getList(kShadowPassListIdx), rtvH);
+			});
+
+		for (uint32_t i = 0; i < Config::kNumBasePassCommandLists; ++i)
+		{
+			m_workerPool.push([&, i]() {
+				recordBasePassList(m_commandLists.getList(kBasePassListIdx + i), i);
+				});
+		}
+
+		// on this thread, since ImGui and Effekseer keep their state per thread
+		recordPostPassList(m_commandLists.getList(kPostPassListIdx), rtvH, dsvH);
+
+		m_workerPool.waitIdle();
+	}
+
+	// execute command lists
+	m_commandLists.execute(queue);
+
+	return S_OK;
+}
+
+void Render::recordShadowPassList(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE rtvH)
+{
+	// the descriptor heap is a state of a command list. Each list binds the global one once
+	Resource::instance()->getDescriptorAllocator()->bind(list);
+
+	// wait unti the back buffer is available, and make the buffers writable to clear them
+	m_frameGraph.emitBarriers(list, toGraphId(GraphPass::kClear));
+
 	// get time stamp for starting
 	{
 		m_timeStamp.set(list, TimeStamp::Index::k0);
@@ -383,48 +575,58 @@ HRESULT Render::render()
 	{
 		const PixScopedEvent pixScopedEvent(list, "clearBuffers");
 
-		m_imguif.newFrame();
 		clearRenderTarget(list, rtvH, kClearColorRenderTarget);
 		clearDepthRenderTargets(list);
-		m_offScreenResource.clearRenderTargets(list);
 		m_ssao.clearRenderTarget(list);
 		m_bloom.clearWorkRenderTarget(list);
 		m_dof.clearWorkRenderTarget(list);
 	}
 
+	m_frameGraph.emitBarriers(list, toGraphId(GraphPass::kShadow));
 	renderShadowPass(list);
 
 	{
 		m_timeStamp.set(list, TimeStamp::Index::k1);
 	}
 
-	renderBasePass(list);
+	ThrowIfFailed(list->Close());
+}
 
+void Render::recordBasePassList(ID3D12GraphicsCommandList* list, uint32_t chunk)
+{
+	Resource::instance()->getDescriptorAllocator()->bind(list);
+
+	renderBasePass(list, chunk);
+
+	if (chunk + 1 == Config::kNumBasePassCommandLists)
 	{
 		m_timeStamp.set(list, TimeStamp::Index::k2);
 	}
 
+	ThrowIfFailed(list->Close());
+}
+
+void Render::recordPostPassList(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE rtvH, D3D12_CPU_DESCRIPTOR_HANDLE dsvH)
+{
+	Resource::instance()->getDescriptorAllocator()->bind(list);
+
 	renderPostPass(list, rtvH);
 
+	// overlays on the back buffer. The depth buffer is read-only from here
+	m_frameGraph.emitBarriers(list, toGraphId(GraphPass::kOverlay));
+
 	{
 		const PixScopedEvent pixScopedEvent(list, "Effekseer");
 		m_effekseerProxy.draw(list);
+
+		// Effekseer binds its own heaps
+		Resource::instance()->getDescriptorAllocator()->bind(list);
 	}
 
 	// UI: axis
 	{
 		const PixScopedEvent pixScopedEvent(list, "Axis");
-
-		{
-			const auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-				m_depthResource.Get(),
-				D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-				D3D12_RESOURCE_STATE_DEPTH_READ,
-				0);
-			list->ResourceBarrier(1, &barrier);
-		}
-
-		m_floor.renderAxis(list, m_sceneDescHeap.Get(), rtvH, dsvH);
+		m_floor.renderAxis(list, getSceneDescHandle(), rtvH, dsvH);
 	}
 
 	renderDebugPass(list, &rtvH);
@@ -432,7 +634,6 @@ HRESULT Render::render()
 	// UI: render imgui
 	{
 		const PixScopedEvent pixScopedEvent(list, "IMGUI");
-		m_imguif.build();
 		m_imguif.render(list);
 	}
 
@@ -458,20 +659,15 @@ HRESULT Render::render()
 		m_timeStamp.set(list, TimeStamp::Index::k3);
 	}
 
-	// resolve time stamps
+	// resolve time stamps into the region of this frame slot
 	{
-		m_timeStamp.resolve(list);
+		m_timeStamp.resolve(list, Resource::instance()->getFrameIndex());
 	}
 
-	resolveResourceBarrier(list, backBufferResource);
+	// make ensure that the back buffer can be presented
+	m_frameGraph.emitFinalBarriers(list);
 
-	// execute command lists
 	ThrowIfFailed(list->Close());
-
-	ID3D12CommandList* cmdLists[] = { list };
-	queue->ExecuteCommandLists(1, cmdLists);
-
-	return S_OK;
 }
 
 HRESULT Render::waitForEndOfRendering()
@@ -481,7 +677,11 @@ HRESULT Render::waitForEndOfRendering()
 
 HRESULT Render::swap()
 {
+	const uint32_t frameIdx = m_frameFenceRing.getFrameIndex();
+
 	ThrowIfFailed(Resource::instance()->getSwapChain()->Present(1, 0));
+	ThrowIfFailed(m_frameFenceRing.endFrame(&m_fenceQueue));
+	m_framePacer.markPresented(frameIdx);
 	ThrowIfFailed(m_dxtkIf.commit(Resource::instance()->getCommandQueue()));
 
 	return S_OK;
@@ -489,10 +689,8 @@ HRESULT Render::swap()
 
 void Render::toggleAnimationEnable()
 {
+	// the actors pick it up in simulate()
 	m_bAnimationEnabled = !m_bAnimationEnabled;
-
-	for (auto& actors : m_pmdActors)
-		actors.enableAnimation(m_bAnimationEnabled);
 }
 
 void Render::toggleAnimationReverse()
@@ -505,6 +703,11 @@ void Render::setFpsInImgui(float fps)
 	m_imguif.setFps(fps);
 }
 
+void Render::setInputLatencyInImgui(float latencyInMs)
+{
+	m_imguif.setInputLatency(latencyInMs);
+}
+
 void Render::moveEye(MoveEye moveEye, float val)
 {
 	switch (moveEye) {
@@ -542,7 +745,7 @@ HRESULT Render::initEffekseer()
 	ThrowIfFailed(m_effekseerProxy.init(
 		Resource::instance()->getDevice(),
 		Resource::instance()->getCommandQueue(),
-		2,
+		Config::kNumFramesInFlight,
 		rtFormats,
 		_countof(rtFormats),
 		depthFormat,
@@ -552,35 +755,54 @@ HRESULT Render::initEffekseer()
 	return S_OK;
 }
 
+HRESULT Render::beginFrame()
+{
+	// only wait for the frame which used the same slot, so that the CPU can run ahead of the GPU
+	const uint32_t frameIdx = m_frameFenceRing.beginFrame(&m_fenceQueue);
+	m_framePacer.markGpuCompleted(frameIdx, m_timeStamp.getCpuTick(TimeStamp::Index::k3, frameIdx));
+	m_framePacer.collect();
+
+	Resource::instance()->setFrameIndex(frameIdx);
+	Resource::instance()->getDescriptorAllocator()->beginFrame(frameIdx);
+	Resource::instance()->getBundleCache()->beginFrame();
+	m_sceneParam = m_mappedSceneParams.at(frameIdx);
+
+	return S_OK;
+}
+
 HRESULT Render::createSceneMatrixBuffer()
 {
 	using namespace DirectX;
 
+	const size_t w = Util::alignmentedSize(sizeof(SceneParam), 256);
+
+	D3D12_HEAP_PROPERTIES heapProp = { };
 	{
-		const size_t w = Util::alignmentedSize(sizeof(SceneParam), 256);
+		heapProp.Type = D3D12_HEAP_TYPE_UPLOAD;
+		heapProp.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+		heapProp.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+		heapProp.CreationNodeMask = 0;
+		heapProp.VisibleNodeMask = 0;
+	}
 
-		D3D12_HEAP_PROPERTIES heapProp = { };
-		{
-			heapProp.Type = D3D12_HEAP_TYPE_UPLOAD;
-			heapProp.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-			heapProp.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-			heapProp.CreationNodeMask = 0;
-			heapProp.VisibleNodeMask = 0;
-		}
+	D3D12_RESOURCE_DESC resourceDesc = { };
+	{
+		resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		resourceDesc.Alignment = 0;
+		resourceDesc.Width = w;
+		resourceDesc.Height = 1;
+		resourceDesc.DepthOrArraySize = 1;
+		resourceDesc.MipLevels = 1;
+		resourceDesc.Format = DXGI_FORMAT_UNKNOWN;
+		resourceDesc.SampleDesc = { 1, 0 };
+		resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+		resourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+	}
 
-		D3D12_RESOURCE_DESC resourceDesc = { };
-		{
-			resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-			resourceDesc.Alignment = 0;
-			resourceDesc.Width = w;
-			resourceDesc.Height = 1;
-			resourceDesc.DepthOrArraySize = 1;
-			resourceDesc.MipLevels = 1;
-			resourceDesc.Format = DXGI_FORMAT_UNKNOWN;
-			resourceDesc.SampleDesc = { 1, 0 };
-			resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-			resourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-		}
+	// one buffer per frame in flight since the CPU writes it every frame
+	for (size_t i = 0; i < Config::kNumFramesInFlight; ++i)
+	{
+		auto& sceneParamResource = m_sceneParamResources.at(i);
 
 		auto result = Resource::instance()->getDevice()->CreateCommittedResource(
 			&heapProp,
@@ -588,40 +810,39 @@ HRESULT Render::createSceneMatrixBuffer()
 			&resourceDesc,
 			D3D12_RESOURCE_STATE_GENERIC_READ,
 			nullptr,
-			IID_PPV_ARGS(m_sceneParamResource.ReleaseAndGetAddressOf())
+			IID_PPV_ARGS(sceneParamResource.ReleaseAndGetAddressOf())
 		);
 		ThrowIfFailed(result);
 
-		result = m_sceneParamResource.Get()->SetName(Util::getWideStringFromString("renderSceneParamBuffer").c_str());
+		result = sceneParamResource.Get()->SetName(Util::getWideStringFromString("renderSceneParamBuffer" + std::to_string(i)).c_str());
 		ThrowIfFailed(result);
-	}
 
-	{
-		auto result = m_sceneParamResource->Map(
+		result = sceneParamResource->Map(
 			0,
 			nullptr,
-			reinterpret_cast<void**>(&m_sceneParam)
+			reinterpret_cast<void**>(&m_mappedSceneParams.at(i))
 		);
 		ThrowIfFailed(result);
 
 		// init
-		m_sceneParam->highLuminanceThreshold = Config::kDefaultHighLuminanceThreshold;
+		m_mappedSceneParams.at(i)->highLuminanceThreshold = m_highLuminanceThreshold;
 	}
 
+	m_sceneParam = m_mappedSceneParams.at(Resource::instance()->getFrameIndex());
+
 	return S_OK;
 }
 
 HRESULT Render::createViews()
 {
-	// create a descriptor heap for shader resource
-	D3D12_DESCRIPTOR_HEAP_DESC descHeapDesc = { };
+	// a staging heap which has the CBV of each frame
 	{
-		{
-			descHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-			descHeapDesc.NumDescriptors = 1;
-			descHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-			descHeapDesc.NodeMask = 0;
-		}
+		const D3D12_DESCRIPTOR_HEAP_DESC descHeapDesc = {
+			.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
+			.NumDescriptors = Config::kNumFramesInFlight,
+			.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE,
+			.NodeMask = 0,
+		};
 
 		auto ret = Resource::instance()->getDevice()->CreateDescriptorHeap(
 			&descHeapDesc,
@@ -632,24 +853,176 @@ HRESULT Render::createViews()
 		ThrowIfFailed(ret);
 	}
 
-	// create a shader resource view on the heap
+	for (size_t i = 0; i < Config::kNumFramesInFlight; ++i)
 	{
-		auto basicHeapHandle = m_sceneDescHeap->GetCPUDescriptorHandleForHeapStart();
+		const CD3DX12_CPU_DESCRIPTOR_HANDLE handle(
+			m_sceneDescHeap->GetCPUDescriptorHandleForHeapStart(),
+			static_cast<INT>(i),
+			Resource::instance()->getDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV));
+
 		D3D12_CONSTANT_BUFFER_VIEW_DESC bvDesc = { };
 		{
-			bvDesc.BufferLocation = m_sceneParamResource->GetGPUVirtualAddress();
-			bvDesc.SizeInBytes = static_cast<UINT>(m_sceneParamResource->GetDesc().Width);
+			bvDesc.BufferLocation = m_sceneParamResources.at(i)->GetGPUVirtualAddress();
+			bvDesc.SizeInBytes = static_cast<UINT>(m_sceneParamResources.at(i)->GetDesc().Width);
 		}
 		Resource::instance()->getDevice()->CreateConstantBufferView(
 			&bvDesc,
-			basicHeapHandle
+			handle
 		);
 	}
 
+	m_sceneDescTable = Resource::instance()->getDescriptorAllocator()->stage(m_sceneDescHeap->GetCPUDescriptorHandleForHeapStart(), Config::kNumFramesInFlight);
+
 	return S_OK;
 }
 
-HRESULT Render::updateMvpMatrix(bool animationReversed)
+HRESULT Render::createFrameGraph()
+{
+	constexpr D3D12_RESOURCE_STATES kRt = D3D12_RESOURCE_STATE_RENDER_TARGET;
+	constexpr D3D12_RESOURCE_STATES kPsr = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+	constexpr D3D12_RESOURCE_STATES kDepthWrite = D3D12_RESOURCE_STATE_DEPTH_WRITE;
+	constexpr D3D12_RESOURCE_STATES kDepthRead = D3D12_RESOURCE_STATE_DEPTH_READ | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+
+	// the back buffer is set every frame in render()
+	ThrowIfFalse(m_frameGraph.importResource("backBuffer", nullptr, D3D12_RESOURCE_STATE_PRESENT, FrameGraph::Content::kProducedInFrame, D3D12_RESOURCE_STATE_PRESENT) == toGraphId(GraphResource::kBackBuffer));
+	ThrowIfFalse(m_frameGraph.importResource("depth", m_depthResource.Get(), kPsr, FrameGraph::Content::kProducedInFrame) == toGraphId(GraphResource::kDepth));
+	ThrowIfFalse(m_frameGraph.importResource("lightDepth", m_lightDepthResource.Get(), kPsr, FrameGraph::Content::kProducedInFrame) == toGraphId(GraphResource::kLightDepth));
+
+	// the off-screen buffers are set after they are placed by their lifetimes
+	for (size_t i = 0; i < OffScreenResource::kNumResource; ++i)
+	{
+		const auto type = static_cast<OffScreenResource::Type>(i);
+		const auto id = m_frameGraph.importResource("offScreen" + std::to_string(i), nullptr, kPsr, FrameGraph::Content::kTransient);
+		ThrowIfFalse(id == toGraphId(type));
+	}
+
+	using Type = OffScreenResource::Type;
+	const FrameGraph::ResourceId backBuffer = toGraphId(GraphResource::kBackBuffer);
+	const FrameGraph::ResourceId depth = toGraphId(GraphResource::kDepth);
+	const FrameGraph::ResourceId lightDepth = toGraphId(GraphResource::kLightDepth);
+
+	// in the order of GraphPass
+	{
+		const auto pass = m_frameGraph.addPass("clear");
+		m_frameGraph.use(pass, backBuffer, kRt);
+		m_frameGraph.use(pass, depth, kDepthWrite);
+		m_frameGraph.use(pass, lightDepth, kDepthWrite);
+	}
+	{
+		const auto pass = m_frameGraph.addPass("shadow");
+		m_frameGraph.use(pass, lightDepth, kDepthWrite);
+	}
+	{
+		const auto pass = m_frameGraph.addPass("base");
+		m_frameGraph.use(pass, lightDepth, kPsr);
+		m_frameGraph.use(pass, depth, kDepthWrite);
+		m_frameGraph.use(pass, toGraphId(Type::kColor), kRt);
+		m_frameGraph.use(pass, toGraphId(Type::kNormal), kRt);
+		m_frameGraph.use(pass, toGraphId(Type::kLuminance), kRt);
+	}
+	{
+		const auto pass = m_frameGraph.addPass("ssao");
+		m_frameGraph.use(pass, depth, kPsr);
+		m_frameGraph.use(pass, toGraphId(Type::kNormal), kPsr);
+		m_frameGraph.use(pass, toGraphId(Type::kColor), kPsr);
+		m_frameGraph.use(pass, toGraphId(Type::kPostSsao), kRt);
+	}
+	{
+		const auto pass = m_frameGraph.addPass("bloom");
+		m_frameGraph.use(pass, toGraphId(Type::kLuminance), kPsr);
+		m_frameGraph.use(pass, toGraphId(Type::kPostSsao), kPsr);
+		m_frameGraph.use(pass, toGraphId(Type::kPostBloom), kRt);
+	}
+	{
+		const auto pass = m_frameGraph.addPass("dof");
+		m_frameGraph.use(pass, toGraphId(Type::kPostBloom), kPsr);
+		m_frameGraph.use(pass, depth, kPsr);
+		m_frameGraph.use(pass, toGraphId(Type::kPostDof), kRt);
+	}
+	{
+		const auto pass = m_frameGraph.addPass("pera");
+		m_frameGraph.use(pass, toGraphId(Type::kPostDof), kPsr);
+		m_frameGraph.use(pass, backBuffer, kRt);
+	}
+	{
+		// effekseer, axis, debug views and imgui
+		const auto pass = m_frameGraph.addPass("overlay");
+		m_frameGraph.use(pass, backBuffer, kRt);
+		m_frameGraph.use(pass, depth, kDepthRead);
+		m_frameGraph.use(pass, lightDepth, kPsr);
+		m_frameGraph.use(pass, toGraphId(Type::kLuminance), kPsr);
+		m_frameGraph.use(pass, toGraphId(Type::kNormal), kPsr);
+	}
+
+	return S_OK;
+}
+
+void Render::simulate(SceneSnapshot* pSnapshot)
+{
+	// runs on the simulation thread if SIMULATION_THREAD. Must not touch anything the render thread writes
+	const bool bAnimationEnabled = m_bAnimationEnabled;
+
+	if (bAnimationEnabled != m_bAnimationEnabledInSim)
+	{
+		for (auto& actor : m_pmdActors)
+		{
+			actor.enableAnimation(bAnimationEnabled);
+		}
+
+		m_bAnimationEnabledInSim = bAnimationEnabled;
+	}
+
+	pSnapshot->bAutoMoveEyePos = m_bAutoMoveEyePos;
+	pSnapshot->bAutoMoveLightPos = m_bAutoMoveLightPos;
+
+	if (pSnapshot->bAutoMoveEyePos)
+	{
+		pSnapshot->eyePos = getAutoMoveEyePos(bAnimationEnabled, m_bAnimationReversed);
+	}
+
+	if (pSnapshot->bAutoMoveLightPos)
+	{
+		pSnapshot->lightPos = getAutoMoveLightPos();
+	}
+
+	pSnapshot->poses.resize(m_pmdActors.size());
+
+	// the far actors are animated less often, from their heights on the screen in the last frame culled
+	const bool bAnimationLod = m_bAnimationLod;
+	float timeInUs = 0.0f;
+	float savedTimeInUs = 0.0f;
+
+	for (size_t i = 0; i < m_pmdActors.size(); ++i)
+	{
+		const AnimationLod::Level level = bAnimationLod
+			? AnimationLod::select(m_actorScreenHeights.at(i), Config::kAnimationLodHalfHeight, Config::kAnimationLodQuarterHeight)
+			: AnimationLod::Level::kFull;
+
+		PmdActor& actor = m_pmdActors.at(i);
+		actor.computePose(&pSnapshot->poses.at(i), level);
+		timeInUs += actor.getAnimationLod().getCostInUs();
+		savedTimeInUs += actor.getAnimationLod().getSavedInUs();
+	}
+
+	m_animationTimeInMs = timeInUs / 1000.0f;
+	m_animationSavedTimeInMs = savedTimeInUs / 1000.0f;
+
+	const PoseCache::Stats poseCacheStats = Resource::instance()->getPoseCache()->takeStats();
+	m_poseCacheHitRate = static_cast<float>(poseCacheStats.numHits) / std::max(poseCacheStats.numHits + poseCacheStats.numMisses, 1u);
+	m_poseCacheSavedTimeInMs = poseCacheStats.savedInUs / 1000.0f;
+}
+
+const SceneSnapshot& Render::acquireSnapshot()
+{
+#if SIMULATION_THREAD
+	return m_simulation.acquireLatest();
+#else
+	simulate(&m_inlineSnapshot);
+	return m_inlineSnapshot;
+#endif // SIMULATION_THREAD
+}
+
+HRESULT Render::updateMvpMatrix(const SceneSnapshot& snapshot)
 {
 	using namespace DirectX;
 	constexpr XMFLOAT3 up(0, 1, 0);
@@ -661,9 +1034,9 @@ HRESULT Render::updateMvpMatrix(bool animationReversed)
 	XMFLOAT3 lightPos(0, 10, -20);
 	XMFLOAT3 lightFocusPos(0, 0, 0);
 
-	if (m_bAutoMoveEyePos)
+	if (snapshot.bAutoMoveEyePos)
 	{
-		eyePos = getAutoMoveEyePos(m_bAnimationEnabled, animationReversed);
+		eyePos = snapshot.eyePos;
 	}
 	else
 	{
@@ -671,9 +1044,9 @@ HRESULT Render::updateMvpMatrix(bool animationReversed)
 		focusPos = m_focusPos;
 	}
 
-	if (m_bAutoMoveLightPos)
+	if (snapshot.bAutoMoveLightPos)
 	{
-		lightPos = getAutoMoveLightPos();
+		lightPos = snapshot.lightPos;
 	}
 
 	{
@@ -683,7 +1056,7 @@ HRESULT Render::updateMvpMatrix(bool animationReversed)
 			XMLoadFloat3(&up)
 		);
 
-		m_sceneParam->view = viewMat;
+		m_cpuSceneParam.view = viewMat;
 	}
 
 	{
@@ -694,8 +1067,8 @@ HRESULT Render::updateMvpMatrix(bool animationReversed)
 			150.0f
 		);
 
-		m_sceneParam->proj = projMat;
-		m_sceneParam->invProj = XMMatrixInverse(nullptr, projMat);
+		m_cpuSceneParam.proj = projMat;
+		m_cpuSceneParam.invProj = XMMatrixInverse(nullptr, projMat);
 	}
 
 	{
@@ -703,13 +1076,17 @@ HRESULT Render::updateMvpMatrix(bool animationReversed)
 		constexpr float viewHeight = 50.0f;
 		const XMVECTOR lightVec = XMLoadFloat3(&lightPos);
 
-		m_sceneParam->lightCamera =
+		m_cpuSceneParam.lightCamera =
 			XMMatrixLookAtLH(lightVec, XMLoadFloat3(&lightFocusPos), XMLoadFloat3(&up)) *
 			XMMatrixOrthographicLH(viewWidth, viewHeight, 1.0f, 150.0f);
 	}
 
-	m_sceneParam->shadow = XMMatrixShadow(XMLoadFloat4(&kPlaneVec), -XMLoadFloat3(&m_parallelLightVec));
-	m_sceneParam->eye = eyePos;
+	m_cpuSceneParam.shadow = XMMatrixShadow(XMLoadFloat4(&kPlaneVec), -XMLoadFloat3(&m_parallelLightVec));
+	m_cpuSceneParam.eye = eyePos;
+	m_cpuSceneParam.highLuminanceThreshold = m_highLuminanceThreshold;
+
+	// written at once. The upload heap is write combined, so it is never read back
+	*m_sceneParam = m_cpuSceneParam;
 
 	{
 		m_imguif.setEyePos(eyePos);
@@ -718,8 +1095,8 @@ HRESULT Render::updateMvpMatrix(bool animationReversed)
 	}
 
 	{
-		m_effekseerProxy.setCameraMatrix(m_sceneParam->view);
-		m_effekseerProxy.setProjectionMatrix(m_sceneParam->proj);
+		m_effekseerProxy.setCameraMatrix(m_cpuSceneParam.view);
+		m_effekseerProxy.setProjectionMatrix(m_cpuSceneParam.proj);
 	}
 
 	return S_OK;
@@ -727,6 +1104,8 @@ HRESULT Render::updateMvpMatrix(bool animationReversed)
 
 void Render::updateHighLuminanceThreshold(float val)
 {
+	m_highLuminanceThreshold = val;
+	m_cpuSceneParam.highLuminanceThreshold = val;
 	m_sceneParam->highLuminanceThreshold = val;
 }
 
@@ -737,27 +1116,6 @@ HRESULT Render::clearDepthRenderTargets(ID3D12GraphicsCommandList* list)
 		m_lightDepthDsvHeap.Get()->GetCPUDescriptorHandleForHeapStart(),
 	};
 
-	{
-		const CD3DX12_RESOURCE_BARRIER barriers[] = {
-			{
-				CD3DX12_RESOURCE_BARRIER::Transition(
-				m_depthResource.Get(),
-				D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-				D3D12_RESOURCE_STATE_DEPTH_WRITE,
-				0)
-			},
-			{
-				CD3DX12_RESOURCE_BARRIER::Transition(
-				m_lightDepthResource.Get(),
-				D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-				D3D12_RESOURCE_STATE_DEPTH_WRITE,
-				0)
-			},
-		};
-
-		list->ResourceBarrier(_countof(barriers), barriers);
-	}
-
 	for (const auto &handle : depthHandles)
 	{
 		list->ClearDepthStencilView(
@@ -777,25 +1135,28 @@ void Render::renderShadowPass(ID3D12GraphicsCommandList* list)
 	// shadow map: render light depth map
 	const PixScopedEvent pixScopedEvent(list, "ShadowMap");
 
-	m_floor.renderShadow(list, m_sceneDescHeap.Get(), m_lightDepthDsvHeap.Get());
+	m_floor.renderShadow(list, getSceneDescHandle(), m_lightDepthDsvHeap.Get());
 
 	for (const auto& actor : m_pmdActors)
 	{
-		actor.renderShadow(list, m_sceneDescHeap.Get(), m_lightDepthDsvHeap.Get());
+		actor.renderShadow(list, getSceneDescHandle(), m_lightDepthDsvHeap.Get());
 	}
 }
 
-void Render::renderBasePass(ID3D12GraphicsCommandList* list)
+void Render::renderBasePass(ID3D12GraphicsCommandList* list, uint32_t chunk)
 {
 	const PixScopedEvent pixScopedEvent(list, "BasePass");
 
 	// base pass: RT0=albedo, RT1=normal, RT2=luminance, depth
+	// the actors are split into chunks which are recorded on different threads. The first chunk also has the floor
+	const bool bFirstChunk = (chunk == 0);
+
+	if (bFirstChunk)
 	{
-		const auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-			m_lightDepthResource.Get(),
-			D3D12_RESOURCE_STATE_DEPTH_WRITE,
-			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-		list->ResourceBarrier(1, &barrier);
+		m_frameGraph.emitBarriers(list, toGraphId(GraphPass::kBase));
+		m_offScreenResource.clearRenderTarget(list, OffScreenResource::Type::kColor);
+		m_offScreenResource.clearRenderTarget(list, OffScreenResource::Type::kNormal);
+		m_offScreenResource.clearRenderTarget(list, OffScreenResource::Type::kLuminance);
 	}
 
 	{
@@ -814,11 +1175,18 @@ void Render::renderBasePass(ID3D12GraphicsCommandList* list)
 	}
 
 	{
-		m_floor.render(list, m_sceneDescHeap.Get(), m_lightDepthSrvHeap.Get());
+		if (bFirstChunk)
+		{
+			m_floor.render(list, getSceneDescHandle(), m_lightDepthSrvTable.getGpuHandle());
+		}
+
+		const size_t numActors = m_pmdActors.size();
+		const size_t begin = numActors * chunk / Config::kNumBasePassCommandLists;
+		const size_t end = numActors * (chunk + 1) / Config::kNumBasePassCommandLists;
 
-		for (const auto& actor : m_pmdActors)
+		for (size_t i = begin; i < end; ++i)
 		{
-			actor.render(list, m_sceneDescHeap.Get(), m_lightDepthSrvHeap.Get());
+			m_pmdActors.at(i).render(list, getSceneDescHandle(), m_lightDepthSrvTable.getGpuHandle());
 		}
 	}
 }
@@ -827,103 +1195,61 @@ void Render::renderPostPass(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTO
 {
 	const PixScopedEvent pixScopedEvent(list, "PostProcess");
 
-	// resource barrier
-	{
-		m_offScreenResource.buildBarrier(list, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-
-		const auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-			m_depthResource.Get(),
-			D3D12_RESOURCE_STATE_DEPTH_WRITE,
-			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-			0);
-		list->ResourceBarrier(1, &barrier);
-	}
-
 	// post process: SSAO
 	{
 		const PixScopedEvent pixScopedEvent(list, "PostProcess : SSAO");
 
-		m_offScreenResource.buildBarrier(
-			list,
-			OffScreenResource::Type::kPostSsao,
-			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-			D3D12_RESOURCE_STATE_RENDER_TARGET);
+		m_frameGraph.emitBarriers(list, toGraphId(GraphPass::kSsao));
+		m_offScreenResource.clearRenderTarget(list, OffScreenResource::Type::kPostSsao);
 
 		m_ssao.setResource(Ssao::TargetResource::kDstRt, m_offScreenResource.getResource(OffScreenResource::Type::kPostSsao));
 		m_ssao.setResource(Ssao::TargetResource::kSrcDepth, m_depthResource);
 		m_ssao.setResource(Ssao::TargetResource::kSrcNormal, m_offScreenResource.getResource(OffScreenResource::Type::kNormal));
 		m_ssao.setResource(Ssao::TargetResource::kSrcColor, m_offScreenResource.getResource(OffScreenResource::Type::kColor));
-		m_ssao.setResource(Ssao::TargetResource::kSrcSceneParam, m_sceneParamResource);
+		m_ssao.setResource(Ssao::TargetResource::kSrcSceneParam, m_sceneParamResources.at(Resource::instance()->getFrameIndex()));
 
 		m_ssao.render(list);
-
-		m_offScreenResource.buildBarrier(
-			list,
-			OffScreenResource::Type::kPostSsao,
-			D3D12_RESOURCE_STATE_RENDER_TARGET,
-			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 	}
 
 	// post process: bloom
 	{
 		const PixScopedEvent pixScopedEvent(list, "PostProcess : bloom");
 
-		m_offScreenResource.buildBarrier(
-			list,
-			OffScreenResource::Type::kPostBloom,
-			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-			D3D12_RESOURCE_STATE_RENDER_TARGET);
+		m_frameGraph.emitBarriers(list, toGraphId(GraphPass::kBloom));
+		m_offScreenResource.clearRenderTarget(list, OffScreenResource::Type::kPostBloom);
 
 		m_bloom.renderShrinkTextureForBlur(
 			list,
-			m_offScreenResource.getSrvHeap().Get(),
 			m_offScreenResource.getSrvGpuDescHandle(OffScreenResource::Type::kLuminance));
 		m_bloom.render(
 			list,
 			m_offScreenResource.getRtvCpuDescHandle(OffScreenResource::Type::kPostBloom),
-			m_offScreenResource.getSrvHeap().Get(),
 			m_offScreenResource.getSrvGpuDescHandle(OffScreenResource::Type::kPostSsao),
 			m_offScreenResource.getSrvGpuDescHandle(OffScreenResource::Type::kLuminance));
-
-		m_offScreenResource.buildBarrier(
-			list,
-			OffScreenResource::Type::kPostBloom,
-			D3D12_RESOURCE_STATE_RENDER_TARGET,
-			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 	}
 
 	// post process: depth of field
 	{
 		const PixScopedEvent pixScopedEvent(list, "PostProcess : DoF");
 
-		m_offScreenResource.buildBarrier(
-			list,
-			OffScreenResource::Type::kPostDof,
-			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-			D3D12_RESOURCE_STATE_RENDER_TARGET);
+		m_frameGraph.emitBarriers(list, toGraphId(GraphPass::kDof));
+		m_offScreenResource.clearRenderTarget(list, OffScreenResource::Type::kPostDof);
 
 		m_dof.render(
 			list,
 			m_offScreenResource.getRtvCpuDescHandle(OffScreenResource::Type::kPostDof),
-			m_offScreenResource.getSrvHeap().Get(),
 			m_offScreenResource.getSrvGpuDescHandle(OffScreenResource::Type::kPostBloom),
-			m_depthSrvHeap.Get(),
-			m_depthSrvHeap.Get()->GetGPUDescriptorHandleForHeapStart());
-
-		m_offScreenResource.buildBarrier(
-			list,
-			OffScreenResource::Type::kPostDof,
-			D3D12_RESOURCE_STATE_RENDER_TARGET,
-			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+			m_depthSrvTable.getGpuHandle());
 	}
 
 	// post process: pera (render to display buffer)
 	{
 		const PixScopedEvent pixScopedEvent(list, "PostProcess : pera");
 
+		m_frameGraph.emitBarriers(list, toGraphId(GraphPass::kPera));
 		m_pera.render(
+			list,
 			&fbRtvHandle,
-			m_offScreenResource.getSrvHeap().Get(),
 			m_offScreenResource.getSrvGpuDescHandle(OffScreenResource::Type::kPostDof));
 	}
 }
@@ -981,10 +1307,6 @@ void Render::renderDebugPass(ID3D12GraphicsCommandList* list, const D3D12_CPU_DE
 			Config::kWindowWidth / 4,
 			Config::kWindowHeight / 4);
 		const D3D12_RECT scissorRect = CD3DX12_RECT(0, 0, Config::kWindowWidth, Config::kWindowHeight);
-		const CD3DX12_GPU_DESCRIPTOR_HANDLE texGpuDesc(
-			m_offScreenResource.getSrvHeap().Get()->GetGPUDescriptorHandleForHeapStart(),
-			1,
-			Resource::instance()->getDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV));
 
 		m_shadow.pushRenderCommand(Shadow::Type::kQuadRgba, m_offScreenResource.getResource(OffScreenResource::Type::kNormal).Get(), viewport, scissorRect);
 	}
@@ -1006,68 +1328,18 @@ void Render::renderDebugPass(ID3D12GraphicsCommandList* list, const D3D12_CPU_DE
 	}
 }
 
-void Render::resolveResourceBarrier(ID3D12GraphicsCommandList* list, ID3D12Resource* backBufferResource)
+D3D12_GPU_DESCRIPTOR_HANDLE Render::getSceneDescHandle() const
 {
-	// make ensure that the back buffer can be presented
-	{
-		const D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-			backBufferResource,
-			D3D12_RESOURCE_STATE_RENDER_TARGET,
-			D3D12_RESOURCE_STATE_PRESENT,
-			0);
-		list->ResourceBarrier(1, &barrier);
-	}
-
-	{
-		const auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-			m_depthResource.Get(),
-			D3D12_RESOURCE_STATE_DEPTH_READ,
-			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-			0);
-		list->ResourceBarrier(1, &barrier);
-	}
+	return m_sceneDescTable.getGpuHandle(Resource::instance()->getFrameIndex());
 }
 
 HRESULT Render::waitForEndOfRenderingInternal(ID3D12CommandQueue* queue)
 {
-	m_fenceVal++;
-	ThrowIfFailed(queue->Signal(m_pFence.Get(), m_fenceVal));
-
-	while (m_pFence->GetCompletedValue() < m_fenceVal)
-	{
-		HANDLE event = CreateEvent(nullptr, false, false, nullptr);
-
-		if (event == nullptr)
-		{
-			ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
-		}
-
-		ThrowIfFailed(m_pFence->SetEventOnCompletion(m_fenceVal, event));
-
-		auto ret = WaitForSingleObject(event, INFINITE);
-		ThrowIfFalse(ret == WAIT_OBJECT_0);
-
-		BOOL ret2 = CloseHandle(event); // fail
-
-		if (!ret2)
-		{
-			Debug::debugOutputFormatString("failed to close handle. (ret %d error %d)\n", ret2, GetLastError());
-			ThrowIfFalse(FALSE);
-		}
-	}
-
-	return S_OK;
+	ThrowIfFalse(queue == m_fenceQueue.getQueue());
+	return m_frameFenceRing.flush(&m_fenceQueue);
 }
 
 namespace {
-	HRESULT createFence(UINT64 initVal, ComPtr<ID3D12Fence>* fence)
-	{
-		return Resource::instance()->getDevice()->CreateFence(
-			initVal,
-			D3D12_FENCE_FLAG_NONE,
-			IID_PPV_ARGS(fence->ReleaseAndGetAddressOf()));
-	}
-
 	HRESULT createDepthBuffer(ComPtr<ID3D12Resource>* resource, ComPtr<ID3D12DescriptorHeap>* descHeap, ComPtr<ID3D12DescriptorHeap>* srvDescHeap)
 	{
 		{
@@ -1153,7 +1425,7 @@ namespace {
 			{
 				heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 				heapDesc.NumDescriptors = 1;
-				heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+				heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 				heapDesc.NodeMask = 0;
 			}
 
@@ -1271,7 +1543,7 @@ namespace {
 			{
 				heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 				heapDesc.NumDescriptors = 1;
-				heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+				heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 				heapDesc.NodeMask = 0;
 			}
 
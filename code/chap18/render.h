@@ -5,24 +5,35 @@
 #include <Windows.h>
 #include <DirectXTex.h>
 #include <d3d12.h>
+#include <array>
+#include <atomic>
 #include <vector>
 #include <wrl.h>
 #pragma warning(pop)
 #include "bloom.h"
+#include "bvh.h"
+#include "command_list_set.h"
 #include "config.h"
+#include "descriptor_allocator.h"
 #include "dof.h"
 #include "dxtk_if.h"
 #include "effekseer_proxy.h"
 #include "floor.h"
+#include "frame_fence.h"
+#include "frame_graph.h"
+#include "frame_pacer.h"
 #include "graph.h"
 #include "observer.h"
 #include "imgui_if.h"
 #include "pmd_actor.h"
 #include "pera.h"
 #include "shadow.h"
+#include "simulation.h"
 #include "ssao.h"
 #include "timestamp.h"
 #include "toolkit.h"
+#include "transient_allocator.h"
+#include "worker_pool.h"
 
 struct SceneParam
 {
@@ -58,13 +69,11 @@ public:
 	};
 	static constexpr size_t kNumResource = 6;
 
-	HRESULT createResource(DXGI_FORMAT format);
-	HRESULT clearRenderTargets(ID3D12GraphicsCommandList* list) const;
-	HRESULT buildBarrier(ID3D12GraphicsCommandList* list, Type type, D3D12_RESOURCE_STATES StateBefore, D3D12_RESOURCE_STATES StateAfter) const;
-	HRESULT buildBarrier(ID3D12GraphicsCommandList* list, D3D12_RESOURCE_STATES StateBefore, D3D12_RESOURCE_STATES StateAfter) const;
+	HRESULT createResource(DXGI_FORMAT format, const std::array<FrameGraph::Lifetime, kNumResource>& lifetimes);
+	HRESULT clearRenderTarget(ID3D12GraphicsCommandList* list, Type type) const;
+	bool isAliased(Type type) const;
 	Microsoft::WRL::ComPtr<ID3D12Resource> getResource(Type type) const;
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> getRtvHeap() const;
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> getSrvHeap() const;
 	D3D12_CPU_DESCRIPTOR_HANDLE getRtvCpuDescHandle(Type type) const;
 	D3D12_GPU_DESCRIPTOR_HANDLE getSrvGpuDescHandle(Type type) const;
 
@@ -79,8 +88,10 @@ private:
 	};
 
 	std::array<Microsoft::WRL::ComPtr<ID3D12Resource>, kNumResource> m_resources = { };
+	TransientAllocator m_transientAllocator;
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_rtvHeap = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_srvHeap = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_srvHeap = nullptr; // staging
+	DescriptorTable m_srvTable;
 };
 
 class Render : public Observer
@@ -92,6 +103,7 @@ public:
 
 	HRESULT init(HWND hwnd);
 	void teardown();
+	HRESULT waitForNextFrame();
 	HRESULT update();
 	HRESULT render();
 	HRESULT waitForEndOfRendering();
@@ -99,47 +111,85 @@ public:
 	void toggleAnimationEnable();
 	void toggleAnimationReverse();
 	void setFpsInImgui(float fps);
+	void setInputLatencyInImgui(float latencyInMs);
 	void moveEye(MoveEye moveEye, float val = 0.0f);
 
 private:
+	// command lists recorded in parallel. They are submitted in this order
+	static constexpr uint32_t kShadowPassListIdx = 0;
+	static constexpr uint32_t kBasePassListIdx = kShadowPassListIdx + 1;
+	static constexpr uint32_t kPostPassListIdx = kBasePassListIdx + Config::kNumBasePassCommandLists;
+	static constexpr uint32_t kNumPassLists = kPostPassListIdx + 1;
+
 	HRESULT initEffekseer();
+	HRESULT beginFrame();
 	HRESULT createSceneMatrixBuffer();
 	HRESULT createViews();
-	HRESULT updateMvpMatrix(bool animationReversed);
+	HRESULT createFrameGraph();
+	void simulate(SceneSnapshot* pSnapshot);
+	const SceneSnapshot& acquireSnapshot();
+	HRESULT updateMvpMatrix(const SceneSnapshot& snapshot);
 	void updateHighLuminanceThreshold(float val);
 	HRESULT clearDepthRenderTargets(ID3D12GraphicsCommandList* list);
 	void renderShadowPass(ID3D12GraphicsCommandList* list);
-	void renderBasePass(ID3D12GraphicsCommandList* list);
+	void renderBasePass(ID3D12GraphicsCommandList* list, uint32_t chunk);
 	void renderPostPass(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE fbRtvHandle);
 	void renderDebugPass(ID3D12GraphicsCommandList* list, const D3D12_CPU_DESCRIPTOR_HANDLE* pRtCpuDescHandle);
-	void resolveResourceBarrier(ID3D12GraphicsCommandList* list, ID3D12Resource* backBufferResource);
+	void recordShadowPassList(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE rtvH);
+	void recordBasePassList(ID3D12GraphicsCommandList* list, uint32_t chunk);
+	void recordPostPassList(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE rtvH, D3D12_CPU_DESCRIPTOR_HANDLE dsvH);
+	D3D12_GPU_DESCRIPTOR_HANDLE getSceneDescHandle() const;
 	HRESULT waitForEndOfRenderingInternal(ID3D12CommandQueue* queue);
 
 	static Toolkit s_toolkit;
 
-	bool m_bAnimationEnabled = true;
-	bool m_bAnimationReversed = false;
-	bool m_bAutoMoveEyePos = false;
-	bool m_bAutoMoveLightPos = false;
+	// written by the main thread, read by the simulation thread
+	std::atomic<bool> m_bAnimationEnabled = true;
+	std::atomic<bool> m_bAnimationReversed = false;
+	std::atomic<bool> m_bAutoMoveEyePos = false;
+	std::atomic<bool> m_bAutoMoveLightPos = false;
+	std::atomic<bool> m_bAnimationLod = true;
+	std::vector<std::atomic<float>> m_actorScreenHeights; // per actor, after the culling
+	// written by the simulation thread, read by the main thread
+	std::atomic<float> m_animationTimeInMs = 0.0f;
+	std::atomic<float> m_animationSavedTimeInMs = 0.0f;
+	std::atomic<float> m_poseCacheHitRate = 0.0f;
+	std::atomic<float> m_poseCacheSavedTimeInMs = 0.0f;
+	bool m_bAnimationEnabledInSim = true; // only touched by simulate()
 	DirectX::XMFLOAT3 m_eyePos = DirectX::XMFLOAT3(0.0f, 13.0f, -20.0f);
 	DirectX::XMFLOAT3 m_focusPos = DirectX::XMFLOAT3(0.0f, m_eyePos.y, 0.0f);
 
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_dsvHeap = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_depthSrvHeap = nullptr;
+	DescriptorTable m_depthSrvTable;
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_depthResource = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_lightDepthDsvHeap = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_lightDepthSrvHeap = nullptr;
+	DescriptorTable m_lightDepthSrvTable;
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_lightDepthResource = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_sceneDescHeap = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12Resource> m_sceneParamResource = nullptr;
-	SceneParam* m_sceneParam = nullptr;
+	DescriptorTable m_sceneDescTable; // a CBV per frame
+	std::array<Microsoft::WRL::ComPtr<ID3D12Resource>, Config::kNumFramesInFlight> m_sceneParamResources = { };
+	std::array<SceneParam*, Config::kNumFramesInFlight> m_mappedSceneParams = { };
+	SceneParam* m_sceneParam = nullptr; // points the slot of the current frame
+	SceneParam m_cpuSceneParam; // the one read on the CPU, copied to m_sceneParam
+	float m_highLuminanceThreshold = Config::kDefaultHighLuminanceThreshold;
 	DirectX::XMFLOAT3 m_parallelLightVec = { };
 	OffScreenResource m_offScreenResource;
+	FrameGraph m_frameGraph;
 
-	Microsoft::WRL::ComPtr<ID3D12Fence> m_pFence = nullptr;
-	UINT64 m_fenceVal = 0;
+	D3d12FenceQueue m_fenceQueue;
+	FrameFenceRing m_frameFenceRing;
+	FramePacer m_framePacer;
+	CommandListSet m_commandLists;
+	WorkerPool m_workerPool;
+	uint64_t m_numRecordedFrames = 0;
 
 	std::vector<PmdActor> m_pmdActors;
+	Bvh m_actorBvh; // over the bounds of the actors. Queried for the camera and the light
+	std::vector<uint32_t> m_actorBvhIds; // per actor
+	Simulation m_simulation; // declared after the actors so that it stops before they are destroyed
+	SceneSnapshot m_inlineSnapshot; // used when the simulation does not have its own thread
 
 	Pera m_pera;
 	Floor m_floor;
@@ -0,0 +1,89 @@
+#include "self_check.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <cstdio>
+#pragma warning(pop)
+#include "animation_lod.h"
+#include "bundle_cache.h"
+#include "bvh.h"
+#include "culling.h"
+#include "descriptor_allocator.h"
+#include "frame_fence.h"
+#include "frame_graph.h"
+#include "indirect_draw.h"
+#include "init_graph.h"
+#include "input.h"
+#include "mesh_optimizer.h"
+#include "mesh_report.h"
+#include "mesh_simplifier.h"
+#include "meshlet.h"
+#include "model_cache.h"
+#include "motion_bake.h"
+#include "motion_cache.h"
+#include "motion_compressor.h"
+#include "pipeline_cache.h"
+#include "pmd_actor.h"
+#include "pose_cache.h"
+#include "shader_cache.h"
+#include "simulation.h"
+#include "texture_streamer.h"
+#include "transient_allocator.h"
+
+namespace {
+	struct Check
+	{
+		const char* name = nullptr;
+		bool (*run)() = nullptr;
+	};
+
+	constexpr Check kChecks[] = {
+		{ "Input::EventQueue", &Input::EventQueue::selfCheck },
+		{ "Simulation", []() { return Simulation::stressCheck(10'000); } }, // the triple buffer between two threads
+		{ "FrameFenceRing", &FrameFenceRing::selfCheck },
+		{ "DescriptorAllocator", &DescriptorAllocator::selfCheck },
+		{ "PipelineCache", &PipelineCache::selfCheck },
+		{ "ShaderCache", &ShaderCache::selfCheck },
+		{ "FrameGraph", &FrameGraph::selfCheck },
+		{ "TransientAllocator", &TransientAllocator::selfCheck },
+		{ "InitGraph", &InitGraph::selfCheck },
+		{ "TextureStreamer", &TextureStreamer::selfCheck },
+		{ "BundleCache", &BundleCache::selfCheck },
+		{ "IndirectDraw", &IndirectDraw::selfCheck },
+		{ "PmdActor", &PmdActor::selfCheck },
+		{ "Culling", &Culling::selfCheck },
+		{ "Bvh", &Bvh::selfCheck },
+		{ "Meshlet", &Meshlet::selfCheck },
+		{ "MeshReport", &MeshReport::selfCheck }, // the meshlets of the bundled models
+		{ "MeshOptimizer", &MeshOptimizer::selfCheck },
+		{ "ModelCache", &ModelCache::selfCheck },
+		{ "MeshSimplifier", &MeshSimplifier::selfCheck },
+		{ "AnimationLod", &AnimationLod::selfCheck },
+		{ "PoseCache", &PoseCache::selfCheck },
+		{ "MotionBake", &MotionBake::selfCheck },
+		{ "MotionCompressor", &MotionCompressor::selfCheck },
+		{ "MotionCache", &MotionCache::selfCheck },
+	};
+} // namespace anonymous
+
+namespace SelfCheck {
+
+int run()
+{
+	int exitCode = 0;
+
+	for (const Check& check : kChecks)
+	{
+		const bool bPassed = check.run();
+		printf("%-20s %s\n", check.name, bPassed ? "ok" : "FAILED");
+
+		if (!bPassed)
+		{
+			exitCode = 1;
+		}
+	}
+
+	return exitCode;
+}
+
+} // namespace SelfCheck
@@ -0,0 +1,10 @@
+#pragma once
+
+// A headless run of the checks of the modules, which needs no window nor device: chap18.exe --self-check.
+// Prints the result of each, so that they are run on request instead of at every startup.
+namespace SelfCheck {
+
+// returns the exit code of the process
+int run();
+
+} // namespace SelfCheck
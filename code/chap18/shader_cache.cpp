@@ -0,0 +1,422 @@
+#include "shader_cache.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <cstdio>
+#include <cstring>
+#include <d3dcompiler.h>
+#include <dxcapi.h>
+#include <filesystem>
+#include <set>
+#include <wrl.h>
+#pragma warning(pop)
+#include "debug.h"
+#include "util.h"
+
+#pragma comment(lib, "d3dcompiler.lib")
+
+using namespace Microsoft::WRL;
+
+namespace {
+	// the names and profiles are ASCII
+	std::string toNarrow(LPCWSTR str)
+	{
+		std::string ret;
+
+		for (; *str != L'\0'; ++str)
+		{
+			ret += static_cast<char>(*str);
+		}
+
+		return ret;
+	}
+
+	std::wstring toWide(const std::string& str)
+	{
+		return std::wstring(str.begin(), str.end());
+	}
+
+	bool readFile(const std::string& path, std::string* data)
+	{
+		FILE* fp = nullptr;
+		if (fopen_s(&fp, path.c_str(), "rb") != 0)
+			return false;
+
+		ThrowIfFalse(fseek(fp, 0, SEEK_END) == 0);
+		const long size = ftell(fp);
+		ThrowIfFalse(fseek(fp, 0, SEEK_SET) == 0);
+
+		data->resize(static_cast<size_t>(size));
+		const bool bRead = (size == 0) || (fread(data->data(), data->size(), 1, fp) == 1);
+		ThrowIfFalse(fclose(fp) == 0);
+
+		return bRead;
+	}
+
+	HRESULT createBlob(const void* data, size_t size, ID3DBlob** ppBlob)
+	{
+		auto result = D3DCreateBlob(size, ppBlob);
+		if (FAILED(result))
+			return result;
+
+		memcpy((*ppBlob)->GetBufferPointer(), data, size);
+
+		return S_OK;
+	}
+} // namespace anonymous
+
+HRESULT ShaderCache::init(const char* cacheDir)
+{
+	ThrowIfFalse(cacheDir != nullptr);
+
+	m_cacheDir = cacheDir;
+	m_compilerVersion = getCompilerVersion();
+
+	std::error_code ec;
+	std::filesystem::create_directories(m_cacheDir, ec);
+
+	Debug::debugOutputFormatString("Shader compiler: %s\n", m_compilerVersion.c_str());
+
+	return S_OK;
+}
+
+void ShaderCache::release()
+{
+	Debug::debugOutputFormatString("Shader cache: hit %u, miss %u\n", m_numHits, m_numMisses);
+}
+
+HRESULT ShaderCache::load(LPCWSTR file, const D3D_SHADER_MACRO* defines, LPCSTR entryPoint, LPCWSTR profile, ID3DBlob** ppCode, ID3DBlob** ppErrorMsgs)
+{
+	ThrowIfFalse(file != nullptr);
+	ThrowIfFalse(entryPoint != nullptr);
+	ThrowIfFalse(profile != nullptr);
+	ThrowIfFalse(ppCode != nullptr);
+
+	if (ppErrorMsgs != nullptr)
+	{
+		*ppErrorMsgs = nullptr;
+	}
+
+	std::vector<SourceFile> files;
+	auto result = collectSources(toNarrow(file), &files);
+	if (FAILED(result))
+		return result;
+
+	const uint64_t key = computeKey(m_compilerVersion, files, defines, entryPoint, toNarrow(profile));
+	const std::string path = getEntryPath(key);
+
+	if (std::string code; readFile(path, &code) && !code.empty())
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_numHits;
+
+		return createBlob(code.data(), code.size(), ppCode);
+	}
+
+	Debug::debugOutputFormatString("Shader cache miss: %s %s. Run build_shader_cache.py to build it offline\n", files.front().first.c_str(), entryPoint);
+
+	// outside the lock, so that the init tasks compile in parallel
+	result = compile(file, defines, entryPoint, profile, ppCode, ppErrorMsgs);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	++m_numMisses;
+
+	if (FAILED(result))
+		return result;
+
+	// not fatal. It is compiled again on the next run. Renamed when complete, so that an entry is never read half written
+	const std::string tmpPath = path + ".tmp";
+	FILE* fp = nullptr;
+
+	if (fopen_s(&fp, tmpPath.c_str(), "wb") == 0)
+	{
+		const bool bWritten = fwrite((*ppCode)->GetBufferPointer(), (*ppCode)->GetBufferSize(), 1, fp) == 1;
+		ThrowIfFalse(fclose(fp) == 0);
+
+		std::error_code ec;
+
+		if (bWritten)
+		{
+			std::filesystem::rename(tmpPath, path, ec);
+		}
+
+		if (!bWritten || ec)
+		{
+			std::filesystem::remove(tmpPath, ec);
+		}
+	}
+
+	return S_OK;
+}
+
+std::vector<std::string> ShaderCache::parseIncludes(const std::string& source)
+{
+	std::vector<std::string> includes;
+	size_t pos = 0;
+
+	while (pos < source.size())
+	{
+		size_t end = source.find('\n', pos);
+		if (end == std::string::npos)
+		{
+			end = source.size();
+		}
+
+		// #include "file" with any spaces around '#'
+		const std::string line = source.substr(pos, end - pos);
+		const size_t hash = line.find_first_not_of(" \t");
+
+		if (hash != std::string::npos && line[hash] == '#')
+		{
+			const size_t directive = line.find_first_not_of(" \t", hash + 1);
+
+			if (directive != std::string::npos && line.compare(directive, 7, "include") == 0)
+			{
+				const size_t begin = line.find('"', directive + 7);
+				const size_t close = (begin == std::string::npos) ? std::string::npos : line.find('"', begin + 1);
+
+				if (close != std::string::npos)
+				{
+					includes.push_back(line.substr(begin + 1, close - begin - 1));
+				}
+			}
+		}
+
+		pos = end + 1;
+	}
+
+	return includes;
+}
+
+uint64_t ShaderCache::computeKey(const std::string& compilerVersion, const std::vector<SourceFile>& files, const D3D_SHADER_MACRO* defines, const std::string& entryPoint, const std::string& profile)
+{
+	Util::Fnv1a hasher;
+	hasher.addString(compilerVersion.c_str());
+	hasher.addString(profile.c_str());
+	hasher.addString(entryPoint.c_str());
+
+	for (const D3D_SHADER_MACRO* define = defines; define != nullptr && define->Name != nullptr; ++define)
+	{
+		hasher.addString(define->Name);
+		hasher.addString(define->Definition != nullptr ? define->Definition : "");
+	}
+
+	for (const auto arg : kCompileArgs)
+	{
+		hasher.addString(toNarrow(arg).c_str());
+	}
+
+	for (const auto& [name, contents] : files)
+	{
+		hasher.addString(name.c_str());
+		hasher.addBytes(contents.data(), contents.size());
+		hasher.addString("");
+	}
+
+	return hasher.get();
+}
+
+std::string ShaderCache::getCompilerVersion()
+{
+	ComPtr<IDxcCompiler> compiler = nullptr;
+	ThrowIfFailed(DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(compiler.ReleaseAndGetAddressOf())));
+
+	ComPtr<IDxcVersionInfo> versionInfo = nullptr;
+	ThrowIfFailed(compiler.As(&versionInfo));
+
+	UINT32 major = 0;
+	UINT32 minor = 0;
+	ThrowIfFailed(versionInfo->GetVersion(&major, &minor));
+
+	std::string version = std::to_string(major) + "." + std::to_string(minor);
+
+	// the commit tells the builds of a version apart. An old compiler has only the version
+	ComPtr<IDxcVersionInfo2> versionInfo2 = nullptr;
+
+	if (SUCCEEDED(versionInfo.As(&versionInfo2)))
+	{
+		UINT32 commitCount = 0;
+		char* commitHash = nullptr;
+
+		if (SUCCEEDED(versionInfo2->GetCommitInfo(&commitCount, &commitHash)) && commitHash != nullptr)
+		{
+			version += std::string(" (") + commitHash + ")";
+			CoTaskMemFree(commitHash);
+		}
+	}
+
+	return version;
+}
+
+HRESULT ShaderCache::collectSources(const std::string& file, std::vector<SourceFile>* files)
+{
+	ThrowIfFalse(files != nullptr);
+
+	// depth first in the order of the #include lines. An include is visited once
+	std::set<std::filesystem::path> visited;
+	std::vector<std::pair<std::string, std::filesystem::path>> stack = { { file, std::filesystem::path(file) } };
+
+	while (!stack.empty())
+	{
+		const auto [name, path] = stack.back();
+		stack.pop_back();
+
+		if (!visited.insert(path.lexically_normal()).second)
+			continue;
+
+		std::string contents;
+		if (!readFile(path.string(), &contents))
+		{
+			Debug::debugOutputFormatString("failed to read %s\n", path.string().c_str());
+			return E_FAIL;
+		}
+
+		const auto includes = parseIncludes(contents);
+		files->push_back({ name, std::move(contents) });
+
+		for (auto it = includes.rbegin(); it != includes.rend(); ++it)
+		{
+			stack.push_back({ *it, path.parent_path() / *it });
+		}
+	}
+
+	return S_OK;
+}
+
+HRESULT ShaderCache::compile(LPCWSTR file, const D3D_SHADER_MACRO* defines, LPCSTR entryPoint, LPCWSTR profile, ID3DBlob** ppCode, ID3DBlob** ppErrorMsgs)
+{
+	// an instance for each compile, since IDxcCompiler is not thread safe
+	ComPtr<IDxcLibrary> library = nullptr;
+	auto hr = DxcCreateInstance(CLSID_DxcLibrary, IID_PPV_ARGS(library.ReleaseAndGetAddressOf()));
+	ThrowIfFailed(hr);
+
+	ComPtr<IDxcCompiler> compiler = nullptr;
+	hr = DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(compiler.ReleaseAndGetAddressOf()));
+	ThrowIfFailed(hr);
+
+	uint32_t codePage = CP_UTF8;
+	ComPtr<IDxcBlobEncoding> sourceBlob = nullptr;
+
+	hr = library->CreateBlobFromFile(
+		file,
+		&codePage,
+		sourceBlob.ReleaseAndGetAddressOf());
+	ThrowIfFailed(hr);
+
+	ComPtr<IDxcIncludeHandler> includeHandler = nullptr;
+	hr = library->CreateIncludeHandler(includeHandler.ReleaseAndGetAddressOf());
+	ThrowIfFailed(hr);
+
+	std::vector<std::pair<std::wstring, std::wstring>> defineStrings;
+	for (const D3D_SHADER_MACRO* define = defines; define != nullptr && define->Name != nullptr; ++define)
+	{
+		defineStrings.push_back({ toWide(define->Name), toWide(define->Definition != nullptr ? define->Definition : "") });
+	}
+
+	std::vector<DxcDefine> dxcDefines;
+	for (const auto& [name, value] : defineStrings)
+	{
+		dxcDefines.push_back({ name.c_str(), value.c_str() });
+	}
+
+	const std::wstring entryPointW = toWide(entryPoint);
+	ComPtr<IDxcOperationResult> result = nullptr;
+
+	hr = compiler->Compile(
+		sourceBlob.Get(),
+		file,
+		entryPointW.c_str(),
+		profile,
+		const_cast<LPCWSTR*>(kCompileArgs.data()),
+		static_cast<UINT32>(kCompileArgs.size()),
+		dxcDefines.data(),
+		static_cast<UINT32>(dxcDefines.size()),
+		includeHandler.Get(),
+		result.ReleaseAndGetAddressOf());
+	ThrowIfFailed(hr);
+
+	result->GetStatus(&hr);
+
+	if (FAILED(hr))
+	{
+		ComPtr<IDxcBlobEncoding> errorBlob = nullptr;
+
+		if (ppErrorMsgs != nullptr && SUCCEEDED(result->GetErrorBuffer(errorBlob.ReleaseAndGetAddressOf())) && errorBlob != nullptr)
+		{
+			ThrowIfFailed(createBlob(errorBlob->GetBufferPointer(), errorBlob->GetBufferSize(), ppErrorMsgs));
+		}
+
+		return hr;
+	}
+
+	ComPtr<IDxcBlob> code = nullptr;
+	hr = result->GetResult(code.ReleaseAndGetAddressOf());
+	ThrowIfFailed(hr);
+
+	return createBlob(code->GetBufferPointer(), code->GetBufferSize(), ppCode);
+}
+
+std::string ShaderCache::getEntryPath(uint64_t key) const
+{
+	char name[32] = "";
+	ThrowIfFalse(sprintf_s(name, "%016llx.dxil", static_cast<unsigned long long>(key)) != -1);
+
+	return (std::filesystem::path(m_cacheDir) / name).string();
+}
+
+bool ShaderCache::selfCheck()
+{
+	{
+		const std::string source =
+			"#include \"a.hlsli\"\n"
+			"  #  include \"dir/b.hlsli\" // comment\n"
+			"// #include \"c.hlsli\"\n"
+			"#define INCLUDE \"d.hlsli\"\n"
+			"#include <e.hlsli>";
+		const auto includes = parseIncludes(source);
+
+		if (includes != std::vector<std::string>{ "a.hlsli", "dir/b.hlsli" })
+			return false;
+	}
+
+	{
+		const std::string kVersion = "1.7 (4a9a6b4e0)";
+		const std::vector<SourceFile> files = { { "main.hlsl", "#include \"a.hlsli\"\n" }, { "a.hlsli", "float4 f;\n" } };
+		const uint64_t key = computeKey(kVersion, files, nullptr, "main", "ps_6_6");
+
+		// a compiler, an include change, a define, an entry point and a profile give new keys
+		if (computeKey("1.8 (4a9a6b4e0)", files, nullptr, "main", "ps_6_6") == key)
+			return false;
+
+		std::vector<SourceFile> changed = files;
+		changed.back().second = "float3 f;\n";
+
+		if (computeKey(kVersion, changed, nullptr, "main", "ps_6_6") == key)
+			return false;
+
+		const D3D_SHADER_MACRO defines[] = { { "FOO", "1" }, { nullptr, nullptr } };
+
+		if (computeKey(kVersion, files, defines, "main", "ps_6_6") == key)
+			return false;
+
+		if (computeKey(kVersion, files, nullptr, "main2", "ps_6_6") == key)
+			return false;
+
+		if (computeKey(kVersion, files, nullptr, "main", "vs_6_6") == key)
+			return false;
+
+		// moving bytes between two files is not a collision
+		const std::vector<SourceFile> moved = { { "main.hlsl", "#include \"a.hlsli\"\nf" }, { "a.hlsli", "loat4 f;\n" } };
+
+		if (computeKey(kVersion, moved, nullptr, "main", "ps_6_6") == key)
+			return false;
+
+		// an empty define list is the same as none
+		const D3D_SHADER_MACRO noDefines[] = { { nullptr, nullptr } };
+
+		if (computeKey(kVersion, files, noDefines, "main", "ps_6_6") != key)
+			return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <array>
+#include <cstdint>
+#include <d3dcommon.h>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#pragma warning(pop)
+
+// Compiled shaders keyed by the hash of everything which affects the output: the compiler version, the source
+// and its includes, the defines, the entry point, the profile and the compiler arguments.
+// The entries are built offline by build_shader_cache.py (DXC, optimized) from shader_manifest.txt.
+// A miss is compiled with DXC at runtime and written back, so a warm cache compiles nothing.
+class ShaderCache
+{
+public:
+	using SourceFile = std::pair<std::string, std::string>; // name as referenced, contents
+
+	HRESULT init(const char* cacheDir);
+	void release();
+
+	// same shape as D3DCompileFromFile. The errors are returned only when it is compiled
+	HRESULT load(LPCWSTR file, const D3D_SHADER_MACRO* defines, LPCSTR entryPoint, LPCWSTR profile, ID3DBlob** ppCode, ID3DBlob** ppErrorMsgs);
+
+	static std::vector<std::string> parseIncludes(const std::string& source);
+	static uint64_t computeKey(const std::string& compilerVersion, const std::vector<SourceFile>& files, const D3D_SHADER_MACRO* defines, const std::string& entryPoint, const std::string& profile);
+	static bool selfCheck();
+
+private:
+	static constexpr std::array<LPCWSTR, 1> kCompileArgs = { L"-O3" }; // keep in sync with build_shader_cache.py
+
+	// "major.minor (commit hash)" of dxcompiler.dll, as build_shader_cache.py reads it from dxc --version
+	static std::string getCompilerVersion();
+	static HRESULT collectSources(const std::string& file, std::vector<SourceFile>* files);
+	HRESULT compile(LPCWSTR file, const D3D_SHADER_MACRO* defines, LPCSTR entryPoint, LPCWSTR profile, ID3DBlob** ppCode, ID3DBlob** ppErrorMsgs);
+	std::string getEntryPath(uint64_t key) const;
+
+	std::string m_cacheDir;
+	std::string m_compilerVersion;
+	std::mutex m_mutex; // the counters and the files. Compiling is not locked
+	uint32_t m_numHits = 0;
+	uint32_t m_numMisses = 0;
+};
@@ -18,7 +18,6 @@ HRESULT Shadow::init()
     ThrowIfFailed(compileShaders());
     ThrowIfFailed(createVertexBuffer());
     ThrowIfFailed(createPipelineState());
-    ThrowIfFailed(createDescriptorHeap());
     return S_OK;
 }
 
@@ -32,48 +31,47 @@ void Shadow::pushRenderCommand(Type type, ID3D12Resource* resource, D3D12_VIEWPO
 
 HRESULT Shadow::render(ID3D12GraphicsCommandList* pList, D3D12_CPU_DESCRIPTOR_HANDLE dstRt)
 {
-    setupSrv();
+    if (m_numCommand == 0)
+        return S_OK;
 
-	pList->SetGraphicsRootSignature(m_rootSignature.Get());
-	pList->SetDescriptorHeaps(1, m_srvDescHeap.GetAddressOf());
 	pList->OMSetRenderTargets(1, &dstRt, false, nullptr);
 
     for (size_t i = 0; i < m_numCommand; ++i)
     {
-        const D3D12_GPU_DESCRIPTOR_HANDLE gpuDescHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(
-            m_srvDescHeap.Get()->GetGPUDescriptorHandleForHeapStart(),
-            static_cast<INT>(i),
-            Resource::instance()->getDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV));
+        const Command& command = m_commands.at(i);
+        const D3D12_GPU_DESCRIPTOR_HANDLE gpuDescHandle = getSrv(command.m_resource);
 
-		pList->RSSetViewports(1, &m_commands.at(i).m_viewport);
-		pList->RSSetScissorRects(1, &m_commands.at(i).m_scissorRect);
+		pList->RSSetViewports(1, &command.m_viewport);
+		pList->RSSetScissorRects(1, &command.m_scissorRect);
 
-        {
-            if (m_commands.at(i).m_type == Type::kQuadR)
+        const uint64_t key = BundleCache::makeKey("shadow.quad", { reinterpret_cast<uint64_t>(this), static_cast<uint64_t>(command.m_type), gpuDescHandle.ptr });
+
+        Resource::instance()->getBundleCache()->execute(pList, key, [&](ID3D12GraphicsCommandList* bundle) {
+            bundle->SetGraphicsRootSignature(m_rootSignature.Get());
+
+            if (command.m_type == Type::kQuadR)
             {
-                pList->SetPipelineState(m_pipelineStates.at(static_cast<size_t>(Type::kQuadR)).Get());
-                pList->SetGraphicsRootDescriptorTable(static_cast<UINT>(RootParamIndex::kSrvR), gpuDescHandle);
+                bundle->SetPipelineState(m_pipelineStates.at(static_cast<size_t>(Type::kQuadR)).Get());
+                bundle->SetGraphicsRootDescriptorTable(static_cast<UINT>(RootParamIndex::kSrvR), gpuDescHandle);
             }
             else
             {
-                pList->SetPipelineState(m_pipelineStates.at(static_cast<size_t>(Type::kQuadRgba)).Get());
-                pList->SetGraphicsRootDescriptorTable(static_cast<UINT>(RootParamIndex::kSrvRgba), gpuDescHandle);
+                bundle->SetPipelineState(m_pipelineStates.at(static_cast<size_t>(Type::kQuadRgba)).Get());
+                bundle->SetGraphicsRootDescriptorTable(static_cast<UINT>(RootParamIndex::kSrvRgba), gpuDescHandle);
             }
 
-            pList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-            pList->IASetVertexBuffers(0, 1, &m_vbViews.at(static_cast<size_t>(MeshType::kQuad)));
+            bundle->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+            bundle->IASetVertexBuffers(0, 1, &m_vbViews.at(static_cast<size_t>(MeshType::kQuad)));
 
-            pList->DrawInstanced(4, 1, 0, 0);
-        }
+            bundle->DrawInstanced(4, 1, 0, 0);
 
-        // draw frame
-        {
-            pList->SetPipelineState(m_pipelineStates.at(static_cast<size_t>(TypeInternal::kFrameLine)).Get());
-            pList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_LINESTRIP);
-            pList->IASetVertexBuffers(0, 1, &m_vbViews.at(static_cast<size_t>(MeshType::kFrameLine)));
+            // draw frame
+            bundle->SetPipelineState(m_pipelineStates.at(static_cast<size_t>(TypeInternal::kFrameLine)).Get());
+            bundle->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_LINESTRIP);
+            bundle->IASetVertexBuffers(0, 1, &m_vbViews.at(static_cast<size_t>(MeshType::kFrameLine)));
 
-            pList->DrawInstanced(5, 1, 0, 0);
-        }
+            bundle->DrawInstanced(5, 1, 0, 0);
+            });
     }
 
     m_numCommand = 0;
@@ -85,14 +83,11 @@ HRESULT Shadow::compileShaders()
 {
 	ComPtr<ID3DBlob> errBlob = nullptr;
 
-    auto result = D3DCompileFromFile(
+    auto result = Resource::instance()->getShaderCache()->load(
         L"shadowVertex.hlsl",
         nullptr,
-        D3D_COMPILE_STANDARD_FILE_INCLUDE,
         "main",
-        Constant::kVsShaderModel,
-        0,
-        0,
+        Constant::kDxcVsShaderModel,
         m_commonVs.ReleaseAndGetAddressOf(),
         errBlob.ReleaseAndGetAddressOf());
 
@@ -102,14 +97,11 @@ HRESULT Shadow::compileShaders()
         ThrowIfFalse(false);
 	}
 
-    result = D3DCompileFromFile(
+    result = Resource::instance()->getShaderCache()->load(
         L"shadowPixel.hlsl",
         nullptr,
-        D3D_COMPILE_STANDARD_FILE_INCLUDE,
         "main",
-        Constant::kPsShaderModel,
-        0,
-        0,
+        Constant::kDxcPsShaderModel,
         m_psArray.at(static_cast<size_t>(Type::kQuadR)).ReleaseAndGetAddressOf(),
         errBlob.ReleaseAndGetAddressOf());
 
@@ -119,14 +111,11 @@ HRESULT Shadow::compileShaders()
         ThrowIfFalse(false);
 	}
 
-    result = D3DCompileFromFile(
+    result = Resource::instance()->getShaderCache()->load(
         L"shadowPixel.hlsl",
         nullptr,
-        D3D_COMPILE_STANDARD_FILE_INCLUDE,
         "mainRgba",
-        Constant::kPsShaderModel,
-        0,
-        0,
+        Constant::kDxcPsShaderModel,
         m_psArray.at(static_cast<size_t>(Type::kQuadRgba)).ReleaseAndGetAddressOf(),
         errBlob.ReleaseAndGetAddressOf());
 
@@ -136,14 +125,11 @@ HRESULT Shadow::compileShaders()
         ThrowIfFalse(false);
 	}
 
-    result = D3DCompileFromFile(
+    result = Resource::instance()->getShaderCache()->load(
         L"shadowPixel.hlsl",
         nullptr,
-        D3D_COMPILE_STANDARD_FILE_INCLUDE,
         "black",
-        Constant::kPsShaderModel,
-        0,
-        0,
+        Constant::kDxcPsShaderModel,
         m_psArray.at(static_cast<size_t>(TypeInternal::kFrameLine)).ReleaseAndGetAddressOf(),
         errBlob.ReleaseAndGetAddressOf());
 
@@ -383,11 +369,10 @@ HRESULT Shadow::createPipelineState()
             ThrowIfFalse(false);
         }
 
-        result = Resource::instance()->getDevice()->CreateRootSignature(
-            0,
+        result = Resource::instance()->getPipelineCache()->createRootSignature(
             rsBlob.Get()->GetBufferPointer(),
             rsBlob.Get()->GetBufferSize(),
-            IID_PPV_ARGS(m_rootSignature.ReleaseAndGetAddressOf()));
+            m_rootSignature.ReleaseAndGetAddressOf());
         ThrowIfFailed(result);
 
         m_rootSignature.Get()->SetName(Util::getWideStringFromString("shadowRootSignature").c_str());
@@ -448,9 +433,9 @@ HRESULT Shadow::createPipelineState()
     {
         auto& pipelineState = m_pipelineStates.at(static_cast<size_t>(Type::kQuadR));
 
-        auto result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+        auto result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
             &pipelineDesc,
-            IID_PPV_ARGS(pipelineState.ReleaseAndGetAddressOf()));
+            pipelineState.ReleaseAndGetAddressOf());
         ThrowIfFailed(result);
 
         result = pipelineState.Get()->SetName(Util::getWideStringFromString("shadowRPipelineState").c_str());
@@ -463,9 +448,9 @@ HRESULT Shadow::createPipelineState()
     {
         auto& pipelineState = m_pipelineStates.at(static_cast<size_t>(Type::kQuadRgba));
 
-        auto result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+        auto result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
             &pipelineDesc,
-            IID_PPV_ARGS(pipelineState.ReleaseAndGetAddressOf()));
+            pipelineState.ReleaseAndGetAddressOf());
         ThrowIfFailed(result);
 
         result = pipelineState.Get()->SetName(Util::getWideStringFromString("shadowRgbaPipelineState").c_str());
@@ -479,9 +464,9 @@ HRESULT Shadow::createPipelineState()
     {
         auto& pipelineState = m_pipelineStates.at(static_cast<size_t>(TypeInternal::kFrameLine));
 
-        auto result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+        auto result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
             &pipelineDesc,
-            IID_PPV_ARGS(pipelineState.ReleaseAndGetAddressOf()));
+            pipelineState.ReleaseAndGetAddressOf());
         ThrowIfFailed(result);
 
         result = pipelineState.Get()->SetName(Util::getWideStringFromString("shadowLinePipelineState").c_str());
@@ -491,59 +476,39 @@ HRESULT Shadow::createPipelineState()
     return S_OK;
 }
 
-HRESULT Shadow::createDescriptorHeap()
+D3D12_GPU_DESCRIPTOR_HANDLE Shadow::getSrv(ID3D12Resource* resource)
 {
-    const D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {
-		.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
-		.NumDescriptors = kMaxNumDescriptor,
-		.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE,
-		.NodeMask = 0,
-    };
+    // the same resources are shown every frame, so their views are created once and kept
+    if (const auto it = m_srvTables.find(resource); it != m_srvTables.end())
+        return it->second.getGpuHandle();
 
-	auto result = Resource::instance()->getDevice()->CreateDescriptorHeap(
-		&heapDesc,
-		IID_PPV_ARGS(m_srvDescHeap.ReleaseAndGetAddressOf()));
-    ThrowIfFailed(result);
+    DXGI_FORMAT format = resource->GetDesc().Format;
 
-    result = m_srvDescHeap.Get()->SetName(Util::getWideStringFromString("shadowDescHeap").c_str());
-    ThrowIfFailed(result);
+    if (format == DXGI_FORMAT_R32_TYPELESS)
+    {
+        format = DXGI_FORMAT_R32_FLOAT;
+    }
 
-    return S_OK;
-}
+    const D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {
+        .Format = format,
+        .ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D,
+        .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+        .Texture2D = {
+			.MostDetailedMip = 0,
+			.MipLevels = 1,
+			.PlaneSlice = 0,
+			.ResourceMinLODClamp = 0.0f,
+		},
+    };
 
-void Shadow::setupSrv()
-{
-    for (size_t i = 0; i < m_numCommand; ++i)
-    {
-        auto resource = m_commands.at(i).m_resource;
+    const DescriptorTable table = Resource::instance()->getDescriptorAllocator()->allocate(1);
 
-        DXGI_FORMAT format = resource->GetDesc().Format;
+    Resource::instance()->getDevice()->CreateShaderResourceView(
+        resource,
+        &srvDesc,
+        table.getCpuHandle());
 
-        if (format == DXGI_FORMAT_R32_TYPELESS)
-        {
-            format = DXGI_FORMAT_R32_FLOAT;
-        }
+    m_srvTables.emplace(resource, table);
 
-        const D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {
-            .Format = format,
-            .ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D,
-            .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
-            .Texture2D = {
-				.MostDetailedMip = 0,
-				.MipLevels = 1,
-				.PlaneSlice = 0,
-				.ResourceMinLODClamp = 0.0f,
-			},
-        };
-
-        const D3D12_CPU_DESCRIPTOR_HANDLE cpuDescHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(
-            m_srvDescHeap.Get()->GetCPUDescriptorHandleForHeapStart(),
-            static_cast<INT>(i),
-            Resource::instance()->getDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV));
-
-        Resource::instance()->getDevice()->CreateShaderResourceView(
-            resource,
-            &srvDesc,
-            cpuDescHandle);
-    }
+    return table.getGpuHandle();
 }
@@ -4,9 +4,11 @@
 #pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
 #include <array>
 #include <d3d12.h>
+#include <unordered_map>
 #include <Windows.h>
 #include <wrl.h>
 #pragma warning(pop)
+#include "descriptor_allocator.h"
 
 class Shadow {
 public:
@@ -49,13 +51,11 @@ private:
 	};
 
 	static constexpr size_t kMaxNumCommand = 8;
-    static constexpr UINT kMaxNumDescriptor = kMaxNumCommand;
 
 	HRESULT compileShaders();
 	HRESULT createVertexBuffer();
 	HRESULT createPipelineState();
-	HRESULT createDescriptorHeap();
-	void setupSrv();
+	D3D12_GPU_DESCRIPTOR_HANDLE getSrv(ID3D12Resource* resource);
 
 	Microsoft::WRL::ComPtr<ID3DBlob> m_commonVs = nullptr;
 	std::array<Microsoft::WRL::ComPtr<ID3DBlob>, static_cast<size_t>(TypeInternal::kEnd)> m_psArray = { };
@@ -63,7 +63,7 @@ private:
 	std::array<Microsoft::WRL::ComPtr<ID3D12PipelineState>, static_cast<size_t>(TypeInternal::kEnd)> m_pipelineStates = { };
 	std::array<Microsoft::WRL::ComPtr<ID3D12Resource>, static_cast<size_t>(MeshType::kEnd)> m_vbResources = { };
 	std::array<D3D12_VERTEX_BUFFER_VIEW, static_cast<size_t>(MeshType::kEnd)> m_vbViews = { };
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_srvDescHeap = nullptr;
+	std::unordered_map<ID3D12Resource*, DescriptorTable> m_srvTables;
 	std::array<Command, kMaxNumCommand> m_commands = { };
 	size_t m_numCommand = 0;
 };
@@ -0,0 +1,137 @@
+#include "simulation.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <algorithm>
+#include <chrono>
+#pragma warning(pop)
+#include "debug.h"
+
+namespace {
+	struct StressPayload
+	{
+		uint64_t sequence = 0;
+		std::vector<uint64_t> data; // every element has the sequence number
+	};
+} // namespace anonymous
+
+Simulation::~Simulation()
+{
+	stop();
+}
+
+void Simulation::start(uint32_t hz, StepFunc step)
+{
+	ThrowIfFalse(!isRunning());
+	ThrowIfFalse(hz > 0);
+	ThrowIfFalse(step != nullptr);
+
+	m_hz = hz;
+	m_step = step;
+	m_bQuit = false;
+
+	this->step();
+	m_thread = std::thread(&Simulation::run, this);
+
+	Debug::debugOutputFormatString("Simulation thread: %u Hz\n", hz);
+}
+
+void Simulation::stop()
+{
+	if (!isRunning())
+		return;
+
+	m_bQuit = true;
+	m_thread.join();
+}
+
+const SceneSnapshot& Simulation::acquireLatest()
+{
+	m_buffer.consume();
+	return m_buffer.getFront();
+}
+
+void Simulation::run()
+{
+	using Clock = std::chrono::steady_clock;
+	const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_hz));
+
+	auto next = Clock::now() + period;
+
+	while (!m_bQuit)
+	{
+		std::this_thread::sleep_until(next);
+		step();
+
+		next += period;
+
+		// too late for the next step. Do not try to catch up, or the steps would pile up
+		if (const auto now = Clock::now(); next < now)
+		{
+			next = now + period;
+			m_numLateSteps.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+}
+
+void Simulation::step()
+{
+	SceneSnapshot& snapshot = m_buffer.getBack();
+
+	m_step(&snapshot);
+	snapshot.sequence = ++m_sequence;
+
+	m_buffer.publish();
+	m_numSteps.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool Simulation::stressCheck(uint32_t numSnapshots)
+{
+	constexpr size_t kPayloadSize = 64;
+
+	TripleBuffer<StressPayload> buffer;
+	std::atomic<bool> bTorn = false;
+
+	std::thread writer([&]() {
+		for (uint64_t seq = 1; seq <= numSnapshots; ++seq)
+		{
+			StressPayload& payload = buffer.getBack();
+			payload.data.assign(kPayloadSize, seq);
+			payload.sequence = seq;
+			buffer.publish();
+		}
+		});
+
+	uint64_t last = 0;
+	uint64_t numConsumed = 0;
+
+	while (last < numSnapshots && !bTorn)
+	{
+		if (!buffer.consume())
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		const StressPayload& payload = buffer.getFront();
+
+		const bool bConsistent = payload.data.size() == kPayloadSize &&
+			std::all_of(payload.data.begin(), payload.data.end(), [&payload](uint64_t v) { return v == payload.sequence; });
+
+		// must be whole, and never older than the one taken before
+		if (!bConsistent || payload.sequence <= last)
+		{
+			bTorn = true;
+			break;
+		}
+
+		last = payload.sequence;
+		++numConsumed;
+	}
+
+	writer.join();
+
+	Debug::debugOutputFormatString("Simulation stress check: %u published, %zd consumed, torn %d\n", numSnapshots, numConsumed, bTorn.load());
+
+	return !bTorn && last == numSnapshots;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <DirectXMath.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+#pragma warning(pop)
+#include "pmd_actor.h"
+#include "triple_buffer.h"
+
+// Immutable once published. The render thread only reads it
+struct SceneSnapshot
+{
+	uint64_t sequence = 0;
+	bool bAutoMoveEyePos = false;
+	bool bAutoMoveLightPos = false;
+	DirectX::XMFLOAT3 eyePos = { }; // valid if bAutoMoveEyePos
+	DirectX::XMFLOAT3 lightPos = { }; // valid if bAutoMoveLightPos
+	std::vector<PmdPose> poses; // same order as the actors
+};
+
+// Runs the step function at a fixed rate on its own thread and hands the snapshots to the render thread.
+// A slow GPU frame does not stall the animation, and a slow step does not stall the rendering.
+class Simulation
+{
+public:
+	using StepFunc = std::function<void(SceneSnapshot* pSnapshot)>;
+
+	Simulation() = default;
+	Simulation(const Simulation&) = delete;
+	void operator=(const Simulation&) = delete;
+	~Simulation();
+
+	// the first step runs on the calling thread, so that a snapshot is always available
+	void start(uint32_t hz, StepFunc step);
+	void stop();
+	bool isRunning() const { return m_thread.joinable(); }
+	const SceneSnapshot& acquireLatest();
+	uint64_t getNumOfSteps() const { return m_numSteps.load(std::memory_order_relaxed); }
+	uint64_t getNumOfLateSteps() const { return m_numLateSteps.load(std::memory_order_relaxed); }
+
+	// hands over numSnapshots snapshots between two threads as fast as possible and checks that none of them is torn
+	static bool stressCheck(uint32_t numSnapshots);
+
+private:
+	void run();
+	void step();
+
+	TripleBuffer<SceneSnapshot> m_buffer;
+	std::thread m_thread;
+	std::atomic<bool> m_bQuit = false;
+	uint32_t m_hz = 0;
+	StepFunc m_step = nullptr;
+	uint64_t m_sequence = 0;
+	std::atomic<uint64_t> m_numSteps = 0;
+	std::atomic<uint64_t> m_numLateSteps = 0;
+};
@@ -58,107 +58,6 @@ HRESULT Ssao::render(ID3D12GraphicsCommandList* list)
 
 HRESULT Ssao::compileShaders()
 {
-#if USE_DXC_IN_SSAO
-	for (size_t i = 0; i < kVsEntryPointsDxc.size(); ++i)
-	{
-		//Util::TimeCounter tc("dxc vs ssao");
-
-		if (m_vsBlobTableDxc.find(kVsEntryPointsDxc.at(i)) != m_vsBlobTableDxc.end())
-			continue;
-
-		uint32_t codePage = CP_UTF8;
-		ComPtr<IDxcBlobEncoding> sourceBlob = nullptr;
-
-		auto hr = Resource::instance()->getDxcLibrary()->CreateBlobFromFile(
-			kVsFile,
-			&codePage,
-			sourceBlob.ReleaseAndGetAddressOf());
-		ThrowIfFailed(hr);
-
-		ComPtr<IDxcIncludeHandler> includeHandler = nullptr;
-		hr = Resource::instance()->getDxcLibrary()->CreateIncludeHandler(includeHandler.ReleaseAndGetAddressOf());
-		ThrowIfFailed(hr);
-
-		ComPtr<IDxcOperationResult> result = nullptr;
-
-		hr = Resource::instance()->getDxcCompiler()->Compile(
-			sourceBlob.Get(),
-			kVsFile,
-			kVsEntryPointsDxc.at(i),
-			Constant::kDxcVsShaderModel,
-			nullptr,
-			0,
-			NULL,
-			0,
-			includeHandler.Get(),
-			result.ReleaseAndGetAddressOf());
-		ThrowIfFailed(hr);
-
-		if (SUCCEEDED(hr))
-		{
-			result->GetStatus(&hr);
-		}
-
-		if (FAILED(hr))
-		{
-			Debug::outputDebugMessage(result.Get());
-			ThrowIfFalse(false);
-		}
-
-		m_vsBlobTableDxc[kVsEntryPointsDxc.at(i)] = nullptr;
-		result->GetResult(m_vsBlobTableDxc[kVsEntryPointsDxc.at(i)].ReleaseAndGetAddressOf());
-	}
-
-	for (size_t i = 0; i < kPsEntryPointsDxc.size(); ++i)
-	{
-		//Util::TimeCounter tc("dxc ps ssao");
-
-		if (m_psBlobTableDxc.find(kPsEntryPointsDxc.at(i)) != m_psBlobTableDxc.end())
-			continue;
-
-		uint32_t codePage = CP_UTF8;
-		ComPtr<IDxcBlobEncoding> sourceBlob = nullptr;
-
-		auto hr = Resource::instance()->getDxcLibrary()->CreateBlobFromFile(
-			kPsFile,
-			&codePage,
-			sourceBlob.ReleaseAndGetAddressOf());
-		ThrowIfFailed(hr);
-
-		ComPtr<IDxcIncludeHandler> includeHandler = nullptr;
-		hr = Resource::instance()->getDxcLibrary()->CreateIncludeHandler(includeHandler.ReleaseAndGetAddressOf());
-		ThrowIfFailed(hr);
-
-		ComPtr<IDxcOperationResult> result = nullptr;
-
-		hr = Resource::instance()->getDxcCompiler()->Compile(
-			sourceBlob.Get(),
-			kPsFile,
-			kPsEntryPointsDxc.at(i),
-			Constant::kDxcPsShaderModel,
-			nullptr,
-			0,
-			NULL,
-			0,
-			includeHandler.Get(),
-			result.ReleaseAndGetAddressOf());
-		ThrowIfFailed(hr);
-
-		if (SUCCEEDED(hr))
-		{
-			result->GetStatus(&hr);
-		}
-
-		if (FAILED(hr))
-		{
-			Debug::outputDebugMessage(result.Get());
-			ThrowIfFalse(false);
-		}
-
-		m_psBlobTableDxc[kPsEntryPointsDxc.at(i)] = nullptr;
-		result->GetResult(m_psBlobTableDxc[kPsEntryPointsDxc.at(i)].ReleaseAndGetAddressOf());
-	}
-#else
 	ComPtr<ID3DBlob> shaderBlob = nullptr;
 	ComPtr<ID3DBlob> errorBlob = nullptr;
 
@@ -169,14 +68,11 @@ HRESULT Ssao::compileShaders()
 		if (m_vsBlobTable.find(kVsEntryPoints.at(i)) != m_vsBlobTable.end())
 			continue;
 
-		auto result = D3DCompileFromFile(
+		auto result = Resource::instance()->getShaderCache()->load(
 			kVsFile,
 			Constant::kCompileShaderDefines,
-			D3D_COMPILE_STANDARD_FILE_INCLUDE,
 			kVsEntryPoints.at(i),
-			Constant::kVsShaderModel,
-			Constant::kCompileShaderFlags1,
-			Constant::kCompileShaderFlags2,
+			Constant::kDxcVsShaderModel,
 			shaderBlob.ReleaseAndGetAddressOf(),
 			errorBlob.ReleaseAndGetAddressOf());
 
@@ -196,14 +92,11 @@ HRESULT Ssao::compileShaders()
 		if (m_psBlobTable.find(kPsEntryPoints.at(i)) != m_psBlobTable.end())
 			continue;
 
-		auto result = D3DCompileFromFile(
+		auto result = Resource::instance()->getShaderCache()->load(
 			kPsFile,
 			Constant::kCompileShaderDefines,
-			D3D_COMPILE_STANDARD_FILE_INCLUDE,
 			kPsEntryPoints.at(i),
-			Constant::kPsShaderModel,
-			Constant::kCompileShaderFlags1,
-			Constant::kCompileShaderFlags2,
+			Constant::kDxcPsShaderModel,
 			shaderBlob.ReleaseAndGetAddressOf(),
 			errorBlob.ReleaseAndGetAddressOf());
 
@@ -215,7 +108,6 @@ HRESULT Ssao::compileShaders()
 
 		m_psBlobTable[kPsEntryPoints.at(i)] = shaderBlob;
 	}
-#endif // USE_DXC_IN_SSAO
 
 	return S_OK;
 }
@@ -270,8 +162,8 @@ HRESULT Ssao::createResource(UINT64 dstWidth, UINT dstHeight)
 	{
 		const D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {
 			.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
-			.NumDescriptors = 5,
-			.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE,
+			.NumDescriptors = kNumCbvSrv, // rewritten every frame, then staged in the ring of the frame
+			.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE,
 			.NodeMask = 0,
 		};
 
@@ -333,11 +225,10 @@ HRESULT Ssao::createRootSignature()
 	}
 	ThrowIfFailed(ret);
 
-	auto result = Resource::instance()->getDevice()->CreateRootSignature(
-		0 /* nodeMask */,
+	auto result = Resource::instance()->getPipelineCache()->createRootSignature(
 		rootSigBlob.Get()->GetBufferPointer(),
 		rootSigBlob.Get()->GetBufferSize(),
-		IID_PPV_ARGS(m_rootSignature.ReleaseAndGetAddressOf()));
+		m_rootSignature.ReleaseAndGetAddressOf());
 	ThrowIfFailed(result);
 
 	result = m_rootSignature.Get()->SetName(Util::getWideStringFromString("ssaoRootSignature").c_str());
@@ -352,17 +243,10 @@ HRESULT Ssao::createPipelineState()
 
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC gpDesc = {
 		.pRootSignature = m_rootSignature.Get(),
-#if USE_DXC_IN_SSAO
-		.VS = { m_vsBlobTableDxc.at(kVsEntryPointsDxc.at(static_cast<size_t>(Type::kSsao))).Get()->GetBufferPointer(),
-			m_vsBlobTableDxc.at(kVsEntryPointsDxc.at(static_cast<size_t>(Type::kSsao))).Get()->GetBufferSize()},
-		.PS = { m_psBlobTableDxc.at(kPsEntryPointsDxc.at(static_cast<size_t>(Type::kSsao))).Get()->GetBufferPointer(),
-			m_psBlobTableDxc.at(kPsEntryPointsDxc.at(static_cast<size_t>(Type::kSsao))).Get()->GetBufferSize()},
-#else
 		.VS = { m_vsBlobTable.at(kVsEntryPoints.at(static_cast<size_t>(Type::kSsao))).Get()->GetBufferPointer(),
 			m_vsBlobTable.at(kVsEntryPoints.at(static_cast<size_t>(Type::kSsao))).Get()->GetBufferSize()},
 		.PS = { m_psBlobTable.at(kPsEntryPoints.at(static_cast<size_t>(Type::kSsao))).Get()->GetBufferPointer(),
 			m_psBlobTable.at(kPsEntryPoints.at(static_cast<size_t>(Type::kSsao))).Get()->GetBufferSize()},
-#endif // USE_DXC_IN_SSAO
 		.DS = { nullptr, 0 },
 		.HS = { nullptr, 0 },
 		.GS = { nullptr, 0 },
@@ -386,9 +270,9 @@ HRESULT Ssao::createPipelineState()
 	gpDesc.RTVFormats[0] = Constant::kDefaultRtFormat;
 
 	{
-		auto result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+		auto result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
 			&gpDesc,
-			IID_PPV_ARGS(m_pipelineStateTable[Type::kSsao].ReleaseAndGetAddressOf()));
+			m_pipelineStateTable[Type::kSsao].ReleaseAndGetAddressOf());
 		ThrowIfFailed(result);
 
 		result = m_pipelineStateTable.at(Type::kSsao).Get()->SetName(Util::getWideStringFromString("ssaoPipelineState").c_str());
@@ -396,21 +280,14 @@ HRESULT Ssao::createPipelineState()
 	}
 
 	{
-#if USE_DXC_IN_SSAO
-		gpDesc.VS = { m_vsBlobTableDxc.at(kVsEntryPointsDxc.at(static_cast<size_t>(Type::kResolve))).Get()->GetBufferPointer(),
-			m_vsBlobTableDxc.at(kVsEntryPointsDxc.at(static_cast<size_t>(Type::kResolve))).Get()->GetBufferSize() };
-		gpDesc.PS = { m_psBlobTableDxc.at(kPsEntryPointsDxc.at(static_cast<size_t>(Type::kResolve))).Get()->GetBufferPointer(),
-			m_psBlobTableDxc.at(kPsEntryPointsDxc.at(static_cast<size_t>(Type::kResolve))).Get()->GetBufferSize() };
-#else
 		gpDesc.VS = { m_vsBlobTable.at(kVsEntryPoints.at(static_cast<size_t>(Type::kResolve))).Get()->GetBufferPointer(),
 			m_vsBlobTable.at(kVsEntryPoints.at(static_cast<size_t>(Type::kResolve))).Get()->GetBufferSize() };
 		gpDesc.PS = { m_psBlobTable.at(kPsEntryPoints.at(static_cast<size_t>(Type::kResolve))).Get()->GetBufferPointer(),
 			m_psBlobTable.at(kPsEntryPoints.at(static_cast<size_t>(Type::kResolve))).Get()->GetBufferSize() };
-#endif // USE_DXC_IN_SSAO
 
-		auto result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+		auto result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
 			&gpDesc,
-			IID_PPV_ARGS(m_pipelineStateTable[Type::kResolve].ReleaseAndGetAddressOf()));
+			m_pipelineStateTable[Type::kResolve].ReleaseAndGetAddressOf());
 		ThrowIfFailed(result);
 
 		result = m_pipelineStateTable.at(Type::kResolve).Get()->SetName(Util::getWideStringFromString("ssaoResolvePipelineState").c_str());
@@ -457,6 +334,21 @@ void Ssao::setupShaderResourceView()
 	ThrowIfFalse(m_workResource != nullptr);
 	ThrowIfFalse(m_srcSceneParamResource != nullptr);
 
+	const ViewSources sources = {
+		m_srcDepthResource.Get(),
+		m_srcNormalResource.Get(),
+		m_srcColorResource.Get(),
+		m_workResource.Get(),
+		m_srcSceneParamResource.Get(),
+	};
+
+	// the views are kept, so that the same resources give the same table and the bundles which bind it are reused
+	if (const auto it = m_cbvSrvTables.find(sources); it != m_cbvSrvTables.end())
+	{
+		m_cbvSrvTable = it->second;
+		return;
+	}
+
 	D3D12_CPU_DESCRIPTOR_HANDLE cpuDescHandle = m_workDescHeapCbvSrv.Get()->GetCPUDescriptorHandleForHeapStart();
 
 	{
@@ -510,20 +402,18 @@ void Ssao::setupShaderResourceView()
 			cpuDescHandle.ptr += Resource::instance()->getDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 		}
 	}
+
+	m_cbvSrvTable = Resource::instance()->getDescriptorAllocator()->stage(m_workDescHeapCbvSrv.Get()->GetCPUDescriptorHandleForHeapStart(), kNumCbvSrv);
+	m_cbvSrvTables.emplace(sources, m_cbvSrvTable);
 }
 
-HRESULT Ssao::renderSsao(ID3D12GraphicsCommandList* list)
+D3D12_GPU_DESCRIPTOR_HANDLE Ssao::getCbvSrvGpuDescHandle(UINT offset) const
 {
-	list->SetGraphicsRootSignature(m_rootSignature.Get());
-	list->SetPipelineState(m_pipelineStateTable.at(Type::kSsao).Get());
-
-	list->SetDescriptorHeaps(1, m_workDescHeapCbvSrv.GetAddressOf());
-	list->SetGraphicsRootDescriptorTable(0, m_workDescHeapCbvSrv.Get()->GetGPUDescriptorHandleForHeapStart());
-	list->SetGraphicsRootDescriptorTable(1, CD3DX12_GPU_DESCRIPTOR_HANDLE(
-		m_workDescHeapCbvSrv.Get()->GetGPUDescriptorHandleForHeapStart(),
-		4,
-		Resource::instance()->getDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV)));
+	return m_cbvSrvTable.getGpuHandle(offset);
+}
 
+HRESULT Ssao::renderSsao(ID3D12GraphicsCommandList* list)
+{
 	{
 		const D3D12_VIEWPORT viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(Config::kWindowWidth), static_cast<float>(Config::kWindowHeight));
 		list->RSSetViewports(1, &viewport);
@@ -540,22 +430,27 @@ HRESULT Ssao::renderSsao(ID3D12GraphicsCommandList* list)
 		Resource::instance()->getDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV));
 
 	list->OMSetRenderTargets(1, &dstRtv, false, nullptr);
-	list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-	list->IASetVertexBuffers(0, 1, CommonResource::getVertexBufferView());
 
-	list->DrawInstanced(CommonResource::getVertexCount(), 1, 0, 0);
+	const uint64_t key = BundleCache::makeKey("ssao.ssao", { reinterpret_cast<uint64_t>(this), getCbvSrvGpuDescHandle(0).ptr });
+
+	Resource::instance()->getBundleCache()->execute(list, key, [&](ID3D12GraphicsCommandList* bundle) {
+		bundle->SetGraphicsRootSignature(m_rootSignature.Get());
+		bundle->SetPipelineState(m_pipelineStateTable.at(Type::kSsao).Get());
+
+		bundle->SetGraphicsRootDescriptorTable(0, getCbvSrvGpuDescHandle(0));
+		bundle->SetGraphicsRootDescriptorTable(1, getCbvSrvGpuDescHandle(4));
+
+		bundle->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+		bundle->IASetVertexBuffers(0, 1, CommonResource::getVertexBufferView());
+
+		bundle->DrawInstanced(CommonResource::getVertexCount(), 1, 0, 0);
+		});
 
 	return S_OK;
 }
 
 HRESULT Ssao::renderToTarget(ID3D12GraphicsCommandList* list)
 {
-	list->SetGraphicsRootSignature(m_rootSignature.Get());
-	list->SetPipelineState(m_pipelineStateTable.at(Type::kResolve).Get());
-
-	list->SetDescriptorHeaps(1, m_workDescHeapCbvSrv.GetAddressOf());
-	list->SetGraphicsRootDescriptorTable(0, m_workDescHeapCbvSrv.Get()->GetGPUDescriptorHandleForHeapStart());
-
 	{
 		const D3D12_VIEWPORT viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(Config::kWindowWidth), static_cast<float>(Config::kWindowHeight));
 		list->RSSetViewports(1, &viewport);
@@ -572,10 +467,20 @@ HRESULT Ssao::renderToTarget(ID3D12GraphicsCommandList* list)
 		Resource::instance()->getDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV));
 
 	list->OMSetRenderTargets(1, &dstRtv, false, nullptr);
-	list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-	list->IASetVertexBuffers(0, 1, CommonResource::getVertexBufferView());
 
-	list->DrawInstanced(CommonResource::getVertexCount(), 1, 0, 0);
+	const uint64_t key = BundleCache::makeKey("ssao.resolve", { reinterpret_cast<uint64_t>(this), getCbvSrvGpuDescHandle(0).ptr });
+
+	Resource::instance()->getBundleCache()->execute(list, key, [&](ID3D12GraphicsCommandList* bundle) {
+		bundle->SetGraphicsRootSignature(m_rootSignature.Get());
+		bundle->SetPipelineState(m_pipelineStateTable.at(Type::kResolve).Get());
+
+		bundle->SetGraphicsRootDescriptorTable(0, getCbvSrvGpuDescHandle(0));
+
+		bundle->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+		bundle->IASetVertexBuffers(0, 1, CommonResource::getVertexBufferView());
+
+		bundle->DrawInstanced(CommonResource::getVertexCount(), 1, 0, 0);
+		});
 
 	return S_OK;
 }
@@ -5,12 +5,10 @@
 #include <array>
 #include <Windows.h>
 #include <d3d12.h>
-#include <dxcapi.h>
 #include <map>
 #include <wrl.h>
 #pragma warning(pop)
-
-#define USE_DXC_IN_SSAO (1)
+#include "descriptor_allocator.h"
 
 class Ssao
 {
@@ -38,14 +36,12 @@ private:
 
 	static constexpr LPCWSTR kVsFile = L"ssaoVertex.hlsl";
 	static constexpr LPCWSTR kPsFile = L"ssaoPixel.hlsl";
-#if USE_DXC_IN_SSAO
-	static constexpr std::array<LPCWSTR, static_cast<size_t>(Type::kEnd)> kVsEntryPointsDxc = { L"main", L"main" };
-	static constexpr std::array<LPCWSTR, static_cast<size_t>(Type::kEnd)> kPsEntryPointsDxc = { L"ssao", L"resolve" };
-#else
 	static constexpr std::array<LPCSTR, static_cast<size_t>(Type::kEnd)> kVsEntryPoints = { "main", "main" };
 	static constexpr std::array<LPCSTR, static_cast<size_t>(Type::kEnd)> kPsEntryPoints = { "ssao", "resolve" };
-#endif // USE_DXC_IN_SSAO
 	static constexpr FLOAT kClearColor[4] = { 0, 0, 0, 0 };
+	static constexpr UINT kNumCbvSrv = 5; // 4 SRVs + 1 CBV
+
+	using ViewSources = std::array<ID3D12Resource*, kNumCbvSrv>;
 
 	HRESULT compileShaders();
 	HRESULT createResource(UINT64 dstWidth, UINT dstHeight);
@@ -53,19 +49,17 @@ private:
 	HRESULT createPipelineState();
 	void setupRenderTargetView();
 	void setupShaderResourceView();
+	D3D12_GPU_DESCRIPTOR_HANDLE getCbvSrvGpuDescHandle(UINT offset) const;
 	HRESULT renderSsao(ID3D12GraphicsCommandList* list);
 	HRESULT renderToTarget(ID3D12GraphicsCommandList* list);
 
-#if USE_DXC_IN_SSAO
-	std::map<LPCWSTR, Microsoft::WRL::ComPtr<IDxcBlob>> m_vsBlobTableDxc;
-	std::map<LPCWSTR, Microsoft::WRL::ComPtr<IDxcBlob>> m_psBlobTableDxc;
-#else
 	std::map<LPCSTR, Microsoft::WRL::ComPtr<ID3DBlob>> m_vsBlobTable;
 	std::map<LPCSTR, Microsoft::WRL::ComPtr<ID3DBlob>> m_psBlobTable;
-#endif // USE_DXC_IN_SSAO
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_workResource = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_workDescHeapRtv = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_workDescHeapCbvSrv = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_workDescHeapCbvSrv = nullptr; // staging
+	DescriptorTable m_cbvSrvTable;
+	std::map<ViewSources, DescriptorTable> m_cbvSrvTables; // the scene parameters alternate by frame, so a table for each
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_vertexBuffer = nullptr;
 	D3D12_VERTEX_BUFFER_VIEW m_vbView = { };
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> m_rootSignature = nullptr;
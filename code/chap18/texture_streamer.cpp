@@ -0,0 +1,268 @@
+#include "texture_streamer.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <algorithm>
+#include <numeric>
+#pragma warning(pop)
+#include "debug.h"
+#include "loader.h"
+#include "util.h"
+
+using namespace Microsoft::WRL;
+
+TextureStreamer::~TextureStreamer()
+{
+	stop();
+}
+
+void TextureStreamer::start(uint32_t numThreads)
+{
+	ThrowIfFalse(m_threads.empty());
+	ThrowIfFalse(numThreads > 0);
+
+	m_bQuit = false;
+
+	for (uint32_t i = 0; i < numThreads; ++i)
+	{
+		m_threads.emplace_back(&TextureStreamer::run, this);
+	}
+}
+
+void TextureStreamer::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bQuit = true;
+	}
+	m_cv.notify_all();
+
+	for (auto& thread : m_threads)
+	{
+		if (thread.joinable())
+			thread.join();
+	}
+
+	m_threads.clear();
+}
+
+void TextureStreamer::request(const std::string& path, float priority, Callback callback)
+{
+	ThrowIfFalse(callback != nullptr);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_bIdle)
+		{
+			m_bIdle = false;
+			m_firstRequestTick = Util::getTick();
+		}
+
+		if (Item* item = find(path); item != nullptr)
+		{
+			item->priority = std::max(item->priority, priority);
+			item->nextPriority = std::max(item->nextPriority, priority);
+			item->callbacks.push_back(std::move(callback));
+			return;
+		}
+
+		auto item = std::make_unique<Item>();
+		{
+			item->path = path;
+			item->priority = priority;
+			item->nextPriority = priority;
+			item->callbacks.push_back(std::move(callback));
+		}
+
+		// loaded before. It does not need a decoder
+		if (Loader::instance()->findImage(path, item->resource))
+		{
+			m_decoded.push_back(std::move(item));
+			return;
+		}
+
+		m_pending.push_back(std::move(item));
+	}
+	m_cv.notify_one();
+}
+
+void TextureStreamer::prioritize(const std::string& path, float priority)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (Item* item = find(path); item != nullptr)
+	{
+		item->nextPriority = std::max(item->nextPriority, priority);
+	}
+}
+
+void TextureStreamer::update(size_t budgetInBytes)
+{
+	std::vector<std::unique_ptr<Item>> items;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// the priorities of the last frame. The decoders pick by them until the next update()
+		for (auto* list : { &m_pending, &m_decoding, &m_decoded })
+		{
+			for (auto& item : *list)
+			{
+				item->priority = item->nextPriority;
+				item->nextPriority = 0.0f;
+			}
+		}
+
+		std::vector<std::pair<float, size_t>> candidates;
+		for (const auto& item : m_decoded)
+		{
+			candidates.push_back({ item->priority, item->image.GetPixelsSize() });
+		}
+
+		for (const size_t idx : selectWithinBudget(candidates, budgetInBytes))
+		{
+			items.push_back(std::move(m_decoded.at(idx)));
+		}
+
+		m_decoded.erase(std::remove(m_decoded.begin(), m_decoded.end(), nullptr), m_decoded.end());
+	}
+
+	// the callbacks are not locked, so that they can request more
+	size_t bytesInFrame = 0;
+
+	for (auto& item : items)
+	{
+		if (FAILED(item->result))
+		{
+			Debug::debugOutputFormatString("failed to decode %s (0x%08x). The placeholder is kept\n", item->path.c_str(), static_cast<uint32_t>(item->result));
+		}
+		else if (item->resource == nullptr)
+		{
+			ThrowIfFailed(Loader::instance()->createImage(item->path, item->metadata, item->image, item->resource));
+			bytesInFrame += item->image.GetPixelsSize();
+			++m_numCreated;
+		}
+
+		for (const auto& callback : item->callbacks)
+		{
+			callback(item->resource.Get());
+		}
+	}
+
+	m_bytesCreated += bytesInFrame;
+	m_maxBytesInFrame = std::max(m_maxBytesInFrame, bytesInFrame);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_bIdle && m_pending.empty() && m_decoding.empty() && m_decoded.empty())
+	{
+		Debug::debugOutputFormatString("Texture streaming: %u textures, %zd bytes in %.1f ms, at most %zd bytes in a frame (budget %zd)\n",
+			m_numCreated, m_bytesCreated, Util::toMs(Util::getTick() - m_firstRequestTick), m_maxBytesInFrame, budgetInBytes);
+
+		m_bIdle = true;
+		m_numCreated = 0;
+		m_bytesCreated = 0;
+		m_maxBytesInFrame = 0;
+	}
+}
+
+std::vector<size_t> TextureStreamer::selectWithinBudget(const std::vector<std::pair<float, size_t>>& items, size_t budgetInBytes)
+{
+	// the earlier request first when the priorities are the same
+	std::vector<size_t> order(items.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&items](size_t a, size_t b) { return items.at(a).first > items.at(b).first; });
+
+	std::vector<size_t> selected;
+	size_t bytes = 0;
+
+	for (const size_t idx : order)
+	{
+		// stop at the first one which does not fit, so that a large texture is not passed by the small ones forever
+		if (!selected.empty() && bytes + items.at(idx).second > budgetInBytes)
+			break;
+
+		selected.push_back(idx);
+		bytes += items.at(idx).second;
+	}
+
+	return selected;
+}
+
+void TextureStreamer::run()
+{
+	// WIC needs COM on the thread which decodes the images
+	const HRESULT comResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	while (true)
+	{
+		Item* item = nullptr;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cv.wait(lock, [this]() { return m_bQuit || !m_pending.empty(); });
+
+			if (m_bQuit)
+				break;
+
+			const auto it = std::max_element(m_pending.begin(), m_pending.end(), [](const auto& a, const auto& b) { return a->priority < b->priority; });
+			item = it->get();
+			m_decoding.push_back(std::move(*it));
+			m_pending.erase(it);
+		}
+
+		item->result = Loader::decodeImage(item->path, &item->metadata, &item->image);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const auto it = std::find_if(m_decoding.begin(), m_decoding.end(), [item](const auto& p) { return p.get() == item; });
+		ThrowIfFalse(it != m_decoding.end());
+
+		m_decoded.push_back(std::move(*it));
+		m_decoding.erase(it);
+	}
+
+	if (SUCCEEDED(comResult))
+	{
+		CoUninitialize();
+	}
+}
+
+TextureStreamer::Item* TextureStreamer::find(const std::string& path)
+{
+	for (auto* items : { &m_pending, &m_decoding, &m_decoded })
+	{
+		for (const auto& item : *items)
+		{
+			if (item->path == path)
+				return item.get();
+		}
+	}
+
+	return nullptr;
+}
+
+bool TextureStreamer::selfCheck()
+{
+	constexpr size_t kBudget = 100;
+
+	// by priority within the budget
+	if (selectWithinBudget({ { 1.0f, 40 }, { 3.0f, 50 }, { 2.0f, 40 } }, kBudget) != std::vector<size_t>{ 1, 2 })
+		return false;
+
+	// a large one is taken alone rather than starved
+	if (selectWithinBudget({ { 1.0f, 10 }, { 2.0f, 300 } }, kBudget) != std::vector<size_t>{ 1 })
+		return false;
+
+	// and it is not passed by a smaller one with a lower priority
+	if (selectWithinBudget({ { 2.0f, 60 }, { 3.0f, 30 }, { 1.0f, 10 } }, 50) != std::vector<size_t>{ 1 })
+		return false;
+
+	// the earlier request first with the same priority
+	if (selectWithinBudget({ { 1.0f, 10 }, { 1.0f, 10 }, { 1.0f, 10 } }, 20) != std::vector<size_t>{ 0, 1 })
+		return false;
+
+	if (!selectWithinBudget({ }, kBudget).empty())
+		return false;
+
+	return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <DirectXTex.h>
+#include <condition_variable>
+#include <cstdint>
+#include <d3d12.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <wrl.h>
+#pragma warning(pop)
+
+// Textures decoded on background threads and created on the render thread, the highest priority first,
+// within a budget of bytes per frame. The owner draws with a placeholder until its callback gets the texture.
+class TextureStreamer
+{
+public:
+	using Callback = std::function<void(ID3D12Resource* resource)>; // nullptr when the file could not be decoded
+
+	TextureStreamer() = default;
+	TextureStreamer(const TextureStreamer&) = delete;
+	void operator=(const TextureStreamer&) = delete;
+	~TextureStreamer();
+
+	void start(uint32_t numThreads);
+	void stop();
+	// any thread. A path requested again is loaded once, with the higher priority
+	void request(const std::string& path, float priority, Callback callback);
+	// any thread. The priority of a path not created yet from the next update(), the highest of the calls in a frame.
+	// A priority lasts a frame, so the owners call this every frame while they wait
+	void prioritize(const std::string& path, float priority);
+	// on the render thread. The callbacks of the textures created in this frame run here
+	void update(size_t budgetInBytes);
+
+	// the indexes of the items to create, in priority order. The first one is taken even if it is over the budget
+	static std::vector<size_t> selectWithinBudget(const std::vector<std::pair<float, size_t>>& items, size_t budgetInBytes);
+	static bool selfCheck();
+
+private:
+	struct Item
+	{
+		std::string path;
+		float priority = 0.0f;
+		float nextPriority = 0.0f; // raised by prioritize() until the next update()
+		std::vector<Callback> callbacks;
+		HRESULT result = S_OK;
+		DirectX::TexMetadata metadata = { };
+		DirectX::ScratchImage image;
+		Microsoft::WRL::ComPtr<ID3D12Resource> resource = nullptr; // already loaded by someone else
+	};
+
+	void run();
+	Item* find(const std::string& path);
+
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::vector<std::unique_ptr<Item>> m_pending;
+	std::vector<std::unique_ptr<Item>> m_decoding;
+	std::vector<std::unique_ptr<Item>> m_decoded;
+	bool m_bQuit = false;
+
+	// reported when all the requests so far are done
+	bool m_bIdle = true;
+	LONGLONG m_firstRequestTick = 0;
+	uint32_t m_numCreated = 0;
+	size_t m_bytesCreated = 0;
+	size_t m_maxBytesInFrame = 0;
+};
@@ -23,7 +23,7 @@ HRESULT TimeStamp::init()
 	}
 
 	{
-		const D3D12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(sizeof(UINT64) * kNumOfTimestamp);
+		const D3D12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(sizeof(UINT64) * kNumOfResolved);
 		const D3D12_HEAP_PROPERTIES heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
 
 		auto result = Resource::instance()->getDevice()->CreateCommittedResource(
@@ -43,8 +43,7 @@ HRESULT TimeStamp::init()
 		Resource::instance()->getCommandQueue()->GetTimestampFrequency(&m_gpuFreq);
 		ThrowIfFalse(m_gpuFreq >= 1'000'000); // The counter frequency must be over 1 MHz
 
-		Debug::debugOutputFormatString("Time stamp freq: %zd Hz\n", m_gpuFreq);
-	}
+		Debug::debugOutputFormatString("Time stamp freq: %zd Hz\n", m_gpuFreq);	}
 
 	clear();
 
@@ -61,7 +60,7 @@ void TimeStamp::clear()
 		reinterpret_cast<void**>(&pData));
 	ThrowIfFailed(result);
 
-	for (uint32_t i = 0; i < kNumOfTimestamp; ++i)
+	for (uint32_t i = 0; i < kNumOfResolved; ++i)
 	{
 		pData[i] = 0;
 	}
@@ -75,8 +74,9 @@ void TimeStamp::set(ID3D12GraphicsCommandList* list, Index index)
 	list->EndQuery(m_tsQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, static_cast<UINT>(index));
 }
 
-void TimeStamp::resolve(ID3D12GraphicsCommandList* list)
+void TimeStamp::resolve(ID3D12GraphicsCommandList* list, uint32_t frameIndex)
 {
+	ThrowIfFalse(frameIndex < Config::kNumFramesInFlight);
 	constexpr uint32_t startIndex = 0;
 
 	list->ResolveQueryData(
@@ -85,19 +85,23 @@ void TimeStamp::resolve(ID3D12GraphicsCommandList* list)
 		startIndex,
 		kNumOfTimestamp,
 		m_tsResource.Get(),
-		0);
+		sizeof(UINT64) * kNumOfTimestamp * frameIndex);
 }
 
-float TimeStamp::getInUsec(Index index0, Index index1)
+float TimeStamp::getInUsec(Index index0, Index index1, uint32_t frameIndex)
 {
-	const size_t idx0 = static_cast<size_t>(index0);
-	const size_t idx1 = static_cast<size_t>(index1);
+	ThrowIfFalse(frameIndex < Config::kNumFramesInFlight);
+	const size_t idx0 = kNumOfTimestamp * frameIndex + static_cast<size_t>(index0);
+	const size_t idx1 = kNumOfTimestamp * frameIndex + static_cast<size_t>(index1);
 
+	// only the region of the frame, which the GPU has finished with
+	const D3D12_RANGE readRange = { sizeof(UINT64) * kNumOfTimestamp * frameIndex, sizeof(UINT64) * kNumOfTimestamp * (frameIndex + 1) };
+	const D3D12_RANGE writtenRange = { 0, 0 };
 	uint64_t* pData = nullptr;
 
 	auto result = m_tsResource->Map(
 		0,
-		nullptr,
+		&readRange,
 		reinterpret_cast<void**>(&pData));
 	ThrowIfFailed(result);
 
@@ -107,9 +111,35 @@ float TimeStamp::getInUsec(Index index0, Index index1)
 
 	const float time_us = static_cast<float>(elaps) / (m_gpuFreq / 1'000'000);
 
-	m_tsResource->Unmap(0, nullptr);
+	m_tsResource->Unmap(0, &writtenRange);
 
 	//debugOutputFormatString("[%d %d] %6.1f us (%zd %zd %zd)\n", idx0, idx1, time_us, m_gpuFreq, pData[idx1], pData[idx0]);
 	return time_us;
 }
 
+LONGLONG TimeStamp::getCpuTick(Index index, uint32_t frameIndex)
+{
+	ThrowIfFalse(frameIndex < Config::kNumFramesInFlight);
+	const size_t idx = kNumOfTimestamp * frameIndex + static_cast<size_t>(index);
+
+	const D3D12_RANGE readRange = { sizeof(UINT64) * idx, sizeof(UINT64) * (idx + 1) };
+	const D3D12_RANGE writtenRange = { 0, 0 };
+	uint64_t* pData = nullptr;
+
+	ThrowIfFailed(m_tsResource->Map(0, &readRange, reinterpret_cast<void**>(&pData)));
+	const uint64_t gpuTick = pData[idx];
+	m_tsResource->Unmap(0, &writtenRange);
+
+	if (gpuTick == 0)
+		return 0;
+
+	// the two clocks sampled at once. The time stamp is before it, so the difference is usually negative
+	UINT64 gpuCalibration = 0;
+	UINT64 cpuCalibration = 0;
+	ThrowIfFailed(Resource::instance()->getCommandQueue()->GetClockCalibration(&gpuCalibration, &cpuCalibration));
+
+	const double gpuDelta = static_cast<double>(static_cast<int64_t>(gpuTick - gpuCalibration));
+
+	return static_cast<LONGLONG>(cpuCalibration) + static_cast<LONGLONG>(gpuDelta * Util::getTickFrequency() / m_gpuFreq);
+}
+
@@ -2,11 +2,15 @@
 #pragma warning(push, 0)
 #include <codeanalysis/warnings.h>
 #pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
 #include <cstdint>
 #include <d3d12.h>
 #include <wrl.h>
 #pragma warning(pop)
+#include "config.h"
 
+// The readback buffer has a region for each frame in flight. A frame resolves into the region of its slot,
+// which is read back after beginFrame() has waited for the frame which used the slot last time.
 class TimeStamp
 {
 public:
@@ -22,11 +26,14 @@ public:
 	HRESULT init();
 	void clear();
 	void set(ID3D12GraphicsCommandList* list, Index index);
-	void resolve(ID3D12GraphicsCommandList* list);
-	float getInUsec(Index index0, Index index1);
+	void resolve(ID3D12GraphicsCommandList* list, uint32_t frameIndex);
+	float getInUsec(Index index0, Index index1, uint32_t frameIndex);
+	// when the GPU wrote the time stamp, on the clock of QueryPerformanceCounter(). 0 if the region has none yet
+	LONGLONG getCpuTick(Index index, uint32_t frameIndex);
 
 private:
 	static constexpr size_t kNumOfTimestamp = static_cast<size_t>(Index::kEnd);
+	static constexpr size_t kNumOfResolved = kNumOfTimestamp * Config::kNumFramesInFlight;
 
 	Microsoft::WRL::ComPtr<ID3D12QueryHeap> m_tsQueryHeap = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_tsResource = nullptr;
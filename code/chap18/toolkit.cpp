@@ -57,6 +57,7 @@ void Toolkit::teardown()
 	for (auto& buffer : m_constantOutputColorBuffers)
 		buffer.Reset();
 
+	Resource::instance()->getDescriptorAllocator()->free(&m_constantOutputColorTable);
 	m_constantOutputColorHeap.Reset();
 	m_rootSignature.Reset();
 	m_pipelineState.Reset();
@@ -80,19 +81,22 @@ HRESULT Toolkit::drawRect(ID3D12GraphicsCommandList* list, D3D12_VIEWPORT viewpo
 {
 	ThrowIfFalse(list != nullptr);
 
-	list->SetGraphicsRootSignature(m_rootSignature.Get());
-	list->SetPipelineState(m_pipelineStateRect.Get());
-
-	list->SetDescriptorHeaps(1, m_constantOutputColorHeap.GetAddressOf());
-	list->SetGraphicsRootDescriptorTable(0, m_constantOutputColorHeap.Get()->GetGPUDescriptorHandleForHeapStart());
-
 	list->RSSetViewports(1, &viewport);
 	list->RSSetScissorRects(1, &scissorRect);
 
-	list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_LINESTRIP);
-	list->IASetVertexBuffers(0, 1, &m_vertexBufferViews.at(static_cast<size_t>(DrawType::kRect)));
+	const uint64_t key = BundleCache::makeKey("toolkit.rect", { reinterpret_cast<uint64_t>(this) });
+
+	Resource::instance()->getBundleCache()->execute(list, key, [&](ID3D12GraphicsCommandList* bundle) {
+		bundle->SetGraphicsRootSignature(m_rootSignature.Get());
+		bundle->SetPipelineState(m_pipelineStateRect.Get());
+
+		bundle->SetGraphicsRootDescriptorTable(0, m_constantOutputColorTable.getGpuHandle());
+
+		bundle->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_LINESTRIP);
+		bundle->IASetVertexBuffers(0, 1, &m_vertexBufferViews.at(static_cast<size_t>(DrawType::kRect)));
 
-	list->DrawInstanced(static_cast<UINT>(kNumVertices.at(static_cast<size_t>(DrawType::kRect))), 1, 0, 0);
+		bundle->DrawInstanced(static_cast<UINT>(kNumVertices.at(static_cast<size_t>(DrawType::kRect))), 1, 0, 0);
+		});
 
 	return S_OK;
 }
@@ -112,14 +116,11 @@ HRESULT Toolkit::compileShaders()
 	ComPtr<ID3DBlob> errBlob = nullptr;
 
 	{
-		auto result = D3DCompileFromFile(
+		auto result = Resource::instance()->getShaderCache()->load(
 			L"toolkit_vs.hlsl",
 			nullptr,
-			D3D_COMPILE_STANDARD_FILE_INCLUDE,
 			"main",
-			Constant::kVsShaderModel,
-			0,
-			0,
+			Constant::kDxcVsShaderModel,
 			m_vsArray.at(static_cast<size_t>(DrawType::kClear)).ReleaseAndGetAddressOf(),
 			errBlob.ReleaseAndGetAddressOf());
 
@@ -129,14 +130,11 @@ HRESULT Toolkit::compileShaders()
 			ThrowIfFalse(false);
 		}
 
-		result = D3DCompileFromFile(
+		result = Resource::instance()->getShaderCache()->load(
 			L"toolkit_ps.hlsl",
 			nullptr,
-			D3D_COMPILE_STANDARD_FILE_INCLUDE,
 			"main",
-			Constant::kPsShaderModel,
-			0,
-			0,
+			Constant::kDxcPsShaderModel,
 			m_psArray.at(static_cast<size_t>(DrawType::kClear)).ReleaseAndGetAddressOf(),
 			errBlob.ReleaseAndGetAddressOf());
 
@@ -150,14 +148,11 @@ HRESULT Toolkit::compileShaders()
 	{
 		m_vsArray.at(static_cast<size_t>(DrawType::kRect)) = m_vsArray.at(static_cast<size_t>(DrawType::kClear)).Get();
 #if HAVE_RECT_SHADER
-		auto result = D3DCompileFromFile(
+		auto result = Resource::instance()->getShaderCache()->load(
 			L"toolkit_ps.hlsl",
 			nullptr,
-			D3D_COMPILE_STANDARD_FILE_INCLUDE,
 			"main2",
-			Constant::kPsShaderModel,
-			0,
-			0,
+			Constant::kDxcPsShaderModel,
 			m_psArray.at(static_cast<size_t>(DrawType::kRect)).ReleaseAndGetAddressOf(),
 			errBlob.ReleaseAndGetAddressOf());
 
@@ -214,7 +209,7 @@ HRESULT Toolkit::createConstantBuffer()
 		const D3D12_DESCRIPTOR_HEAP_DESC descHeap = {
 			.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
 			.NumDescriptors = 2,
-			.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE,
+			.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE,
 			.NodeMask = 0,
 		};
 
@@ -258,6 +253,10 @@ HRESULT Toolkit::createConstantBuffer()
 		handle.ptr += Resource::instance()->getDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 	}
 
+	m_constantOutputColorTable = Resource::instance()->getDescriptorAllocator()->stage(
+		m_constantOutputColorHeap.Get()->GetCPUDescriptorHandleForHeapStart(),
+		static_cast<uint32_t>(m_constantOutputColorBuffers.size()));
+
 	return S_OK;
 }
 
@@ -291,11 +290,10 @@ HRESULT Toolkit::createPipelineState()
 		Debug::outputDebugMessage(errBlob.Get());
 	}
 
-	result = Resource::instance()->getDevice()->CreateRootSignature(
-		0,
+	result = Resource::instance()->getPipelineCache()->createRootSignature(
 		rsBlob.Get()->GetBufferPointer(),
 		rsBlob.Get()->GetBufferSize(),
-		IID_PPV_ARGS(m_rootSignature.ReleaseAndGetAddressOf()));
+		m_rootSignature.ReleaseAndGetAddressOf());
 	ThrowIfFailed(result);
 
 	result = m_rootSignature.Get()->SetName(Util::getWideStringFromString("RootSignatureToolkit").c_str());
@@ -339,9 +337,9 @@ HRESULT Toolkit::createPipelineState()
 	gpDesc.DepthStencilState.DepthEnable = false;
 	gpDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
 
-	result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+	result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
 		&gpDesc,
-		IID_PPV_ARGS(m_pipelineState.ReleaseAndGetAddressOf()));
+		m_pipelineState.ReleaseAndGetAddressOf());
 	ThrowIfFailed(result);
 
 	result = m_pipelineState.Get()->SetName(Util::getWideStringFromString("pipelineStateToolkit").c_str());
@@ -363,9 +361,9 @@ HRESULT Toolkit::createPipelineState()
 		gpDesc.BlendState.RenderTarget[0] = blendDesc;
 	}
 
-	result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+	result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
 		&gpDesc,
-		IID_PPV_ARGS(m_pipelineStateBlend.ReleaseAndGetAddressOf()));
+		m_pipelineStateBlend.ReleaseAndGetAddressOf());
 	ThrowIfFailed(result);
 
 	result = m_pipelineStateBlend.Get()->SetName(Util::getWideStringFromString("pipelineStateBlendToolkit").c_str());
@@ -378,9 +376,9 @@ HRESULT Toolkit::createPipelineState()
 		gpDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE;
 	}
 
-	result = Resource::instance()->getDevice()->CreateGraphicsPipelineState(
+	result = Resource::instance()->getPipelineCache()->createGraphicsPipelineState(
 		&gpDesc,
-		IID_PPV_ARGS(m_pipelineStateRect.ReleaseAndGetAddressOf()));
+		m_pipelineStateRect.ReleaseAndGetAddressOf());
 	ThrowIfFailed(result);
 
 	result = m_pipelineStateBlend.Get()->SetName(Util::getWideStringFromString("pipelineStateRectToolkit").c_str());
@@ -425,27 +423,30 @@ HRESULT Toolkit::drawClearInternal(ID3D12GraphicsCommandList* list, D3D12_VIEWPO
 {
 	ThrowIfFalse(list != nullptr);
 
-	list->SetGraphicsRootSignature(m_rootSignature.Get());
+	list->RSSetViewports(1, &viewport);
+	list->RSSetScissorRects(1, &scissorRect);
 
-	if (blend)
-	{
-		list->SetPipelineState(m_pipelineStateBlend.Get());
-	}
-	else
-	{
-		list->SetPipelineState(m_pipelineState.Get());
-	}
+	const uint64_t key = BundleCache::makeKey("toolkit.clear", { reinterpret_cast<uint64_t>(this), blend ? 1ull : 0ull });
 
-	list->SetDescriptorHeaps(1, m_constantOutputColorHeap.GetAddressOf());
-	list->SetGraphicsRootDescriptorTable(0, m_constantOutputColorHeap.Get()->GetGPUDescriptorHandleForHeapStart());
+	Resource::instance()->getBundleCache()->execute(list, key, [&](ID3D12GraphicsCommandList* bundle) {
+		bundle->SetGraphicsRootSignature(m_rootSignature.Get());
 
-	list->RSSetViewports(1, &viewport);
-	list->RSSetScissorRects(1, &scissorRect);
+		if (blend)
+		{
+			bundle->SetPipelineState(m_pipelineStateBlend.Get());
+		}
+		else
+		{
+			bundle->SetPipelineState(m_pipelineState.Get());
+		}
+
+		bundle->SetGraphicsRootDescriptorTable(0, m_constantOutputColorTable.getGpuHandle());
 
-	list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	list->IASetVertexBuffers(0, 1, &m_vertexBufferViews.at(static_cast<size_t>(DrawType::kClear)));
+		bundle->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		bundle->IASetVertexBuffers(0, 1, &m_vertexBufferViews.at(static_cast<size_t>(DrawType::kClear)));
 
-	list->DrawInstanced(static_cast<UINT>(kNumVertices.at(static_cast<size_t>(DrawType::kClear))), 1, 0, 0);
+		bundle->DrawInstanced(static_cast<UINT>(kNumVertices.at(static_cast<size_t>(DrawType::kClear))), 1, 0, 0);
+		});
 
 	return S_OK;
 }
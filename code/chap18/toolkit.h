@@ -8,6 +8,7 @@
 #include <d3d12.h>
 #include <wrl.h>
 #pragma warning(pop)
+#include "descriptor_allocator.h"
 
 #define HAVE_RECT_SHADER (1)
 
@@ -66,7 +67,8 @@ private:
 	std::array<Microsoft::WRL::ComPtr<ID3DBlob>, static_cast<uint32_t>(DrawType::kEnd)> m_psArray = { };
 	std::array<Microsoft::WRL::ComPtr<ID3D12Resource>, static_cast<uint32_t>(DrawType::kEnd)> m_vertexBuffers = { };
 	std::array<Microsoft::WRL::ComPtr<ID3D12Resource>, static_cast<uint32_t>(DrawType::kEnd)> m_constantOutputColorBuffers = { };
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_constantOutputColorHeap = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_constantOutputColorHeap = nullptr; // staging
+	DescriptorTable m_constantOutputColorTable;
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> m_rootSignature = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12PipelineState> m_pipelineState = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12PipelineState> m_pipelineStateBlend = nullptr;
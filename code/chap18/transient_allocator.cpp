@@ -0,0 +1,246 @@
+#include "transient_allocator.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <algorithm>
+#include <numeric>
+#include <d3dx12.h>
+#pragma warning(pop)
+#include "debug.h"
+#include "util.h"
+
+namespace {
+	struct Range
+	{
+		uint64_t begin = 0;
+		uint64_t end = 0;
+	};
+
+	uint64_t alignUp(uint64_t value, uint64_t alignment)
+	{
+		return (alignment == 0) ? value : (value + alignment - 1) / alignment * alignment;
+	}
+} // namespace anonymous
+
+uint32_t TransientAllocator::add(const std::string& name, const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE& clearValue, D3D12_RESOURCE_STATES initialState, FrameGraph::Lifetime lifetime)
+{
+	ThrowIfFalse(m_heap == nullptr);
+	ThrowIfFalse(lifetime.first <= lifetime.last);
+
+	Entry entry = { };
+	{
+		entry.name = name;
+		entry.desc = desc;
+		entry.clearValue = clearValue;
+		entry.initialState = initialState;
+		entry.lifetime = lifetime;
+	}
+	m_entries.push_back(entry);
+
+	return static_cast<uint32_t>(m_entries.size() - 1);
+}
+
+HRESULT TransientAllocator::allocate(ID3D12Device* device)
+{
+	ThrowIfFalse(device != nullptr);
+	ThrowIfFalse(!m_entries.empty());
+
+	std::vector<Block> blocks;
+	uint64_t heapAlignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+
+	for (auto& entry : m_entries)
+	{
+		const D3D12_RESOURCE_ALLOCATION_INFO info = device->GetResourceAllocationInfo(0, 1, &entry.desc);
+		ThrowIfFalse(info.SizeInBytes != UINT64_MAX);
+
+		entry.size = info.SizeInBytes;
+		blocks.push_back({ info.SizeInBytes, info.Alignment, entry.lifetime });
+		heapAlignment = std::max(heapAlignment, info.Alignment);
+	}
+
+	std::vector<uint64_t> offsets;
+	m_heapSize = pack(blocks, &offsets);
+
+	for (size_t i = 0; i < m_entries.size(); ++i)
+	{
+		m_entries.at(i).offset = offsets.at(i);
+	}
+
+	// aliased if another resource uses any byte of the memory
+	for (auto& entry : m_entries)
+	{
+		entry.bAliased = std::any_of(m_entries.begin(), m_entries.end(), [&entry](const Entry& other) {
+			return &other != &entry && other.offset < entry.offset + entry.size && entry.offset < other.offset + other.size;
+			});
+	}
+
+	// create the heap
+	{
+		const D3D12_HEAP_DESC heapDesc = {
+			.SizeInBytes = m_heapSize,
+			.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+			.Alignment = heapAlignment,
+			.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES,
+		};
+
+		auto result = device->CreateHeap(&heapDesc, IID_PPV_ARGS(m_heap.ReleaseAndGetAddressOf()));
+		ThrowIfFailed(result);
+
+		result = m_heap.Get()->SetName(Util::getWideStringFromString("transientHeap").c_str());
+		ThrowIfFailed(result);
+	}
+
+	for (auto& entry : m_entries)
+	{
+		auto result = device->CreatePlacedResource(
+			m_heap.Get(),
+			entry.offset,
+			&entry.desc,
+			entry.initialState,
+			&entry.clearValue,
+			IID_PPV_ARGS(entry.resource.ReleaseAndGetAddressOf()));
+		ThrowIfFailed(result);
+
+		result = entry.resource.Get()->SetName(Util::getWideStringFromString(entry.name).c_str());
+		ThrowIfFailed(result);
+	}
+
+	Debug::debugOutputFormatString("Transient heap: %llu KB (committed: %llu KB, saved: %llu KB)\n",
+		getHeapSize() / 1024,
+		getCommittedSize() / 1024,
+		getSavedSize() / 1024);
+
+	return S_OK;
+}
+
+uint64_t TransientAllocator::getCommittedSize() const
+{
+	uint64_t size = 0;
+
+	for (const auto& entry : m_entries)
+	{
+		size += entry.size;
+	}
+
+	return size;
+}
+
+uint64_t TransientAllocator::pack(const std::vector<Block>& blocks, std::vector<uint64_t>* pOffsets)
+{
+	ThrowIfFalse(pOffsets != nullptr);
+
+	// the large ones first. They are the hardest to fit into a gap
+	std::vector<size_t> order(blocks.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&blocks](size_t a, size_t b) {
+		if (blocks.at(a).size != blocks.at(b).size)
+			return blocks.at(a).size > blocks.at(b).size;
+
+		return blocks.at(a).lifetime.first < blocks.at(b).lifetime.first;
+		});
+
+	pOffsets->assign(blocks.size(), 0);
+	std::vector<size_t> placed;
+	uint64_t heapSize = 0;
+
+	for (const size_t idx : order)
+	{
+		const Block& block = blocks.at(idx);
+
+		// the memory of the placed blocks which are alive at the same time
+		std::vector<Range> ranges;
+
+		for (const size_t other : placed)
+		{
+			if (overlaps(block.lifetime, blocks.at(other).lifetime))
+			{
+				ranges.push_back({ pOffsets->at(other), pOffsets->at(other) + blocks.at(other).size });
+			}
+		}
+
+		std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.begin < b.begin; });
+
+		// the lowest gap which the block fits in
+		uint64_t offset = 0;
+
+		for (const Range& range : ranges)
+		{
+			if (alignUp(offset, block.alignment) + block.size <= range.begin)
+				break;
+
+			offset = std::max(offset, range.end);
+		}
+
+		pOffsets->at(idx) = alignUp(offset, block.alignment);
+		heapSize = std::max(heapSize, pOffsets->at(idx) + block.size);
+		placed.push_back(idx);
+	}
+
+	return heapSize;
+}
+
+bool TransientAllocator::overlaps(const FrameGraph::Lifetime& a, const FrameGraph::Lifetime& b)
+{
+	return a.first <= b.last && b.first <= a.last;
+}
+
+bool TransientAllocator::selfCheck()
+{
+	constexpr uint64_t kRtSize = 3600 * 1024;
+	constexpr uint64_t kAlignment = 64 * 1024;
+
+	// the off-screen buffers of Render: color, normal, luminance, post SSAO, post bloom, post DoF
+	{
+		const std::vector<Block> blocks = {
+			{ kRtSize, kAlignment, { 2, 3 } },
+			{ kRtSize, kAlignment, { 2, 7 } },
+			{ kRtSize, kAlignment, { 2, 7 } },
+			{ kRtSize, kAlignment, { 3, 4 } },
+			{ kRtSize, kAlignment, { 4, 5 } },
+			{ kRtSize, kAlignment, { 5, 6 } },
+		};
+		std::vector<uint64_t> offsets;
+		const uint64_t heapSize = pack(blocks, &offsets);
+
+		if (heapSize != alignUp(kRtSize, kAlignment) * 3 + kRtSize)
+			return false;
+
+		// post bloom takes over color, and post DoF takes over post SSAO
+		if (offsets.at(4) != offsets.at(0) || offsets.at(5) != offsets.at(3))
+			return false;
+
+		// no two blocks which are alive at the same time share any byte
+		for (size_t i = 0; i < blocks.size(); ++i)
+		{
+			for (size_t j = i + 1; j < blocks.size(); ++j)
+			{
+				const bool bShareMemory = offsets.at(i) < offsets.at(j) + blocks.at(j).size && offsets.at(j) < offsets.at(i) + blocks.at(i).size;
+
+				if (bShareMemory && overlaps(blocks.at(i).lifetime, blocks.at(j).lifetime))
+					return false;
+			}
+		}
+	}
+
+	// a small block fits into the gap which a large one left, with its alignment
+	{
+		const std::vector<Block> blocks = {
+			{ 1000, 256, { 0, 0 } },
+			{ 100, 1, { 0, 1 } },
+			{ 300, 256, { 1, 1 } },
+		};
+		std::vector<uint64_t> offsets;
+		const uint64_t heapSize = pack(blocks, &offsets);
+
+		if (offsets.at(0) != 0 || offsets.at(1) != 1000 || offsets.at(2) != 0 || heapSize != 1100)
+			return false;
+	}
+
+	// the same pass is an overlap
+	{
+		if (!overlaps({ 1, 2 }, { 2, 3 }) || overlaps({ 1, 2 }, { 3, 3 }))
+			return false;
+	}
+
+	return true;
+}
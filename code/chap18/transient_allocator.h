@@ -0,0 +1,57 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <Windows.h>
+#include <cstdint>
+#include <d3d12.h>
+#include <string>
+#include <vector>
+#include <wrl.h>
+#pragma warning(pop)
+#include "frame_graph.h"
+
+// Places resources whose lifetimes (pass ranges from FrameGraph::getLifetime()) do not overlap
+// at the same offset of one heap. pack() only deals with sizes and pass ranges, so it also runs headless.
+class TransientAllocator
+{
+public:
+	struct Block
+	{
+		uint64_t size = 0;
+		uint64_t alignment = 0;
+		FrameGraph::Lifetime lifetime;
+	};
+
+	uint32_t add(const std::string& name, const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE& clearValue, D3D12_RESOURCE_STATES initialState, FrameGraph::Lifetime lifetime);
+	HRESULT allocate(ID3D12Device* device);
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> getResource(uint32_t idx) const { return m_entries.at(idx).resource; }
+	bool isAliased(uint32_t idx) const { return m_entries.at(idx).bAliased; }
+	uint64_t getHeapSize() const { return m_heapSize; }
+	uint64_t getCommittedSize() const; // if each resource had its own memory
+	uint64_t getSavedSize() const { return getCommittedSize() - getHeapSize(); }
+
+	// returns the size of the heap
+	static uint64_t pack(const std::vector<Block>& blocks, std::vector<uint64_t>* pOffsets);
+	static bool overlaps(const FrameGraph::Lifetime& a, const FrameGraph::Lifetime& b);
+	static bool selfCheck();
+
+private:
+	struct Entry
+	{
+		std::string name;
+		D3D12_RESOURCE_DESC desc = { };
+		D3D12_CLEAR_VALUE clearValue = { };
+		D3D12_RESOURCE_STATES initialState = D3D12_RESOURCE_STATE_COMMON;
+		FrameGraph::Lifetime lifetime;
+		uint64_t size = 0;
+		uint64_t offset = 0;
+		bool bAliased = false;
+		Microsoft::WRL::ComPtr<ID3D12Resource> resource = nullptr;
+	};
+
+	std::vector<Entry> m_entries;
+	Microsoft::WRL::ComPtr<ID3D12Heap> m_heap = nullptr;
+	uint64_t m_heapSize = 0;
+};
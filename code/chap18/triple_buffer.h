@@ -0,0 +1,48 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <array>
+#include <atomic>
+#include <cstdint>
+#pragma warning(pop)
+
+// Lock-free handoff of the latest value from one writer thread to one reader thread.
+// The writer fills getBack() and publishes it. The reader takes the newest published one with consume().
+// Neither side ever waits, and the value which the reader holds is never written.
+template<typename T>
+class TripleBuffer
+{
+public:
+	// writer side
+	T& getBack() { return m_slots.at(m_back); }
+
+	void publish()
+	{
+		const uint32_t prev = m_shared.exchange(m_back | kDirtyBit, std::memory_order_acq_rel);
+		m_back = prev & kIndexMask;
+	}
+
+	// reader side. Returns false if nothing new has been published since the last call
+	bool consume()
+	{
+		if ((m_shared.load(std::memory_order_relaxed) & kDirtyBit) == 0)
+			return false;
+
+		const uint32_t prev = m_shared.exchange(m_front, std::memory_order_acq_rel);
+		m_front = prev & kIndexMask;
+
+		return true;
+	}
+
+	const T& getFront() const { return m_slots.at(m_front); }
+
+private:
+	static constexpr uint32_t kIndexMask = 0x3;
+	static constexpr uint32_t kDirtyBit = 0x4;
+
+	std::array<T, 3> m_slots = { };
+	std::atomic<uint32_t> m_shared = 1;
+	uint32_t m_back = 0;
+	uint32_t m_front = 2;
+};
@@ -1,4 +1,9 @@
 #include "util.h"
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <cstring>
+#pragma warning(pop)
 #include "debug.h"
 
 namespace Util {
@@ -50,12 +55,9 @@ TimeCounter::~TimeCounter()
 	LARGE_INTEGER end = { };
 	ThrowIfFalse(QueryPerformanceCounter(&end));
 
-	LARGE_INTEGER freq = { };
-	ThrowIfFalse(QueryPerformanceFrequency(&freq));
-
 	auto elapsed = end.QuadPart - m_start.QuadPart;
 	elapsed *= 1'000'000; // to usec
-	elapsed /= freq.QuadPart;
+	elapsed /= getTickFrequency();
 
 	if (m_str.empty())
 		Debug::debugOutputFormatString("%zd usec\n", elapsed);
@@ -63,6 +65,57 @@ TimeCounter::~TimeCounter()
 		Debug::debugOutputFormatString("%s %zd usec\n", m_str.c_str(), elapsed);
 }
 
+LONGLONG getTick()
+{
+	LARGE_INTEGER tick = { };
+	ThrowIfFalse(QueryPerformanceCounter(&tick));
+	return tick.QuadPart;
+}
+
+LONGLONG getTickFrequency()
+{
+	// fixed at boot
+	static const LONGLONG s_freq = []() {
+		LARGE_INTEGER freq = { };
+		ThrowIfFalse(QueryPerformanceFrequency(&freq));
+		return freq.QuadPart;
+	}();
+
+	return s_freq;
+}
+
+float toUs(LONGLONG ticks)
+{
+	return static_cast<float>(ticks) * 1'000'000.0f / static_cast<float>(getTickFrequency());
+}
+
+float toMs(LONGLONG ticks)
+{
+	return static_cast<float>(ticks) * 1000.0f / static_cast<float>(getTickFrequency());
+}
+
+void Fnv1a::addBytes(const void* data, size_t size)
+{
+	if (data == nullptr)
+		return;
+
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		m_hash ^= p[i];
+		m_hash *= 0x100000001b3ull;
+	}
+}
+
+void Fnv1a::addString(const char* str)
+{
+	if (str == nullptr)
+		return;
+
+	addBytes(str, strlen(str) + 1);
+}
+
 size_t alignmentedSize(size_t size, size_t alignment)
 {
 	return (size % alignment) == 0 ? size : size + (alignment - size % alignment);
@@ -4,8 +4,10 @@
 #pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
 #include <DirectXTex.h>
 #include <Windows.h>
+#include <cstdint>
 #include <functional>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #pragma warning(pop)
 
@@ -24,6 +26,30 @@ private:
 	std::string m_str = "";
 };
 
+// QueryPerformanceCounter(). The frequency is read once
+LONGLONG getTick();
+LONGLONG getTickFrequency();
+float toUs(LONGLONG ticks);
+float toMs(LONGLONG ticks);
+
+// FNV-1a, for the keys of the caches. The values are hashed as their bytes
+class Fnv1a
+{
+public:
+	void addBytes(const void* data, size_t size);
+	void addString(const char* str);
+	template <typename T>
+	void add(const T& value)
+	{
+		static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>);
+		addBytes(&value, sizeof(value));
+	}
+	uint64_t get() const { return m_hash; }
+
+private:
+	uint64_t m_hash = 0xcbf29ce484222325ull;
+};
+
 void init();
 
 size_t alignmentedSize(size_t size, size_t alignment);
@@ -0,0 +1,105 @@
+#include "worker_pool.h"
+#include "debug.h"
+
+WorkerPool::~WorkerPool()
+{
+	stop();
+}
+
+void WorkerPool::start(uint32_t numThreads)
+{
+	ThrowIfFalse(m_threads.empty());
+	ThrowIfFalse(numThreads > 0);
+
+	m_bQuit = false;
+
+	for (uint32_t i = 0; i < numThreads; ++i)
+	{
+		m_threads.emplace_back(&WorkerPool::run, this);
+	}
+}
+
+void WorkerPool::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bQuit = true;
+	}
+	m_taskCv.notify_all();
+
+	for (auto& thread : m_threads)
+	{
+		if (thread.joinable())
+			thread.join();
+	}
+
+	m_threads.clear();
+}
+
+void WorkerPool::push(std::function<void()> task)
+{
+	// no thread: run the task in place so the callers do not need a special path
+	if (m_threads.empty())
+	{
+		task();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+	}
+	m_taskCv.notify_one();
+}
+
+void WorkerPool::waitIdle()
+{
+	std::exception_ptr exception = nullptr;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_idleCv.wait(lock, [this]() { return m_tasks.empty() && m_numRunning == 0; });
+		std::swap(exception, m_exception);
+	}
+
+	if (exception)
+		std::rethrow_exception(exception);
+}
+
+void WorkerPool::run()
+{
+	while (true)
+	{
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_taskCv.wait(lock, [this]() { return m_bQuit || !m_tasks.empty(); });
+
+			if (m_tasks.empty())
+				return; // quit
+
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+			++m_numRunning;
+		}
+
+		try
+		{
+			task();
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (!m_exception)
+				m_exception = std::current_exception();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			--m_numRunning;
+		}
+		m_idleCv.notify_all();
+	}
+}
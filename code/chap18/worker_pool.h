@@ -0,0 +1,42 @@
+#pragma once
+#pragma warning(push, 0)
+#include <codeanalysis/warnings.h>
+#pragma warning(disable: ALL_CODE_ANALYSIS_WARNINGS)
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#pragma warning(pop)
+
+// Fixed number of threads which run pushed tasks in FIFO order.
+// An exception thrown in a task is re-thrown by waitIdle() on the calling thread.
+class WorkerPool
+{
+public:
+	WorkerPool() = default;
+	WorkerPool(const WorkerPool&) = delete;
+	void operator=(const WorkerPool&) = delete;
+	~WorkerPool();
+
+	void start(uint32_t numThreads);
+	void stop();
+	void push(std::function<void()> task);
+	void waitIdle();
+	uint32_t getNumThreads() const { return static_cast<uint32_t>(m_threads.size()); }
+
+private:
+	void run();
+
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_taskCv;
+	std::condition_variable m_idleCv;
+	std::deque<std::function<void()>> m_tasks;
+	uint32_t m_numRunning = 0;
+	bool m_bQuit = false;
+	std::exception_ptr m_exception = nullptr;
+};